@@ -845,6 +845,16 @@ unsigned char binaryConversion( float* f1, float* f2 );
 /* compute LBD descriptors using EDLine extractor */
 int computeLBD( ScaleLines &keyLines, bool useDetectionData = false );
 
+/* compute LBD descriptors of the lines in a single LineVec */
+void computeLBDOfLines( LinesVec &lines, bool useDetectionData ) const;
+
+/* parallel loop bodies for per-octave line extraction and per-line LBD computation */
+class EDLineInvoker;
+class LBDInvoker;
+
+/* parallel loop body for batch detection and description */
+class BatchInvoker;
+
 /* gathers lines in groups using EDLine extractor.
  Each group contains the same line, detected in different octaves */
 int OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines );
@@ -1247,18 +1257,12 @@ UINT64 N;
 /** Table of original full-length codes */
 cv::Mat codes;
 
-/** Counter for eliminating duplicate results (it is not thread safe) */
-bitarray *counter;
-
 /** Array of m hashtables */
 SparseHashtable *H;
 
 /** Volume of a b-bit Hamming ball with radius s (for s = 0 to d) */
 UINT32 *xornum;
 
-/** Used within generation of binary codes at a certain Hamming distance */
-int power[100];
-
 /** constructor */
 Mihasher();
 
@@ -1271,16 +1275,21 @@ Mihasher( int B, int m );
 /** K setter */
 void setK( int K );
 
-/** populate tables */
+/** populate tables (codes are appended to the ones already indexed) */
 void populate( cv::Mat & codes, UINT32 N, int dim1codes );
 
-/** execute a batch query */
+/** execute a batch query (queries are answered concurrently) */
 void batchquery( UINT32 * results, UINT32 *numres/*, qstat *stats*/, const cv::Mat & q, UINT32 numq, int dim1queries );
 
 private:
 
-/** execute a single query */
-void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, UINT8 *q, UINT64 * chunks, UINT32 * res );
+/** execute a single query; counter (for eliminating duplicate results), power (used within
+ generation of binary codes at a certain Hamming distance), chunks and res are scratch buffers
+ owned by the calling thread */
+void query( UINT32 * results, UINT32* numres/*, qstat *stats*/, const UINT8 *q, UINT64 * chunks, UINT32 * res, bitarray& counter, int* power );
+
+/** parallel loop body for batch queries */
+class QueryInvoker;
 };
 
 /** retrieve Hamming distances */
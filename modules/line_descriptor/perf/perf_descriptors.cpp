@@ -75,3 +75,27 @@ PERF_TEST_P(file_str, descriptors, testing::Values(IMAGES))
   SANITY_CHECK_NOTHING();
 
 }
+
+PERF_TEST_P(file_str, descriptors_batch, testing::Values(IMAGES))
+{
+  std::string filename = getDataPath( GetParam() );
+
+  Mat frame = imread( filename, 1 );
+
+  if( frame.empty() )
+    FAIL()<< "Unable to load source image " << filename;
+
+  std::vector<Mat> frames( 4, frame );
+  std::vector<Mat> descriptors;
+  std::vector<std::vector<KeyLine> > keylines;
+  Ptr<BinaryDescriptor> bd = BinaryDescriptor::createBinaryDescriptor();
+  bd->detect( frames, keylines );
+
+  TEST_CYCLE()
+  {
+    bd->compute( frames, keylines, descriptors );
+  }
+
+  SANITY_CHECK_NOTHING();
+
+}
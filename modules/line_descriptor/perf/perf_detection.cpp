@@ -136,3 +136,26 @@ PERF_TEST_P(file_str, detect_lsd, testing::Values(IMAGES))
   SANITY_CHECK_NOTHING();
 
 }
+
+PERF_TEST_P(file_str, detect_batch, testing::Values(IMAGES))
+{
+  std::string filename = getDataPath( GetParam() );
+
+  Mat frame = imread( filename, 1 );
+
+  if( frame.empty() )
+    FAIL()<< "Unable to load source image " << filename;
+
+  std::vector<Mat> frames( 4, frame );
+  std::vector<std::vector<KeyLine> > keylines;
+  Ptr<BinaryDescriptor> bd = BinaryDescriptor::createBinaryDescriptor();
+
+  TEST_CYCLE()
+  {
+    keylines.clear();
+    bd->detect( frames, keylines );
+  }
+
+  SANITY_CHECK_NOTHING();
+
+}
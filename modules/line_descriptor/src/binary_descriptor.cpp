@@ -369,6 +369,34 @@ void BinaryDescriptor::computeGaussianPyramid( const Mat& image, const int numOc
   }
 }
 
+/* computes Sobel's derivatives for a range of octaves */
+class SobelInvoker : public ParallelLoopBody
+{
+ public:
+  SobelInvoker( const std::vector<cv::Mat>& images, std::vector<cv::Mat>& dxImgs, std::vector<cv::Mat>& dyImgs ) :
+      images_( images ),
+      dxImgs_( dxImgs ),
+      dyImgs_( dyImgs )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    for ( int sobelCnt = range.start; sobelCnt < range.end; sobelCnt++ )
+    {
+      cv::Sobel( images_[sobelCnt], dxImgs_[sobelCnt], CV_16SC1, 1, 0, 3 );
+      cv::Sobel( images_[sobelCnt], dyImgs_[sobelCnt], CV_16SC1, 0, 1, 3 );
+    }
+  }
+
+ private:
+  SobelInvoker& operator=( const SobelInvoker& );
+
+  const std::vector<cv::Mat>& images_;
+  std::vector<cv::Mat>& dxImgs_;
+  std::vector<cv::Mat>& dyImgs_;
+};
+
 /* compute Sobel's derivatives */
 void BinaryDescriptor::computeSobel( const cv::Mat& image, const int numOctaves )
 {
@@ -386,15 +414,8 @@ void BinaryDescriptor::computeSobel( const cv::Mat& image, const int numOctaves
   dxImg_vector.resize( octaveImages.size() );
   dyImg_vector.resize( octaveImages.size() );
 
-  /* compute derivatives */
-  for ( size_t sobelCnt = 0; sobelCnt < octaveImages.size(); sobelCnt++ )
-  {
-    dxImg_vector[sobelCnt].create( images_sizes[sobelCnt].height, images_sizes[sobelCnt].width, CV_16SC1 );
-    dyImg_vector[sobelCnt].create( images_sizes[sobelCnt].height, images_sizes[sobelCnt].width, CV_16SC1 );
-
-    cv::Sobel( octaveImages[sobelCnt], dxImg_vector[sobelCnt], CV_16SC1, 1, 0, 3 );
-    cv::Sobel( octaveImages[sobelCnt], dyImg_vector[sobelCnt], CV_16SC1, 0, 1, 3 );
-  }
+  /* compute derivatives, octaves are independent from each other */
+  parallel_for_( Range( 0, (int) octaveImages.size() ), SobelInvoker( octaveImages, dxImg_vector, dyImg_vector ) );
 }
 
 /* utility function for conversion of an LBD descriptor to its binary representation */
@@ -427,6 +448,56 @@ void BinaryDescriptor::detect( const Mat& image, CV_OUT std::vector<KeyLine>& ke
   detectImpl( image, keylines, mask );
 }
 
+/* detects lines or computes descriptors on a range of images of a batch; since detection and
+ * description keep per-image state in the descriptor, every range works on its own copy */
+class BinaryDescriptor::BatchInvoker : public ParallelLoopBody
+{
+ public:
+  BatchInvoker( const Params& params, const std::vector<Mat>& images, const std::vector<Mat>& masks, std::vector<std::vector<KeyLine> >& keylines ) :
+      params_( params ),
+      images_( images ),
+      masks_( &masks ),
+      keylines_( keylines ),
+      descriptors_( NULL ),
+      returnFloatDescr_( false )
+  {
+  }
+
+  BatchInvoker( const Params& params, const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, std::vector<Mat>& descriptors,
+                bool returnFloatDescr ) :
+      params_( params ),
+      images_( images ),
+      masks_( NULL ),
+      keylines_( keylines ),
+      descriptors_( &descriptors ),
+      returnFloatDescr_( returnFloatDescr )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    BinaryDescriptor worker( params_ );
+    for ( int i = range.start; i < range.end; i++ )
+    {
+      if( descriptors_ != NULL )
+        worker.computeImpl( images_[i], keylines_[i], ( *descriptors_ )[i], returnFloatDescr_, false );
+
+      else
+        worker.detectImpl( images_[i], keylines_[i], masks_->empty() ? Mat() : ( *masks_ )[i] );
+    }
+  }
+
+ private:
+  BatchInvoker& operator=( const BatchInvoker& );
+
+  const Params& params_;
+  const std::vector<Mat>& images_;
+  const std::vector<Mat>* masks_;
+  std::vector<std::vector<KeyLine> >& keylines_;
+  std::vector<Mat>* descriptors_;
+  bool returnFloatDescr_;
+};
+
 /* requires line detection (more than one image) */
 void BinaryDescriptor::detect( const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, const std::vector<Mat>& masks ) const
 {
@@ -437,15 +508,20 @@ void BinaryDescriptor::detect( const std::vector<Mat>& images, std::vector<std::
     return;
   }
 
-  /* detect lines from each image */
-  for ( size_t counter = 0; counter < images.size(); counter++ )
+  if( !masks.empty() && masks.size() != images.size() )
+    throw std::runtime_error( "Masks error while detecting lines: please provide one mask per image" );
+
+  /* check masks before any work is started */
+  for ( size_t counter = 0; counter < masks.size(); counter++ )
   {
     if( masks[counter].data != NULL && ( masks[counter].size() != images[counter].size() || masks[counter].type() != CV_8UC1 ) )
       throw std::runtime_error( "Masks error while detecting lines: please check their dimensions and that data types are CV_8UC1" );
-
-    else
-      detectImpl( images[counter], keylines[counter], masks[counter] );
   }
+
+  keylines.resize( images.size() );
+
+  /* detect lines from each image */
+  parallel_for_( Range( 0, (int) images.size() ), BatchInvoker( params, images, masks, keylines ) );
 }
 
 void BinaryDescriptor::detectImpl( const Mat& imageSrc, std::vector<KeyLine>& keylines, const Mat& mask ) const
@@ -530,8 +606,11 @@ void BinaryDescriptor::compute( const Mat& image, CV_OUT CV_IN_OUT std::vector<K
 void BinaryDescriptor::compute( const std::vector<Mat>& images, std::vector<std::vector<KeyLine> >& keylines, std::vector<Mat>& descriptors,
                                 bool returnFloatDescr ) const
 {
-  for ( size_t i = 0; i < images.size(); i++ )
-    computeImpl( images[i], keylines[i], descriptors[i], returnFloatDescr, false );
+  CV_Assert( keylines.size() == images.size() );
+  descriptors.resize( images.size() );
+
+  /* compute descriptors of each image */
+  parallel_for_( Range( 0, (int) images.size() ), BatchInvoker( params, images, keylines, descriptors, returnFloatDescr ) );
 }
 
 /* implementation of descriptors computation */
@@ -683,6 +762,31 @@ void BinaryDescriptor::computeImpl( const Mat& imageSrc, std::vector<KeyLine>& k
 
 }
 
+/* runs EDLine detection on a range of octaves, each with its own detector */
+class BinaryDescriptor::EDLineInvoker : public ParallelLoopBody
+{
+ public:
+  EDLineInvoker( std::vector<Ptr<EDLineDetector> >& detectors, std::vector<cv::Mat>& images, std::vector<int>& results ) :
+      detectors_( detectors ),
+      images_( images ),
+      results_( results )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    for ( int octaveCount = range.start; octaveCount < range.end; octaveCount++ )
+      results_[octaveCount] = detectors_[octaveCount]->EDline( images_[octaveCount] );
+  }
+
+ private:
+  EDLineInvoker& operator=( const EDLineInvoker& );
+
+  std::vector<Ptr<EDLineDetector> >& detectors_;
+  std::vector<cv::Mat>& images_;
+  std::vector<int>& results_;
+};
+
 int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
 {
 
@@ -694,34 +798,36 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
   float curSigma2 = 1.0;  //[sqrt(2)]^0=1;
   double factor = sqrt( 2.0 );  //the down sample factor between connective two octave images
 
-  /* loop over number of octaves */
+  /* build the blurred octave images; each level depends on the previous one */
+  std::vector<cv::Mat> blurred( params.numOfOctave_ );
   for ( int octaveCount = 0; octaveCount < params.numOfOctave_; octaveCount++ )
   {
-    /* matrix storing results from blurring processes */
-    cv::Mat blur;
-
     /* apply Gaussian blur */
     float increaseSigma = sqrt( curSigma2 - preSigma2 );
-    cv::GaussianBlur( image, blur, cv::Size( params.ksize_, params.ksize_ ), increaseSigma );
-    images_sizes[octaveCount] = blur.size();
-
-    /* for current octave, extract lines */
-    if( ( edLineVec_[octaveCount]->EDline( blur ) ) != 1 )
-    {
-      return -1;
-    }
-
-    /* update number of total extracted lines */
-    numOfFinalLine += edLineVec_[octaveCount]->lines_.numOfLines;
+    cv::GaussianBlur( image, blurred[octaveCount], cv::Size( params.ksize_, params.ksize_ ), increaseSigma );
+    images_sizes[octaveCount] = blurred[octaveCount].size();
 
     /* resize image for next level of pyramid */
-    cv::resize( blur, image, cv::Size(), ( 1.f / factor ), ( 1.f / factor ) );
+    if( octaveCount + 1 < params.numOfOctave_ )
+      cv::resize( blurred[octaveCount], image, cv::Size(), ( 1.f / factor ), ( 1.f / factor ) );
 
     /* update sigma values */
     preSigma2 = curSigma2;
     curSigma2 = curSigma2 * 2;
+  }
+
+  /* extract lines from all octaves concurrently: every octave owns its EDLineDetector */
+  std::vector<int> results( params.numOfOctave_, 0 );
+  parallel_for_( Range( 0, params.numOfOctave_ ), EDLineInvoker( edLineVec_, blurred, results ) );
 
-  } /* end of loop over number of octaves */
+  for ( int octaveCount = 0; octaveCount < params.numOfOctave_; octaveCount++ )
+  {
+    if( results[octaveCount] != 1 )
+      return -1;
+
+    /* update number of total extracted lines */
+    numOfFinalLine += edLineVec_[octaveCount]->lines_.numOfLines;
+  }
 
   /* prepare a vector to store octave information associated to extracted lines */
   std::vector < OctaveLine > octaveLines( numOfFinalLine );
@@ -1020,12 +1126,42 @@ int BinaryDescriptor::OctaveKeyLines( cv::Mat& image, ScaleLines &keyLines )
   return 1;
 }
 
+/* describes the lines of a range of LineVecs, each LineVec being independent from the others */
+class BinaryDescriptor::LBDInvoker : public ParallelLoopBody
+{
+ public:
+  LBDInvoker( const BinaryDescriptor& bd, ScaleLines& keyLines, bool useDetectionData ) :
+      bd_( bd ),
+      keyLines_( keyLines ),
+      useDetectionData_( useDetectionData )
+  {
+  }
+
+  void operator()( const Range& range ) const
+  {
+    for ( int lineIDInScaleVec = range.start; lineIDInScaleVec < range.end; lineIDInScaleVec++ )
+      bd_.computeLBDOfLines( keyLines_[lineIDInScaleVec], useDetectionData_ );
+  }
+
+ private:
+  LBDInvoker& operator=( const LBDInvoker& );
+
+  const BinaryDescriptor& bd_;
+  ScaleLines& keyLines_;
+  bool useDetectionData_;
+};
+
 int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
+{
+  parallel_for_( Range( 0, (int) keyLines.size() ), LBDInvoker( *this, keyLines, useDetectionData ) );
+  return 1;
+}
+
+void BinaryDescriptor::computeLBDOfLines( LinesVec &lines, bool useDetectionData ) const
 {
   //the default length of the band is the line length.
-  short numOfFinalLine = (short) keyLines.size();
-  float *dL = new float[2];  //line direction cos(dir), sin(dir)
-  float *dO = new float[2];  //the clockwise orthogonal vector of line direction.
+  float dL[2];  //line direction cos(dir), sin(dir)
+  float dO[2];  //the clockwise orthogonal vector of line direction.
   short heightOfLSP = (short) ( params.widthOfBand_ * NUM_OF_BANDS );  //the height of line support region;
   short descriptor_size = NUM_OF_BANDS * 8;  //each band, we compute the m( pgdL, ngdL,  pgdO, ngdO) and std( pgdL, ngdL,  pgdO, ngdO);
   float pgdLRowSum;  //the summation of {g_dL |g_dL>0 } for each row of the region;
@@ -1037,14 +1173,14 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
   float pgdO2RowSum;  //the summation of {g_dO^2 |g_dO>0 } for each row of the region;
   float ngdO2RowSum;  //the summation of {g_dO^2 |g_dO<0 } for each row of the region;
 
-  float *pgdLBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL |g_dL>0 } for each band of the region;
-  float *ngdLBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL |g_dL<0 } for each band of the region;
-  float *pgdL2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL>0 } for each band of the region;
-  float *ngdL2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL<0 } for each band of the region;
-  float *pgdOBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO |g_dO>0 } for each band of the region;
-  float *ngdOBandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO |g_dO<0 } for each band of the region;
-  float *pgdO2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO>0 } for each band of the region;
-  float *ngdO2BandSum = new float[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO<0 } for each band of the region;
+  float pgdLBandSum[NUM_OF_BANDS];  //the summation of {g_dL |g_dL>0 } for each band of the region;
+  float ngdLBandSum[NUM_OF_BANDS];  //the summation of {g_dL |g_dL<0 } for each band of the region;
+  float pgdL2BandSum[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL>0 } for each band of the region;
+  float ngdL2BandSum[NUM_OF_BANDS];  //the summation of {g_dL^2 |g_dL<0 } for each band of the region;
+  float pgdOBandSum[NUM_OF_BANDS];  //the summation of {g_dO |g_dO>0 } for each band of the region;
+  float ngdOBandSum[NUM_OF_BANDS];  //the summation of {g_dO |g_dO<0 } for each band of the region;
+  float pgdO2BandSum[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO>0 } for each band of the region;
+  float ngdO2BandSum[NUM_OF_BANDS];  //the summation of {g_dO^2 |g_dO<0 } for each band of the region;
 
   short numOfBitsBand = NUM_OF_BANDS * sizeof(float);
   short lengthOfLSP;  //the length of line support region, varies with lines
@@ -1059,144 +1195,156 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
   float gDL;  //store the gradient projection of pixels in support region along dL vector
   float gDO;  //store the gradient projection of pixels in support region along dO vector
   short imageWidth, imageHeight, realWidth;
-  short *pdxImg, *pdyImg;
+  const short *pdxImg, *pdyImg;
   float *desVec;
 
-  short sameLineSize;
+  short sameLineSize = (short) lines.size();
   short octaveCount;
   OctaveSingleLine *pSingleLine;
-  /* loop over list of LineVec */
-  for ( short lineIDInScaleVec = 0; lineIDInScaleVec < numOfFinalLine; lineIDInScaleVec++ )
+  /* loop over current LineVec's lines */
+  for ( short lineIDInSameLine = 0; lineIDInSameLine < sameLineSize; lineIDInSameLine++ )
   {
-    sameLineSize = (short) ( keyLines[lineIDInScaleVec].size() );
-    /* loop over current LineVec's lines */
-    for ( short lineIDInSameLine = 0; lineIDInSameLine < sameLineSize; lineIDInSameLine++ )
-    {
-      /* get a line in current LineVec and its original ID in its octave */
-      pSingleLine = & ( keyLines[lineIDInScaleVec][lineIDInSameLine] );
-      octaveCount = (short) pSingleLine->octaveCount;
+    /* get a line in current LineVec and its original ID in its octave */
+    pSingleLine = & ( lines[lineIDInSameLine] );
+    octaveCount = (short) pSingleLine->octaveCount;
 
-      if( useDetectionData )
-      {
-        /* retrieve associated dxImg and dyImg */
-        pdxImg = edLineVec_[octaveCount]->dxImg_.ptr<short>();
-        pdyImg = edLineVec_[octaveCount]->dyImg_.ptr<short>();
-
-        /* get image size to work on from real one */
-        realWidth = (short) edLineVec_[octaveCount]->imageWidth;
-        imageWidth = realWidth - 1;
-        imageHeight = (short) ( edLineVec_[octaveCount]->imageHeight - 1 );
-      }
+    if( useDetectionData )
+    {
+      /* retrieve associated dxImg and dyImg */
+      pdxImg = edLineVec_[octaveCount]->dxImg_.ptr<short>();
+      pdyImg = edLineVec_[octaveCount]->dyImg_.ptr<short>();
+
+      /* get image size to work on from real one */
+      realWidth = (short) edLineVec_[octaveCount]->imageWidth;
+      imageWidth = realWidth - 1;
+      imageHeight = (short) ( edLineVec_[octaveCount]->imageHeight - 1 );
+    }
 
-      else
-      {
-        /* retrieve associated dxImg and dyImg */
-        pdxImg = dxImg_vector[octaveCount].ptr<short>();
-        pdyImg = dyImg_vector[octaveCount].ptr<short>();
-
-        /* get image size to work on from real one */
-        realWidth = (short) images_sizes[octaveCount].width;
-        imageWidth = realWidth - 1;
-        imageHeight = (short) ( images_sizes[octaveCount].height - 1 );
-      }
+    else
+    {
+      /* retrieve associated dxImg and dyImg */
+      pdxImg = dxImg_vector[octaveCount].ptr<short>();
+      pdyImg = dyImg_vector[octaveCount].ptr<short>();
+
+      /* get image size to work on from real one */
+      realWidth = (short) images_sizes[octaveCount].width;
+      imageWidth = realWidth - 1;
+      imageHeight = (short) ( images_sizes[octaveCount].height - 1 );
+    }
 
-      /* initialize memory areas */
-      memset( pgdLBandSum, 0, numOfBitsBand );
-      memset( ngdLBandSum, 0, numOfBitsBand );
-      memset( pgdL2BandSum, 0, numOfBitsBand );
-      memset( ngdL2BandSum, 0, numOfBitsBand );
-      memset( pgdOBandSum, 0, numOfBitsBand );
-      memset( ngdOBandSum, 0, numOfBitsBand );
-      memset( pgdO2BandSum, 0, numOfBitsBand );
-      memset( ngdO2BandSum, 0, numOfBitsBand );
-
-      /* get length of line and its half */
-      lengthOfLSP = (short) keyLines[lineIDInScaleVec][lineIDInSameLine].numOfPixels;
-      halfWidth = ( lengthOfLSP - 1 ) / 2;
-
-      /* get middlepoint of line */
-      lineMiddlePointX = (float) ( 0.5 * ( pSingleLine->sPointInOctaveX + pSingleLine->ePointInOctaveX ) );
-      lineMiddlePointY = (float) ( 0.5 * ( pSingleLine->sPointInOctaveY + pSingleLine->ePointInOctaveY ) );
-
-      /*1.rotate the local coordinate system to the line direction (direction is the angle
-       between positive line direction and positive X axis)
-       *2.compute the gradient projection of pixels in line support region*/
-
-      /* get the vector representing original image reference system after rotation to aligh with
-       line's direction */
-      dL[0] = cos( pSingleLine->direction );
-      dL[1] = sin( pSingleLine->direction );
-
-      /* set the clockwise orthogonal vector of line direction */
-      dO[0] = -dL[1];
-      dO[1] = dL[0];
-
-      /* get rotated reference frame */
-      sCorX0 = -dL[0] * halfWidth + dL[1] * halfHeight + lineMiddlePointX;  //hID =0; wID = 0;
-      sCorY0 = -dL[1] * halfWidth - dL[0] * halfHeight + lineMiddlePointY;
-
-      /* BIAS::Matrix<float> gDLMat(heightOfLSP,lengthOfLSP) */
-      for ( short hID = 0; hID < heightOfLSP; hID++ )
-      {
-        /*initialization */
-        sCorX = sCorX0;
-        sCorY = sCorY0;
+    /* initialize memory areas */
+    memset( pgdLBandSum, 0, numOfBitsBand );
+    memset( ngdLBandSum, 0, numOfBitsBand );
+    memset( pgdL2BandSum, 0, numOfBitsBand );
+    memset( ngdL2BandSum, 0, numOfBitsBand );
+    memset( pgdOBandSum, 0, numOfBitsBand );
+    memset( ngdOBandSum, 0, numOfBitsBand );
+    memset( pgdO2BandSum, 0, numOfBitsBand );
+    memset( ngdO2BandSum, 0, numOfBitsBand );
+
+    /* get length of line and its half */
+    lengthOfLSP = (short) lines[lineIDInSameLine].numOfPixels;
+    halfWidth = ( lengthOfLSP - 1 ) / 2;
+
+    /* get middlepoint of line */
+    lineMiddlePointX = (float) ( 0.5 * ( pSingleLine->sPointInOctaveX + pSingleLine->ePointInOctaveX ) );
+    lineMiddlePointY = (float) ( 0.5 * ( pSingleLine->sPointInOctaveY + pSingleLine->ePointInOctaveY ) );
+
+    /*1.rotate the local coordinate system to the line direction (direction is the angle
+     between positive line direction and positive X axis)
+     *2.compute the gradient projection of pixels in line support region*/
+
+    /* get the vector representing original image reference system after rotation to aligh with
+     line's direction */
+    dL[0] = cos( pSingleLine->direction );
+    dL[1] = sin( pSingleLine->direction );
+
+    /* set the clockwise orthogonal vector of line direction */
+    dO[0] = -dL[1];
+    dO[1] = dL[0];
+
+    /* get rotated reference frame */
+    sCorX0 = -dL[0] * halfWidth + dL[1] * halfHeight + lineMiddlePointX;  //hID =0; wID = 0;
+    sCorY0 = -dL[1] * halfWidth - dL[0] * halfHeight + lineMiddlePointY;
+
+    /* BIAS::Matrix<float> gDLMat(heightOfLSP,lengthOfLSP) */
+    for ( short hID = 0; hID < heightOfLSP; hID++ )
+    {
+      /*initialization */
+      sCorX = sCorX0;
+      sCorY = sCorY0;
 
-        pgdLRowSum = 0;
-        ngdLRowSum = 0;
-        pgdORowSum = 0;
-        ngdORowSum = 0;
+      pgdLRowSum = 0;
+      ngdLRowSum = 0;
+      pgdORowSum = 0;
+      ngdORowSum = 0;
 
-        for ( short wID = 0; wID < lengthOfLSP; wID++ )
+      for ( short wID = 0; wID < lengthOfLSP; wID++ )
+      {
+        tempCor = (short) round( sCorX );
+        xCor = ( tempCor < 0 ) ? 0 : ( tempCor > imageWidth ) ? imageWidth : tempCor;
+        tempCor = (short) round( sCorY );
+        yCor = ( tempCor < 0 ) ? 0 : ( tempCor > imageHeight ) ? imageHeight : tempCor;
+
+        /* To achieve rotation invariance, each simple gradient is rotated aligned with
+         * the line direction and clockwise orthogonal direction.*/
+        dx = pdxImg[yCor * realWidth + xCor];
+        dy = pdyImg[yCor * realWidth + xCor];
+        gDL = dx * dL[0] + dy * dL[1];
+        gDO = dx * dO[0] + dy * dO[1];
+        if( gDL > 0 )
         {
-          tempCor = (short) round( sCorX );
-          xCor = ( tempCor < 0 ) ? 0 : ( tempCor > imageWidth ) ? imageWidth : tempCor;
-          tempCor = (short) round( sCorY );
-          yCor = ( tempCor < 0 ) ? 0 : ( tempCor > imageHeight ) ? imageHeight : tempCor;
-
-          /* To achieve rotation invariance, each simple gradient is rotated aligned with
-           * the line direction and clockwise orthogonal direction.*/
-          dx = pdxImg[yCor * realWidth + xCor];
-          dy = pdyImg[yCor * realWidth + xCor];
-          gDL = dx * dL[0] + dy * dL[1];
-          gDO = dx * dO[0] + dy * dO[1];
-          if( gDL > 0 )
-          {
-            pgdLRowSum += gDL;
-          }
-          else
-          {
-            ngdLRowSum -= gDL;
-          }
-          if( gDO > 0 )
-          {
-            pgdORowSum += gDO;
-          }
-          else
-          {
-            ngdORowSum -= gDO;
-          }
-          sCorX += dL[0];
-          sCorY += dL[1];
-          /* gDLMat[hID][wID] = gDL; */
+          pgdLRowSum += gDL;
         }
-        sCorX0 -= dL[1];
-        sCorY0 += dL[0];
-        coefInGaussion = (float) gaussCoefG_[hID];
-        pgdLRowSum = coefInGaussion * pgdLRowSum;
-        ngdLRowSum = coefInGaussion * ngdLRowSum;
-        pgdL2RowSum = pgdLRowSum * pgdLRowSum;
-        ngdL2RowSum = ngdLRowSum * ngdLRowSum;
-        pgdORowSum = coefInGaussion * pgdORowSum;
-        ngdORowSum = coefInGaussion * ngdORowSum;
-        pgdO2RowSum = pgdORowSum * pgdORowSum;
-        ngdO2RowSum = ngdORowSum * ngdORowSum;
-
-        /* compute {g_dL |g_dL>0 }, {g_dL |g_dL<0 },
-         {g_dO |g_dO>0 }, {g_dO |g_dO<0 } of each band in the line support region
-         first, current row belong to current band */
-        bandID = (short) ( hID / params.widthOfBand_ );
-        coefInGaussion = (float) ( gaussCoefL_[hID % params.widthOfBand_ + params.widthOfBand_] );
+        else
+        {
+          ngdLRowSum -= gDL;
+        }
+        if( gDO > 0 )
+        {
+          pgdORowSum += gDO;
+        }
+        else
+        {
+          ngdORowSum -= gDO;
+        }
+        sCorX += dL[0];
+        sCorY += dL[1];
+        /* gDLMat[hID][wID] = gDL; */
+      }
+      sCorX0 -= dL[1];
+      sCorY0 += dL[0];
+      coefInGaussion = (float) gaussCoefG_[hID];
+      pgdLRowSum = coefInGaussion * pgdLRowSum;
+      ngdLRowSum = coefInGaussion * ngdLRowSum;
+      pgdL2RowSum = pgdLRowSum * pgdLRowSum;
+      ngdL2RowSum = ngdLRowSum * ngdLRowSum;
+      pgdORowSum = coefInGaussion * pgdORowSum;
+      ngdORowSum = coefInGaussion * ngdORowSum;
+      pgdO2RowSum = pgdORowSum * pgdORowSum;
+      ngdO2RowSum = ngdORowSum * ngdORowSum;
+
+      /* compute {g_dL |g_dL>0 }, {g_dL |g_dL<0 },
+       {g_dO |g_dO>0 }, {g_dO |g_dO<0 } of each band in the line support region
+       first, current row belong to current band */
+      bandID = (short) ( hID / params.widthOfBand_ );
+      coefInGaussion = (float) ( gaussCoefL_[hID % params.widthOfBand_ + params.widthOfBand_] );
+      pgdLBandSum[bandID] += coefInGaussion * pgdLRowSum;
+      ngdLBandSum[bandID] += coefInGaussion * ngdLRowSum;
+      pgdL2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdL2RowSum;
+      ngdL2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdL2RowSum;
+      pgdOBandSum[bandID] += coefInGaussion * pgdORowSum;
+      ngdOBandSum[bandID] += coefInGaussion * ngdORowSum;
+      pgdO2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdO2RowSum;
+      ngdO2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdO2RowSum;
+
+      /* In order to reduce boundary effect along the line gradient direction,
+       * a row's gradient will contribute not only to its current band, but also
+       * to its nearest upper and down band with gaussCoefL_.*/
+      bandID--;
+      if( bandID >= 0 )
+      {/* the band above the current band */
+        coefInGaussion = (float) ( gaussCoefL_[hID % params.widthOfBand_ + 2 * params.widthOfBand_] );
         pgdLBandSum[bandID] += coefInGaussion * pgdLRowSum;
         ngdLBandSum[bandID] += coefInGaussion * ngdLRowSum;
         pgdL2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdL2RowSum;
@@ -1205,167 +1353,122 @@ int BinaryDescriptor::computeLBD( ScaleLines &keyLines, bool useDetectionData )
         ngdOBandSum[bandID] += coefInGaussion * ngdORowSum;
         pgdO2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdO2RowSum;
         ngdO2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdO2RowSum;
-
-        /* In order to reduce boundary effect along the line gradient direction,
-         * a row's gradient will contribute not only to its current band, but also
-         * to its nearest upper and down band with gaussCoefL_.*/
-        bandID--;
-        if( bandID >= 0 )
-        {/* the band above the current band */
-          coefInGaussion = (float) ( gaussCoefL_[hID % params.widthOfBand_ + 2 * params.widthOfBand_] );
-          pgdLBandSum[bandID] += coefInGaussion * pgdLRowSum;
-          ngdLBandSum[bandID] += coefInGaussion * ngdLRowSum;
-          pgdL2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdL2RowSum;
-          ngdL2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdL2RowSum;
-          pgdOBandSum[bandID] += coefInGaussion * pgdORowSum;
-          ngdOBandSum[bandID] += coefInGaussion * ngdORowSum;
-          pgdO2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdO2RowSum;
-          ngdO2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdO2RowSum;
-        }
-        bandID = bandID + 2;
-        if( bandID < NUM_OF_BANDS )
-        {/*the band below the current band */
-          coefInGaussion = (float) ( gaussCoefL_[hID % params.widthOfBand_] );
-          pgdLBandSum[bandID] += coefInGaussion * pgdLRowSum;
-          ngdLBandSum[bandID] += coefInGaussion * ngdLRowSum;
-          pgdL2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdL2RowSum;
-          ngdL2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdL2RowSum;
-          pgdOBandSum[bandID] += coefInGaussion * pgdORowSum;
-          ngdOBandSum[bandID] += coefInGaussion * ngdORowSum;
-          pgdO2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdO2RowSum;
-          ngdO2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdO2RowSum;
-        }
       }
-      /* gDLMat.Save("gDLMat.txt");
-       return 0; */
+      bandID = bandID + 2;
+      if( bandID < NUM_OF_BANDS )
+      {/*the band below the current band */
+        coefInGaussion = (float) ( gaussCoefL_[hID % params.widthOfBand_] );
+        pgdLBandSum[bandID] += coefInGaussion * pgdLRowSum;
+        ngdLBandSum[bandID] += coefInGaussion * ngdLRowSum;
+        pgdL2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdL2RowSum;
+        ngdL2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdL2RowSum;
+        pgdOBandSum[bandID] += coefInGaussion * pgdORowSum;
+        ngdOBandSum[bandID] += coefInGaussion * ngdORowSum;
+        pgdO2BandSum[bandID] += coefInGaussion * coefInGaussion * pgdO2RowSum;
+        ngdO2BandSum[bandID] += coefInGaussion * coefInGaussion * ngdO2RowSum;
+      }
+    }
+    /* gDLMat.Save("gDLMat.txt");
+     return 0; */
 
-      /* construct line descriptor */
-      pSingleLine->descriptor.resize( descriptor_size );
-      desVec = &pSingleLine->descriptor.front();
+    /* construct line descriptor */
+    pSingleLine->descriptor.resize( descriptor_size );
+    desVec = &pSingleLine->descriptor.front();
 
-      short desID;
+    short desID;
 
-      /*Note that the first and last bands only have (lengthOfLSP * widthOfBand_ * 2.0) pixels
-       * which are counted. */
-      float invN2 = (float) ( 1.0 / ( params.widthOfBand_ * 2.0 ) );
-      float invN3 = (float) ( 1.0 / ( params.widthOfBand_ * 3.0 ) );
-      float invN, temp;
-      for ( bandID = 0; bandID < NUM_OF_BANDS; bandID++ )
+    /*Note that the first and last bands only have (lengthOfLSP * widthOfBand_ * 2.0) pixels
+     * which are counted. */
+    float invN2 = (float) ( 1.0 / ( params.widthOfBand_ * 2.0 ) );
+    float invN3 = (float) ( 1.0 / ( params.widthOfBand_ * 3.0 ) );
+    float invN, temp;
+    for ( bandID = 0; bandID < NUM_OF_BANDS; bandID++ )
+    {
+      if( bandID == 0 || bandID == NUM_OF_BANDS - 1 )
       {
-        if( bandID == 0 || bandID == NUM_OF_BANDS - 1 )
-        {
-          invN = invN2;
-        }
-        else
-        {
-          invN = invN3;
-        }
-        desID = bandID * 8;
-        temp = pgdLBandSum[bandID] * invN;
-        desVec[desID] = temp;/* mean value of pgdL; */
-        desVec[desID + 4] = sqrt( pgdL2BandSum[bandID] * invN - temp * temp );  //std value of pgdL;
-        temp = ngdLBandSum[bandID] * invN;
-        desVec[desID + 1] = temp;  //mean value of ngdL;
-        desVec[desID + 5] = sqrt( ngdL2BandSum[bandID] * invN - temp * temp );  //std value of ngdL;
-
-        temp = pgdOBandSum[bandID] * invN;
-        desVec[desID + 2] = temp;  //mean value of pgdO;
-        desVec[desID + 6] = sqrt( pgdO2BandSum[bandID] * invN - temp * temp );  //std value of pgdO;
-        temp = ngdOBandSum[bandID] * invN;
-        desVec[desID + 3] = temp;  //mean value of ngdO;
-        desVec[desID + 7] = sqrt( ngdO2BandSum[bandID] * invN - temp * temp );  //std value of ngdO;
+        invN = invN2;
       }
-
-      // normalize;
-      float tempM, tempS;
-      tempM = 0;
-      tempS = 0;
-      desVec = &pSingleLine->descriptor.front();
-
-      int base = 0;
-      for ( short i = 0; i < (short) ( NUM_OF_BANDS * 8 ); ++base, i = (short) ( base * 8 ) )
+      else
       {
-        tempM += * ( desVec + i ) * * ( desVec + i );  //desVec[8*i+0] * desVec[8*i+0];
-        tempM += * ( desVec + i + 1 ) * * ( desVec + i + 1 );  //desVec[8*i+1] * desVec[8*i+1];
-        tempM += * ( desVec + i + 2 ) * * ( desVec + i + 2 );  //desVec[8*i+2] * desVec[8*i+2];
-        tempM += * ( desVec + i + 3 ) * * ( desVec + i + 3 );  //desVec[8*i+3] * desVec[8*i+3];
-        tempS += * ( desVec + i + 4 ) * * ( desVec + i + 4 );  //desVec[8*i+4] * desVec[8*i+4];
-        tempS += * ( desVec + i + 5 ) * * ( desVec + i + 5 );  //desVec[8*i+5] * desVec[8*i+5];
-        tempS += * ( desVec + i + 6 ) * * ( desVec + i + 6 );  //desVec[8*i+6] * desVec[8*i+6];
-        tempS += * ( desVec + i + 7 ) * * ( desVec + i + 7 );  //desVec[8*i+7] * desVec[8*i+7];
+        invN = invN3;
       }
+      desID = bandID * 8;
+      temp = pgdLBandSum[bandID] * invN;
+      desVec[desID] = temp;/* mean value of pgdL; */
+      desVec[desID + 4] = sqrt( pgdL2BandSum[bandID] * invN - temp * temp );  //std value of pgdL;
+      temp = ngdLBandSum[bandID] * invN;
+      desVec[desID + 1] = temp;  //mean value of ngdL;
+      desVec[desID + 5] = sqrt( ngdL2BandSum[bandID] * invN - temp * temp );  //std value of ngdL;
+
+      temp = pgdOBandSum[bandID] * invN;
+      desVec[desID + 2] = temp;  //mean value of pgdO;
+      desVec[desID + 6] = sqrt( pgdO2BandSum[bandID] * invN - temp * temp );  //std value of pgdO;
+      temp = ngdOBandSum[bandID] * invN;
+      desVec[desID + 3] = temp;  //mean value of ngdO;
+      desVec[desID + 7] = sqrt( ngdO2BandSum[bandID] * invN - temp * temp );  //std value of ngdO;
+    }
 
-      tempM = 1 / sqrt( tempM );
-      tempS = 1 / sqrt( tempS );
-      desVec = &pSingleLine->descriptor.front();
-      base = 0;
-      for ( short i = 0; i < (short) ( NUM_OF_BANDS * 8 ); ++base, i = (short) ( base * 8 ) )
-      {
-        * ( desVec + i ) = * ( desVec + i ) * tempM;  //desVec[8*i] =  desVec[8*i] * tempM;
-        * ( desVec + 1 + i ) = * ( desVec + 1 + i ) * tempM;  //desVec[8*i+1] =  desVec[8*i+1] * tempM;
-        * ( desVec + 2 + i ) = * ( desVec + 2 + i ) * tempM;  //desVec[8*i+2] =  desVec[8*i+2] * tempM;
-        * ( desVec + 3 + i ) = * ( desVec + 3 + i ) * tempM;  //desVec[8*i+3] =  desVec[8*i+3] * tempM;
-        * ( desVec + 4 + i ) = * ( desVec + 4 + i ) * tempS;  //desVec[8*i+4] =  desVec[8*i+4] * tempS;
-        * ( desVec + 5 + i ) = * ( desVec + 5 + i ) * tempS;  //desVec[8*i+5] =  desVec[8*i+5] * tempS;
-        * ( desVec + 6 + i ) = * ( desVec + 6 + i ) * tempS;  //desVec[8*i+6] =  desVec[8*i+6] * tempS;
-        * ( desVec + 7 + i ) = * ( desVec + 7 + i ) * tempS;  //desVec[8*i+7] =  desVec[8*i+7] * tempS;
-      }
+    // normalize;
+    float tempM, tempS;
+    tempM = 0;
+    tempS = 0;
+    desVec = &pSingleLine->descriptor.front();
 
-      /* In order to reduce the influence of non-linear illumination,
-       * a threshold is used to limit the value of element in the unit feature
-       * vector no larger than this threshold. In Z.Wang's work, a value of 0.4 is found
-       * empirically to be a proper threshold.*/
-      desVec = &pSingleLine->descriptor.front();
-      for ( short i = 0; i < descriptor_size; i++ )
-      {
-        if( desVec[i] > 0.4 )
-        {
-          desVec[i] = (float) 0.4;
-        }
-      }
+    int base = 0;
+    for ( short i = 0; i < (short) ( NUM_OF_BANDS * 8 ); ++base, i = (short) ( base * 8 ) )
+    {
+      tempM += * ( desVec + i ) * * ( desVec + i );  //desVec[8*i+0] * desVec[8*i+0];
+      tempM += * ( desVec + i + 1 ) * * ( desVec + i + 1 );  //desVec[8*i+1] * desVec[8*i+1];
+      tempM += * ( desVec + i + 2 ) * * ( desVec + i + 2 );  //desVec[8*i+2] * desVec[8*i+2];
+      tempM += * ( desVec + i + 3 ) * * ( desVec + i + 3 );  //desVec[8*i+3] * desVec[8*i+3];
+      tempS += * ( desVec + i + 4 ) * * ( desVec + i + 4 );  //desVec[8*i+4] * desVec[8*i+4];
+      tempS += * ( desVec + i + 5 ) * * ( desVec + i + 5 );  //desVec[8*i+5] * desVec[8*i+5];
+      tempS += * ( desVec + i + 6 ) * * ( desVec + i + 6 );  //desVec[8*i+6] * desVec[8*i+6];
+      tempS += * ( desVec + i + 7 ) * * ( desVec + i + 7 );  //desVec[8*i+7] * desVec[8*i+7];
+    }
 
-      //re-normalize desVec;
-      temp = 0;
-      for ( short i = 0; i < descriptor_size; i++ )
-      {
-        temp += desVec[i] * desVec[i];
-      }
+    tempM = 1 / sqrt( tempM );
+    tempS = 1 / sqrt( tempS );
+    desVec = &pSingleLine->descriptor.front();
+    base = 0;
+    for ( short i = 0; i < (short) ( NUM_OF_BANDS * 8 ); ++base, i = (short) ( base * 8 ) )
+    {
+      * ( desVec + i ) = * ( desVec + i ) * tempM;  //desVec[8*i] =  desVec[8*i] * tempM;
+      * ( desVec + 1 + i ) = * ( desVec + 1 + i ) * tempM;  //desVec[8*i+1] =  desVec[8*i+1] * tempM;
+      * ( desVec + 2 + i ) = * ( desVec + 2 + i ) * tempM;  //desVec[8*i+2] =  desVec[8*i+2] * tempM;
+      * ( desVec + 3 + i ) = * ( desVec + 3 + i ) * tempM;  //desVec[8*i+3] =  desVec[8*i+3] * tempM;
+      * ( desVec + 4 + i ) = * ( desVec + 4 + i ) * tempS;  //desVec[8*i+4] =  desVec[8*i+4] * tempS;
+      * ( desVec + 5 + i ) = * ( desVec + 5 + i ) * tempS;  //desVec[8*i+5] =  desVec[8*i+5] * tempS;
+      * ( desVec + 6 + i ) = * ( desVec + 6 + i ) * tempS;  //desVec[8*i+6] =  desVec[8*i+6] * tempS;
+      * ( desVec + 7 + i ) = * ( desVec + 7 + i ) * tempS;  //desVec[8*i+7] =  desVec[8*i+7] * tempS;
+    }
 
-      temp = 1 / sqrt( temp );
-      for ( short i = 0; i < descriptor_size; i++ )
+    /* In order to reduce the influence of non-linear illumination,
+     * a threshold is used to limit the value of element in the unit feature
+     * vector no larger than this threshold. In Z.Wang's work, a value of 0.4 is found
+     * empirically to be a proper threshold.*/
+    desVec = &pSingleLine->descriptor.front();
+    for ( short i = 0; i < descriptor_size; i++ )
+    {
+      if( desVec[i] > 0.4 )
       {
-        desVec[i] = desVec[i] * temp;
+        desVec[i] = (float) 0.4;
       }
-    }/* end for(short lineIDInSameLine = 0; lineIDInSameLine<sameLineSize;
-     lineIDInSameLine++) */
+    }
 
-    cv::Mat appoggio = cv::Mat( 1, 32, CV_32FC1 );
-    float* pointerToRow = appoggio.ptr<float>( 0 );
-    for ( int g = 0; g < 32; g++ )
+    //re-normalize desVec;
+    temp = 0;
+    for ( short i = 0; i < descriptor_size; i++ )
     {
-      /* get LBD data */
-      float* des_Vec = &keyLines[lineIDInScaleVec][0].descriptor.front();
-      *pointerToRow = des_Vec[g];
-      pointerToRow++;
-
+      temp += desVec[i] * desVec[i];
     }
 
-  }/* end for(short lineIDInScaleVec = 0;
-   lineIDInScaleVec<numOfFinalLine; lineIDInScaleVec++) */
-
-  delete[] dL;
-  delete[] dO;
-  delete[] pgdLBandSum;
-  delete[] ngdLBandSum;
-  delete[] pgdL2BandSum;
-  delete[] ngdL2BandSum;
-  delete[] pgdOBandSum;
-  delete[] ngdOBandSum;
-  delete[] pgdO2BandSum;
-  delete[] ngdO2BandSum;
-
-  return 1;
-
+    temp = 1 / sqrt( temp );
+    for ( short i = 0; i < descriptor_size; i++ )
+    {
+      desVec[i] = desVec[i] * temp;
+    }
+  }
 }
 
 BinaryDescriptor::EDLineDetector::EDLineDetector()
@@ -1436,6 +1539,60 @@ BinaryDescriptor::EDLineDetector::~EDLineDetector()
   }
 }
 
+/* rounds a non-negative gradient sum divided by 4 to the nearest integer, ties to even,
+ * exactly like the Mat expression sum / 4 on CV_16S data */
+static inline short divideGradientBy4( int sum )
+{
+  int q = sum >> 2, r = sum & 3;
+  return (short) ( q + ( ( r > 2 || ( r == 2 && ( q & 1 ) ) ) ? 1 : 0 ) );
+}
+
+/* single pass computing the thresholded gradient, the unthresholded gradient and the direction image;
+ * equivalent to abs + add + threshold( THRESH_TOZERO ) + division + compare( CMP_LT ) */
+static void computeGradientAndDirection( const cv::Mat& dxImg, const cv::Mat& dyImg, short gradientThreshold, cv::Mat& gImg, cv::Mat& gImgWO,
+                                         cv::Mat& dirImg )
+{
+  const int threshold = gradientThreshold + 1;
+  for ( int y = 0; y < dxImg.rows; y++ )
+  {
+    const short* pdx = dxImg.ptr<short>( y );
+    const short* pdy = dyImg.ptr<short>( y );
+    short* pg = gImg.ptr<short>( y );
+    short* pgWO = gImgWO.ptr<short>( y );
+    uchar* pdir = dirImg.ptr<uchar>( y );
+    int x = 0;
+
+#if CV_SIMD128
+    const v_int16x8 v_zero = v_setzero_s16(), v_one = v_setall_s16( 1 ), v_two = v_setall_s16( 2 ), v_three = v_setall_s16( 3 );
+    const v_int16x8 v_thresh = v_setall_s16( (short) std::min( threshold, (int) SHRT_MAX ) );
+    for ( ; x <= dxImg.cols - 8; x += 8 )
+    {
+      v_int16x8 dx = v_load( pdx + x ), dy = v_load( pdy + x );
+      v_int16x8 adx = v_max( dx, v_zero - dx ), ady = v_max( dy, v_zero - dy );
+      v_int16x8 sum = adx + ady;
+
+      v_int16x8 q = sum >> 2, r = sum & v_three;
+      v_int16x8 roundUp = ( r > v_two ) | ( ( r == v_two ) & ( ( q & v_one ) == v_one ) );
+      v_int16x8 gWO = q - roundUp;
+
+      v_store( pgWO + x, gWO );
+      v_store( pg + x, gWO & ( sum > v_thresh ) );
+      v_pack_store( (schar*) ( pdir + x ), adx < ady );
+    }
+#endif
+
+    for ( ; x < dxImg.cols; x++ )
+    {
+      int adx = std::abs( (int) pdx[x] ), ady = std::abs( (int) pdy[x] );
+      int sum = std::min( adx + ady, (int) SHRT_MAX );
+      short gWO = divideGradientBy4( sum );
+      pgWO[x] = gWO;
+      pg[x] = sum > threshold ? gWO : (short) 0;
+      pdir[x] = adx < ady ? (uchar) Horizontal : (uchar) Vertical;
+    }
+  }
+}
+
 int BinaryDescriptor::EDLineDetector::EdgeDrawing( cv::Mat &image, EdgeChains &edgeChains )
 {
   imageWidth = image.cols;
@@ -1478,15 +1635,7 @@ int BinaryDescriptor::EDLineDetector::EdgeDrawing( cv::Mat &image, EdgeChains &e
   cv::Sobel( image, dyImg_, CV_16SC1, 0, 1, 3 );
 
   //compute gradient and direction images
-  cv::Mat dxABS_m = cv::abs( dxImg_ );
-  cv::Mat dyABS_m = cv::abs( dyImg_ );
-  cv::Mat sumDxDy;
-  cv::add( dyABS_m, dxABS_m, sumDxDy );
-
-  cv::threshold( sumDxDy, gImg_, gradienThreshold_ + 1, 255, cv::THRESH_TOZERO );
-  gImg_ = gImg_ / 4;
-  gImgWO_ = sumDxDy / 4;
-  cv::compare( dxABS_m, dyABS_m, dirImg_, cv::CMP_LT );
+  computeGradientAndDirection( dxImg_, dyImg_, gradienThreshold_, gImg_, gImgWO_, dirImg_ );
 
   short *pgImg = gImg_.ptr<short>();
   unsigned char *pdirImg = dirImg_.ptr();
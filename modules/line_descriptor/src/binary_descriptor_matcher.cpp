@@ -85,10 +85,11 @@ void BinaryDescriptorMatcher::train()
   if( !dataset )
     dataset = new Mihasher( 256, 32 );
 
+  /* only descriptors added since last training are inserted */
   if( descriptorsMat.rows > 0 )
     dataset->populate( descriptorsMat, descriptorsMat.rows, descriptorsMat.cols );
 
-  descrInDS = descriptorsMat.rows;
+  descrInDS += descriptorsMat.rows;
   descriptorsMat.release();
 }
 
@@ -592,47 +593,57 @@ void BinaryDescriptorMatcher::radiusMatch( const Mat& queryDescriptors, std::vec
 
 }
 
-/* execute a batch query */
-void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+/* answers a range of queries; every range owns its scratch buffers, results are written
+ to the disjoint slices of the output arrays associated to its queries */
+class BinaryDescriptorMatcher::Mihasher::QueryInvoker : public ParallelLoopBody
 {
-  /* create and initialize a bitarray */
-  counter = new bitarray;
-  counter->init( N );
-
-  UINT32 *res = new UINT32[K * ( D + 1 )];
-  UINT64 *chunks = new UINT64[m];
-  UINT32 * presults = results;
-  UINT32 *pnumres = numres;
-
-  /* make a copy of input queries */
-  cv::Mat queries_clone = queries.clone();
-
-  /* set a pointer to first query (row) */
-  UINT8 *pq = queries_clone.ptr();
-
-  /* loop over number of descriptors */
-  for ( size_t i = 0; i < numq; i++ )
+ public:
+  QueryInvoker( Mihasher& mh, UINT32* results, UINT32* numres, const cv::Mat& queries ) :
+      mh_( mh ),
+      results_( results ),
+      numres_( numres ),
+      queries_( queries )
   {
-    /* for every descriptor, query database */
-    query( presults, pnumres, pq, chunks, res );
+  }
 
-    /* move pointer to write next K indeces */
-    presults += K;
-    pnumres += B + 1;
+  void operator()( const Range& range ) const
+  {
+    /* create and initialize a bitarray */
+    bitarray counter;
+    counter.init( mh_.N );
 
-    /* move forward pointer to current row in descriptors matrix */
-    pq += dim1queries;
+    std::vector<UINT32> res( mh_.K * ( mh_.D + 1 ) );
+    std::vector<UINT64> chunks( mh_.m );
+    int power[100];
 
+    for ( int i = range.start; i < range.end; i++ )
+    {
+      /* for every descriptor, query database */
+      mh_.query( results_ + (size_t) i * mh_.K, numres_ + (size_t) i * ( mh_.B + 1 ), queries_.ptr( i ), &chunks[0], res.empty() ? NULL : &res[0],
+                 counter, power );
+    }
   }
 
-  delete[] res;
-  delete[] chunks;
+ private:
+  QueryInvoker& operator=( const QueryInvoker& );
+
+  Mihasher& mh_;
+  UINT32* results_;
+  UINT32* numres_;
+  const cv::Mat& queries_;
+};
+
+/* execute a batch query */
+void BinaryDescriptorMatcher::Mihasher::batchquery( UINT32 * results, UINT32 *numres, const cv::Mat & queries, UINT32 numq, int dim1queries )
+{
+  CV_Assert( queries.type() == CV_8UC1 && queries.cols >= dim1queries && queries.rows >= (int) numq );
 
-  delete counter;
+  parallel_for_( Range( 0, (int) numq ), QueryInvoker( *this, results, numres, queries ) );
 }
 
 /* execute a single query */
-void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, UINT8 * Query, UINT64 *chunks, UINT32 *res )
+void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres, const UINT8 * Query, UINT64 *chunks, UINT32 *res, bitarray& counter,
+                                              int* power )
 {
   /* if K == 0 that means we want everything to be processed.
    So maxres = N in that case. Otherwise K limits the results processed */
@@ -654,7 +665,7 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
   UINT32 index;
   int hammd;
 
-  counter->erase();
+  counter.erase();
   memset( numres, 0, ( B + 1 ) * sizeof ( *numres ) );
 
   split( chunks, Query, m, mplus, b );
@@ -712,9 +723,9 @@ void BinaryDescriptorMatcher::Mihasher::query( UINT32* results, UINT32* numres,
             for ( int c = 0; c < size; c++ )
             {
               index = arr[c];
-              if( !counter->get( index ) )
+              if( !counter.get( index ) )
               { /* if it is not a duplicate */
-                counter->set( index );
+                counter.set( index );
                 hammd = cv::line_descriptor::match( codes.ptr() + (UINT64) index * ( B_over_8 ), Query, B_over_8 );
 
                 nc++;
@@ -757,6 +768,8 @@ BinaryDescriptorMatcher::Mihasher::Mihasher( int B_val, int _m )
 {
   B = B_val;
   B_over_8 = B / 8;
+  N = 0;
+  K = 0;
   m = _m;
   b = (int) ceil( (double) B / m );
 
@@ -799,20 +812,25 @@ BinaryDescriptorMatcher::Mihasher::~Mihasher()
 /* populate tables */
 void BinaryDescriptorMatcher::Mihasher::populate( cv::Mat & _codes, UINT32 N_val, int dim1codes )
 {
-  N = N_val;
-  codes = _codes;
+  CV_Assert( _codes.type() == CV_8UC1 && _codes.cols == dim1codes && _codes.rows >= (int) N_val );
+
+  /* new codes are indexed after the ones already in the tables,
+   so that growing the dataset does not require rebuilding it */
+  UINT64 firstIndex = codes.empty() ? 0 : N;
+  if( codes.empty() )
+    codes = _codes;
+  else
+    codes.push_back( _codes.rowRange( 0, (int) N_val ) );
+
+  N = firstIndex + N_val;
   UINT64 * chunks = new UINT64[m];
 
-  UINT8 * pcodes = codes.ptr();
-  for ( UINT64 i = 0; i < N; i++, pcodes += dim1codes )
+  for ( UINT64 i = 0; i < N_val; i++ )
   {
-    split( chunks, pcodes, m, mplus, b );
+    split( chunks, _codes.ptr( (int) i ), m, mplus, b );
 
     for ( int k = 0; k < m; k++ )
-      H[k].insert( chunks[k], (UINT32) i );
-
-    if( i % (int) ceil( N / 1000.0 ) == 0 )
-      fflush (stdout);
+      H[k].insert( chunks[k], (UINT32) ( firstIndex + i ) );
   }
 
   delete[] chunks;
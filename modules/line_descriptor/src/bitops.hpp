@@ -48,9 +48,13 @@
 #ifdef _MSC_VER
 # include <intrin.h>
 # define popcnt __popcnt
+# if defined _M_X64
+#  define popcnt64 __popcnt64
+# endif
 # pragma warning( disable : 4267 )
 #else
 # define popcnt __builtin_popcount
+# define popcnt64 __builtin_popcountll
 
 #endif
 
@@ -80,23 +84,51 @@ namespace cv
 namespace line_descriptor
 {
 /*matching function */
-inline int match( UINT8*P, UINT8*Q, int codelb )
+inline int match( const UINT8*P, const UINT8*Q, int codelb )
 {
-    int i, output = 0;
-    for( i = 0; i <= codelb - 16; i += 16 )
+    int i = 0, output = 0;
+#if CV_AVX2
+    /* 32 bytes at a time: per-nibble lookup of bit counts, summed with SAD */
+    if( codelb >= 32 )
     {
-        output += popcnt( *(UINT32*) (P+i) ^ *(UINT32*) (Q+i) ) +
-                  popcnt( *(UINT32*) (P+i+4) ^ *(UINT32*) (Q+i+4) ) +
-                  popcnt( *(UINT32*) (P+i+8) ^ *(UINT32*) (Q+i+8) ) +
-                  popcnt( *(UINT32*) (P+i+12) ^ *(UINT32*) (Q+i+12) );
+        const __m256i nibbleCounts = _mm256_setr_epi8( 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 );
+        const __m256i lowMask = _mm256_set1_epi8( 0x0f );
+        __m256i sum = _mm256_setzero_si256();
+        for( ; i <= codelb - 32; i += 32 )
+        {
+            __m256i x = _mm256_xor_si256( _mm256_loadu_si256( (const __m256i*) (P+i) ), _mm256_loadu_si256( (const __m256i*) (Q+i) ) );
+            __m256i bits = _mm256_add_epi8( _mm256_shuffle_epi8( nibbleCounts, _mm256_and_si256( x, lowMask ) ),
+                                            _mm256_shuffle_epi8( nibbleCounts, _mm256_and_si256( _mm256_srli_epi16( x, 4 ), lowMask ) ) );
+            sum = _mm256_add_epi64( sum, _mm256_sad_epu8( bits, _mm256_setzero_si256() ) );
+        }
+        UINT64 partial[4];
+        _mm256_storeu_si256( (__m256i*) partial, sum );
+        output += (int) ( partial[0] + partial[1] + partial[2] + partial[3] );
     }
+#endif
+#ifdef popcnt64
+    for( ; i <= codelb - 16; i += 16 )
+    {
+        output += (int) ( popcnt64( *(const UINT64*) (P+i) ^ *(const UINT64*) (Q+i) ) +
+                          popcnt64( *(const UINT64*) (P+i+8) ^ *(const UINT64*) (Q+i+8) ) );
+    }
+#else
+    for( ; i <= codelb - 16; i += 16 )
+    {
+        output += popcnt( *(const UINT32*) (P+i) ^ *(const UINT32*) (Q+i) ) +
+                  popcnt( *(const UINT32*) (P+i+4) ^ *(const UINT32*) (Q+i+4) ) +
+                  popcnt( *(const UINT32*) (P+i+8) ^ *(const UINT32*) (Q+i+8) ) +
+                  popcnt( *(const UINT32*) (P+i+12) ^ *(const UINT32*) (Q+i+12) );
+    }
+#endif
     for( ; i < codelb; i++ )
         output += lookup[P[i] ^ Q[i]];
     return output;
 }
 
 /* splitting function (b <= 64) */
-inline void split( UINT64 *chunks, UINT8 *code, int m, int mplus, int b )
+inline void split( UINT64 *chunks, const UINT8 *code, int m, int mplus, int b )
 {
   UINT64 temp = 0x0;
   int nbits = 0;
@@ -577,3 +577,32 @@ TEST( BinaryDescriptor_Matcher, regression)
   CV_BinaryDescriptorMatcherTest test( 0.01f );
   test.safe_run();
 }
+
+TEST( BinaryDescriptor_Matcher, incrementalTrain )
+{
+  RNG& rng = theRNG();
+  Mat train( 200, 32, CV_8UC1 );
+  rng.fill( train, RNG::UNIFORM, Scalar( 0 ), Scalar( 256 ) );
+
+  Ptr<BinaryDescriptorMatcher> matcher = BinaryDescriptorMatcher::createBinaryDescriptorMatcher();
+
+  /* the second training only indexes the descriptors added after the first one */
+  std::vector<Mat> firstHalf( 1, train.rowRange( 0, 100 ).clone() );
+  matcher->add( firstHalf );
+  matcher->train();
+
+  std::vector<Mat> secondHalf( 1, train.rowRange( 100, 200 ).clone() );
+  matcher->add( secondHalf );
+  matcher->train();
+
+  std::vector<DMatch> matches;
+  matcher->match( train, matches );
+
+  ASSERT_EQ( train.rows, (int) matches.size() );
+  for ( int i = 0; i < train.rows; i++ )
+  {
+    EXPECT_EQ( i, matches[i].trainIdx );
+    EXPECT_EQ( i < 100 ? 0 : 1, matches[i].imgIdx );
+    EXPECT_EQ( 0.f, matches[i].distance );
+  }
+}
@@ -107,9 +107,15 @@ namespace rgbd
   class CV_EXPORTS RgbdNormals: public Algorithm
   {
   public:
+    /** RGBD_NORMALS_METHOD_AVG3D_GRADIENT averages the horizontal and vertical 3d gradients over the window
+     * using integral images and takes their cross product: it is the fastest method on dense depth streams.
+     * The per-camera tables of RGBD_NORMALS_METHOD_FALS are shared between all the instances that have the
+     * same size, depth, window size and calibration, so that re-creating an RgbdNormals object is cheap.
+     */
     enum RGBD_NORMALS_METHOD
     {
-      RGBD_NORMALS_METHOD_FALS, RGBD_NORMALS_METHOD_LINEMOD, RGBD_NORMALS_METHOD_SRI
+      RGBD_NORMALS_METHOD_FALS, RGBD_NORMALS_METHOD_LINEMOD, RGBD_NORMALS_METHOD_SRI,
+      RGBD_NORMALS_METHOD_AVG3D_GRADIENT
     };
 
     RgbdNormals()
@@ -130,7 +136,8 @@ namespace rgbd
      * @param depth the depth of the normals (only CV_32F or CV_64F)
      * @param K the calibration matrix to use
      * @param window_size the window size to compute the normals: can only be 1,3,5 or 7
-     * @param method one of the methods to use: RGBD_NORMALS_METHOD_SRI, RGBD_NORMALS_METHOD_FALS
+     * @param method one of the methods to use: RGBD_NORMALS_METHOD_SRI, RGBD_NORMALS_METHOD_FALS,
+     *        RGBD_NORMALS_METHOD_LINEMOD, RGBD_NORMALS_METHOD_AVG3D_GRADIENT
      */
     RgbdNormals(int rows, int cols, int depth, InputArray K, int window_size = 5, int method =
         RGBD_NORMALS_METHOD_FALS);
@@ -355,9 +362,13 @@ namespace rgbd
   class CV_EXPORTS RgbdPlane: public Algorithm
   {
   public:
+    /** RGBD_PLANE_METHOD_PARALLEL grows each plane by processing all the tiles of its current boundary at once
+     * in parallel, the plane being refitted after each such wave instead of after each tile. The result is
+     * deterministic and does not depend on the number of threads.
+     */
     enum RGBD_PLANE_METHOD
     {
-      RGBD_PLANE_METHOD_DEFAULT
+      RGBD_PLANE_METHOD_DEFAULT, RGBD_PLANE_METHOD_PARALLEL
     };
 
     RgbdPlane(RGBD_PLANE_METHOD method = RGBD_PLANE_METHOD_DEFAULT)
@@ -1031,6 +1042,132 @@ namespace rgbd
   warpFrame(const Mat& image, const Mat& depth, const Mat& mask, const Mat& Rt, const Mat& cameraMatrix,
             const Mat& distCoeff, Mat& warpedImage, Mat* warpedDepth = 0, Mat* warpedMask = 0);
 
+  /** Truncated signed distance function (TSDF) volume for dense reconstruction, as in
+   * ``KinectFusion: Real-Time Dense Surface Mapping and Tracking``
+   * by R. A. Newcombe, S. Izadi, O. Hilliges, D. Molyneaux, D. Kim, A. J. Davison, P. Kohli, J. Shotton, S. Hodges
+   * and A. Fitzgibbon
+   *
+   * Depth frames are integrated at known camera poses (e.g. the ones accumulated from ICPOdometry).
+   * The volume can then be raycast from the current pose to get the model points and normals that are
+   * used as the reference frame of the next ICP step, or its surface can be extracted as a point cloud or
+   * a mesh. Integration, raycasting and extraction all run in parallel.
+   *
+   * The volume is a cube of resolution^3 voxels and of side size meters. Its corner voxel (0,0,0) is placed
+   * at the origin of the volume frame, whose pose in the world frame is given by volumePose. Camera poses
+   * transform points from the camera frame to the world frame.
+   */
+  class CV_EXPORTS TSDFVolume: public Algorithm
+  {
+  public:
+    TSDFVolume();
+
+    /** Constructor
+     * @param resolution the number of voxels along each side of the volume
+     * @param size the length of a side of the volume, in meters
+     * @param cameraMatrix the calibration matrix of the depth camera
+     * @param volumePose the 4x4 pose of the volume in the world frame. If empty, the volume is centered
+     *        on the z axis of the world frame and starts at z = 0, which suits a first camera pose set to
+     *        the identity
+     * @param truncationDistance the distance (in meters) at which the signed distance is truncated.
+     *        If not positive, 4 voxel sizes are used
+     * @param maxWeight the maximum weight of a voxel, which bounds the number of frames it averages
+     */
+    TSDFVolume(int resolution, float size, const Mat& cameraMatrix, const Mat& volumePose = Mat(),
+               float truncationDistance = 0.f, int maxWeight = 64);
+
+    /** Empties the volume
+     */
+    void
+    reset();
+
+    /** Integrates a depth frame into the volume
+     * @param depth the depth image (CV_16U in millimeters or CV_32F in meters, see rescaleDepth)
+     * @param cameraPose the 4x4 pose of the camera in the world frame
+     */
+    void
+    integrate(InputArray depth, InputArray cameraPose);
+
+    /** Renders the surface seen from a camera
+     * @param cameraPose the 4x4 pose of the camera in the world frame
+     * @param frameSize the size of the rendered frame
+     * @param points the rendered 3d points (CV_32FC3, in the camera frame, NaN where nothing is hit).
+     *        Its third channel can be used as the depth of an OdometryFrame
+     * @param normals the normals at the rendered points (CV_32FC3, in the camera frame)
+     */
+    void
+    raycast(InputArray cameraPose, const Size& frameSize, OutputArray points, OutputArray normals) const;
+
+    /** Extracts the zero crossings of the volume as a point cloud
+     * To bound the memory used on large volumes, the extraction can be done by slabs of the volume:
+     * only the voxels with an x index in slices are processed.
+     * @param points the points of the surface in the world frame (N x 1, CV_32FC3)
+     * @param normals the corresponding normals (N x 1, CV_32FC3)
+     * @param slices the range of x indices of the voxels to process
+     */
+    void
+    fetchPointsNormals(OutputArray points, OutputArray normals, const Range& slices = Range::all()) const;
+
+    /** Extracts the surface as a triangle mesh, using marching tetrahedra
+     * As for fetchPointsNormals, the extraction can be done by slabs of the volume.
+     * @param vertices the vertices of the triangles in the world frame (3N x 1, CV_32FC3),
+     *        each triangle is made of three consecutive vertices
+     * @param slices the range of x indices of the cubes to process
+     */
+    void
+    fetchMesh(OutputArray vertices, const Range& slices = Range::all()) const;
+
+    int getResolution() const
+    {
+        return resolution_;
+    }
+    float getSize() const
+    {
+        return size_;
+    }
+    float getVoxelSize() const
+    {
+        return size_ / resolution_;
+    }
+    cv::Mat getVolumePose() const
+    {
+        return volumePose_;
+    }
+    cv::Mat getCameraMatrix() const
+    {
+        return cameraMatrix_;
+    }
+    void setCameraMatrix(const cv::Mat &val)
+    {
+        cameraMatrix_ = val;
+    }
+    float getTruncationDistance() const
+    {
+        return truncationDistance_;
+    }
+    void setTruncationDistance(float val)
+    {
+        truncationDistance_ = val;
+    }
+    int getMaxWeight() const
+    {
+        return maxWeight_;
+    }
+    void setMaxWeight(int val)
+    {
+        maxWeight_ = val;
+    }
+
+  protected:
+    int resolution_;
+    float size_;
+    Mat cameraMatrix_;
+    Mat volumePose_;
+    float truncationDistance_;
+    int maxWeight_;
+    /** resolution^3 voxels of (tsdf, weight), CV_32FC2, the z index being the fastest */
+    Mat volume_;
+  };
+
 // TODO Depth interpolation
 // Curvature
 // Get rescaleDepth return dubles if asked for
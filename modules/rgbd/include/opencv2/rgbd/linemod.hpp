@@ -401,7 +401,7 @@ public:
 
   int numTemplates() const;
   int numTemplates(const String& class_id) const;
-  int numClasses() const { return static_cast<int>(class_templates.size()); }
+  int numClasses() const;
 
   std::vector<String> classIds() const;
 
@@ -415,6 +415,28 @@ public:
                    const String& format = "templates_%s.yml.gz");
   void writeClasses(const String& format = "templates_%s.yml.gz") const;
 
+  /**
+   * \brief Write the templates of all classes to a single binary file.
+   *
+   * The file starts with an index of the classes, followed by one block per class in which
+   * the features of each template are packed as separate x, y and label arrays. The file
+   * uses the byte order of the machine that wrote it.
+   */
+  void writeTemplateDatabase(const String& filename) const;
+
+  /**
+   * \brief Use the classes of a binary file written by writeTemplateDatabase().
+   *
+   * Only the class index is read. The file is memory-mapped where the platform allows it, and
+   * the templates of a class are decoded the first time the class is needed (e.g. matched),
+   * so that loading time and memory usage only depend on the classes actually queried.
+   * The file must have been written with the same modalities and number of pyramid levels, and
+   * its classes must not already be in the detector. Opening a database replaces the previous one.
+   *
+   * \return Number of classes in the database.
+   */
+  int openTemplateDatabase(const String& filename);
+
 protected:
   std::vector< Ptr<Modality> > modalities;
   int pyramid_levels;
@@ -433,6 +455,18 @@ protected:
                   float threshold, std::vector<Match>& matches,
                   const String& class_id,
                   const std::vector<TemplatePyramid>& template_pyramids) const;
+
+  // Matches a list of template pyramids in parallel, see linemod.cpp
+  class MatchInvoker;
+
+  // Classes of a file opened with openTemplateDatabase(), decoded on demand
+  struct TemplateDatabase;
+  Ptr<TemplateDatabase> template_database;
+
+  // Templates of a class, in memory or in the database. If class_id_storage is given, it
+  // is set to a copy of the class ID that lives as long as the templates
+  const std::vector<TemplatePyramid>* findTemplatePyramids(const String& class_id,
+                                                           const String** class_id_storage = NULL) const;
 };
 
 /**
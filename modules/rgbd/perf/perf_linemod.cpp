@@ -0,0 +1,73 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+using std::tr1::get;
+
+namespace
+{
+
+// Draws a textured object made of a few filled shapes, rotated by angle around the image center
+static void drawObject(Mat& image, Mat& mask, double angle, RNG& rng)
+{
+    Point2f center(image.cols * 0.5f, image.rows * 0.5f);
+    RotatedRect box(center, Size2f(image.cols * 0.3f, image.rows * 0.2f), (float)angle);
+    Point2f corners[4];
+    box.points(corners);
+    vector<Point> poly(corners, corners + 4);
+
+    fillConvexPoly(image, poly, Scalar(rng.uniform(50, 255), rng.uniform(50, 255), rng.uniform(50, 255)));
+    fillConvexPoly(mask, poly, Scalar::all(255));
+    circle(image, corners[0], image.rows / 10, Scalar(rng.uniform(0, 255), 0, rng.uniform(0, 255)), -1);
+    circle(mask, corners[0], image.rows / 10, Scalar::all(255), -1);
+    line(image, corners[1], corners[3], Scalar(0, rng.uniform(0, 255), 0), 5);
+}
+
+static Ptr<linemod::Detector> createDetector(int numClasses, int numTemplates)
+{
+    Ptr<linemod::Detector> detector = linemod::getDefaultLINE();
+    RNG rng(0);
+
+    for (int c = 0; c < numClasses; ++c)
+    {
+        String class_id = format("class_%d", c);
+        for (int t = 0; t < numTemplates; ++t)
+        {
+            Mat image(240, 320, CV_8UC3, Scalar::all(0)), mask(image.size(), CV_8U, Scalar::all(0));
+            drawObject(image, mask, 360.0 * t / numTemplates, rng);
+            vector<Mat> sources(1, image);
+            detector->addTemplate(sources, class_id, mask);
+        }
+    }
+    return detector;
+}
+
+}
+
+typedef std::tr1::tuple<int, int> LinemodParams;
+typedef perf::TestBaseWithParam<LinemodParams> LinemodMatch;
+
+PERF_TEST_P(LinemodMatch, match,
+            testing::Combine(testing::Values(1, 4),       // classes
+                             testing::Values(50, 250)))   // templates per class
+{
+    const int numClasses = get<0>(GetParam());
+    const int numTemplates = get<1>(GetParam());
+
+    Ptr<linemod::Detector> detector = createDetector(numClasses, numTemplates);
+
+    RNG rng(1);
+    Mat scene(480, 640, CV_8UC3);
+    randu(scene, Scalar::all(0), Scalar::all(64));
+    Mat object = scene(Rect(160, 120, 320, 240)), objectMask(object.size(), CV_8U, Scalar::all(0));
+    drawObject(object, objectMask, 30.0, rng);
+    vector<Mat> sources(1, scene);
+    vector<linemod::Match> matches;
+
+    declare.in(scene).time(60);
+
+    TEST_CYCLE() detector->match(sources, 80.f, matches);
+
+    SANITY_CHECK_NOTHING();
+}
@@ -0,0 +1,46 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+using std::tr1::get;
+
+CV_ENUM(NormalsMethod, RgbdNormals::RGBD_NORMALS_METHOD_FALS, RgbdNormals::RGBD_NORMALS_METHOD_LINEMOD,
+        RgbdNormals::RGBD_NORMALS_METHOD_SRI, RgbdNormals::RGBD_NORMALS_METHOD_AVG3D_GRADIENT)
+
+typedef std::tr1::tuple<NormalsMethod, MatDepth> NormalsParams;
+typedef perf::TestBaseWithParam<NormalsParams> NormalsPerfTest;
+
+PERF_TEST_P(NormalsPerfTest, compute,
+            testing::Combine(NormalsMethod::all(), testing::Values(CV_32F, CV_64F)))
+{
+    const int method = get<0>(GetParam());
+    const int depth = get<1>(GetParam());
+
+    string depthFilename = getDataPath("cv/rgbd/depth.png");
+    Mat depth16 = imread(depthFilename, IMREAD_UNCHANGED);
+    ASSERT_FALSE(depth16.empty()) << "Unable to load depth " << depthFilename;
+
+    Mat depthFlt;
+    depth16.convertTo(depthFlt, CV_32FC1, 1.f/5000.f);
+    depthFlt.setTo(std::numeric_limits<float>::quiet_NaN(), depthFlt < FLT_EPSILON);
+
+    Mat K = (Mat_<float>(3, 3) << 525.f,    0.f, 319.5f,
+                                    0.f,  525.f, 239.5f,
+                                    0.f,    0.f,    1.f);
+
+    Mat points3d;
+    depthTo3d(depthFlt, K, points3d);
+    points3d.convertTo(points3d, depth);
+
+    RgbdNormals normalsComputer(depthFlt.rows, depthFlt.cols, depth, K, 5, method);
+    normalsComputer.initialize();
+
+    Mat normals;
+    declare.in(points3d);
+
+    TEST_CYCLE() normalsComputer(points3d, normals);
+
+    SANITY_CHECK_NOTHING();
+}
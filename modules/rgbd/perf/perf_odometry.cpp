@@ -0,0 +1,65 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+using std::tr1::get;
+
+CV_ENUM(TransformType, Odometry::ROTATION, Odometry::TRANSLATION, Odometry::RIGID_BODY_MOTION)
+
+typedef std::tr1::tuple<string, TransformType> OdometryParams;
+typedef perf::TestBaseWithParam<OdometryParams> OdometryPerfTest;
+
+static void readRgbdData(Mat& image, Mat& depth)
+{
+    string imageFilename = getDataPath("cv/rgbd/rgb.png");
+    string depthFilename = getDataPath("cv/rgbd/depth.png");
+
+    image = imread(imageFilename, IMREAD_GRAYSCALE);
+    depth = imread(depthFilename, IMREAD_UNCHANGED);
+    ASSERT_FALSE(image.empty()) << "Unable to load image " << imageFilename;
+    ASSERT_FALSE(depth.empty()) << "Unable to load depth " << depthFilename;
+
+    Mat depth_flt;
+    depth.convertTo(depth_flt, CV_32FC1, 1.f/5000.f);
+    depth_flt.setTo(std::numeric_limits<float>::quiet_NaN(), depth_flt < FLT_EPSILON);
+    depth = depth_flt;
+}
+
+PERF_TEST_P(OdometryPerfTest, compute,
+            testing::Combine(testing::Values(string("RgbdOdometry"), string("ICPOdometry"), string("RgbdICPOdometry")),
+                             TransformType::all()))
+{
+    const string odometryType = get<0>(GetParam());
+    const int transformType = get<1>(GetParam());
+
+    Mat image, depth;
+    readRgbdData(image, depth);
+
+    Mat K = (Mat_<float>(3, 3) << 525.f,    0.f, 319.5f,
+                                    0.f,  525.f, 239.5f,
+                                    0.f,    0.f,    1.f);
+
+    Ptr<Odometry> odometry = Odometry::create(odometryType);
+    odometry->setCameraMatrix(K);
+    odometry->setTransformType(transformType);
+
+    // Shift the second frame a little so that the iterations do not stop at once
+    Mat warpedImage, warpedDepth;
+    Mat Rt = Mat::eye(4, 4, CV_64FC1);
+    Rt.at<double>(0, 3) = 0.01;
+    warpFrame(image, depth, Mat(), Rt, K, Mat(), warpedImage, &warpedDepth);
+
+    Ptr<OdometryFrame> srcFrame = makePtr<OdometryFrame>(image, depth);
+    Ptr<OdometryFrame> dstFrame = makePtr<OdometryFrame>(warpedImage, warpedDepth);
+    odometry->prepareFrameCache(srcFrame, OdometryFrame::CACHE_SRC);
+    odometry->prepareFrameCache(dstFrame, OdometryFrame::CACHE_DST);
+
+    Mat calcRt;
+    declare.in(image, depth).time(60);
+
+    TEST_CYCLE() odometry->compute(srcFrame, dstFrame, calcRt);
+
+    SANITY_CHECK_NOTHING();
+}
@@ -0,0 +1,51 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::rgbd;
+using namespace perf;
+
+CV_ENUM(PlaneMethod, RgbdPlane::RGBD_PLANE_METHOD_DEFAULT, RgbdPlane::RGBD_PLANE_METHOD_PARALLEL)
+
+typedef perf::TestBaseWithParam<PlaneMethod> PlanePerfTest;
+
+// A 1280x720 scene made of a floor and three walls, 1/z being linear in the image coordinates on a plane
+static void generateScene(Mat& points3d)
+{
+    const int width = 1280, height = 720;
+    Mat K = (Mat_<float>(3, 3) << 1000.f,     0.f, 639.5f,
+                                     0.f,  1000.f, 359.5f,
+                                     0.f,     0.f,    1.f);
+    Mat_<float> depth(height, width);
+    RNG rng(0);
+    for (int v = 0; v < height; ++v)
+        for (int u = 0; u < width; ++u)
+        {
+            float inv_z;
+            if (v > 500)
+                inv_z = 0.15f + 0.0012f * (v - 500);
+            else if (u < 400)
+                inv_z = 0.4f - 0.0004f * u;
+            else if (u < 900)
+                inv_z = 0.25f;
+            else
+                inv_z = 0.25f + 0.0003f * (u - 900);
+            depth(v, u) = 1.f / inv_z + rng.gaussian(0.001);
+        }
+    depthTo3d(depth, K, points3d);
+}
+
+PERF_TEST_P(PlanePerfTest, compute, PlaneMethod::all())
+{
+    Mat points3d;
+    generateScene(points3d);
+
+    RgbdPlane planeComputer(RgbdPlane::RGBD_PLANE_METHOD(int(GetParam())));
+    Mat mask;
+    vector<Vec4f> coefficients;
+    declare.in(points3d);
+
+    TEST_CYCLE() planeComputer(points3d, mask, coefficients);
+
+    SANITY_CHECK_NOTHING();
+}
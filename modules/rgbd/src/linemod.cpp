@@ -41,6 +41,16 @@
 //M*/
 
 #include "precomp.hpp"
+#include <fstream>
+#include <cstring>
+
+#if defined __unix__ || defined __APPLE__
+#  define LINEMOD_HAVE_MMAP
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 
 namespace cv
 {
@@ -920,6 +930,9 @@ static void orUnaligned8u(const uchar * src, const int src_stride,
                    uchar * dst, const int dst_stride,
                    const int width, const int height)
 {
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+#endif
 #if CV_SSE2
   volatile bool haveSSE2 = checkHardwareSupport(CPU_SSE2);
 #if CV_SSE3
@@ -932,6 +945,18 @@ static void orUnaligned8u(const uchar * src, const int src_stride,
   {
     int c = 0;
 
+#if CV_AVX2
+    // 32 labels at a time, the SSE paths below handle the remaining 16 if any
+    if (haveAVX2)
+    {
+      for ( ; c < width - 31; c += 32)
+      {
+        __m256i val = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + c));
+        __m256i* dst_ptr = reinterpret_cast<__m256i*>(dst + c);
+        _mm256_storeu_si256(dst_ptr, _mm256_or_si256(_mm256_loadu_si256(dst_ptr), val));
+      }
+    }
+#endif
 #if CV_SSE2
     // Use aligned loads if possible
     if (haveSSE2 && src_aligned)
@@ -1193,9 +1218,14 @@ static void similarity(const std::vector<Mat>& linear_memories, const Template&
 
   /// @todo In old code, dst is buffer of size m_U. Could make it something like
   /// (span_x)x(span_y) instead?
-  dst = Mat::zeros(H, W, CV_8U);
+  // Reuse the buffer of dst when possible, the matcher calls this once per template
+  dst.create(H, W, CV_8U);
+  dst.setTo(Scalar::all(0));
   uchar* dst_ptr = dst.ptr<uchar>();
 
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+#endif
 #if CV_SSE2
   volatile bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2);
 #if CV_SSE3
@@ -1218,6 +1248,18 @@ static void similarity(const std::vector<Mat>& linear_memories, const Template&
 
     // Now we do an aligned/unaligned add of dst_ptr and lm_ptr with template_positions elements
     int j = 0;
+#if CV_AVX2
+    // Process responses 32 at a time, the SSE paths below finish the last 16 if any
+    if (haveAVX2)
+    {
+      for ( ; j < template_positions - 31; j += 32)
+      {
+        __m256i responses = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lm_ptr + j));
+        __m256i* dst_ptr_avx = reinterpret_cast<__m256i*>(dst_ptr + j);
+        _mm256_storeu_si256(dst_ptr_avx, _mm256_add_epi8(_mm256_loadu_si256(dst_ptr_avx), responses));
+      }
+    }
+#endif
     // Process responses 16 at a time if vectorization possible
 #if CV_SSE2
 #if CV_SSE3
@@ -1268,7 +1310,8 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
 
   // Compute the similarity map in a 16x16 patch around center
   int W = size.width / T;
-  dst = Mat::zeros(16, 16, CV_8U);
+  dst.create(16, 16, CV_8U);
+  dst.setTo(Scalar::all(0));
 
   // Offset each feature point by the requested center. Further adjust to (-8,-8) from the
   // center to get the top-left corner of the 16x16 patch.
@@ -1276,6 +1319,11 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
   int offset_x = (center.x / T - 8) * T;
   int offset_y = (center.y / T - 8) * T;
 
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+  // Two consecutive rows of the continuous 16x16 patch per register
+  __m256i* dst_ptr_avx = dst.ptr<__m256i>();
+#endif
 #if CV_SSE2
   volatile bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2);
 #if CV_SSE3
@@ -1296,6 +1344,21 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
     const uchar* lm_ptr = accessLinearMemory(linear_memories, f, T, W);
 
     // Process whole row at a time if vectorization possible
+#if CV_AVX2
+    if (haveAVX2)
+    {
+      for (int row = 0; row < 16; row += 2)
+      {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lm_ptr));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lm_ptr + W));
+        __m256i responses = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        __m256i* dst_row = dst_ptr_avx + row / 2;
+        _mm256_storeu_si256(dst_row, _mm256_add_epi8(_mm256_loadu_si256(dst_row), responses));
+        lm_ptr += 2 * W; // Step to next pair of rows
+      }
+    }
+    else
+#endif
 #if CV_SSE2
 #if CV_SSE3
     if (haveSSE3)
@@ -1337,16 +1400,39 @@ static void similarityLocal(const std::vector<Mat>& linear_memories, const Templ
 
 static void addUnaligned8u16u(const uchar * src1, const uchar * src2, ushort * res, int length)
 {
-  const uchar * end = src1 + length;
+  int i = 0;
 
-  while (src1 != end)
+#if CV_AVX2
+  volatile bool haveAVX2 = checkHardwareSupport(CV_CPU_AVX2);
+  if (haveAVX2)
   {
-    *res = *src1 + *src2;
-
-    ++src1;
-    ++src2;
-    ++res;
+    for ( ; i < length - 15; i += 16)
+    {
+      __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i)));
+      __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src2 + i)));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(res + i), _mm256_add_epi16(a, b));
+    }
+  }
+#endif
+#if CV_SSE2
+  volatile bool haveSSE2 = checkHardwareSupport(CV_CPU_SSE2);
+  if (haveSSE2)
+  {
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i < length - 15; i += 16)
+    {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src2 + i));
+      __m128i sum_lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+      __m128i sum_hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(res + i), sum_lo);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(res + i + 8), sum_hi);
+    }
   }
+#endif
+
+  for ( ; i < length; ++i)
+    res[i] = static_cast<ushort>(src1[i] + src2[i]);
 }
 
 /**
@@ -1374,100 +1460,292 @@ static void addSimilarities(const std::vector<Mat>& similarities, Mat& dst)
 }
 
 /****************************************************************************************\
-*                               High-level Detector API                                  *
+*                                 Template database                                      *
 \****************************************************************************************/
 
-Detector::Detector()
+/*
+ * Binary layout written by Detector::writeTemplateDatabase(), in native byte order:
+ *
+ *   char[8] magic, int32 version, int32 index size
+ *   index:  int32 number of modalities, the modality names, int32 pyramid levels,
+ *           int32 number of classes, then for each class its ID, int32 number of templates,
+ *           int64 offset (from the end of the index) and int64 size of its block
+ *   blocks: for each template pyramid, int32 number of templates, then for each template
+ *           int32 width, height, pyramid level and number of features, followed by the
+ *           int16 x, int16 y and uint8 label arrays of its features
+ *
+ * Strings are stored as an int32 length followed by the characters.
+ */
+static const char DB_MAGIC[8] = { 'L', 'I', 'N', 'E', 'M', 'O', 'D', 'B' };
+static const int DB_VERSION = 1;
+
+template<typename T>
+static inline void appendBinary(std::vector<uchar>& buf, const T& value)
 {
+  const uchar* p = reinterpret_cast<const uchar*>(&value);
+  buf.insert(buf.end(), p, p + sizeof(T));
 }
 
-Detector::Detector(const std::vector< Ptr<Modality> >& _modalities,
-                   const std::vector<int>& T_pyramid)
-  : modalities(_modalities),
-    pyramid_levels(static_cast<int>(T_pyramid.size())),
-    T_at_level(T_pyramid)
+template<typename T>
+static inline void appendBinary(std::vector<uchar>& buf, const std::vector<T>& values)
 {
+  if (values.empty())
+    return;
+  const uchar* p = reinterpret_cast<const uchar*>(&values[0]);
+  buf.insert(buf.end(), p, p + values.size() * sizeof(T));
 }
 
-void Detector::match(const std::vector<Mat>& sources, float threshold, std::vector<Match>& matches,
-                     const std::vector<String>& class_ids, OutputArrayOfArrays quantized_images,
-                     const std::vector<Mat>& masks) const
+static inline void appendBinary(std::vector<uchar>& buf, const String& str)
 {
-  matches.clear();
-  if (quantized_images.needed())
-    quantized_images.create(1, static_cast<int>(pyramid_levels * modalities.size()), CV_8U);
+  appendBinary(buf, static_cast<int>(str.size()));
+  buf.insert(buf.end(), str.begin(), str.end());
+}
 
-  CV_Assert(sources.size() == modalities.size());
-  // Initialize each modality with our sources
-  std::vector< Ptr<QuantizedPyramid> > quantizers;
-  for (int i = 0; i < (int)modalities.size(); ++i){
-    Mat mask, source;
-    source = sources[i];
-    if(!masks.empty()){
-      CV_Assert(masks.size() == modalities.size());
-      mask = masks[i];
-    }
-    CV_Assert(mask.empty() || mask.size() == source.size());
-    quantizers.push_back(modalities[i]->process(source, mask));
+/**
+ * \brief Reads values from a memory block, checking that they do not go past its end.
+ *
+ * The values are copied as they are not aligned in the file.
+ */
+class BinaryReader
+{
+public:
+  BinaryReader(const uchar* data, size_t size) : ptr(data), end(data + size) {}
+
+  template<typename T> T read()
+  {
+    T value;
+    readArray(&value, 1);
+    return value;
   }
-  // pyramid level -> modality -> quantization
-  LinearMemoryPyramid lm_pyramid(pyramid_levels,
-                                 std::vector<LinearMemories>(modalities.size(), LinearMemories(8)));
 
-  // For each pyramid level, precompute linear memories for each modality
-  std::vector<Size> sizes;
-  for (int l = 0; l < pyramid_levels; ++l)
+  template<typename T> void readArray(T* dst, size_t n)
   {
-    int T = T_at_level[l];
-    std::vector<LinearMemories>& lm_level = lm_pyramid[l];
+    size_t bytes = n * sizeof(T);
+    if (bytes > static_cast<size_t>(end - ptr))
+      CV_Error(Error::StsParseError, "Truncated LINEMOD template database");
+    if (bytes)
+      memcpy(dst, ptr, bytes);
+    ptr += bytes;
+  }
 
-    if (l > 0)
-    {
-      for (int i = 0; i < (int)quantizers.size(); ++i)
-        quantizers[i]->pyrDown();
-    }
+  String readString()
+  {
+    int length = read<int>();
+    if (length < 0 || static_cast<size_t>(length) > static_cast<size_t>(end - ptr))
+      CV_Error(Error::StsParseError, "Truncated LINEMOD template database");
+    String str(reinterpret_cast<const char*>(ptr), static_cast<size_t>(length));
+    ptr += length;
+    return str;
+  }
 
-    Mat quantized, spread_quantized;
-    std::vector<Mat> response_maps;
-    for (int i = 0; i < (int)quantizers.size(); ++i)
-    {
-      quantizers[i]->quantize(quantized);
-      spread(quantized, spread_quantized, T);
-      computeResponseMaps(spread_quantized, response_maps);
+private:
+  const uchar* ptr;
+  const uchar* end;
+};
 
-      LinearMemories& memories = lm_level[i];
-      for (int j = 0; j < 8; ++j)
-        linearize(response_maps[j], memories[j], T);
+struct Detector::TemplateDatabase
+{
+  struct ClassEntry
+  {
+    ClassEntry() : num_templates(0), offset(0), size(0), loaded(false) {}
+
+    int num_templates;
+    int64 offset;
+    int64 size;
+    bool loaded;
+    std::vector<TemplatePyramid> template_pyramids;
+  };
+  typedef std::map<String, ClassEntry> ClassIndex;
+
+  TemplateDatabase(const String& filename);
+  ~TemplateDatabase();
+
+  /// Decode the templates of a class the first time they are requested
+  const std::vector<TemplatePyramid>& load(ClassEntry& entry);
+
+  /// Move a class to the templates in memory so that templates can be added to it
+  void detach(const String& class_id, TemplatesMap& class_templates);
+
+  ClassIndex classes;
+  std::vector<String> modality_names;
+  int pyramid_levels;
+
+private:
+  /// Pointer to size bytes of the file at offset, read into buf if the file is not mapped
+  const uchar* fetch(int64 offset, size_t size, std::vector<uchar>& buf);
+
+  int64 data_offset;
+  Mutex mutex;
+#ifdef LINEMOD_HAVE_MMAP
+  int fd;
+  uchar* mapped;
+  size_t mapped_size;
+#else
+  std::ifstream stream;
+#endif
 
-      if (quantized_images.needed()) //use copyTo here to side step reference semantics.
-        quantized.copyTo(quantized_images.getMatRef(static_cast<int>(l*quantizers.size() + i)));
-    }
+  TemplateDatabase(const TemplateDatabase&);
+  TemplateDatabase& operator=(const TemplateDatabase&);
+};
 
-    sizes.push_back(quantized.size());
+Detector::TemplateDatabase::TemplateDatabase(const String& filename)
+  : pyramid_levels(0), data_offset(0)
+{
+#ifdef LINEMOD_HAVE_MMAP
+  mapped = NULL;
+  mapped_size = 0;
+  fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    CV_Error(Error::StsError, "Could not open LINEMOD template database " + filename);
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void* ptr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED)
+    {
+      mapped = static_cast<uchar*>(ptr);
+      mapped_size = static_cast<size_t>(st.st_size);
+    }
   }
+  if (!mapped)
+  {
+    close(fd);
+    CV_Error(Error::StsError, "Could not map LINEMOD template database " + filename);
+  }
+#else
+  stream.open(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!stream.is_open())
+    CV_Error(Error::StsError, "Could not open LINEMOD template database " + filename);
+#endif
 
-  if (class_ids.empty())
+  std::vector<uchar> buf;
+  const size_t header_size = sizeof(DB_MAGIC) + 2 * sizeof(int);
+  BinaryReader header(fetch(0, header_size, buf), header_size);
+  char magic[sizeof(DB_MAGIC)];
+  header.readArray(magic, sizeof(DB_MAGIC));
+  if (memcmp(magic, DB_MAGIC, sizeof(DB_MAGIC)) != 0 || header.read<int>() != DB_VERSION)
+    CV_Error(Error::StsBadArg, filename + " is not a LINEMOD template database");
+  int index_size = header.read<int>();
+  CV_Assert(index_size >= 0);
+  data_offset = static_cast<int64>(header_size) + index_size;
+
+  BinaryReader index(fetch(header_size, static_cast<size_t>(index_size), buf), static_cast<size_t>(index_size));
+  int num_modalities = index.read<int>();
+  CV_Assert(num_modalities >= 0);
+  for (int i = 0; i < num_modalities; ++i)
+    modality_names.push_back(index.readString());
+  pyramid_levels = index.read<int>();
+  int num_classes = index.read<int>();
+  CV_Assert(num_classes >= 0);
+  for (int i = 0; i < num_classes; ++i)
   {
-    // Match all templates
-    TemplatesMap::const_iterator it = class_templates.begin(), itend = class_templates.end();
-    for ( ; it != itend; ++it)
-      matchClass(lm_pyramid, sizes, threshold, matches, it->first, it->second);
+    String class_id = index.readString();
+    ClassEntry& entry = classes[class_id];
+    entry.num_templates = index.read<int>();
+    entry.offset = index.read<int64>();
+    entry.size = index.read<int64>();
+    CV_Assert(entry.num_templates >= 0 && entry.offset >= 0 && entry.size >= 0);
   }
-  else
+}
+
+Detector::TemplateDatabase::~TemplateDatabase()
+{
+#ifdef LINEMOD_HAVE_MMAP
+  munmap(mapped, mapped_size);
+  close(fd);
+#endif
+}
+
+const uchar* Detector::TemplateDatabase::fetch(int64 offset, size_t size, std::vector<uchar>& buf)
+{
+#ifdef LINEMOD_HAVE_MMAP
+  (void)buf;
+  if (offset < 0 || static_cast<uint64>(offset) + size > mapped_size)
+    CV_Error(Error::StsParseError, "Truncated LINEMOD template database");
+  return mapped + offset;
+#else
+  buf.resize(size);
+  stream.clear();
+  stream.seekg(static_cast<std::streamoff>(offset));
+  stream.read(reinterpret_cast<char*>(buf.empty() ? NULL : &buf[0]), static_cast<std::streamsize>(size));
+  if (static_cast<size_t>(stream.gcount()) != size)
+    CV_Error(Error::StsParseError, "Truncated LINEMOD template database");
+  return buf.empty() ? NULL : &buf[0];
+#endif
+}
+
+const std::vector<Detector::TemplatePyramid>& Detector::TemplateDatabase::load(ClassEntry& entry)
+{
+  AutoLock lock(mutex);
+  if (entry.loaded)
+    return entry.template_pyramids;
+
+  std::vector<uchar> buf;
+  size_t size = static_cast<size_t>(entry.size);
+  BinaryReader reader(fetch(data_offset + entry.offset, size, buf), size);
+
+  std::vector<TemplatePyramid>& tps = entry.template_pyramids;
+  tps.resize(entry.num_templates);
+  std::vector<short> xs, ys;
+  std::vector<uchar> labels;
+  for (size_t i = 0; i < tps.size(); ++i)
   {
-    // Match only templates for the requested class IDs
-    for (int i = 0; i < (int)class_ids.size(); ++i)
+    TemplatePyramid& tp = tps[i];
+    int num_templates = reader.read<int>();
+    CV_Assert(num_templates >= 0);
+    tp.resize(num_templates);
+    for (size_t j = 0; j < tp.size(); ++j)
     {
-      TemplatesMap::const_iterator it = class_templates.find(class_ids[i]);
-      if (it != class_templates.end())
-        matchClass(lm_pyramid, sizes, threshold, matches, it->first, it->second);
+      Template& templ = tp[j];
+      templ.width = reader.read<int>();
+      templ.height = reader.read<int>();
+      templ.pyramid_level = reader.read<int>();
+      int num_features = reader.read<int>();
+      CV_Assert(num_features >= 0);
+
+      xs.resize(num_features);
+      ys.resize(num_features);
+      labels.resize(num_features);
+      if (num_features > 0)
+      {
+        reader.readArray(&xs[0], xs.size());
+        reader.readArray(&ys[0], ys.size());
+        reader.readArray(&labels[0], labels.size());
+      }
+
+      templ.features.resize(num_features);
+      for (int k = 0; k < num_features; ++k)
+        templ.features[k] = Feature(xs[k], ys[k], labels[k]);
     }
   }
 
-  // Sort matches by similarity, and prune any duplicates introduced by pyramid refinement
-  std::sort(matches.begin(), matches.end());
-  std::vector<Match>::iterator new_end = std::unique(matches.begin(), matches.end());
-  matches.erase(new_end, matches.end());
+  entry.loaded = true;
+  return tps;
+}
+
+void Detector::TemplateDatabase::detach(const String& class_id, TemplatesMap& class_templates)
+{
+  ClassIndex::iterator it = classes.find(class_id);
+  if (it == classes.end())
+    return;
+  class_templates[class_id] = load(it->second);
+  classes.erase(it);
+}
+
+/****************************************************************************************\
+*                               High-level Detector API                                  *
+\****************************************************************************************/
+
+Detector::Detector()
+{
+}
+
+Detector::Detector(const std::vector< Ptr<Modality> >& _modalities,
+                   const std::vector<int>& T_pyramid)
+  : modalities(_modalities),
+    pyramid_levels(static_cast<int>(T_pyramid.size())),
+    T_at_level(T_pyramid)
+{
 }
 
 // Used to filter out weak matches
@@ -1478,23 +1756,86 @@ struct MatchPredicate
   float threshold;
 };
 
-void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
-                          const std::vector<Size>& sizes,
-                          float threshold, std::vector<Match>& matches,
-                          const String& class_id,
-                          const std::vector<TemplatePyramid>& template_pyramids) const
+/**
+ * \brief Matches template pyramids in parallel.
+ *
+ * The templates are split into fixed size blocks, each block collects its matches in its
+ * own buffer and the buffers are concatenated in template order afterwards, so the result
+ * is the same as matching the templates one after the other.
+ */
+class Detector::MatchInvoker : public ParallelLoopBody
 {
-  // For each template...
-  for (size_t template_id = 0; template_id < template_pyramids.size(); ++template_id)
+public:
+  struct Job
   {
-    const TemplatePyramid& tp = template_pyramids[template_id];
+    Job(const String* _class_id, const TemplatePyramid* _tp, int _template_id)
+      : class_id(_class_id), tp(_tp), template_id(_template_id) {}
+
+    const String* class_id;
+    const TemplatePyramid* tp;
+    int template_id;
+  };
+
+  static void addJobs(const String& class_id, const std::vector<TemplatePyramid>& template_pyramids,
+                      std::vector<Job>& jobs)
+  {
+    for (size_t template_id = 0; template_id < template_pyramids.size(); ++template_id)
+      jobs.push_back(Job(&class_id, &template_pyramids[template_id], static_cast<int>(template_id)));
+  }
+
+  static void run(const Detector& detector, const LinearMemoryPyramid& lm_pyramid,
+                  const std::vector<Size>& sizes, float threshold,
+                  const std::vector<Job>& jobs, std::vector<Match>& matches)
+  {
+    const int num_blocks = static_cast<int>((jobs.size() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    std::vector< std::vector<Match> > block_matches(num_blocks);
+
+    parallel_for_(Range(0, num_blocks),
+                  MatchInvoker(detector, lm_pyramid, sizes, threshold, jobs, block_matches));
+
+    for (int b = 0; b < num_blocks; ++b)
+      matches.insert(matches.end(), block_matches[b].begin(), block_matches[b].end());
+  }
+
+  virtual void operator()(const Range& range) const
+  {
+    // Per-thread similarity buffers, reused by all the templates of the range
+    std::vector<Mat> similarities(detector.modalities.size()), similarities2(detector.modalities.size());
+    Mat total_similarity, total_similarity2;
+
+    for (int b = range.start; b < range.end; ++b)
+    {
+      size_t end = std::min(jobs.size(), static_cast<size_t>(b + 1) * BLOCK_SIZE);
+      for (size_t j = static_cast<size_t>(b) * BLOCK_SIZE; j < end; ++j)
+        matchTemplate(jobs[j], similarities, total_similarity, similarities2, total_similarity2,
+                      block_matches[b]);
+    }
+  }
+
+private:
+  enum { BLOCK_SIZE = 16 };
+
+  MatchInvoker(const Detector& _detector, const LinearMemoryPyramid& _lm_pyramid,
+               const std::vector<Size>& _sizes, float _threshold, const std::vector<Job>& _jobs,
+               std::vector< std::vector<Match> >& _block_matches)
+    : detector(_detector), lm_pyramid(_lm_pyramid), sizes(_sizes), threshold(_threshold),
+      jobs(_jobs), block_matches(_block_matches)
+  {
+  }
+
+  void matchTemplate(const Job& job, std::vector<Mat>& similarities, Mat& total_similarity,
+                     std::vector<Mat>& similarities2, Mat& total_similarity2,
+                     std::vector<Match>& matches) const
+  {
+    const std::vector< Ptr<Modality> >& modalities = detector.modalities;
+    const std::vector<int>& T_at_level = detector.T_at_level;
+    const int pyramid_levels = detector.pyramid_levels;
+    const TemplatePyramid& tp = *job.tp;
 
     // First match over the whole image at the lowest pyramid level
-    /// @todo Factor this out into separate function
     const std::vector<LinearMemories>& lowest_lm = lm_pyramid.back();
 
     // Compute similarity maps for each modality at lowest pyramid level
-    std::vector<Mat> similarities(modalities.size());
     int lowest_start = static_cast<int>(tp.size() - modalities.size());
     int lowest_T = T_at_level.back();
     int num_features = 0;
@@ -1507,7 +1848,6 @@ void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
 
     // Combine into overall similarity
     /// @todo Support weighting the modalities
-    Mat total_similarity;
     addSimilarities(similarities, total_similarity);
 
     // Convert user-friendly percentage to raw similarity threshold. The percentage
@@ -1530,7 +1870,7 @@ void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
           int x = c * lowest_T + offset;
           int y = r * lowest_T + offset;
           float score =(raw_score * 100.f) / (4 * num_features) + 0.5f;
-          candidates.push_back(Match(x, y, score, class_id, static_cast<int>(template_id)));
+          candidates.push_back(Match(x, y, score, *job.class_id, job.template_id));
         }
       }
     }
@@ -1547,8 +1887,6 @@ void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
       int max_x = size.width - tp[start].width - border;
       int max_y = size.height - tp[start].height - border;
 
-      std::vector<Mat> similarities2(modalities.size());
-      Mat total_similarity2;
       for (int m = 0; m < (int)candidates.size(); ++m)
       {
         Match& match2 = candidates[m];
@@ -1604,12 +1942,148 @@ void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
 
     matches.insert(matches.end(), candidates.begin(), candidates.end());
   }
+
+  const Detector& detector;
+  const LinearMemoryPyramid& lm_pyramid;
+  const std::vector<Size>& sizes;
+  float threshold;
+  const std::vector<Job>& jobs;
+  std::vector< std::vector<Match> >& block_matches;
+};
+
+void Detector::match(const std::vector<Mat>& sources, float threshold, std::vector<Match>& matches,
+                     const std::vector<String>& class_ids, OutputArrayOfArrays quantized_images,
+                     const std::vector<Mat>& masks) const
+{
+  matches.clear();
+  if (quantized_images.needed())
+    quantized_images.create(1, static_cast<int>(pyramid_levels * modalities.size()), CV_8U);
+
+  CV_Assert(sources.size() == modalities.size());
+  // Initialize each modality with our sources
+  std::vector< Ptr<QuantizedPyramid> > quantizers;
+  for (int i = 0; i < (int)modalities.size(); ++i){
+    Mat mask, source;
+    source = sources[i];
+    if(!masks.empty()){
+      CV_Assert(masks.size() == modalities.size());
+      mask = masks[i];
+    }
+    CV_Assert(mask.empty() || mask.size() == source.size());
+    quantizers.push_back(modalities[i]->process(source, mask));
+  }
+  // pyramid level -> modality -> quantization
+  LinearMemoryPyramid lm_pyramid(pyramid_levels,
+                                 std::vector<LinearMemories>(modalities.size(), LinearMemories(8)));
+
+  // For each pyramid level, precompute linear memories for each modality
+  std::vector<Size> sizes;
+  for (int l = 0; l < pyramid_levels; ++l)
+  {
+    int T = T_at_level[l];
+    std::vector<LinearMemories>& lm_level = lm_pyramid[l];
+
+    if (l > 0)
+    {
+      for (int i = 0; i < (int)quantizers.size(); ++i)
+        quantizers[i]->pyrDown();
+    }
+
+    Mat quantized, spread_quantized;
+    std::vector<Mat> response_maps;
+    for (int i = 0; i < (int)quantizers.size(); ++i)
+    {
+      quantizers[i]->quantize(quantized);
+      spread(quantized, spread_quantized, T);
+      computeResponseMaps(spread_quantized, response_maps);
+
+      LinearMemories& memories = lm_level[i];
+      for (int j = 0; j < 8; ++j)
+        linearize(response_maps[j], memories[j], T);
+
+      if (quantized_images.needed()) //use copyTo here to side step reference semantics.
+        quantized.copyTo(quantized_images.getMatRef(static_cast<int>(l*quantizers.size() + i)));
+    }
+
+    sizes.push_back(quantized.size());
+  }
+
+  // Gather the templates of the requested classes, they are all matched at once so that
+  // the work is spread evenly over the threads regardless of how it is split into classes
+  std::vector<MatchInvoker::Job> jobs;
+  if (class_ids.empty())
+  {
+    // Match all templates
+    TemplatesMap::const_iterator it = class_templates.begin(), itend = class_templates.end();
+    for ( ; it != itend; ++it)
+      MatchInvoker::addJobs(it->first, it->second, jobs);
+    if (template_database)
+    {
+      TemplateDatabase::ClassIndex::iterator db_it = template_database->classes.begin();
+      for ( ; db_it != template_database->classes.end(); ++db_it)
+        MatchInvoker::addJobs(db_it->first, template_database->load(db_it->second), jobs);
+    }
+  }
+  else
+  {
+    // Match only templates for the requested class IDs
+    for (int i = 0; i < (int)class_ids.size(); ++i)
+    {
+      const String* class_id = NULL;
+      const std::vector<TemplatePyramid>* template_pyramids = findTemplatePyramids(class_ids[i], &class_id);
+      if (template_pyramids)
+        MatchInvoker::addJobs(*class_id, *template_pyramids, jobs);
+    }
+  }
+  MatchInvoker::run(*this, lm_pyramid, sizes, threshold, jobs, matches);
+
+  // Sort matches by similarity, and prune any duplicates introduced by pyramid refinement
+  std::sort(matches.begin(), matches.end());
+  std::vector<Match>::iterator new_end = std::unique(matches.begin(), matches.end());
+  matches.erase(new_end, matches.end());
+}
+
+void Detector::matchClass(const LinearMemoryPyramid& lm_pyramid,
+                          const std::vector<Size>& sizes,
+                          float threshold, std::vector<Match>& matches,
+                          const String& class_id,
+                          const std::vector<TemplatePyramid>& template_pyramids) const
+{
+  std::vector<MatchInvoker::Job> jobs;
+  MatchInvoker::addJobs(class_id, template_pyramids, jobs);
+  MatchInvoker::run(*this, lm_pyramid, sizes, threshold, jobs, matches);
+}
+
+const std::vector<Detector::TemplatePyramid>* Detector::findTemplatePyramids(const String& class_id,
+                                                                           const String** class_id_storage) const
+{
+  TemplatesMap::const_iterator it = class_templates.find(class_id);
+  if (it != class_templates.end())
+  {
+    if (class_id_storage)
+      *class_id_storage = &it->first;
+    return &it->second;
+  }
+
+  if (template_database)
+  {
+    TemplateDatabase::ClassIndex::iterator db_it = template_database->classes.find(class_id);
+    if (db_it != template_database->classes.end())
+    {
+      if (class_id_storage)
+        *class_id_storage = &db_it->first;
+      return &template_database->load(db_it->second);
+    }
+  }
+  return NULL;
 }
 
 int Detector::addTemplate(const std::vector<Mat>& sources, const String& class_id,
                           const Mat& object_mask, Rect* bounding_box)
 {
   int num_modalities = static_cast<int>(modalities.size());
+  if (template_database)
+    template_database->detach(class_id, class_templates);
   std::vector<TemplatePyramid>& template_pyramids = class_templates[class_id];
   int template_id = static_cast<int>(template_pyramids.size());
 
@@ -1644,6 +2118,8 @@ int Detector::addTemplate(const std::vector<Mat>& sources, const String& class_i
 
 int Detector::addSyntheticTemplate(const std::vector<Template>& templates, const String& class_id)
 {
+  if (template_database)
+    template_database->detach(class_id, class_templates);
   std::vector<TemplatePyramid>& template_pyramids = class_templates[class_id];
   int template_id = static_cast<int>(template_pyramids.size());
   template_pyramids.push_back(templates);
@@ -1652,10 +2128,10 @@ int Detector::addSyntheticTemplate(const std::vector<Template>& templates, const
 
 const std::vector<Template>& Detector::getTemplates(const String& class_id, int template_id) const
 {
-  TemplatesMap::const_iterator i = class_templates.find(class_id);
-  CV_Assert(i != class_templates.end());
-  CV_Assert(i->second.size() > size_t(template_id));
-  return i->second[template_id];
+  const std::vector<TemplatePyramid>* template_pyramids = findTemplatePyramids(class_id);
+  CV_Assert(template_pyramids != NULL);
+  CV_Assert(template_pyramids->size() > size_t(template_id));
+  return (*template_pyramids)[template_id];
 }
 
 int Detector::numTemplates() const
@@ -1664,15 +2140,36 @@ int Detector::numTemplates() const
   TemplatesMap::const_iterator i = class_templates.begin(), iend = class_templates.end();
   for ( ; i != iend; ++i)
     ret += static_cast<int>(i->second.size());
+  if (template_database)
+  {
+    // Use the index, there is no need to load the classes
+    TemplateDatabase::ClassIndex::const_iterator j = template_database->classes.begin();
+    for ( ; j != template_database->classes.end(); ++j)
+      ret += j->second.num_templates;
+  }
   return ret;
 }
 
 int Detector::numTemplates(const String& class_id) const
 {
   TemplatesMap::const_iterator i = class_templates.find(class_id);
-  if (i == class_templates.end())
-    return 0;
-  return static_cast<int>(i->second.size());
+  if (i != class_templates.end())
+    return static_cast<int>(i->second.size());
+  if (template_database)
+  {
+    TemplateDatabase::ClassIndex::const_iterator j = template_database->classes.find(class_id);
+    if (j != template_database->classes.end())
+      return j->second.num_templates;
+  }
+  return 0;
+}
+
+int Detector::numClasses() const
+{
+  int ret = static_cast<int>(class_templates.size());
+  if (template_database)
+    ret += static_cast<int>(template_database->classes.size());
+  return ret;
 }
 
 std::vector<String> Detector::classIds() const
@@ -1683,6 +2180,12 @@ std::vector<String> Detector::classIds() const
   {
     ids.push_back(i->first);
   }
+  if (template_database)
+  {
+    TemplateDatabase::ClassIndex::const_iterator j = template_database->classes.begin();
+    for ( ; j != template_database->classes.end(); ++j)
+      ids.push_back(j->first);
+  }
 
   return ids;
 }
@@ -1690,6 +2193,7 @@ std::vector<String> Detector::classIds() const
 void Detector::read(const FileNode& fn)
 {
   class_templates.clear();
+  template_database.release();
   pyramid_levels = fn["pyramid_levels"];
   fn["T"] >> T_at_level;
 
@@ -1733,7 +2237,7 @@ void Detector::write(FileStorage& fs) const
     if (class_id_override.empty())
     {
       String class_id_tmp = fn["class_id"];
-      CV_Assert(class_templates.find(class_id_tmp) == class_templates.end());
+      CV_Assert(findTemplatePyramids(class_id_tmp) == NULL);
       class_id = class_id_tmp;
     }
     else
@@ -1769,11 +2273,11 @@ void Detector::write(FileStorage& fs) const
 
 void Detector::writeClass(const String& class_id, FileStorage& fs) const
 {
-  TemplatesMap::const_iterator it = class_templates.find(class_id);
-  CV_Assert(it != class_templates.end());
-  const std::vector<TemplatePyramid>& tps = it->second;
+  const std::vector<TemplatePyramid>* template_pyramids = findTemplatePyramids(class_id);
+  CV_Assert(template_pyramids != NULL);
+  const std::vector<TemplatePyramid>& tps = *template_pyramids;
 
-  fs << "class_id" << it->first;
+  fs << "class_id" << class_id;
   fs << "modalities" << "[:";
   for (size_t i = 0; i < modalities.size(); ++i)
     fs << modalities[i]->name();
@@ -1812,16 +2316,105 @@ void Detector::readClasses(const std::vector<String>& class_ids,
 
 void Detector::writeClasses(const String& format) const
 {
-  TemplatesMap::const_iterator it = class_templates.begin(), it_end = class_templates.end();
-  for ( ; it != it_end; ++it)
+  std::vector<String> ids = classIds();
+  for (size_t i = 0; i < ids.size(); ++i)
   {
-    const String& class_id = it->first;
+    const String& class_id = ids[i];
     String filename = cv::format(format.c_str(), class_id.c_str());
     FileStorage fs(filename, FileStorage::WRITE);
     writeClass(class_id, fs);
   }
 }
 
+void Detector::writeTemplateDatabase(const String& filename) const
+{
+  std::vector<String> ids = classIds();
+
+  // Serialize the classes first to know where their blocks start
+  std::vector<uchar> data, index;
+  appendBinary(index, static_cast<int>(modalities.size()));
+  for (size_t i = 0; i < modalities.size(); ++i)
+    appendBinary(index, modalities[i]->name());
+  appendBinary(index, pyramid_levels);
+  appendBinary(index, static_cast<int>(ids.size()));
+
+  std::vector<short> xs, ys;
+  std::vector<uchar> labels;
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    const std::vector<TemplatePyramid>& tps = *findTemplatePyramids(ids[i]);
+    int64 offset = static_cast<int64>(data.size());
+    for (size_t j = 0; j < tps.size(); ++j)
+    {
+      const TemplatePyramid& tp = tps[j];
+      appendBinary(data, static_cast<int>(tp.size()));
+      for (size_t k = 0; k < tp.size(); ++k)
+      {
+        const Template& templ = tp[k];
+        int num_features = static_cast<int>(templ.features.size());
+        appendBinary(data, templ.width);
+        appendBinary(data, templ.height);
+        appendBinary(data, templ.pyramid_level);
+        appendBinary(data, num_features);
+
+        xs.resize(num_features);
+        ys.resize(num_features);
+        labels.resize(num_features);
+        for (int f = 0; f < num_features; ++f)
+        {
+          const Feature& feat = templ.features[f];
+          CV_Assert(feat.x == (short)feat.x && feat.y == (short)feat.y && (unsigned)feat.label < 256);
+          xs[f] = (short)feat.x;
+          ys[f] = (short)feat.y;
+          labels[f] = (uchar)feat.label;
+        }
+        appendBinary(data, xs);
+        appendBinary(data, ys);
+        appendBinary(data, labels);
+      }
+    }
+
+    appendBinary(index, ids[i]);
+    appendBinary(index, static_cast<int>(tps.size()));
+    appendBinary(index, offset);
+    appendBinary(index, static_cast<int64>(data.size()) - offset);
+  }
+
+  std::ofstream stream(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!stream.is_open())
+    CV_Error(Error::StsError, "Could not open " + filename + " for writing");
+  std::vector<uchar> header;
+  header.insert(header.end(), DB_MAGIC, DB_MAGIC + sizeof(DB_MAGIC));
+  appendBinary(header, DB_VERSION);
+  appendBinary(header, static_cast<int>(index.size()));
+  stream.write(reinterpret_cast<const char*>(&header[0]), static_cast<std::streamsize>(header.size()));
+  stream.write(reinterpret_cast<const char*>(&index[0]), static_cast<std::streamsize>(index.size()));
+  if (!data.empty())
+    stream.write(reinterpret_cast<const char*>(&data[0]), static_cast<std::streamsize>(data.size()));
+  if (!stream.good())
+    CV_Error(Error::StsError, "Could not write " + filename);
+}
+
+int Detector::openTemplateDatabase(const String& filename)
+{
+  template_database.release();
+  Ptr<TemplateDatabase> db = makePtr<TemplateDatabase>(filename);
+
+  // Verify compatible with Detector settings
+  CV_Assert(db->modality_names.size() == modalities.size());
+  for (size_t i = 0; i < modalities.size(); ++i)
+    CV_Assert(modalities[i]->name() == db->modality_names[i]);
+  CV_Assert(db->pyramid_levels == pyramid_levels);
+
+  // Detector should not already have these classes
+  TemplateDatabase::ClassIndex::const_iterator it = db->classes.begin(), it_end = db->classes.end();
+  for ( ; it != it_end; ++it)
+    CV_Assert(class_templates.find(it->first) == class_templates.end());
+
+  template_database = db;
+  return static_cast<int>(template_database->classes.size());
+}
+
 static const int T_DEFAULTS[] = {5, 8};
 
 Ptr<Detector> getDefaultLINE()
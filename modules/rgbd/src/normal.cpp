@@ -205,6 +205,54 @@ namespace rgbd
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+  /** The V and M^-1 tables of FALS only depend on the camera: they are shared between all the FALS instances
+   * with the same parameters so that re-creating the normals computer (e.g. once per frame) does not recompute them
+   */
+  struct FALSTables
+  {
+    int rows, cols, depth, window_size;
+    Matx33d K;
+    Mat V, M_inv;
+  };
+
+  static Mutex falsTablesMutex;
+  static std::list<FALSTables> falsTables;
+  static const size_t falsTablesMaxSize = 4;
+
+  static bool
+  findFALSTables(int rows, int cols, int depth, int window_size, const Matx33d &K, Mat &V, Mat &M_inv)
+  {
+    AutoLock lock(falsTablesMutex);
+    for (std::list<FALSTables>::iterator it = falsTables.begin(); it != falsTables.end(); ++it)
+      if (it->rows == rows && it->cols == cols && it->depth == depth && it->window_size == window_size && it->K == K)
+      {
+        V = it->V;
+        M_inv = it->M_inv;
+        // Keep the most recently used tables in front
+        falsTables.splice(falsTables.begin(), falsTables, it);
+        return true;
+      }
+    return false;
+  }
+
+  static void
+  addFALSTables(int rows, int cols, int depth, int window_size, const Matx33d &K, const Mat &V, const Mat &M_inv)
+  {
+    FALSTables tables;
+    tables.rows = rows;
+    tables.cols = cols;
+    tables.depth = depth;
+    tables.window_size = window_size;
+    tables.K = K;
+    tables.V = V;
+    tables.M_inv = M_inv;
+
+    AutoLock lock(falsTablesMutex);
+    falsTables.push_front(tables);
+    if (falsTables.size() > falsTablesMaxSize)
+      falsTables.pop_back();
+  }
+
   /** Given a set of 3d points in a depth image, compute the normals at each point
    * using the FALS method described in
    * ``Fast and Accurate Computation of Surface Normals from Range Images``
@@ -232,6 +280,17 @@ namespace rgbd
     virtual void
     cache()
     {
+      Matx33d K;
+      Mat K_mat(3, 3, CV_64F, K.val);
+      K_ori_.convertTo(K_mat, CV_64F);
+      Mat V, M_inv;
+      if (findFALSTables(rows_, cols_, depth_, window_size_, K, V, M_inv))
+      {
+        V_ = V;
+        M_inv_ = M_inv;
+        return;
+      }
+
       // Compute theta and phi according to equation 3
       Mat cos_theta, sin_theta, cos_phi, sin_phi;
       computeThetaPhi<T>(rows_, cols_, K_, cos_theta, sin_theta, cos_phi, sin_phi);
@@ -266,6 +325,8 @@ namespace rgbd
         invert(Mat33T(M_ptr->val), M_inv, DECOMP_CHOLESKY);
         *M_inv_ptr = Vec9T(M_inv.val);
       }
+
+      addFALSTables(rows_, cols_, depth_, window_size_, K, V_, M_inv_);
     }
 
     /** Compute the normals
@@ -293,29 +354,61 @@ namespace rgbd
       boxFilter(B, B, B.depth(), Size(window_size_, window_size_), Point(-1, -1), false);
 
       // compute the Minv*B products
-      row_r = r.ptr < T > (0);
-      const Vec3T * B_vec = B[0];
-      const Mat33T * M_inv = reinterpret_cast<const Mat33T *>(M_inv_.ptr(0));
-      Vec3T *normal = normals.ptr<Vec3T>(0);
-      for (; row_r != row_r_end; ++row_r, ++B_vec, ++normal, ++M_inv)
-        if (cvIsNaN(*row_r))
-        {
-          (*normal)[0] = *row_r;
-          (*normal)[1] = *row_r;
-          (*normal)[2] = *row_r;
-        }
-        else
-        {
-            Mat33T Mr = *M_inv;
-            Vec3T Br = *B_vec;
-            Vec3T MBr(Mr(0, 0) * Br[0] + Mr(0, 1)*Br[1] + Mr(0, 2)*Br[2],
-                      Mr(1, 0) * Br[0] + Mr(1, 1)*Br[1] + Mr(1, 2)*Br[2],
-                      Mr(2, 0) * Br[0] + Mr(2, 1)*Br[1] + Mr(2, 2)*Br[2]);
-           signNormal(MBr, *normal);
-        }
+      parallel_for_(Range(0, rows_), ProductInvoker(r, B, M_inv_, normals));
     }
 
   private:
+    /** Computes the Minv*B products for a range of rows
+     */
+    class ProductInvoker: public ParallelLoopBody
+    {
+    public:
+      ProductInvoker(const Mat &r, const Mat_<Vec3T> &B, const Mat_<Vec9T> &M_inv, Mat &normals)
+          :
+            r_(r),
+            B_(B),
+            M_inv_(M_inv),
+            normals_(normals)
+      {
+      }
+
+      virtual void
+      operator()(const Range& range) const
+      {
+        for (int y = range.start; y < range.end; ++y)
+        {
+          const T* row_r = r_.ptr < T > (y), *row_r_end = row_r + r_.cols;
+          const Vec3T * B_vec = B_[y];
+          const Mat33T * M_inv = reinterpret_cast<const Mat33T *>(M_inv_[y]);
+          Vec3T *normal = normals_.ptr<Vec3T>(y);
+          for (; row_r != row_r_end; ++row_r, ++B_vec, ++normal, ++M_inv)
+            if (cvIsNaN(*row_r))
+            {
+              (*normal)[0] = *row_r;
+              (*normal)[1] = *row_r;
+              (*normal)[2] = *row_r;
+            }
+            else
+            {
+              const Mat33T &Mr = *M_inv;
+              const Vec3T &Br = *B_vec;
+              Vec3T MBr(Mr(0, 0) * Br[0] + Mr(0, 1)*Br[1] + Mr(0, 2)*Br[2],
+                        Mr(1, 0) * Br[0] + Mr(1, 1)*Br[1] + Mr(1, 2)*Br[2],
+                        Mr(2, 0) * Br[0] + Mr(2, 1)*Br[1] + Mr(2, 2)*Br[2]);
+              signNormal(MBr, *normal);
+            }
+        }
+      }
+
+    private:
+      ProductInvoker& operator=(const ProductInvoker&);
+
+      const Mat &r_;
+      const Mat_<Vec3T> &B_;
+      const Mat_<Vec9T> &M_inv_;
+      Mat &normals_;
+    };
+
     Mat_<Vec3T> V_;
     Mat_<Vec9T> M_inv_;
   };
@@ -668,6 +761,188 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     Mat invxy_, invfxy_;
   };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+  /** Sums the 4 channels of an integral image over the columns [x0, x1) of the rows between top and bottom
+   */
+  static inline void
+  boxSum(const Vec4d *top, const Vec4d *bottom, int x0, int x1, Vec4d &sum)
+  {
+#if defined(CV_SIMD128_64F) && CV_SIMD128_64F
+    const double *a = top[x0].val, *b = top[x1].val, *c = bottom[x0].val, *d = bottom[x1].val;
+    v_float64x2 lo = v_load(d) - v_load(c) - v_load(b) + v_load(a);
+    v_float64x2 hi = v_load(d + 2) - v_load(c + 2) - v_load(b + 2) + v_load(a + 2);
+    v_store(sum.val, lo);
+    v_store(sum.val + 2, hi);
+#else
+    sum = bottom[x1] - bottom[x0] - top[x1] + top[x0];
+#endif
+  }
+
+  /** Given a set of 3d points in a depth image, compute the normals at each point as the cross product of the
+   * horizontal and vertical 3d gradients averaged over the window, as in
+   * ``Adaptive Neighborhood Selection for Real-Time Surface Normal Estimation from Organized Point Cloud Data
+   * Using Integral Images`` by S. Holzer, R. B. Rusu, M. Dixon, S. Gedikli and N. Navab
+   * The averages are read from integral images so the cost does not depend on the window size.
+   */
+  template<typename T>
+  class AVG3D_GRADIENT: public RgbdNormalsImpl
+  {
+  public:
+    typedef Vec<T, 3> Vec3T;
+    typedef Vec<T, 4> Vec4T;
+
+    AVG3D_GRADIENT(int rows, int cols, int window_size, int depth, const Mat &K,
+                   RgbdNormals::RGBD_NORMALS_METHOD method)
+        :
+          RgbdNormalsImpl(rows, cols, window_size, depth, K, method)
+    {
+    }
+
+    /** Compute cached data
+     */
+    virtual void
+    cache()
+    {
+    }
+
+    /** Compute the normals
+     * @param points3d the 3d points
+     * @param normals the output normals
+     */
+    void
+    compute(const Mat &points3d, Mat & normals) const
+    {
+      // The 4th channel counts the valid differences so that holes and depth discontinuities are ignored
+      Mat_<Vec4T> dx(rows_, cols_), dy(rows_, cols_);
+      parallel_for_(Range(0, rows_), GradientInvoker(points3d, dx, dy));
+
+      Mat sum_dx, sum_dy;
+      integral(dx, sum_dx, CV_64F);
+      integral(dy, sum_dy, CV_64F);
+
+      parallel_for_(Range(0, rows_), NormalInvoker(points3d, sum_dx, sum_dy, window_size_, normals));
+    }
+
+  private:
+    /** Computes the central differences of the points, one row at a time
+     */
+    class GradientInvoker: public ParallelLoopBody
+    {
+    public:
+      GradientInvoker(const Mat &points3d, Mat_<Vec4T> &dx, Mat_<Vec4T> &dy)
+          :
+            points3d_(points3d),
+            dx_(dx),
+            dy_(dy)
+      {
+      }
+
+      virtual void
+      operator()(const Range& range) const
+      {
+        const int rows = points3d_.rows, cols = points3d_.cols;
+        for (int y = range.start; y < range.end; ++y)
+        {
+          const Vec3T *p = points3d_.ptr<Vec3T>(y);
+          const Vec3T *p_up = points3d_.ptr<Vec3T>(std::max(y - 1, 0));
+          const Vec3T *p_down = points3d_.ptr<Vec3T>(std::min(y + 1, rows - 1));
+          Vec4T *dx = dx_[y], *dy = dy_[y];
+          bool has_dy = y > 0 && y < rows - 1;
+
+          dx[0] = dx[cols - 1] = Vec4T::all(0);
+          for (int x = 1; x < cols - 1; ++x)
+            difference(p[x - 1], p[x + 1], dx[x]);
+          if (has_dy)
+          {
+            for (int x = 0; x < cols; ++x)
+              difference(p_up[x], p_down[x], dy[x]);
+          }
+          else
+          {
+            for (int x = 0; x < cols; ++x)
+              dy[x] = Vec4T::all(0);
+          }
+        }
+      }
+
+    private:
+      GradientInvoker& operator=(const GradientInvoker&);
+
+      static inline void
+      difference(const Vec3T &a, const Vec3T &b, Vec4T &d)
+      {
+        // Relative depth change above which the two points are considered to be on different surfaces
+        const T max_depth_change_factor = (T)0.05;
+        T z = std::min(std::abs(a[2]), std::abs(b[2]));
+        if (cvIsNaN(a[2]) || cvIsNaN(b[2]) || std::abs(b[2] - a[2]) > max_depth_change_factor * z)
+          d = Vec4T::all(0);
+        else
+          d = Vec4T(b[0] - a[0], b[1] - a[1], b[2] - a[2], 1);
+      }
+
+      const Mat &points3d_;
+      Mat_<Vec4T> &dx_, &dy_;
+    };
+
+    /** Averages the gradients over the window and takes their cross product, one row at a time
+     */
+    class NormalInvoker: public ParallelLoopBody
+    {
+    public:
+      NormalInvoker(const Mat &points3d, const Mat &sum_dx, const Mat &sum_dy, int window_size, Mat &normals)
+          :
+            points3d_(points3d),
+            sum_dx_(sum_dx),
+            sum_dy_(sum_dy),
+            r_(window_size / 2),
+            min_count_(std::max(1, window_size * window_size / 2)),
+            normals_(normals)
+      {
+      }
+
+      virtual void
+      operator()(const Range& range) const
+      {
+        const int rows = points3d_.rows, cols = points3d_.cols;
+        const T nan = std::numeric_limits<T>::quiet_NaN();
+        for (int y = range.start; y < range.end; ++y)
+        {
+          int y0 = std::max(y - r_, 0), y1 = std::min(y + r_ + 1, rows);
+          const Vec4d *dx_top = sum_dx_.ptr<Vec4d>(y0), *dx_bottom = sum_dx_.ptr<Vec4d>(y1);
+          const Vec4d *dy_top = sum_dy_.ptr<Vec4d>(y0), *dy_bottom = sum_dy_.ptr<Vec4d>(y1);
+          const Vec3T *point = points3d_.ptr<Vec3T>(y);
+          Vec3T *normal = normals_.ptr<Vec3T>(y);
+
+          for (int x = 0; x < cols; ++x)
+          {
+            int x0 = std::max(x - r_, 0), x1 = std::min(x + r_ + 1, cols);
+            Vec4d gx, gy;
+            boxSum(dx_top, dx_bottom, x0, x1, gx);
+            boxSum(dy_top, dy_bottom, x0, x1, gy);
+
+            // No need to divide by the number of differences as the normal is normalized
+            double a = gx[1] * gy[2] - gx[2] * gy[1];
+            double b = gx[2] * gy[0] - gx[0] * gy[2];
+            double c = gx[0] * gy[1] - gx[1] * gy[0];
+            if (cvIsNaN(point[x][2]) || gx[3] < min_count_ || gy[3] < min_count_ || (a == 0 && b == 0 && c == 0))
+              normal[x] = Vec3T(nan, nan, nan);
+            else
+              signNormal((T)a, (T)b, (T)c, normal[x]);
+          }
+        }
+      }
+
+    private:
+      NormalInvoker& operator=(const NormalInvoker&);
+
+      const Mat &points3d_;
+      const Mat &sum_dx_, &sum_dy_;
+      int r_, min_count_;
+      Mat &normals_;
+    };
+  };
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
   /** Default constructor of the Algorithm class that computes normals
@@ -718,6 +993,14 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
           delete reinterpret_cast<const FALS<double> *>(rgbd_normals_impl_);
         break;
       }
+      case RgbdNormals::RGBD_NORMALS_METHOD_AVG3D_GRADIENT:
+      {
+        if (depth == CV_32F)
+          delete reinterpret_cast<const AVG3D_GRADIENT<float> *>(rgbd_normals_impl_);
+        else
+          delete reinterpret_cast<const AVG3D_GRADIENT<double> *>(rgbd_normals_impl_);
+        break;
+      }
     }
   }
 
@@ -737,7 +1020,7 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     CV_Assert(K_.cols == 3 && K.rows == 3 && (K.depth() == CV_32F || K.depth() == CV_64F));
     CV_Assert(
         method_in == RGBD_NORMALS_METHOD_FALS || method_in == RGBD_NORMALS_METHOD_LINEMOD
-        || method_in == RGBD_NORMALS_METHOD_SRI);
+        || method_in == RGBD_NORMALS_METHOD_SRI || method_in == RGBD_NORMALS_METHOD_AVG3D_GRADIENT);
     switch (method_in)
     {
       case (RGBD_NORMALS_METHOD_FALS):
@@ -764,6 +1047,16 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
           rgbd_normals_impl_ = new SRI<double>(rows, cols, window_size, depth, K, RGBD_NORMALS_METHOD_SRI);
         break;
       }
+      case RGBD_NORMALS_METHOD_AVG3D_GRADIENT:
+      {
+        if (depth == CV_32F)
+          rgbd_normals_impl_ = new AVG3D_GRADIENT<float>(rows, cols, window_size, depth, K,
+                                                         RGBD_NORMALS_METHOD_AVG3D_GRADIENT);
+        else
+          rgbd_normals_impl_ = new AVG3D_GRADIENT<double>(rows, cols, window_size, depth, K,
+                                                          RGBD_NORMALS_METHOD_AVG3D_GRADIENT);
+        break;
+      }
     }
 
     reinterpret_cast<RgbdNormalsImpl *>(rgbd_normals_impl_)->cache();
@@ -810,6 +1103,7 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
         break;
       }
       case RGBD_NORMALS_METHOD_SRI:
+      case RGBD_NORMALS_METHOD_AVG3D_GRADIENT:
       {
         CV_Assert( ((points3d_ori.channels() == 3) && (points3d_ori.depth() == CV_32F || points3d_ori.depth() == CV_64F)));
         break;
@@ -819,9 +1113,10 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
     // Initialize the pimpl
     initialize();
 
-    // Precompute something for RGBD_NORMALS_METHOD_SRI and RGBD_NORMALS_METHOD_FALS
+    // Precompute something for RGBD_NORMALS_METHOD_SRI, RGBD_NORMALS_METHOD_FALS and RGBD_NORMALS_METHOD_AVG3D_GRADIENT
     Mat points3d, radius;
-    if ((method_ == RGBD_NORMALS_METHOD_SRI) || (method_ == RGBD_NORMALS_METHOD_FALS))
+    if ((method_ == RGBD_NORMALS_METHOD_SRI) || (method_ == RGBD_NORMALS_METHOD_FALS)
+        || (method_ == RGBD_NORMALS_METHOD_AVG3D_GRADIENT))
     {
       // Make the points have the right depth
       if (points3d_ori.depth() == depth_)
@@ -829,11 +1124,14 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
       else
         points3d_ori.convertTo(points3d, depth_);
 
-      // Compute the distance to the points
-      if (depth_ == CV_32F)
-        radius = computeRadius<float>(points3d);
-      else
-        radius = computeRadius<double>(points3d);
+      // Compute the distance to the points (not needed by RGBD_NORMALS_METHOD_AVG3D_GRADIENT)
+      if (method_ != RGBD_NORMALS_METHOD_AVG3D_GRADIENT)
+      {
+        if (depth_ == CV_32F)
+          radius = computeRadius<float>(points3d);
+        else
+          radius = computeRadius<double>(points3d);
+      }
     }
 
     // Get the normals
@@ -879,6 +1177,14 @@ multiply_by_K_inv(const Matx<T, 3, 3> & K_inv, U a, U b, U c, Vec<T, 3> &res)
           reinterpret_cast<const SRI<double> *>(rgbd_normals_impl_)->compute(points3d, radius, normals);
         break;
       }
+      case RGBD_NORMALS_METHOD_AVG3D_GRADIENT:
+      {
+        if (depth_ == CV_32F)
+          reinterpret_cast<const AVG3D_GRADIENT<float> *>(rgbd_normals_impl_)->compute(points3d, normals);
+        else
+          reinterpret_cast<const AVG3D_GRADIENT<double> *>(rgbd_normals_impl_)->compute(points3d, normals);
+        break;
+      }
     }
   }
 }
@@ -451,6 +451,83 @@ void computeProjectiveMatrix(const Mat& ksi, Mat& Rt)
 #endif
 }
 
+// Projects every selected pixel of depth1 into the frame 0 and keeps the ones that land on a valid
+// pixel with a close enough depth. Rows are independent, so this is done in parallel; the
+// resolution of the pixels of frame 0 hit several times is done afterwards in scan order.
+class ProjectCorrespsInvoker : public ParallelLoopBody
+{
+public:
+    ProjectCorrespsInvoker(const Mat& _depth0, const Mat& _validMask0,
+                           const Mat& _depth1, const Mat& _selectMask1, float _maxDepthDiff,
+                           const float* _KRK_inv0_u1, const float* _KRK_inv1_v1_plus_KRK_inv2,
+                           const float* _KRK_inv3_u1, const float* _KRK_inv4_v1_plus_KRK_inv5,
+                           const float* _KRK_inv6_u1, const float* _KRK_inv7_v1_plus_KRK_inv8,
+                           const double* _Kt_ptr, Mat& _projections, Mat& _transformedDepth)
+        : depth0(_depth0), validMask0(_validMask0), depth1(_depth1), selectMask1(_selectMask1),
+          maxDepthDiff(_maxDepthDiff),
+          KRK_inv0_u1(_KRK_inv0_u1), KRK_inv1_v1_plus_KRK_inv2(_KRK_inv1_v1_plus_KRK_inv2),
+          KRK_inv3_u1(_KRK_inv3_u1), KRK_inv4_v1_plus_KRK_inv5(_KRK_inv4_v1_plus_KRK_inv5),
+          KRK_inv6_u1(_KRK_inv6_u1), KRK_inv7_v1_plus_KRK_inv8(_KRK_inv7_v1_plus_KRK_inv8),
+          Kt_ptr(_Kt_ptr), projections(_projections), transformedDepth(_transformedDepth)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        Rect r(0, 0, depth1.cols, depth1.rows);
+        for(int v1 = range.start; v1 < range.end; v1++)
+        {
+            const float *depth1_row = depth1.ptr<float>(v1);
+            const uchar *mask1_row = selectMask1.ptr<uchar>(v1);
+            Vec2s *projections_row = projections.ptr<Vec2s>(v1);
+            float *transformedDepth_row = transformedDepth.ptr<float>(v1);
+            for(int u1 = 0; u1 < depth1.cols; u1++)
+            {
+                projections_row[u1] = Vec2s(-1, -1);
+
+                float d1 = depth1_row[u1];
+                if(!mask1_row[u1])
+                    continue;
+
+                CV_DbgAssert(!cvIsNaN(d1));
+                float transformed_d1 = static_cast<float>(d1 * (KRK_inv6_u1[u1] + KRK_inv7_v1_plus_KRK_inv8[v1]) +
+                                                          Kt_ptr[2]);
+                if(transformed_d1 <= 0)
+                    continue;
+
+                float transformed_d1_inv = 1.f / transformed_d1;
+                int u0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv0_u1[u1] + KRK_inv1_v1_plus_KRK_inv2[v1]) +
+                                                       Kt_ptr[0]));
+                int v0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv3_u1[u1] + KRK_inv4_v1_plus_KRK_inv5[v1]) +
+                                                       Kt_ptr[1]));
+
+                if(!r.contains(Point(u0,v0)))
+                    continue;
+
+                float d0 = depth0.ptr<float>(v0)[u0];
+                if(validMask0.ptr<uchar>(v0)[u0] && std::abs(transformed_d1 - d0) <= maxDepthDiff)
+                {
+                    CV_DbgAssert(!cvIsNaN(d0));
+                    projections_row[u1] = Vec2s((short)u0, (short)v0);
+                    transformedDepth_row[u1] = transformed_d1;
+                }
+            }
+        }
+    }
+
+private:
+    const Mat& depth0;
+    const Mat& validMask0;
+    const Mat& depth1;
+    const Mat& selectMask1;
+    float maxDepthDiff;
+    const float *KRK_inv0_u1, *KRK_inv1_v1_plus_KRK_inv2;
+    const float *KRK_inv3_u1, *KRK_inv4_v1_plus_KRK_inv5;
+    const float *KRK_inv6_u1, *KRK_inv7_v1_plus_KRK_inv8;
+    const double* Kt_ptr;
+    Mat& projections;
+    Mat& transformedDepth;
+};
+
 static
 void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
                      const Mat& depth0, const Mat& validMask0,
@@ -462,8 +539,7 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
     CV_Assert(Rt.type() == CV_64FC1);
 
     Mat corresps(depth1.size(), CV_16SC2, Scalar::all(-1));
-    
-    Rect r(0, 0, depth1.cols, depth1.rows);
+
     Mat Kt = Rt(Rect(3,0,1,3)).clone();
     Kt = K * Kt;
     const double * Kt_ptr = Kt.ptr<const double>();
@@ -486,7 +562,7 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
             KRK_inv3_u1[u1] = (float)(KRK_inv_ptr[3] * u1);
             KRK_inv6_u1[u1] = (float)(KRK_inv_ptr[6] * u1);
         }
-        
+
         for(int v1 = 0; v1 < depth1.rows; v1++)
         {
             KRK_inv1_v1_plus_KRK_inv2[v1] = (float)(KRK_inv_ptr[1] * v1 + KRK_inv_ptr[2]);
@@ -495,52 +571,40 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
         }
     }
 
+    Mat projections(depth1.size(), CV_16SC2), transformedDepth(depth1.size(), CV_32FC1);
+    parallel_for_(Range(0, depth1.rows),
+                  ProjectCorrespsInvoker(depth0, validMask0, depth1, selectMask1, maxDepthDiff,
+                                         KRK_inv0_u1, KRK_inv1_v1_plus_KRK_inv2,
+                                         KRK_inv3_u1, KRK_inv4_v1_plus_KRK_inv5,
+                                         KRK_inv6_u1, KRK_inv7_v1_plus_KRK_inv8,
+                                         Kt_ptr, projections, transformedDepth));
+
+    // Keep the closest point among the ones projected on the same pixel, in scan order
+    Mat correspsDepth(depth1.size(), CV_32FC1);
     int correspCount = 0;
     for(int v1 = 0; v1 < depth1.rows; v1++)
     {
-        const float *depth1_row = depth1.ptr<float>(v1);
-        const uchar *mask1_row = selectMask1.ptr<uchar>(v1);
+        const Vec2s *projections_row = projections.ptr<Vec2s>(v1);
+        const float *transformedDepth_row = transformedDepth.ptr<float>(v1);
         for(int u1 = 0; u1 < depth1.cols; u1++)
         {
-            float d1 = depth1_row[u1];
-            if(mask1_row[u1])
+            const Vec2s& p = projections_row[u1];
+            if(p[0] == -1)
+                continue;
+
+            float transformed_d1 = transformedDepth_row[u1];
+            Vec2s& c = corresps.at<Vec2s>(p[1],p[0]);
+            float& exist_d1 = correspsDepth.at<float>(p[1],p[0]);
+            if(c[0] != -1)
             {
-                CV_DbgAssert(!cvIsNaN(d1));
-                float transformed_d1 = static_cast<float>(d1 * (KRK_inv6_u1[u1] + KRK_inv7_v1_plus_KRK_inv8[v1]) + 
-                                                          Kt_ptr[2]);
-                if(transformed_d1 > 0)
-                {
-                    float transformed_d1_inv = 1.f / transformed_d1;
-                    int u0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv0_u1[u1] + KRK_inv1_v1_plus_KRK_inv2[v1]) + 
-                                                           Kt_ptr[0]));
-                    int v0 = cvRound(transformed_d1_inv * (d1 * (KRK_inv3_u1[u1] + KRK_inv4_v1_plus_KRK_inv5[v1]) + 
-                                                           Kt_ptr[1]));
-                    
-                    if(r.contains(Point(u0,v0)))
-                    {
-                        float d0 = depth0.at<float>(v0,u0);
-                        if(validMask0.at<uchar>(v0, u0) && std::abs(transformed_d1 - d0) <= maxDepthDiff)
-                        {
-                            CV_DbgAssert(!cvIsNaN(d0));
-                            Vec2s& c = corresps.at<Vec2s>(v0,u0);
-                            if(c[0] != -1)
-                            {
-                                int exist_u1 = c[0], exist_v1 = c[1];
-
-                                float exist_d1 = (float)(depth1.at<float>(exist_v1,exist_u1) * 
-                                    (KRK_inv6_u1[exist_u1] + KRK_inv7_v1_plus_KRK_inv8[exist_v1]) + Kt_ptr[2]);
-
-                                if(transformed_d1 > exist_d1)
-                                    continue;
-                            }
-                            else
-                                correspCount++;
-
-                            c = Vec2s((short)u1, (short)v1);
-                        }
-                    }
-                }
+                if(transformed_d1 > exist_d1)
+                    continue;
             }
+            else
+                correspCount++;
+
+            c = Vec2s((short)u1, (short)v1);
+            exist_d1 = transformed_d1;
         }
     }
 
@@ -559,50 +623,47 @@ void computeCorresps(const Mat& K, const Mat& K_inv, const Mat& Rt,
 }
 
 static inline
-void calcRgbdEquationCoeffs(double* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
+void calcRgbdEquationCoeffs(float* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
 {
     double invz  = 1. / p3d.z,
            v0 = dIdx * fx * invz,
            v1 = dIdy * fy * invz,
            v2 = -(v0 * p3d.x + v1 * p3d.y) * invz;
 
-    C[0] = -p3d.z * v1 + p3d.y * v2;
-    C[1] =  p3d.z * v0 - p3d.x * v2;
-    C[2] = -p3d.y * v0 + p3d.x * v1;
-    C[3] = v0;
-    C[4] = v1;
-    C[5] = v2;
+    C[0] = (float)(-p3d.z * v1 + p3d.y * v2);
+    C[1] = (float)( p3d.z * v0 - p3d.x * v2);
+    C[2] = (float)(-p3d.y * v0 + p3d.x * v1);
+    C[3] = (float)v0;
+    C[4] = (float)v1;
+    C[5] = (float)v2;
 }
 
 static inline
-void calcRgbdEquationCoeffsRotation(double* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
+void calcRgbdEquationCoeffsRotation(float* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
 {
     double invz  = 1. / p3d.z,
            v0 = dIdx * fx * invz,
            v1 = dIdy * fy * invz,
            v2 = -(v0 * p3d.x + v1 * p3d.y) * invz;
-    C[0] = -p3d.z * v1 + p3d.y * v2;
-    C[1] =  p3d.z * v0 - p3d.x * v2;
-    C[2] = -p3d.y * v0 + p3d.x * v1;
+    C[0] = (float)(-p3d.z * v1 + p3d.y * v2);
+    C[1] = (float)( p3d.z * v0 - p3d.x * v2);
+    C[2] = (float)(-p3d.y * v0 + p3d.x * v1);
 }
 
 static inline
-void calcRgbdEquationCoeffsTranslation(double* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
+void calcRgbdEquationCoeffsTranslation(float* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
 {
     double invz  = 1. / p3d.z,
            v0 = dIdx * fx * invz,
            v1 = dIdy * fy * invz,
            v2 = -(v0 * p3d.x + v1 * p3d.y) * invz;
-    C[0] = v0;
-    C[1] = v1;
-    C[2] = v2;
+    C[0] = (float)v0;
+    C[1] = (float)v1;
+    C[2] = (float)v2;
 }
 
-typedef
-void (*CalcRgbdEquationCoeffsPtr)(double*, double, double, const Point3f&, double, double);
-
 static inline
-void calcICPEquationCoeffs(double* C, const Point3f& p0, const Vec3f& n1)
+void calcICPEquationCoeffs(float* C, const Point3f& p0, const Vec3f& n1)
 {
     C[0] = -p0.z * n1[1] + p0.y * n1[2];
     C[1] =  p0.z * n1[0] - p0.x * n1[2];
@@ -613,7 +674,7 @@ void calcICPEquationCoeffs(double* C, const Point3f& p0, const Vec3f& n1)
 }
 
 static inline
-void calcICPEquationCoeffsRotation(double* C, const Point3f& p0, const Vec3f& n1)
+void calcICPEquationCoeffsRotation(float* C, const Point3f& p0, const Vec3f& n1)
 {
     C[0] = -p0.z * n1[1] + p0.y * n1[2];
     C[1] =  p0.z * n1[0] - p0.x * n1[2];
@@ -621,27 +682,297 @@ void calcICPEquationCoeffsRotation(double* C, const Point3f& p0, const Vec3f& n1
 }
 
 static inline
-void calcICPEquationCoeffsTranslation(double* C, const Point3f& /*p0*/, const Vec3f& n1)
+void calcICPEquationCoeffsTranslation(float* C, const Point3f& /*p0*/, const Vec3f& n1)
 {
     C[0] = n1[0];
     C[1] = n1[1];
     C[2] = n1[2];
 }
 
-typedef
-void (*CalcICPEquationCoeffsPtr)(double*, const Point3f&, const Vec3f&);
+// Compile-time selection of the equation coefficients for each transformation type,
+// so that the accumulation loops below are instantiated without indirect calls.
+struct RigidBodyMotionCoeffs
+{
+    enum { transformDim = 6 };
+    static inline void rgbd(float* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
+    { calcRgbdEquationCoeffs(C, dIdx, dIdy, p3d, fx, fy); }
+    static inline void icp(float* C, const Point3f& p0, const Vec3f& n1)
+    { calcICPEquationCoeffs(C, p0, n1); }
+};
+
+struct RotationCoeffs
+{
+    enum { transformDim = 3 };
+    static inline void rgbd(float* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
+    { calcRgbdEquationCoeffsRotation(C, dIdx, dIdy, p3d, fx, fy); }
+    static inline void icp(float* C, const Point3f& p0, const Vec3f& n1)
+    { calcICPEquationCoeffsRotation(C, p0, n1); }
+};
 
-static 
+struct TranslationCoeffs
+{
+    enum { transformDim = 3 };
+    static inline void rgbd(float* C, double dIdx, double dIdy, const Point3f& p3d, double fx, double fy)
+    { calcRgbdEquationCoeffsTranslation(C, dIdx, dIdy, p3d, fx, fy); }
+    static inline void icp(float* C, const Point3f& p0, const Vec3f& n1)
+    { calcICPEquationCoeffsTranslation(C, p0, n1); }
+};
+
+// Number of correspondences processed by one task of the parallel reductions
+const int lsmBlockSize = 4096;
+
+/*
+ * Accumulates A^t*A and A^t*B for the rows of one block of correspondences.
+ * The rows are summed in single precision with SIMD and flushed to double precision
+ * every flushPeriod rows, which keeps the accuracy of a double precision accumulation.
+ * Rows are padded to a multiple of 4 floats, the whole matrix is accumulated so that
+ * it does not need to be symmetrized.
+ */
+template<int Dim>
+class NormalEquationsAccumulator
+{
+public:
+    enum { width = (Dim + 3) & ~3, flushPeriod = 64 };
+
+    NormalEquationsAccumulator() : count(0)
+    {
+        std::fill(AtA, AtA + Dim*Dim, 0.);
+        std::fill(AtB, AtB + Dim, 0.);
+        resetPartial();
+    }
+
+    // A has to be padded with zeros up to width elements
+    inline void add(const float* A, float b)
+    {
+#if CV_SIMD128
+        v_float32x4 a[width/4];
+        for(int k = 0; k < width/4; k++)
+            a[k] = v_load(A + 4*k);
+        for(int y = 0; y < Dim; y++)
+        {
+            v_float32x4 ay = v_setall_f32(A[y]);
+            for(int k = 0; k < width/4; k++)
+                partialAtA[y][k] += ay * a[k];
+        }
+        v_float32x4 vb = v_setall_f32(b);
+        for(int k = 0; k < width/4; k++)
+            partialAtB[k] += vb * a[k];
+#else
+        for(int y = 0; y < Dim; y++)
+        {
+            for(int x = 0; x < Dim; x++)
+                partialAtA[y][x] += A[y] * A[x];
+            partialAtB[y] += A[y] * b;
+        }
+#endif
+        if(++count == flushPeriod)
+            flush();
+    }
+
+    // Writes the Dim*Dim elements of A^t*A followed by the Dim elements of A^t*B
+    void store(double* dst)
+    {
+        flush();
+        std::copy(AtA, AtA + Dim*Dim, dst);
+        std::copy(AtB, AtB + Dim, dst + Dim*Dim);
+    }
+
+private:
+    void flush()
+    {
+#if CV_SIMD128
+        float buf[width];
+        for(int y = 0; y < Dim; y++)
+        {
+            for(int k = 0; k < width/4; k++)
+                v_store(buf + 4*k, partialAtA[y][k]);
+            for(int x = 0; x < Dim; x++)
+                AtA[y*Dim + x] += buf[x];
+        }
+        for(int k = 0; k < width/4; k++)
+            v_store(buf + 4*k, partialAtB[k]);
+        for(int y = 0; y < Dim; y++)
+            AtB[y] += buf[y];
+#else
+        for(int y = 0; y < Dim; y++)
+        {
+            for(int x = 0; x < Dim; x++)
+                AtA[y*Dim + x] += partialAtA[y][x];
+            AtB[y] += partialAtB[y];
+        }
+#endif
+        resetPartial();
+    }
+
+    void resetPartial()
+    {
+#if CV_SIMD128
+        for(int k = 0; k < width/4; k++)
+        {
+            for(int y = 0; y < Dim; y++)
+                partialAtA[y][k] = v_setzero_f32();
+            partialAtB[k] = v_setzero_f32();
+        }
+#else
+        for(int y = 0; y < Dim; y++)
+        {
+            std::fill(partialAtA[y], partialAtA[y] + Dim, 0.f);
+            partialAtB[y] = 0.f;
+        }
+#endif
+        count = 0;
+    }
+
+#if CV_SIMD128
+    v_float32x4 partialAtA[Dim][width/4];
+    v_float32x4 partialAtB[width/4];
+#else
+    float partialAtA[Dim][Dim];
+    float partialAtB[Dim];
+#endif
+    double AtA[Dim*Dim];
+    double AtB[Dim];
+    int count;
+};
+
+// Sums the per-block systems in block order, so that the result does not depend on the scheduling
+template<int Dim>
+static void reduceNormalEquations(const std::vector<double>& partials, Mat& AtA, Mat& AtB)
+{
+    const int blockStride = Dim*Dim + Dim;
+    const int blocksCount = (int)partials.size() / blockStride;
+
+    AtA = Mat(Dim, Dim, CV_64FC1, Scalar(0));
+    AtB = Mat(Dim, 1, CV_64FC1, Scalar(0));
+    double* AtA_ptr = AtA.ptr<double>();
+    double* AtB_ptr = AtB.ptr<double>();
+    for(int b = 0; b < blocksCount; b++)
+    {
+        const double* partial = &partials[b * blockStride];
+        for(int i = 0; i < Dim*Dim; i++)
+            AtA_ptr[i] += partial[i];
+        for(int i = 0; i < Dim; i++)
+            AtB_ptr[i] += partial[Dim*Dim + i];
+    }
+}
+
+static inline
+Point3f transformPoint(const Point3f& p, const double* Rt_ptr)
+{
+    Point3f tp;
+    tp.x = (float)(p.x * Rt_ptr[0] + p.y * Rt_ptr[1] + p.z * Rt_ptr[2] + Rt_ptr[3]);
+    tp.y = (float)(p.x * Rt_ptr[4] + p.y * Rt_ptr[5] + p.z * Rt_ptr[6] + Rt_ptr[7]);
+    tp.z = (float)(p.x * Rt_ptr[8] + p.y * Rt_ptr[9] + p.z * Rt_ptr[10] + Rt_ptr[11]);
+    return tp;
+}
+
+// Photometric residuals of the correspondences and their per-block sums of squares
+class RgbdDiffsInvoker : public ParallelLoopBody
+{
+public:
+    RgbdDiffsInvoker(const Mat& _image0, const Mat& _image1, const Vec4i* _corresps_ptr, int _correspsCount,
+                     float* _diffs_ptr, double* _sqSums)
+        : image0(_image0), image1(_image1), corresps_ptr(_corresps_ptr), correspsCount(_correspsCount),
+          diffs_ptr(_diffs_ptr), sqSums(_sqSums)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        for(int b = range.start; b < range.end; b++)
+        {
+            double sqSum = 0;
+            const int end = std::min(correspsCount, (b + 1) * lsmBlockSize);
+            for(int correspIndex = b * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u0 = c[0], v0 = c[1];
+                int u1 = c[2], v1 = c[3];
+
+                diffs_ptr[correspIndex] = static_cast<float>(static_cast<int>(image0.ptr<uchar>(v0)[u0]) -
+                                                             static_cast<int>(image1.ptr<uchar>(v1)[u1]));
+                sqSum += diffs_ptr[correspIndex] * diffs_ptr[correspIndex];
+            }
+            sqSums[b] = sqSum;
+        }
+    }
+
+private:
+    const Mat& image0;
+    const Mat& image1;
+    const Vec4i* corresps_ptr;
+    int correspsCount;
+    float* diffs_ptr;
+    double* sqSums;
+};
+
+template<class Coeffs>
+class RgbdLsmInvoker : public ParallelLoopBody
+{
+public:
+    enum { Dim = Coeffs::transformDim };
+
+    RgbdLsmInvoker(const Mat& _cloud0, const double* _Rt_ptr, const Mat& _dI_dx1, const Mat& _dI_dy1,
+                   const Vec4i* _corresps_ptr, int _correspsCount, const float* _diffs_ptr, double _sigma,
+                   double _fx, double _fy, double _sobelScale, double* _partials)
+        : cloud0(_cloud0), Rt_ptr(_Rt_ptr), dI_dx1(_dI_dx1), dI_dy1(_dI_dy1),
+          corresps_ptr(_corresps_ptr), correspsCount(_correspsCount), diffs_ptr(_diffs_ptr), sigma(_sigma),
+          fx(_fx), fy(_fy), sobelScale(_sobelScale), partials(_partials)
+    {}
+
+    virtual void operator()(const Range& range) const
+    {
+        float A[NormalEquationsAccumulator<Dim>::width] = {0};
+        for(int b = range.start; b < range.end; b++)
+        {
+            NormalEquationsAccumulator<Dim> equations;
+            const int end = std::min(correspsCount, (b + 1) * lsmBlockSize);
+            for(int correspIndex = b * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u0 = c[0], v0 = c[1];
+                int u1 = c[2], v1 = c[3];
+
+                double w = sigma + std::abs(diffs_ptr[correspIndex]);
+                w = w > DBL_EPSILON ? 1./w : 1.;
+
+                double w_sobelScale = w * sobelScale;
+
+                Point3f tp0 = transformPoint(cloud0.ptr<Point3f>(v0)[u0], Rt_ptr);
+
+                Coeffs::rgbd(A,
+                             w_sobelScale * dI_dx1.ptr<short int>(v1)[u1],
+                             w_sobelScale * dI_dy1.ptr<short int>(v1)[u1],
+                             tp0, fx, fy);
+
+                equations.add(A, (float)(w * diffs_ptr[correspIndex]));
+            }
+            equations.store(partials + b * (Dim*Dim + Dim));
+        }
+    }
+
+private:
+    const Mat& cloud0;
+    const double* Rt_ptr;
+    const Mat& dI_dx1;
+    const Mat& dI_dy1;
+    const Vec4i* corresps_ptr;
+    int correspsCount;
+    const float* diffs_ptr;
+    double sigma;
+    double fx, fy, sobelScale;
+    double* partials;
+};
+
+template<class Coeffs>
+static
 void calcRgbdLsmMatrices(const Mat& image0, const Mat& cloud0, const Mat& Rt,
                const Mat& image1, const Mat& dI_dx1, const Mat& dI_dy1,
                const Mat& corresps, double fx, double fy, double sobelScaleIn,
-               Mat& AtA, Mat& AtB, CalcRgbdEquationCoeffsPtr func, int transformDim)
+               Mat& AtA, Mat& AtB)
 {
-    AtA = Mat(transformDim, transformDim, CV_64FC1, Scalar(0));
-    AtB = Mat(transformDim, 1, CV_64FC1, Scalar(0));
-    double* AtB_ptr = AtB.ptr<double>();
-
+    const int Dim = Coeffs::transformDim;
     const int correspsCount = corresps.rows;
+    const int blocksCount = (correspsCount + lsmBlockSize - 1) / lsmBlockSize;
 
     CV_Assert(Rt.type() == CV_64FC1);
     const double * Rt_ptr = Rt.ptr<const double>();
@@ -651,70 +982,127 @@ void calcRgbdLsmMatrices(const Mat& image0, const Mat& cloud0, const Mat& Rt,
 
     const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
 
+    std::vector<double> sqSums(blocksCount);
+    parallel_for_(Range(0, blocksCount),
+                  RgbdDiffsInvoker(image0, image1, corresps_ptr, correspsCount, diffs_ptr, &sqSums[0]));
+
     double sigma = 0;
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-         const Vec4i& c = corresps_ptr[correspIndex];
-         int u0 = c[0], v0 = c[1];
-         int u1 = c[2], v1 = c[3];
-              
-         diffs_ptr[correspIndex] = static_cast<float>(static_cast<int>(image0.at<uchar>(v0,u0)) - 
-                                                      static_cast<int>(image1.at<uchar>(v1,u1)));
-         sigma += diffs_ptr[correspIndex] * diffs_ptr[correspIndex];
-    }
+    for(int b = 0; b < blocksCount; b++)
+        sigma += sqSums[b];
     sigma = std::sqrt(sigma/correspsCount);
 
-    std::vector<double> A_buf(transformDim);
-    double* A_ptr = &A_buf[0];
+    std::vector<double> partials(blocksCount * (Dim*Dim + Dim));
+    parallel_for_(Range(0, blocksCount),
+                  RgbdLsmInvoker<Coeffs>(cloud0, Rt_ptr, dI_dx1, dI_dy1, corresps_ptr, correspsCount,
+                                         diffs_ptr, sigma, fx, fy, sobelScaleIn, &partials[0]));
 
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
+    reduceNormalEquations<Dim>(partials, AtA, AtB);
+}
+
+// Point to plane residuals of the correspondences and their per-block sums of squares
+class ICPDiffsInvoker : public ParallelLoopBody
+{
+public:
+    ICPDiffsInvoker(const Mat& _cloud0, const double* _Rt_ptr, const Mat& _cloud1, const Mat& _normals1,
+                    const Vec4i* _corresps_ptr, int _correspsCount,
+                    float* _diffs_ptr, Point3f* _tps0_ptr, double* _sqSums)
+        : cloud0(_cloud0), Rt_ptr(_Rt_ptr), cloud1(_cloud1), normals1(_normals1),
+          corresps_ptr(_corresps_ptr), correspsCount(_correspsCount),
+          diffs_ptr(_diffs_ptr), tps0_ptr(_tps0_ptr), sqSums(_sqSums)
+    {}
+
+    virtual void operator()(const Range& range) const
     {
-         const Vec4i& c = corresps_ptr[correspIndex];
-         int u0 = c[0], v0 = c[1];
-         int u1 = c[2], v1 = c[3];
+        for(int b = range.start; b < range.end; b++)
+        {
+            double sqSum = 0;
+            const int end = std::min(correspsCount, (b + 1) * lsmBlockSize);
+            for(int correspIndex = b * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u0 = c[0], v0 = c[1];
+                int u1 = c[2], v1 = c[3];
+
+                Point3f tp0 = transformPoint(cloud0.ptr<Point3f>(v0)[u0], Rt_ptr);
 
-         double w = sigma + std::abs(diffs_ptr[correspIndex]);
-         w = w > DBL_EPSILON ? 1./w : 1.;
+                const Vec3f& n1 = normals1.ptr<Vec3f>(v1)[u1];
+                Point3f v = cloud1.ptr<Point3f>(v1)[u1] - tp0;
+
+                tps0_ptr[correspIndex] = tp0;
+                diffs_ptr[correspIndex] = n1[0] * v.x + n1[1] * v.y + n1[2] * v.z;
+                sqSum += diffs_ptr[correspIndex] * diffs_ptr[correspIndex];
+            }
+            sqSums[b] = sqSum;
+        }
+    }
 
-         double w_sobelScale = w * sobelScaleIn;
+private:
+    const Mat& cloud0;
+    const double* Rt_ptr;
+    const Mat& cloud1;
+    const Mat& normals1;
+    const Vec4i* corresps_ptr;
+    int correspsCount;
+    float* diffs_ptr;
+    Point3f* tps0_ptr;
+    double* sqSums;
+};
 
-         const Point3f& p0 = cloud0.at<Point3f>(v0,u0);
-         Point3f tp0;
-         tp0.x = (float)(p0.x * Rt_ptr[0] + p0.y * Rt_ptr[1] + p0.z * Rt_ptr[2] + Rt_ptr[3]);
-         tp0.y = (float)(p0.x * Rt_ptr[4] + p0.y * Rt_ptr[5] + p0.z * Rt_ptr[6] + Rt_ptr[7]);
-         tp0.z = (float)(p0.x * Rt_ptr[8] + p0.y * Rt_ptr[9] + p0.z * Rt_ptr[10] + Rt_ptr[11]);
+template<class Coeffs>
+class ICPLsmInvoker : public ParallelLoopBody
+{
+public:
+    enum { Dim = Coeffs::transformDim };
 
-         func(A_ptr,
-              w_sobelScale * dI_dx1.at<short int>(v1,u1),
-              w_sobelScale * dI_dy1.at<short int>(v1,u1),
-              tp0, fx, fy);
+    ICPLsmInvoker(const Mat& _normals1, const Vec4i* _corresps_ptr, int _correspsCount,
+                  const float* _diffs_ptr, const Point3f* _tps0_ptr, double _sigma, double* _partials)
+        : normals1(_normals1), corresps_ptr(_corresps_ptr), correspsCount(_correspsCount),
+          diffs_ptr(_diffs_ptr), tps0_ptr(_tps0_ptr), sigma(_sigma), partials(_partials)
+    {}
 
-        for(int y = 0; y < transformDim; y++)
+    virtual void operator()(const Range& range) const
+    {
+        float A[NormalEquationsAccumulator<Dim>::width] = {0};
+        for(int b = range.start; b < range.end; b++)
         {
-            double* AtA_ptr = AtA.ptr<double>(y);
-            for(int x = y; x < transformDim; x++)
-                AtA_ptr[x] += A_ptr[y] * A_ptr[x];
+            NormalEquationsAccumulator<Dim> equations;
+            const int end = std::min(correspsCount, (b + 1) * lsmBlockSize);
+            for(int correspIndex = b * lsmBlockSize; correspIndex < end; correspIndex++)
+            {
+                const Vec4i& c = corresps_ptr[correspIndex];
+                int u1 = c[2], v1 = c[3];
+
+                double w = sigma + std::abs(diffs_ptr[correspIndex]);
+                w = w > DBL_EPSILON ? 1./w : 1.;
 
-            AtB_ptr[y] += A_ptr[y] * w * diffs_ptr[correspIndex];
+                Coeffs::icp(A, tps0_ptr[correspIndex], normals1.ptr<Vec3f>(v1)[u1] * w);
+
+                equations.add(A, (float)(w * diffs_ptr[correspIndex]));
+            }
+            equations.store(partials + b * (Dim*Dim + Dim));
         }
-    }		
-    
-    for(int y = 0; y < transformDim; y++)
-        for(int x = y+1; x < transformDim; x++)
-            AtA.at<double>(x,y) = AtA.at<double>(y,x);
-}
+    }
+
+private:
+    const Mat& normals1;
+    const Vec4i* corresps_ptr;
+    int correspsCount;
+    const float* diffs_ptr;
+    const Point3f* tps0_ptr;
+    double sigma;
+    double* partials;
+};
 
+template<class Coeffs>
 static
 void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
                         const Mat& cloud1, const Mat& normals1,
                         const Mat& corresps,
-                        Mat& AtA, Mat& AtB, CalcICPEquationCoeffsPtr func, int transformDim)
+                        Mat& AtA, Mat& AtB)
 {
-    AtA = Mat(transformDim, transformDim, CV_64FC1, Scalar(0));
-    AtB = Mat(transformDim, 1, CV_64FC1, Scalar(0));
-    double* AtB_ptr = AtB.ptr<double>();
-
+    const int Dim = Coeffs::transformDim;
     const int correspsCount = corresps.rows;
+    const int blocksCount = (correspsCount + lsmBlockSize - 1) / lsmBlockSize;
 
     CV_Assert(Rt.type() == CV_64FC1);
     const double * Rt_ptr = Rt.ptr<const double>();
@@ -727,54 +1115,22 @@ void calcICPLsmMatrices(const Mat& cloud0, const Mat& Rt,
 
     const Vec4i* corresps_ptr = corresps.ptr<Vec4i>();
 
-    double sigma = 0;
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-        const Vec4i& c = corresps_ptr[correspIndex];
-        int u0 = c[0], v0 = c[1];
-        int u1 = c[2], v1 = c[3];
-
-        const Point3f& p0 = cloud0.at<Point3f>(v0,u0);
-        Point3f tp0;
-        tp0.x = (float)(p0.x * Rt_ptr[0] + p0.y * Rt_ptr[1] + p0.z * Rt_ptr[2] + Rt_ptr[3]);
-        tp0.y = (float)(p0.x * Rt_ptr[4] + p0.y * Rt_ptr[5] + p0.z * Rt_ptr[6] + Rt_ptr[7]);
-        tp0.z = (float)(p0.x * Rt_ptr[8] + p0.y * Rt_ptr[9] + p0.z * Rt_ptr[10] + Rt_ptr[11]);
-
-        Vec3f n1 = normals1.at<Vec3f>(v1, u1);
-        Point3f v = cloud1.at<Point3f>(v1,u1) - tp0;
-
-        tps0_ptr[correspIndex] = tp0;
-        diffs_ptr[correspIndex] = n1[0] * v.x + n1[1] * v.y + n1[2] * v.z;
-        sigma += diffs_ptr[correspIndex] * diffs_ptr[correspIndex];
-    }
+    std::vector<double> sqSums(blocksCount);
+    parallel_for_(Range(0, blocksCount),
+                  ICPDiffsInvoker(cloud0, Rt_ptr, cloud1, normals1, corresps_ptr, correspsCount,
+                                  diffs_ptr, tps0_ptr, &sqSums[0]));
 
+    double sigma = 0;
+    for(int b = 0; b < blocksCount; b++)
+        sigma += sqSums[b];
     sigma = std::sqrt(sigma/correspsCount);
 
-    std::vector<double> A_buf(transformDim);
-    double* A_ptr = &A_buf[0];
-    for(int correspIndex = 0; correspIndex < corresps.rows; correspIndex++)
-    {
-        const Vec4i& c = corresps_ptr[correspIndex];
-        int u1 = c[2], v1 = c[3];
-
-        double w = sigma + std::abs(diffs_ptr[correspIndex]);
-        w = w > DBL_EPSILON ? 1./w : 1.;
-
-        func(A_ptr, tps0_ptr[correspIndex], normals1.at<Vec3f>(v1, u1) * w);
-
-        for(int y = 0; y < transformDim; y++)
-        {
-            double* AtA_ptr = AtA.ptr<double>(y);
-            for(int x = y; x < transformDim; x++)
-                AtA_ptr[x] += A_ptr[y] * A_ptr[x];
-
-            AtB_ptr[y] += A_ptr[y] * w * diffs_ptr[correspIndex];
-        }
-    }
+    std::vector<double> partials(blocksCount * (Dim*Dim + Dim));
+    parallel_for_(Range(0, blocksCount),
+                  ICPLsmInvoker<Coeffs>(normals1, corresps_ptr, correspsCount, diffs_ptr, tps0_ptr,
+                                        sigma, &partials[0]));
 
-    for(int y = 0; y < transformDim; y++)
-        for(int x = y+1; x < transformDim; x++)
-            AtA.at<double>(x,y) = AtA.at<double>(y,x);
+    reduceNormalEquations<Dim>(partials, AtA, AtB);
 }
 
 static
@@ -803,6 +1159,7 @@ bool testDeltaTransformation(const Mat& deltaRt, double maxTranslation, double m
     return translation <= maxTranslation && rotation <= maxRotation;
 }
 
+template<class Coeffs>
 static
 bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
                          const Ptr<OdometryFrame>& srcFrame,
@@ -812,29 +1169,7 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
                          double maxTranslation, double maxRotation,
                          int method, int transfromType)
 {
-    int transformDim = -1;
-    CalcRgbdEquationCoeffsPtr rgbdEquationFuncPtr = 0;
-    CalcICPEquationCoeffsPtr icpEquationFuncPtr = 0;
-    switch(transfromType)
-    {
-    case Odometry::RIGID_BODY_MOTION:
-        transformDim = 6;
-        rgbdEquationFuncPtr = calcRgbdEquationCoeffs;
-        icpEquationFuncPtr = calcICPEquationCoeffs;
-        break;
-    case Odometry::ROTATION:
-        transformDim = 3;
-        rgbdEquationFuncPtr = calcRgbdEquationCoeffsRotation;
-        icpEquationFuncPtr = calcICPEquationCoeffsRotation;
-        break;
-    case Odometry::TRANSLATION:
-        transformDim = 3;
-        rgbdEquationFuncPtr = calcRgbdEquationCoeffsTranslation;
-        icpEquationFuncPtr = calcICPEquationCoeffsTranslation;
-        break;
-    default:
-        CV_Error(Error::StsBadArg, "Incorrect transformation type");
-    }
+    const int transformDim = Coeffs::transformDim;
 
     const int minOverdetermScale = 20;
     const int minCorrespsCount = minOverdetermScale * transformDim;
@@ -881,19 +1216,19 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
             Mat AtA(transformDim, transformDim, CV_64FC1, Scalar(0)), AtB(transformDim, 1, CV_64FC1, Scalar(0));
             if(corresps_rgbd.rows >= minCorrespsCount)
             {
-                calcRgbdLsmMatrices(srcFrame->pyramidImage[level], srcFrame->pyramidCloud[level], resultRt,
-                                    dstFrame->pyramidImage[level], dstFrame->pyramid_dI_dx[level], dstFrame->pyramid_dI_dy[level],
-                                    corresps_rgbd, fx, fy, sobelScale,
-                                    AtA_rgbd, AtB_rgbd, rgbdEquationFuncPtr, transformDim);
+                calcRgbdLsmMatrices<Coeffs>(srcFrame->pyramidImage[level], srcFrame->pyramidCloud[level], resultRt,
+                                            dstFrame->pyramidImage[level], dstFrame->pyramid_dI_dx[level], dstFrame->pyramid_dI_dy[level],
+                                            corresps_rgbd, fx, fy, sobelScale,
+                                            AtA_rgbd, AtB_rgbd);
 
                 AtA += AtA_rgbd;
                 AtB += AtB_rgbd;
             }
             if(corresps_icp.rows >= minCorrespsCount)
             {
-                calcICPLsmMatrices(srcFrame->pyramidCloud[level], resultRt,
-                                   dstFrame->pyramidCloud[level], dstFrame->pyramidNormals[level],
-                                   corresps_icp, AtA_icp, AtB_icp, icpEquationFuncPtr, transformDim);
+                calcICPLsmMatrices<Coeffs>(srcFrame->pyramidCloud[level], resultRt,
+                                           dstFrame->pyramidCloud[level], dstFrame->pyramidNormals[level],
+                                           corresps_icp, AtA_icp, AtB_icp);
                 AtA += AtA_icp;
                 AtB += AtB_icp;
             }
@@ -937,6 +1272,32 @@ bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
     return isOk;
 }
 
+static
+bool RGBDICPOdometryImpl(Mat& Rt, const Mat& initRt,
+                         const Ptr<OdometryFrame>& srcFrame,
+                         const Ptr<OdometryFrame>& dstFrame,
+                         const Mat& cameraMatrix,
+                         float maxDepthDiff, const std::vector<int>& iterCounts,
+                         double maxTranslation, double maxRotation,
+                         int method, int transfromType)
+{
+    switch(transfromType)
+    {
+    case Odometry::RIGID_BODY_MOTION:
+        return RGBDICPOdometryImpl<RigidBodyMotionCoeffs>(Rt, initRt, srcFrame, dstFrame, cameraMatrix, maxDepthDiff,
+                                                          iterCounts, maxTranslation, maxRotation, method, transfromType);
+    case Odometry::ROTATION:
+        return RGBDICPOdometryImpl<RotationCoeffs>(Rt, initRt, srcFrame, dstFrame, cameraMatrix, maxDepthDiff,
+                                                   iterCounts, maxTranslation, maxRotation, method, transfromType);
+    case Odometry::TRANSLATION:
+        return RGBDICPOdometryImpl<TranslationCoeffs>(Rt, initRt, srcFrame, dstFrame, cameraMatrix, maxDepthDiff,
+                                                      iterCounts, maxTranslation, maxRotation, method, transfromType);
+    default:
+        CV_Error(Error::StsBadArg, "Incorrect transformation type");
+    }
+    return false;
+}
+
 template<class ImageElemType>
 static void
 warpFrameImpl(const Mat& image, const Mat& depth, const Mat& mask,
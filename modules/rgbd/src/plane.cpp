@@ -120,13 +120,23 @@ public:
   /** Update the different sum of point and sum of point*point.t()
    */
   void
-  UpdateStatistics(const Vec3f & point, const Matx33f & Q_local)
+  UpdateStatistics(const Vec3f & point)
   {
     m_sum_ += point;
-    Q_ += Q_local;
+    Q_ += point * point.t();
     ++K_;
   }
 
+  /** Add the sums of points and of point*point.t() of K points
+   */
+  void
+  UpdateStatistics(const Vec3f & m_sum, const Matx33f & Q, int K)
+  {
+    m_sum_ += m_sum;
+    Q_ += Q;
+    K_ += K;
+  }
+
   inline size_t
   empty() const
   {
@@ -240,71 +250,81 @@ public:
     if (points3d.cols % block_size != 0)
       ++mini_cols;
 
-    // Compute all the interesting quantities
+    // Compute all the interesting quantities, the tiles being independent
     m_.create(mini_rows, mini_cols);
     n_.create(mini_rows, mini_cols);
-    Q_.create(points3d.rows, points3d.cols);
     mse_.create(mini_rows, mini_cols);
-    for (int y = 0; y < mini_rows; ++y)
-      for (int x = 0; x < mini_cols; ++x)
-      {
-        // Update the tiles
-        Matx33f Q = Matx33f::zeros();
-        Vec3f m = Vec3f(0, 0, 0);
-        int K = 0;
-        for (int j = y * block_size; j < std::min((y + 1) * block_size, points3d.rows); ++j)
-        {
-          const Vec3f * vec = points3d.ptr < Vec3f > (j, x * block_size), *vec_end;
-          float * pointpointt = reinterpret_cast<float*>(Q_.ptr < Vec<float, 9> > (j, x * block_size));
-          if (x == mini_cols - 1)
-            vec_end = points3d.ptr < Vec3f > (j, points3d.cols - 1) + 1;
-          else
-            vec_end = vec + block_size;
-          for (; vec != vec_end; ++vec, pointpointt += 9)
-          {
-            if (cvIsNaN(vec->val[0]))
-              continue;
-            // Fill point*point.t()
-            *pointpointt = vec->val[0] * vec->val[0];
-            *(pointpointt + 1) = vec->val[0] * vec->val[1];
-            *(pointpointt + 2) = vec->val[0] * vec->val[2];
-            *(pointpointt + 3) = *(pointpointt + 1);
-            *(pointpointt + 4) = vec->val[1] * vec->val[1];
-            *(pointpointt + 5) = vec->val[1] * vec->val[2];
-            *(pointpointt + 6) = *(pointpointt + 2);
-            *(pointpointt + 7) = *(pointpointt + 5);
-            *(pointpointt + 8) = vec->val[2] * vec->val[2];
-
-            Q += *reinterpret_cast<Matx33f*>(pointpointt);
-            m += (*vec);
-            ++K;
-          }
-        }
-        if (K == 0)
-        {
-          mse_(y, x) = std::numeric_limits<float>::max();
-          continue;
-        }
-
-        m /= K;
-        m_(y, x) = m;
-
-        // Compute C
-        Matx33f C = Q - K * m * m.t();
-
-        // Compute n
-        SVD svd(C);
-        n_(y, x) = Vec3f(svd.vt.at<float>(2, 0), svd.vt.at<float>(2, 1), svd.vt.at<float>(2, 2));
-        mse_(y, x) = svd.w.at<float>(2) / K;
-      }
+    parallel_for_(Range(0, mini_rows), TileInvoker(points3d, *this));
   }
 
   /** The size of the block */
   int block_size_;
   Mat_<Vec3f> m_;
   Mat_<Vec3f> n_;
-  Mat_<Vec<float, 9> > Q_;
   Mat_<float> mse_;
+
+private:
+  /** Fits a plane to every tile of a range of tile rows
+   */
+  class TileInvoker: public ParallelLoopBody
+  {
+  public:
+    TileInvoker(const Mat_<Vec3f> & points3d, PlaneGrid & grid)
+        :
+          points3d_(points3d),
+          grid_(grid)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+      int block_size = grid_.block_size_;
+      for (int y = range.start; y < range.end; ++y)
+        for (int x = 0; x < grid_.mse_.cols; ++x)
+        {
+          // Update the tiles
+          Matx33f Q = Matx33f::zeros();
+          Vec3f m = Vec3f(0, 0, 0);
+          int K = 0;
+          for (int j = y * block_size; j < std::min((y + 1) * block_size, points3d_.rows); ++j)
+          {
+            const Vec3f * vec = points3d_[j] + x * block_size;
+            const Vec3f * vec_end = points3d_[j] + std::min((x + 1) * block_size, points3d_.cols);
+            for (; vec != vec_end; ++vec)
+            {
+              if (cvIsNaN(vec->val[0]))
+                continue;
+              Q += (*vec) * vec->t();
+              m += (*vec);
+              ++K;
+            }
+          }
+          if (K == 0)
+          {
+            grid_.mse_(y, x) = std::numeric_limits<float>::max();
+            continue;
+          }
+
+          m /= K;
+          grid_.m_(y, x) = m;
+
+          // Compute C
+          Matx33f C = Q - K * m * m.t();
+
+          // Compute n
+          SVD svd(C);
+          grid_.n_(y, x) = Vec3f(svd.vt.at<float>(2, 0), svd.vt.at<float>(2, 1), svd.vt.at<float>(2, 2));
+          grid_.mse_(y, x) = svd.w.at<float>(2) / K;
+        }
+    }
+
+  private:
+    TileInvoker& operator=(const TileInvoker&);
+
+    const Mat_<Vec3f> & points3d_;
+    PlaneGrid & grid_;
+  };
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -380,6 +400,31 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+/** Sums of the points (and of point*point.t()) of a tile that are inliers to a plane
+ */
+struct TileStatistics
+{
+  TileStatistics()
+      :
+        m_sum_(Vec3f(0, 0, 0)),
+        Q_(Matx33f::zeros()),
+        K_(0)
+  {
+  }
+
+  void
+  UpdateStatistics(const Vec3f & point)
+  {
+    m_sum_ += point;
+    Q_ += point * point.t();
+    ++K_;
+  }
+
+  Vec3f m_sum_;
+  Matx33f Q_;
+  int K_;
+};
+
 class InlierFinder
 {
 public:
@@ -404,6 +449,108 @@ public:
 
     // Figure the part of the image to look at
     Range range_x, range_y;
+    TileRanges(tile, plane_mask, overall_mask, range_x, range_y);
+
+    // The plane parameters are only updated at the end so it can accumulate its own statistics
+    int n_valid_points = FindInliers(*plane, *plane, range_x, range_y, overall_mask);
+
+    plane->UpdateParameters();
+
+    // Mark the front as being done and pop it
+    if (n_valid_points > (range_x.size() * range_y.size()) / 2)
+      tile_queue.remove(tile.y_, tile.x_);
+    plane_mask(tile.y_, tile.x_) = 1;
+    neighboring_tiles.erase(neighboring_tiles.begin());
+
+    AddNeighbors(plane_grid, tile, range_x, range_y, overall_mask, plane_mask, neighboring_tiles);
+  }
+
+  /** Process all the current neighboring tiles at once against the same plane: the tiles do not overlap so they
+   * are processed in parallel, and their statistics are then merged in the order of the set so that the result
+   * does not depend on the number of threads
+   */
+  void
+  FindParallel(const PlaneGrid &plane_grid, Ptr<PlaneBase> & plane, TileQueue & tile_queue,
+               std::set<TileQueue::PlaneTile> & neighboring_tiles, Mat_<unsigned char> & overall_mask,
+               Mat_<unsigned char> & plane_mask)
+  {
+    std::vector<TileQueue::PlaneTile> tiles(neighboring_tiles.begin(), neighboring_tiles.end());
+    neighboring_tiles.clear();
+
+    std::vector<TileStatistics> statistics(tiles.size());
+    parallel_for_(Range(0, (int)tiles.size()),
+                  TileInlierInvoker(*this, *plane, tiles, plane_mask, overall_mask, statistics));
+
+    for (size_t i = 0; i < tiles.size(); ++i)
+      plane->UpdateStatistics(statistics[i].m_sum_, statistics[i].Q_, statistics[i].K_);
+    plane->UpdateParameters();
+
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+      const TileQueue::PlaneTile & tile = tiles[i];
+      Range range_x, range_y;
+      TileRanges(tile, plane_mask, overall_mask, range_x, range_y);
+
+      if (statistics[i].K_ > (range_x.size() * range_y.size()) / 2)
+        tile_queue.remove(tile.y_, tile.x_);
+      plane_mask(tile.y_, tile.x_) = 1;
+    }
+
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+      Range range_x, range_y;
+      TileRanges(tiles[i], plane_mask, overall_mask, range_x, range_y);
+      AddNeighbors(plane_grid, tiles[i], range_x, range_y, overall_mask, plane_mask, neighboring_tiles);
+    }
+  }
+
+private:
+  /** Finds the inliers of a tile in parallel, every tile accumulating its own statistics
+   */
+  class TileInlierInvoker: public ParallelLoopBody
+  {
+  public:
+    TileInlierInvoker(const InlierFinder & finder, const PlaneBase & plane,
+                      const std::vector<TileQueue::PlaneTile> & tiles, const Mat_<unsigned char> & plane_mask,
+                      Mat_<unsigned char> & overall_mask, std::vector<TileStatistics> & statistics)
+        :
+          finder_(finder),
+          plane_(plane),
+          tiles_(tiles),
+          plane_mask_(plane_mask),
+          overall_mask_(overall_mask),
+          statistics_(statistics)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+      for (int i = range.start; i < range.end; ++i)
+      {
+        Range range_x, range_y;
+        finder_.TileRanges(tiles_[i], plane_mask_, overall_mask_, range_x, range_y);
+        finder_.FindInliers(plane_, statistics_[i], range_x, range_y, overall_mask_);
+      }
+    }
+
+  private:
+    TileInlierInvoker& operator=(const TileInlierInvoker&);
+
+    const InlierFinder & finder_;
+    const PlaneBase & plane_;
+    const std::vector<TileQueue::PlaneTile> & tiles_;
+    const Mat_<unsigned char> & plane_mask_;
+    Mat_<unsigned char> & overall_mask_;
+    std::vector<TileStatistics> & statistics_;
+  };
+
+  /** The pixels covered by a tile, the last tiles getting what is left of the image
+   */
+  void
+  TileRanges(const TileQueue::PlaneTile & tile, const Mat_<unsigned char> & plane_mask,
+             const Mat_<unsigned char> & overall_mask, Range & range_x, Range & range_y) const
+  {
     int x = tile.x_ * block_size_, y = tile.y_ * block_size_;
 
     if (tile.x_ == plane_mask.cols - 1)
@@ -415,33 +562,40 @@ public:
       range_y = Range(y, overall_mask.rows);
     else
       range_y = Range(y, y + block_size_);
+  }
 
+  /** Label the points of the tile that are close to the plane and add them to the statistics
+   * @return the number of inliers
+   */
+  template<typename Statistics>
+  int
+  FindInliers(const PlaneBase & plane, Statistics & statistics, const Range & range_x, const Range & range_y,
+              Mat_<unsigned char> & overall_mask) const
+  {
     int n_valid_points = 0;
     for (int yy = range_y.start; yy != range_y.end; ++yy)
     {
       uchar* data = overall_mask.ptr(yy, range_x.start), *data_end = data + range_x.size();
       const Vec3f* point = points3d_.ptr < Vec3f > (yy, range_x.start);
-      const Matx33f* Q_local = reinterpret_cast<const Matx33f *>(plane_grid.Q_.ptr < Vec<float, 9>
-          > (yy, range_x.start));
 
       // Depending on whether you have a normal, check it
       if (!normals_.empty())
       {
         const Vec3f* normal = normals_.ptr < Vec3f > (yy, range_x.start);
-        for (; data != data_end; ++data, ++point, ++normal, ++Q_local)
+        for (; data != data_end; ++data, ++point, ++normal)
         {
           // Don't do anything if the point already belongs to another plane
           if (cvIsNaN(point->val[0]) || ((*data) != 255))
             continue;
 
           // If the point is close enough to the plane
-          if (plane->distance(*point) < err_)
+          if (plane.distance(*point) < err_)
           {
             // make sure the normals are similar to the plane
-            if (std::abs(plane->n().dot(*normal)) > 0.3)
+            if (std::abs(plane.n().dot(*normal)) > 0.3)
             {
               // The point now belongs to the plane
-              plane->UpdateStatistics(*point, *Q_local);
+              statistics.UpdateStatistics(*point);
               *data = plane_index_;
               ++n_valid_points;
             }
@@ -450,33 +604,33 @@ public:
       }
       else
       {
-        for (; data != data_end; ++data, ++point, ++Q_local)
+        for (; data != data_end; ++data, ++point)
         {
           // Don't do anything if the point already belongs to another plane
           if (cvIsNaN(point->val[0]) || ((*data) != 255))
             continue;
 
           // If the point is close enough to the plane
-          if (plane->distance(*point) < err_)
+          if (plane.distance(*point) < err_)
           {
             // The point now belongs to the plane
-            plane->UpdateStatistics(*point, *Q_local);
+            statistics.UpdateStatistics(*point);
             *data = plane_index_;
             ++n_valid_points;
           }
         }
       }
     }
+    return n_valid_points;
+  }
 
-    plane->UpdateParameters();
-
-    // Mark the front as being done and pop it
-    if (n_valid_points > (range_x.size() * range_y.size()) / 2)
-      tile_queue.remove(tile.y_, tile.x_);
-    plane_mask(tile.y_, tile.x_) = 1;
-    neighboring_tiles.erase(neighboring_tiles.begin());
-
-    // Add potential neighbors of the tile
+  /** Add the neighbors of the tile that touch one of its inliers
+   */
+  void
+  AddNeighbors(const PlaneGrid &plane_grid, const TileQueue::PlaneTile & tile, const Range & range_x,
+               const Range & range_y, Mat_<unsigned char> & overall_mask, const Mat_<unsigned char> & plane_mask,
+               std::set<TileQueue::PlaneTile> & neighboring_tiles) const
+  {
     std::vector<std::pair<int, int> > pairs;
     if (tile.x_ > 0)
       for (unsigned char * val = overall_mask.ptr<unsigned char>(range_y.start, range_x.start), *val_end = val
@@ -517,7 +671,6 @@ public:
             TileQueue::PlaneTile(pairs[i].first, pairs[i].second, plane_grid.mse_(pairs[i].second, pairs[i].first)));
   }
 
-private:
   float err_;
   const Mat_<Vec3f> & points3d_;
   const Mat_<Vec3f> & normals_;
@@ -584,15 +737,18 @@ private:
         plane = Ptr<PlaneBase>(new PlaneABC(plane_grid.m_(y, x), n, (int)index_plane,
 			(float)sensor_error_a_, (float)sensor_error_b_, (float)sensor_error_c_));
 
-      Mat_<unsigned char> plane_mask = Mat_<unsigned char>::zeros(points3d.rows / block_size_,
-                                                                          points3d.cols / block_size_);
+      Mat_<unsigned char> plane_mask = Mat_<unsigned char>::zeros(plane_grid.mse_.rows, plane_grid.mse_.cols);
       std::set<TileQueue::PlaneTile> neighboring_tiles;
       neighboring_tiles.insert(front_tile);
       plane_queue.remove(front_tile.y_, front_tile.x_);
 
       // Process all the neighboring tiles
-      while (!neighboring_tiles.empty())
-        inlier_finder.Find(plane_grid, plane, plane_queue, neighboring_tiles, mask_out_uc, plane_mask);
+      if (method_ == RGBD_PLANE_METHOD_PARALLEL)
+        while (!neighboring_tiles.empty())
+          inlier_finder.FindParallel(plane_grid, plane, plane_queue, neighboring_tiles, mask_out_uc, plane_mask);
+      else
+        while (!neighboring_tiles.empty())
+          inlier_finder.Find(plane_grid, plane, plane_queue, neighboring_tiles, mask_out_uc, plane_mask);
 
       // Don't record the plane if it's empty
       if (plane->empty())
@@ -48,6 +48,7 @@
 #include "opencv2/imgproc.hpp"
 #include "opencv2/core/utility.hpp"
 #include "opencv2/core/private.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <iostream>
 #include <list>
 #include <set>
@@ -0,0 +1,688 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2016, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "precomp.hpp"
+
+namespace cv
+{
+namespace rgbd
+{
+
+static Matx44f toPose(InputArray _pose)
+{
+    Mat pose = _pose.getMat();
+    CV_Assert(pose.size() == Size(4,4) && (pose.type() == CV_32FC1 || pose.type() == CV_64FC1));
+    Matx44f res;
+    pose.convertTo(res, CV_32F);
+    return res;
+}
+
+static inline Matx33f poseRotation(const Matx44f& pose)
+{
+    return pose.get_minor<3,3>(0, 0);
+}
+
+static inline Vec3f poseTranslation(const Matx44f& pose)
+{
+    return Vec3f(pose(0,3), pose(1,3), pose(2,3));
+}
+
+static inline Matx44f poseInverse(const Matx44f& pose)
+{
+    Matx33f Rinv = poseRotation(pose).t();
+    Vec3f tinv = -(Rinv * poseTranslation(pose));
+    return Matx44f(Rinv(0,0), Rinv(0,1), Rinv(0,2), tinv[0],
+                   Rinv(1,0), Rinv(1,1), Rinv(1,2), tinv[1],
+                   Rinv(2,0), Rinv(2,1), Rinv(2,2), tinv[2],
+                   0, 0, 0, 1);
+}
+
+/** Read-only access to the voxels of a volume, with trilinear interpolation
+ */
+class VolumeAccessor
+{
+public:
+    VolumeAccessor(const Mat& _volume, int _resolution, float _voxelSize)
+        : volume(_volume), resolution(_resolution), voxelSize(_voxelSize),
+          voxelSizeInv(1.f / _voxelSize)
+    {
+    }
+
+    inline const Vec2f& at(int x, int y, int z) const
+    {
+        return volume.ptr<Vec2f>(x, y)[z];
+    }
+
+    /** Interpolates the tsdf at a point given in the metric volume frame
+     * @return false if the point is outside of the volume or near an unobserved voxel
+     */
+    inline bool
+    interpolate(const Point3f& p, float& tsdf) const
+    {
+        // voxel values are sampled at the voxel centers
+        float gx = p.x * voxelSizeInv - 0.5f, gy = p.y * voxelSizeInv - 0.5f, gz = p.z * voxelSizeInv - 0.5f;
+        int x0 = cvFloor(gx), y0 = cvFloor(gy), z0 = cvFloor(gz);
+        if (x0 < 0 || y0 < 0 || z0 < 0 || x0 >= resolution - 1 || y0 >= resolution - 1 || z0 >= resolution - 1)
+          return false;
+
+        float tx = gx - x0, ty = gy - y0, tz = gz - z0;
+        const Vec2f* v00 = volume.ptr<Vec2f>(x0, y0) + z0;
+        const Vec2f* v01 = volume.ptr<Vec2f>(x0, y0 + 1) + z0;
+        const Vec2f* v10 = volume.ptr<Vec2f>(x0 + 1, y0) + z0;
+        const Vec2f* v11 = volume.ptr<Vec2f>(x0 + 1, y0 + 1) + z0;
+
+        if (v00[0][1] <= 0 || v00[1][1] <= 0 || v01[0][1] <= 0 || v01[1][1] <= 0 ||
+            v10[0][1] <= 0 || v10[1][1] <= 0 || v11[0][1] <= 0 || v11[1][1] <= 0)
+          return false;
+
+        float c00 = v00[0][0] + (v00[1][0] - v00[0][0]) * tz;
+        float c01 = v01[0][0] + (v01[1][0] - v01[0][0]) * tz;
+        float c10 = v10[0][0] + (v10[1][0] - v10[0][0]) * tz;
+        float c11 = v11[0][0] + (v11[1][0] - v11[0][0]) * tz;
+        float c0 = c00 + (c01 - c00) * ty;
+        float c1 = c10 + (c11 - c10) * ty;
+        tsdf = c0 + (c1 - c0) * tx;
+        return true;
+    }
+
+    /** Normalized gradient of the tsdf at a point of the metric volume frame, pointing outside of the surface
+     */
+    inline bool
+    normal(const Point3f& p, Vec3f& n) const
+    {
+        float fx0, fx1, fy0, fy1, fz0, fz1;
+        const float d = voxelSize;
+        if (!interpolate(Point3f(p.x - d, p.y, p.z), fx0) || !interpolate(Point3f(p.x + d, p.y, p.z), fx1) ||
+            !interpolate(Point3f(p.x, p.y - d, p.z), fy0) || !interpolate(Point3f(p.x, p.y + d, p.z), fy1) ||
+            !interpolate(Point3f(p.x, p.y, p.z - d), fz0) || !interpolate(Point3f(p.x, p.y, p.z + d), fz1))
+          return false;
+
+        n = Vec3f(fx1 - fx0, fy1 - fy0, fz1 - fz0);
+        float len = (float)norm(n);
+        if (len < FLT_EPSILON)
+          return false;
+        n *= 1.f / len;
+        return true;
+    }
+
+    const Mat& volume;
+    int resolution;
+    float voxelSize, voxelSizeInv;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Updates the voxels of a range of x slices with a depth frame.
+ * The camera coordinates of consecutive voxels along z differ by a constant step, they are computed
+ * 4 at a time with SIMD and only the depth lookups and the voxel updates are done per voxel.
+ */
+class IntegrateInvoker : public ParallelLoopBody
+{
+public:
+    IntegrateInvoker(Mat& _volume, int _resolution, float _voxelSize, const Mat& _depth,
+                     const Matx33f& _K, const Matx44f& _volumeToCamera, float _truncation, int _maxWeight)
+        : volume(_volume), resolution(_resolution), voxelSize(_voxelSize), depth(_depth), K(_K),
+          volumeToCamera(_volumeToCamera), truncation(_truncation), maxWeight((float)_maxWeight)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+        const Matx33f R = poseRotation(volumeToCamera);
+        const Vec3f t = poseTranslation(volumeToCamera);
+        const Vec3f zStep = Vec3f(R(0,2), R(1,2), R(2,2)) * voxelSize;
+        const float fx = K(0,0), fy = K(1,1), cx = K(0,2), cy = K(1,2);
+        const float truncationInv = 1.f / truncation;
+
+        float u[4], v[4], pz[4];
+        for (int x = range.start; x < range.end; ++x)
+        {
+          for (int y = 0; y < resolution; ++y)
+          {
+            // camera coordinates of the center of the voxel (x, y, 0)
+            Vec3f base = R * Vec3f((x + 0.5f) * voxelSize, (y + 0.5f) * voxelSize, 0.5f * voxelSize) + t;
+            Vec2f* voxels = volume.ptr<Vec2f>(x, y);
+
+            int z = 0;
+#if CV_SIMD128
+            const v_float32x4 vfx = v_setall_f32(fx), vfy = v_setall_f32(fy);
+            const v_float32x4 vcx = v_setall_f32(cx), vcy = v_setall_f32(cy);
+            const v_float32x4 steps(0.f, 1.f, 2.f, 3.f);
+            for (; z <= resolution - 4; z += 4)
+            {
+              v_float32x4 zs = v_setall_f32((float)z) + steps;
+              v_float32x4 px = v_setall_f32(base[0]) + zs * v_setall_f32(zStep[0]);
+              v_float32x4 py = v_setall_f32(base[1]) + zs * v_setall_f32(zStep[1]);
+              v_float32x4 vpz = v_setall_f32(base[2]) + zs * v_setall_f32(zStep[2]);
+              v_float32x4 invz = v_setall_f32(1.f) / vpz;
+              v_store(u, px * invz * vfx + vcx);
+              v_store(v, py * invz * vfy + vcy);
+              v_store(pz, vpz);
+              for (int k = 0; k < 4; ++k)
+                update(voxels[z + k], u[k], v[k], pz[k], truncationInv);
+            }
+#endif
+            for (; z < resolution; ++z)
+            {
+              Vec3f p = base + zStep * (float)z;
+              float invz = 1.f / p[2];
+              update(voxels[z], p[0] * invz * fx + cx, p[1] * invz * fy + cy, p[2], truncationInv);
+            }
+          }
+        }
+    }
+
+private:
+    inline void
+    update(Vec2f& voxel, float u, float v, float z, float truncationInv) const
+    {
+        if (z <= 0)
+          return;
+        int ui = cvRound(u), vi = cvRound(v);
+        if (ui < 0 || vi < 0 || ui >= depth.cols || vi >= depth.rows)
+          return;
+        float d = depth.ptr<float>(vi)[ui];
+        if (!(d > 0)) // also rejects NaN
+          return;
+
+        float sdf = d - z;
+        if (sdf < -truncation)
+          return;
+
+        float tsdf = std::min(1.f, sdf * truncationInv);
+        float weight = voxel[1];
+        voxel[0] = (voxel[0] * weight + tsdf) / (weight + 1.f);
+        voxel[1] = std::min(weight + 1.f, maxWeight);
+    }
+
+    Mat& volume;
+    int resolution;
+    float voxelSize;
+    const Mat& depth;
+    Matx33f K;
+    Matx44f volumeToCamera;
+    float truncation;
+    float maxWeight;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Marches the rays of a range of rows through the volume until the surface is crossed
+ */
+class RaycastInvoker : public ParallelLoopBody
+{
+public:
+    RaycastInvoker(const VolumeAccessor& _accessor, float _size, const Matx33f& _K,
+                   const Matx44f& _cameraToVolume, float _truncation, Mat& _points, Mat& _normals)
+        : accessor(_accessor), size(_size), K(_K), cameraToVolume(_cameraToVolume),
+          truncation(_truncation), points(_points), normals(_normals)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+        const Matx33f R = poseRotation(cameraToVolume);
+        const Matx33f Rinv = R.t();
+        const Vec3f origin = poseTranslation(cameraToVolume);
+        const float fxInv = 1.f / K(0,0), fyInv = 1.f / K(1,1), cx = K(0,2), cy = K(1,2);
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        const float minStep = accessor.voxelSize;
+
+        for (int v = range.start; v < range.end; ++v)
+        {
+          Vec3f* points_row = points.ptr<Vec3f>(v);
+          Vec3f* normals_row = normals.ptr<Vec3f>(v);
+          for (int u = 0; u < points.cols; ++u)
+          {
+            points_row[u] = normals_row[u] = Vec3f(nan, nan, nan);
+
+            Vec3f dir = R * Vec3f((u - cx) * fxInv, (v - cy) * fyInv, 1.f);
+            dir *= 1.f / (float)norm(dir);
+
+            float tmin, tmax;
+            if (!intersectBox(origin, dir, tmin, tmax))
+              continue;
+
+            float t = tmin, tPrev = tmin, fPrev = 0.f;
+            bool hasPrev = false;
+            while (t < tmax)
+            {
+              Vec3f p = origin + dir * t;
+              float f;
+              if (!accessor.interpolate(Point3f(p), f))
+              {
+                hasPrev = false;
+                t += minStep;
+                continue;
+              }
+
+              if (hasPrev && fPrev > 0.f && f <= 0.f)
+              {
+                // linear interpolation of the zero crossing
+                float tHit = tPrev + (t - tPrev) * fPrev / (fPrev - f);
+                Point3f hit(origin + dir * tHit);
+                Vec3f n;
+                if (accessor.normal(hit, n))
+                {
+                  Vec3f pc = Rinv * (Vec3f(hit) - origin);
+                  points_row[u] = pc;
+                  normals_row[u] = Rinv * n;
+                }
+                break;
+              }
+              if (hasPrev && fPrev < 0.f && f > 0.f)
+                break; // back face
+
+              hasPrev = true;
+              fPrev = f;
+              tPrev = t;
+              // the tsdf is a lower bound of the distance to the surface
+              t += std::max(minStep, f * truncation * 0.8f);
+            }
+          }
+        }
+    }
+
+private:
+    bool
+    intersectBox(const Vec3f& origin, const Vec3f& dir, float& tmin, float& tmax) const
+    {
+        tmin = 0.f;
+        tmax = std::numeric_limits<float>::max();
+        for (int i = 0; i < 3; ++i)
+        {
+          if (std::abs(dir[i]) < FLT_EPSILON)
+          {
+            if (origin[i] < 0 || origin[i] > size)
+              return false;
+            continue;
+          }
+          float inv = 1.f / dir[i];
+          float t0 = -origin[i] * inv, t1 = (size - origin[i]) * inv;
+          if (t0 > t1)
+            std::swap(t0, t1);
+          tmin = std::max(tmin, t0);
+          tmax = std::min(tmax, t1);
+        }
+        return tmin < tmax;
+    }
+
+    const VolumeAccessor& accessor;
+    float size;
+    Matx33f K;
+    Matx44f cameraToVolume;
+    float truncation;
+    Mat& points;
+    Mat& normals;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/** Collects the zero crossings along the three axes of a range of x slices, one buffer per slice
+ */
+class FetchPointsNormalsInvoker : public ParallelLoopBody
+{
+public:
+    FetchPointsNormalsInvoker(const VolumeAccessor& _accessor, const Matx44f& _volumePose, int _firstSlice,
+                              std::vector< std::vector<Vec3f> >& _points,
+                              std::vector< std::vector<Vec3f> >& _normals)
+        : accessor(_accessor), volumePose(_volumePose), firstSlice(_firstSlice), points(_points), normals(_normals)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+        const int res = accessor.resolution;
+        const float vs = accessor.voxelSize;
+        const Matx33f R = poseRotation(volumePose);
+        const Vec3f t = poseTranslation(volumePose);
+
+        for (int x = range.start; x < range.end; ++x)
+        {
+          std::vector<Vec3f>& slicePoints = points[x - firstSlice];
+          std::vector<Vec3f>& sliceNormals = normals[x - firstSlice];
+          for (int y = 0; y < res; ++y)
+            for (int z = 0; z < res; ++z)
+            {
+              const Vec2f& v0 = accessor.at(x, y, z);
+              if (v0[1] <= 0)
+                continue;
+              Vec3f p0((x + 0.5f) * vs, (y + 0.5f) * vs, (z + 0.5f) * vs);
+
+              for (int axis = 0; axis < 3; ++axis)
+              {
+                int x1 = x + (axis == 0), y1 = y + (axis == 1), z1 = z + (axis == 2);
+                if (x1 >= res || y1 >= res || z1 >= res)
+                  continue;
+                const Vec2f& v1 = accessor.at(x1, y1, z1);
+                if (v1[1] <= 0 || (v0[0] > 0) == (v1[0] > 0))
+                  continue;
+
+                Vec3f p = p0;
+                p[axis] += vs * v0[0] / (v0[0] - v1[0]);
+                Vec3f n;
+                if (!accessor.normal(Point3f(p), n))
+                  continue;
+                slicePoints.push_back(R * p + t);
+                sliceNormals.push_back(R * n);
+              }
+            }
+        }
+    }
+
+private:
+    const VolumeAccessor& accessor;
+    Matx44f volumePose;
+    int firstSlice;
+    std::vector< std::vector<Vec3f> >& points;
+    std::vector< std::vector<Vec3f> >& normals;
+};
+
+/** Marching tetrahedra over the cubes of a range of x slices, one buffer per slice.
+ * Each cube is split in 6 tetrahedra around its main diagonal, which needs no case table
+ * and gives a watertight surface.
+ */
+class FetchMeshInvoker : public ParallelLoopBody
+{
+public:
+    FetchMeshInvoker(const VolumeAccessor& _accessor, const Matx44f& _volumePose, int _firstSlice,
+                     std::vector< std::vector<Vec3f> >& _vertices)
+        : accessor(_accessor), volumePose(_volumePose), firstSlice(_firstSlice), vertices(_vertices)
+    {
+    }
+
+    virtual void
+    operator()(const Range& range) const
+    {
+        static const int tetrahedra[6][4] = { {0, 1, 3, 7}, {0, 3, 2, 7}, {0, 2, 6, 7},
+                                              {0, 6, 4, 7}, {0, 4, 5, 7}, {0, 5, 1, 7} };
+        const int res = accessor.resolution;
+        const float vs = accessor.voxelSize;
+
+        for (int x = range.start; x < range.end; ++x)
+        {
+          std::vector<Vec3f>& sliceVertices = vertices[x - firstSlice];
+          for (int y = 0; y < res - 1; ++y)
+            for (int z = 0; z < res - 1; ++z)
+            {
+              // corner i of the cube is at offset (i & 1, (i >> 1) & 1, (i >> 2) & 1)
+              Vec3f corners[8];
+              float values[8];
+              bool valid = true;
+              for (int i = 0; i < 8 && valid; ++i)
+              {
+                int cx = x + (i & 1), cy = y + ((i >> 1) & 1), cz = z + ((i >> 2) & 1);
+                const Vec2f& voxel = accessor.at(cx, cy, cz);
+                valid = voxel[1] > 0;
+                values[i] = voxel[0];
+                corners[i] = Vec3f((cx + 0.5f) * vs, (cy + 0.5f) * vs, (cz + 0.5f) * vs);
+              }
+              if (!valid)
+                continue;
+
+              for (int k = 0; k < 6; ++k)
+                polygonizeTetrahedron(tetrahedra[k], corners, values, sliceVertices);
+            }
+        }
+    }
+
+private:
+    inline Vec3f
+    crossing(const Vec3f* corners, const float* values, int a, int b) const
+    {
+        float s = values[a] / (values[a] - values[b]);
+        return corners[a] + (corners[b] - corners[a]) * s;
+    }
+
+    // Adds a triangle in the world frame, facing outside of the surface
+    inline void
+    addTriangle(const Vec3f& p0, const Vec3f& p1, const Vec3f& p2, const Vec3f& outside,
+                std::vector<Vec3f>& dst) const
+    {
+        const Matx33f R = poseRotation(volumePose);
+        const Vec3f t = poseTranslation(volumePose);
+        Vec3f n = (p1 - p0).cross(p2 - p0);
+        dst.push_back(R * p0 + t);
+        if (n.dot(outside) >= 0)
+        {
+          dst.push_back(R * p1 + t);
+          dst.push_back(R * p2 + t);
+        }
+        else
+        {
+          dst.push_back(R * p2 + t);
+          dst.push_back(R * p1 + t);
+        }
+    }
+
+    void
+    polygonizeTetrahedron(const int* tet, const Vec3f* corners, const float* values, std::vector<Vec3f>& dst) const
+    {
+        int inside[4], outside[4];
+        int nIn = 0, nOut = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+          if (values[tet[i]] < 0)
+            inside[nIn++] = tet[i];
+          else
+            outside[nOut++] = tet[i];
+        }
+        if (nIn == 0 || nOut == 0)
+          return;
+
+        Vec3f inCenter(0, 0, 0), outCenter(0, 0, 0);
+        for (int i = 0; i < nIn; ++i)
+          inCenter += corners[inside[i]] * (1.f / nIn);
+        for (int i = 0; i < nOut; ++i)
+          outCenter += corners[outside[i]] * (1.f / nOut);
+        const Vec3f outsideDir = outCenter - inCenter;
+
+        if (nIn == 1 || nOut == 1)
+        {
+          // a single vertex is cut off from the three others
+          int a = nIn == 1 ? inside[0] : outside[0];
+          const int* others = nIn == 1 ? outside : inside;
+          addTriangle(crossing(corners, values, a, others[0]),
+                      crossing(corners, values, a, others[1]),
+                      crossing(corners, values, a, others[2]), outsideDir, dst);
+        }
+        else
+        {
+          // the surface is a quad between the two inside and the two outside vertices
+          Vec3f p00 = crossing(corners, values, inside[0], outside[0]);
+          Vec3f p01 = crossing(corners, values, inside[0], outside[1]);
+          Vec3f p11 = crossing(corners, values, inside[1], outside[1]);
+          Vec3f p10 = crossing(corners, values, inside[1], outside[0]);
+          addTriangle(p00, p01, p11, outsideDir, dst);
+          addTriangle(p00, p11, p10, outsideDir, dst);
+        }
+    }
+
+    const VolumeAccessor& accessor;
+    Matx44f volumePose;
+    int firstSlice;
+    std::vector< std::vector<Vec3f> >& vertices;
+};
+
+static void
+concatenate(const std::vector< std::vector<Vec3f> >& buffers, OutputArray _dst)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < buffers.size(); ++i)
+      total += buffers[i].size();
+
+    _dst.create((int)total, 1, CV_32FC3);
+    if (total == 0)
+      return;
+    Mat dst = _dst.getMat();
+    Vec3f* dst_ptr = dst.ptr<Vec3f>();
+    for (size_t i = 0; i < buffers.size(); ++i)
+      dst_ptr = std::copy(buffers[i].begin(), buffers[i].end(), dst_ptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TSDFVolume::TSDFVolume()
+    :
+      resolution_(0),
+      size_(0),
+      truncationDistance_(0),
+      maxWeight_(0)
+{
+}
+
+TSDFVolume::TSDFVolume(int resolution, float size, const Mat& cameraMatrix, const Mat& volumePose,
+                       float truncationDistance, int maxWeight)
+    :
+      resolution_(resolution),
+      size_(size),
+      cameraMatrix_(cameraMatrix),
+      truncationDistance_(truncationDistance),
+      maxWeight_(maxWeight)
+{
+    CV_Assert(resolution > 1 && size > 0 && maxWeight > 0);
+
+    if (volumePose.empty())
+    {
+      volumePose_ = Mat::eye(4, 4, CV_32FC1);
+      volumePose_.at<float>(0, 3) = -0.5f * size;
+      volumePose_.at<float>(1, 3) = -0.5f * size;
+    }
+    else
+    {
+      CV_Assert(volumePose.size() == Size(4,4));
+      volumePose.convertTo(volumePose_, CV_32F);
+    }
+
+    if (truncationDistance_ <= 0)
+      truncationDistance_ = 4 * getVoxelSize();
+
+    reset();
+}
+
+void
+TSDFVolume::reset()
+{
+    const int sizes[] = { resolution_, resolution_, resolution_ };
+    volume_.create(3, sizes, CV_32FC2);
+    volume_ = Scalar::all(0);
+}
+
+void
+TSDFVolume::integrate(InputArray _depth, InputArray cameraPose)
+{
+    CV_Assert(!volume_.empty());
+    CV_Assert(cameraMatrix_.size() == Size(3,3));
+
+    Mat depth;
+    rescaleDepth(_depth, CV_32F, depth);
+
+    Matx33f K;
+    cameraMatrix_.convertTo(K, CV_32F);
+
+    // volume -> world -> camera
+    Matx44f volumeToCamera = poseInverse(toPose(cameraPose)) * toPose(volumePose_);
+
+    parallel_for_(Range(0, resolution_),
+                  IntegrateInvoker(volume_, resolution_, getVoxelSize(), depth, K, volumeToCamera,
+                                   truncationDistance_, maxWeight_));
+}
+
+void
+TSDFVolume::raycast(InputArray cameraPose, const Size& frameSize, OutputArray _points, OutputArray _normals) const
+{
+    CV_Assert(!volume_.empty());
+    CV_Assert(cameraMatrix_.size() == Size(3,3));
+
+    Matx33f K;
+    cameraMatrix_.convertTo(K, CV_32F);
+
+    // camera -> world -> volume
+    Matx44f cameraToVolume = poseInverse(toPose(volumePose_)) * toPose(cameraPose);
+
+    _points.create(frameSize, CV_32FC3);
+    _normals.create(frameSize, CV_32FC3);
+    Mat points = _points.getMat(), normals = _normals.getMat();
+
+    VolumeAccessor accessor(volume_, resolution_, getVoxelSize());
+    parallel_for_(Range(0, frameSize.height),
+                  RaycastInvoker(accessor, size_, K, cameraToVolume, truncationDistance_, points, normals));
+}
+
+void
+TSDFVolume::fetchPointsNormals(OutputArray points, OutputArray normals, const Range& _slices) const
+{
+    CV_Assert(!volume_.empty());
+
+    Range slices = _slices == Range::all() ? Range(0, resolution_) : _slices;
+    CV_Assert(0 <= slices.start && slices.start <= slices.end && slices.end <= resolution_);
+
+    std::vector< std::vector<Vec3f> > slicePoints(slices.size()), sliceNormals(slices.size());
+    VolumeAccessor accessor(volume_, resolution_, getVoxelSize());
+    parallel_for_(slices, FetchPointsNormalsInvoker(accessor, toPose(volumePose_), slices.start,
+                                                    slicePoints, sliceNormals));
+
+    concatenate(slicePoints, points);
+    if (normals.needed())
+      concatenate(sliceNormals, normals);
+}
+
+void
+TSDFVolume::fetchMesh(OutputArray vertices, const Range& _slices) const
+{
+    CV_Assert(!volume_.empty());
+
+    // cubes span two voxels along x, the last slice of voxels has no cube
+    Range slices = _slices == Range::all() ? Range(0, resolution_ - 1) : _slices;
+    CV_Assert(0 <= slices.start && slices.start <= slices.end && slices.end <= resolution_ - 1);
+
+    std::vector< std::vector<Vec3f> > sliceVertices(slices.size());
+    VolumeAccessor accessor(volume_, resolution_, getVoxelSize());
+    parallel_for_(slices, FetchMeshInvoker(accessor, toPose(volumePose_), slices.start, sliceVertices));
+
+    concatenate(sliceVertices, vertices);
+}
+
+} /* namespace rgbd */
+} /* namespace cv */
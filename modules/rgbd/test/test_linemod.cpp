@@ -0,0 +1,192 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2016, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+#include <opencv2/imgproc.hpp>
+
+namespace cv
+{
+namespace linemod
+{
+
+static std::vector<Template> makeSyntheticTemplates(RNG& rng, int num_levels)
+{
+  std::vector<Template> templates(num_levels);
+  for (int l = 0; l < num_levels; ++l)
+  {
+    Template& templ = templates[l];
+    templ.width = 64 >> l;
+    templ.height = 48 >> l;
+    templ.pyramid_level = l;
+    int num_features = 63 >> l;
+    for (int i = 0; i < num_features; ++i)
+      templ.features.push_back(Feature(rng.uniform(0, templ.width), rng.uniform(0, templ.height),
+                                       rng.uniform(0, 8)));
+  }
+  return templates;
+}
+
+// Draws a textured object made of a few filled shapes, rotated by angle around the image center
+static void drawObject(Mat& image, Mat& mask, double angle)
+{
+  Point2f center(image.cols * 0.5f, image.rows * 0.5f);
+  RotatedRect box(center, Size2f(image.cols * 0.3f, image.rows * 0.2f), (float)angle);
+  Point2f corners[4];
+  box.points(corners);
+  std::vector<Point> poly(corners, corners + 4);
+
+  fillConvexPoly(image, poly, Scalar(200, 120, 60));
+  fillConvexPoly(mask, poly, Scalar::all(255));
+  circle(image, corners[0], image.rows / 10, Scalar(40, 0, 220), -1);
+  circle(mask, corners[0], image.rows / 10, Scalar::all(255), -1);
+  line(image, corners[1], corners[3], Scalar(0, 180, 0), 5);
+}
+
+TEST(Rgbd_LinemodTemplateDatabase, roundTrip)
+{
+  Ptr<Detector> detector = getDefaultLINE();
+  RNG rng(0);
+  for (int c = 0; c < 3; ++c)
+    for (int t = 0; t < 4; ++t)
+      detector->addSyntheticTemplate(makeSyntheticTemplates(rng, detector->pyramidLevels()),
+                                     cv::format("class_%d", c));
+
+  String filename = cv::tempfile(".bin");
+  detector->writeTemplateDatabase(filename);
+
+  Ptr<Detector> loaded = getDefaultLINE();
+  ASSERT_EQ(3, loaded->openTemplateDatabase(filename));
+  ASSERT_EQ(detector->classIds(), loaded->classIds());
+  ASSERT_EQ(detector->numTemplates(), loaded->numTemplates());
+
+  std::vector<String> ids = detector->classIds();
+  for (size_t c = 0; c < ids.size(); ++c)
+    for (int t = 0; t < detector->numTemplates(ids[c]); ++t)
+    {
+      const std::vector<Template>& expected = detector->getTemplates(ids[c], t);
+      const std::vector<Template>& actual = loaded->getTemplates(ids[c], t);
+      ASSERT_EQ(expected.size(), actual.size());
+      for (size_t l = 0; l < expected.size(); ++l)
+      {
+        EXPECT_EQ(expected[l].width, actual[l].width);
+        EXPECT_EQ(expected[l].height, actual[l].height);
+        EXPECT_EQ(expected[l].pyramid_level, actual[l].pyramid_level);
+        ASSERT_EQ(expected[l].features.size(), actual[l].features.size());
+        for (size_t f = 0; f < expected[l].features.size(); ++f)
+        {
+          EXPECT_EQ(expected[l].features[f].x, actual[l].features[f].x);
+          EXPECT_EQ(expected[l].features[f].y, actual[l].features[f].y);
+          EXPECT_EQ(expected[l].features[f].label, actual[l].features[f].label);
+        }
+      }
+    }
+
+  // Adding a template moves the class out of the database
+  loaded->addSyntheticTemplate(makeSyntheticTemplates(rng, loaded->pyramidLevels()), "class_0");
+  EXPECT_EQ(5, loaded->numTemplates("class_0"));
+  EXPECT_EQ(3, loaded->numClasses());
+
+  loaded.release();
+  remove(filename.c_str());
+}
+
+TEST(Rgbd_LinemodTemplateDatabase, match)
+{
+  Ptr<Detector> detector = getDefaultLINE();
+  for (int c = 0; c < 2; ++c)
+    for (int t = 0; t < 3; ++t)
+    {
+      Mat image(240, 320, CV_8UC3, Scalar::all(0)), mask(image.size(), CV_8U, Scalar::all(0));
+      drawObject(image, mask, 90.0 * c + 30.0 * t);
+      std::vector<Mat> sources(1, image);
+      ASSERT_EQ(t, detector->addTemplate(sources, cv::format("class_%d", c), mask));
+    }
+
+  String filename = cv::tempfile(".bin");
+  detector->writeTemplateDatabase(filename);
+
+  Mat scene(480, 640, CV_8UC3);
+  RNG rng(1);
+  rng.fill(scene, RNG::UNIFORM, Scalar::all(0), Scalar::all(64));
+  Mat object = scene(Rect(160, 120, 320, 240)), object_mask(object.size(), CV_8U, Scalar::all(0));
+  drawObject(object, object_mask, 30.0);
+  std::vector<Mat> sources(1, scene);
+
+  std::vector<Match> expected;
+  detector->match(sources, 80.f, expected);
+  ASSERT_FALSE(expected.empty());
+
+  // all the classes, they only exist in the database
+  {
+    Ptr<Detector> loaded = getDefaultLINE();
+    ASSERT_EQ(2, loaded->openTemplateDatabase(filename));
+    std::vector<Match> actual;
+    loaded->match(sources, 80.f, actual);
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+      EXPECT_EQ(expected[i], actual[i]);
+      EXPECT_EQ(expected[i].template_id, actual[i].template_id);
+    }
+  }
+
+  // only the requested class
+  {
+    Ptr<Detector> loaded = getDefaultLINE();
+    ASSERT_EQ(2, loaded->openTemplateDatabase(filename));
+    std::vector<String> class_ids(1, "class_1");
+    std::vector<Match> expected_class, actual_class;
+    detector->match(sources, 80.f, expected_class, class_ids);
+    loaded->match(sources, 80.f, actual_class, class_ids);
+    ASSERT_EQ(expected_class.size(), actual_class.size());
+    for (size_t i = 0; i < expected_class.size(); ++i)
+    {
+      EXPECT_EQ("class_1", actual_class[i].class_id);
+      EXPECT_EQ(expected_class[i], actual_class[i]);
+      EXPECT_EQ(expected_class[i].template_id, actual_class[i].template_id);
+    }
+  }
+
+  remove(filename.c_str());
+}
+
+}
+}
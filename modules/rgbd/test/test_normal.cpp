@@ -248,7 +248,7 @@ protected:
     try
     {
       Mat_<unsigned char> plane_mask;
-      for (unsigned char i = 0; i < 3; ++i)
+      for (unsigned char i = 0; i < 4; ++i)
       {
         RgbdNormals::RGBD_NORMALS_METHOD method;
         // inner vector: whether it's 1 plane or 3 planes
@@ -287,6 +287,14 @@ protected:
             errors[1][0] = 0.02f;
             errors[1][1] = 0.04f;
             break;
+          case 3:
+            method = RgbdNormals::RGBD_NORMALS_METHOD_AVG3D_GRADIENT;
+            std::cout << std::endl << "*** AVG3D_GRADIENT" << std::endl;
+            errors[0][0] = 0.01f;
+            errors[0][1] = 0.05f;
+            errors[1][0] = 0.01f;
+            errors[1][1] = 0.05f;
+            break;
           default:
             method = (RgbdNormals::RGBD_NORMALS_METHOD)-1;
             CV_Error(0, "");
@@ -423,17 +431,21 @@ protected:
   {
     try
     {
-      RgbdPlane plane_computer;
-
-      std::vector<Plane> planes;
-      Mat points3d, ground_normals;
-      Mat_<unsigned char> plane_mask;
-      gen_points_3d(planes, plane_mask, points3d, ground_normals, 1);
-      testit(planes, plane_mask, points3d, plane_computer); // 1 plane, continuous scene, very low error..
-      for (int ii = 0; ii < 10; ii++)
+      for (int method = RgbdPlane::RGBD_PLANE_METHOD_DEFAULT; method <= RgbdPlane::RGBD_PLANE_METHOD_PARALLEL;
+           ++method)
       {
-        gen_points_3d(planes, plane_mask, points3d, ground_normals, 3); //three planes
-        testit(planes, plane_mask, points3d, plane_computer); // 3 discontinuities, more error expected.
+        RgbdPlane plane_computer((RgbdPlane::RGBD_PLANE_METHOD)method);
+
+        std::vector<Plane> planes;
+        Mat points3d, ground_normals;
+        Mat_<unsigned char> plane_mask;
+        gen_points_3d(planes, plane_mask, points3d, ground_normals, 1);
+        testit(planes, plane_mask, points3d, plane_computer); // 1 plane, continuous scene, very low error..
+        for (int ii = 0; ii < 10; ii++)
+        {
+          gen_points_3d(planes, plane_mask, points3d, ground_normals, 3); //three planes
+          testit(planes, plane_mask, points3d, plane_computer); // 3 discontinuities, more error expected.
+        }
       }
     } catch (...)
     {
@@ -0,0 +1,116 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2016, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "test_precomp.hpp"
+
+namespace cv
+{
+namespace rgbd
+{
+
+// A fronto-parallel wall at 1 meter, seen by a VGA camera at the origin
+static void makeWallFrame(Mat& K, Mat& depth)
+{
+  K = (Mat_<float>(3, 3) << 525.f, 0.f, 319.5f, 0.f, 525.f, 239.5f, 0.f, 0.f, 1.f);
+  depth = Mat(480, 640, CV_32FC1, Scalar::all(1.0));
+}
+
+TEST(Rgbd_TSDFVolume, raycastIntegratedFrame)
+{
+  Mat K, depth;
+  makeWallFrame(K, depth);
+
+  TSDFVolume volume(128, 2.f, K);
+  Mat pose = Mat::eye(4, 4, CV_64FC1);
+  volume.integrate(depth, pose);
+
+  Mat points, normals;
+  volume.raycast(pose, depth.size(), points, normals);
+  ASSERT_EQ(CV_32FC3, points.type());
+  ASSERT_EQ(depth.size(), points.size());
+
+  // the center of the frame sees the wall well inside of the volume
+  int hits = 0;
+  for (int y = 140; y < 340; ++y)
+    for (int x = 220; x < 420; ++x)
+    {
+      const Vec3f& p = points.at<Vec3f>(y, x);
+      const Vec3f& n = normals.at<Vec3f>(y, x);
+      if (cvIsNaN(p[2]))
+        continue;
+      ++hits;
+      EXPECT_NEAR(1.f, p[2], volume.getVoxelSize());
+      EXPECT_NEAR(-1.f, n[2], 1e-2);
+    }
+  EXPECT_GT(hits, 200 * 200 * 9 / 10);
+}
+
+TEST(Rgbd_TSDFVolume, fetchSurface)
+{
+  Mat K, depth;
+  makeWallFrame(K, depth);
+
+  TSDFVolume volume(64, 2.f, K);
+  volume.integrate(depth, Mat::eye(4, 4, CV_32FC1));
+
+  Mat points, normals;
+  volume.fetchPointsNormals(points, normals);
+  ASSERT_GT(points.rows, 0);
+  ASSERT_EQ(points.rows, normals.rows);
+  for (int i = 0; i < points.rows; ++i)
+    EXPECT_NEAR(1.f, points.at<Vec3f>(i)[2], 1e-3);
+
+  // extracting by slabs gives the same points
+  Mat part0, part1, partNormals;
+  volume.fetchPointsNormals(part0, partNormals, Range(0, 32));
+  volume.fetchPointsNormals(part1, partNormals, Range(32, 64));
+  EXPECT_EQ(points.rows, part0.rows + part1.rows);
+
+  Mat vertices;
+  volume.fetchMesh(vertices);
+  ASSERT_GT(vertices.rows, 0);
+  EXPECT_EQ(0, vertices.rows % 3);
+  for (int i = 0; i < vertices.rows; ++i)
+    EXPECT_NEAR(1.f, vertices.at<Vec3f>(i)[2], 1e-3);
+}
+
+}
+}
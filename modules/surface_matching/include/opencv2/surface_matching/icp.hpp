@@ -95,6 +95,7 @@ public:
     m_numLevels = 6;
     m_sampleType = ICP_SAMPLING_TYPE_UNIFORM;
     m_numNeighborsCorr = 1;
+    m_reuseSceneIndex = false;
   }
 
   virtual ~ICP() { }
@@ -122,6 +123,7 @@ public:
     m_maxIterations = iterations;
     m_numLevels = numLevels;
     m_sampleType = sampleType;
+    m_reuseSceneIndex = false;
   }
 
   /**
@@ -151,13 +153,38 @@ public:
      */
   int registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses);
 
+  /**
+     *  \brief Keep the KD-tree of the scene alive between calls to registerModelToScene
+     *
+     *  @param [in] reuse If true, the index built for a scene is kept and reused as long as the
+     *  following calls pass the same scene matrix (same data pointer and size). The scene data
+     *  must not be modified in place while it is cached. If false, any cached index is released.
+     *
+     *  \details The multiple pose overload of registerModelToScene always builds the scene index
+     *  once and shares it among all the poses. This mode extends the sharing across separate calls,
+     *  e.g. when the poses returned by PPF are refined one by one against the same scene.
+     */
+  void setSceneIndexReuse(bool reuse);
+
+  /**
+     *  \brief Release the cached scene index, if any
+     */
+  void clearSceneIndex();
+
 private:
+  struct SceneIndex;
+
+  int registerModelToScene(const Mat& srcPC, const Mat& dstPC, const SceneIndex& sceneIndex, double& residual, double pose[16]);
+  Ptr<SceneIndex> getSceneIndex(const Mat& dstPC);
+
   float m_tolerance;
   int m_maxIterations;
   float m_rejectionScale;
   int m_numNeighborsCorr;
   int m_numLevels;
   int m_sampleType;
+  bool m_reuseSceneIndex;
+  Ptr<SceneIndex> m_sceneIndex;
 
 };
 
@@ -191,38 +191,132 @@ static float getRejectionThreshold(float* r, int m, float outlierScale)
   return threshold;
 }
 
-// Kok Lim Low's linearization
-static void minimizePointToPlaneMetric(Mat Src, Mat Dst, Mat& X)
+// Accumulates the normal equations (A'A, A'b) of the linearized point to plane metric
+// over a block of correspondences. Each block owns its partial sums, which are reduced
+// in a fixed order afterwards so that the result does not depend on the scheduling.
+class PointToPlaneNormalEquations : public ParallelLoopBody
 {
-  //Mat sub = Dst - Src;
-  Mat A = Mat(Src.rows, 6, CV_64F);
-  Mat b = Mat(Src.rows, 1, CV_64F);
+public:
+  PointToPlaneNormalEquations(const Mat& Src, const Mat& Dst, int blockSize, double* partials)
+    : src(Src), dst(Dst), block(blockSize), partial(partials) {}
+
+  virtual void operator()(const Range& r) const
+  {
+    for (int bi=r.start; bi<r.end; bi++)
+    {
+      const int start = bi*block;
+      const int end = std::min(start+block, src.rows);
+      double* AtA = partial + bi*(36+6);
+      double* Atb = AtA + 36;
+      accumulate(start, end, AtA, Atb);
+    }
+  }
 
-#if defined _OPENMP
-#pragma omp parallel for
+private:
+  void accumulate(int start, int end, double* AtA, double* Atb) const
+  {
+#if defined(CV_SIMD128_64F) && CV_SIMD128_64F
+    v_float64x2 acc[6][3], accb[3];
+    for (int j=0; j<6; j++)
+      acc[j][0] = acc[j][1] = acc[j][2] = v_setzero_f64();
+    accb[0] = accb[1] = accb[2] = v_setzero_f64();
+
+    for (int i=start; i<end; i++)
+    {
+      double a[6], b;
+      getRow(i, a, b);
+      const v_float64x2 va[3] = {v_load(a), v_load(a+2), v_load(a+4)};
+      for (int j=0; j<6; j++)
+      {
+        const v_float64x2 aj = v_setall_f64(a[j]);
+        acc[j][0] += aj*va[0];
+        acc[j][1] += aj*va[1];
+        acc[j][2] += aj*va[2];
+      }
+      const v_float64x2 vb = v_setall_f64(b);
+      accb[0] += vb*va[0];
+      accb[1] += vb*va[1];
+      accb[2] += vb*va[2];
+    }
+
+    for (int j=0; j<6; j++)
+    {
+      v_store(AtA+j*6, acc[j][0]);
+      v_store(AtA+j*6+2, acc[j][1]);
+      v_store(AtA+j*6+4, acc[j][2]);
+    }
+    v_store(Atb, accb[0]);
+    v_store(Atb+2, accb[1]);
+    v_store(Atb+4, accb[2]);
+#else
+    for (int j=0; j<36; j++)
+      AtA[j] = 0;
+    for (int j=0; j<6; j++)
+      Atb[j] = 0;
+
+    for (int i=start; i<end; i++)
+    {
+      double a[6], b;
+      getRow(i, a, b);
+      for (int j=0; j<6; j++)
+      {
+        for (int k=j; k<6; k++)
+          AtA[j*6+k] += a[j]*a[k];
+        Atb[j] += a[j]*b;
+      }
+    }
+    for (int j=0; j<6; j++)
+      for (int k=0; k<j; k++)
+        AtA[j*6+k] = AtA[k*6+j];
 #endif
-  for (int i=0; i<Src.rows; i++)
+  }
+
+  // one row of the linear system: a = [src x n, n], b = (dst-src).n
+  inline void getRow(int i, double a[6], double& b) const
   {
-    const double *srcPt = (double*)&Src.data[i*Src.step];
-    const double *dstPt = (double*)&Dst.data[i*Dst.step];
+    const double *srcPt = src.ptr<double>(i);
+    const double *dstPt = dst.ptr<double>(i);
     const double *normals = &dstPt[3];
-    double *bVal = (double*)&b.data[i*b.step];
-    double *aRow = (double*)&A.data[i*A.step];
-
     const double sub[3]={dstPt[0]-srcPt[0], dstPt[1]-srcPt[1], dstPt[2]-srcPt[2]};
 
-    *bVal = TDot3(sub, normals);
-    TCross(srcPt, normals, aRow);
+    b = TDot3(sub, normals);
+    TCross(srcPt, normals, a);
+    a[3] = normals[0];
+    a[4] = normals[1];
+    a[5] = normals[2];
+  }
+
+  const Mat& src;
+  const Mat& dst;
+  int block;
+  double* partial;
+};
+
+// Kok Lim Low's linearization
+static void minimizePointToPlaneMetric(Mat Src, Mat Dst, Mat& X)
+{
+  const int blockSize = 1024;
+  const int numBlocks = (Src.rows + blockSize - 1) / blockSize;
+  std::vector<double> partials((size_t)std::max(numBlocks, 1)*(36+6), 0.0);
+
+  parallel_for_(Range(0, numBlocks), PointToPlaneNormalEquations(Src, Dst, blockSize, &partials[0]));
 
-    aRow[3] = normals[0];
-    aRow[4] = normals[1];
-    aRow[5] = normals[2];
+  Mat AtA = Mat::zeros(6, 6, CV_64F);
+  Mat Atb = Mat::zeros(6, 1, CV_64F);
+  double* ata = AtA.ptr<double>();
+  double* atb = Atb.ptr<double>();
+  for (int bi=0; bi<numBlocks; bi++)
+  {
+    const double* p = &partials[(size_t)bi*(36+6)];
+    for (int j=0; j<36; j++)
+      ata[j] += p[j];
+    for (int j=0; j<6; j++)
+      atb[j] += p[36+j];
   }
 
-  cv::solve(A, b, X, DECOMP_SVD);
+  cv::solve(AtA, Atb, X, DECOMP_SVD);
 }
 
-
 static void getTransformMat(Mat X, double Pose[16])
 {
   Mat DCM;
@@ -292,8 +386,77 @@ static hashtable_int* getHashtable(int* data, size_t length, int numMaxElement)
   return hashtable;
 }
 
+// KD-tree over the raw scene coordinates. Registration works on clouds that are centered
+// and scaled depending on the model as well, so the tree is built on the untouched scene
+// and the queries are mapped back instead. Nearest neighbors are invariant to this
+// similarity transform, only the (squared) distances need to be rescaled.
+struct ICP::SceneIndex
+{
+  explicit SceneIndex(const Mat& dstPC) : scene(dstPC), flann(indexPCFlann(dstPC)) {}
+  ~SceneIndex() { destroyFlann(flann); }
+
+  bool isBuiltFor(const Mat& dstPC) const
+  {
+    return scene.data == dstPC.data && scene.rows == dstPC.rows &&
+           scene.cols == dstPC.cols && scene.step == dstPC.step;
+  }
+
+  void query(const Mat& pc, double scale, const double mean[3], Mat& indices, Mat& distances) const
+  {
+    Mat pcScene(pc.rows, 3, CV_32F);
+    const float invScale = (float)(1.0/scale);
+    for (int i=0; i<pc.rows; i++)
+    {
+      const float* src = pc.ptr<float>(i);
+      float* dst = pcScene.ptr<float>(i);
+      dst[0] = src[0]*invScale + (float)mean[0];
+      dst[1] = src[1]*invScale + (float)mean[1];
+      dst[2] = src[2]*invScale + (float)mean[2];
+    }
+
+    queryPCFlann(flann, pcScene, indices, distances);
+    distances *= scale*scale;
+  }
+
+  Mat scene;
+  void* flann;
+
+private:
+  SceneIndex(const SceneIndex&);
+  SceneIndex& operator=(const SceneIndex&);
+};
+
+void ICP::setSceneIndexReuse(bool reuse)
+{
+  m_reuseSceneIndex = reuse;
+  if (!reuse)
+    clearSceneIndex();
+}
+
+void ICP::clearSceneIndex()
+{
+  m_sceneIndex.release();
+}
+
+Ptr<ICP::SceneIndex> ICP::getSceneIndex(const Mat& dstPC)
+{
+  if (m_reuseSceneIndex && m_sceneIndex && m_sceneIndex->isBuiltFor(dstPC))
+    return m_sceneIndex;
+
+  Ptr<SceneIndex> sceneIndex(new SceneIndex(dstPC));
+  if (m_reuseSceneIndex)
+    m_sceneIndex = sceneIndex;
+  return sceneIndex;
+}
+
 // source point clouds are assumed to contain their normals
 int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residual, double pose[16])
+{
+  Ptr<SceneIndex> sceneIndex = getSceneIndex(dstPC);
+  return registerModelToScene(srcPC, dstPC, *sceneIndex, residual, pose);
+}
+
+int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, const SceneIndex& sceneIndex, double& residual, double pose[16])
 {
   int n = srcPC.rows;
 
@@ -322,7 +485,6 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
   // initialize pose
   matrixIdentity(4, pose);
 
-  void* flann = indexPCFlann(dstPC0);
   Mat M = Mat::eye(4,4,CV_64F);
 
   double tempResidual = 0;
@@ -351,7 +513,7 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
     decrease the accuracy. That's why I won't be implementing it at this
     moment.
 
-    Also note that you have to compute a KD-tree for each level.
+    The KD-tree of the scene is shared by all the levels (see SceneIndex).
     */
     srcPCT = samplePCUniformInd(srcPCT, sampleStep, srcSampleInd);
 
@@ -384,7 +546,7 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
     {
       size_t di=0, selInd = 0;
 
-      queryPCFlann(flann, Src_Moved, Indices, Distances);
+      sceneIndex.query(Src_Moved, scale, meanAvg, Indices, Distances);
 
       for (di=0; di<numElSrc; di++)
       {
@@ -533,18 +695,20 @@ int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, double& residu
 
   residual = tempResidual;
 
-  destroyFlann(flann);
   return 0;
 }
 
 // source point clouds are assumed to contain their normals
 int ICP::registerModelToScene(const Mat& srcPC, const Mat& dstPC, std::vector<Pose3DPtr>& poses)
 {
+  // all the poses are refined against the same scene: build its index only once
+  Ptr<SceneIndex> sceneIndex = getSceneIndex(dstPC);
+
   for (size_t i=0; i<poses.size(); i++)
   {
     double poseICP[16]={0};
     Mat srcTemp = transformPCPose(srcPC, poses[i]->pose);
-    registerModelToScene(srcTemp, dstPC, poses[i]->residual, poseICP);
+    registerModelToScene(srcTemp, dstPC, *sceneIndex, poses[i]->residual, poseICP);
     poses[i]->appendPose(poseICP);
   }
   return 0;
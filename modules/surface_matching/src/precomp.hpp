@@ -62,6 +62,7 @@ the use of this software, even if advised of the possibility of such damage.
 
 #include <sstream>  // flann dependency, needed in precomp now
 #include "opencv2/flann.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 #include "c_utils.hpp"
 
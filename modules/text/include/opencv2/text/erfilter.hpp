@@ -353,6 +353,22 @@ CV_EXPORTS void MSERsToERStats(InputArray image, std::vector<std::vector<Point>
 // Utility funtion for scripting
 CV_EXPORTS_W void detectRegions(InputArray image, const Ptr<ERFilter>& er_filter1, const Ptr<ERFilter>& er_filter2, CV_OUT std::vector< std::vector<Point> >& regions);
 
+/** @brief Extracts the ERs of several channels at once, the channels are processed in parallel.
+
+@param channels Vector of single channel images CV_8UC1, e.g. the output of computeNMChannels.
+
+@param er_filter1 Filter for the 1st stage, it is copied for each channel.
+
+@param er_filter2 Optional filter for the 2nd stage, it is copied for each channel.
+
+@param regions Output, regions[c] holds the ERStat regions extracted from channels[c] exactly as if
+er_filter1->run and er_filter2->run had been called on it. The classifier callbacks are shared
+among the copies and must be thread-safe. Filters not created with createERFilterNM1 or
+createERFilterNM2 can not be copied and the channels are then processed sequentially.
+ */
+CV_EXPORTS void detectRegions(InputArrayOfArrays channels, const Ptr<ERFilter>& er_filter1, const Ptr<ERFilter>& er_filter2,
+                              std::vector< std::vector<ERStat> >& regions);
+
 //! @}
 
 }
@@ -65,27 +65,6 @@ using namespace cv::ml;
 using namespace std;
 using namespace cv::ml;
 
-// Deletes a tree of ERStat regions starting at root. Used only
-// internally to this implementation.
-static void deleteERStatTree(ERStat* root) {
-    queue<ERStat*> to_delete;
-    to_delete.push(root);
-    while (!to_delete.empty()) {
-        ERStat* n = to_delete.front();
-        to_delete.pop();
-        ERStat* c = n->child;
-        if (c != NULL) {
-            to_delete.push(c);
-            ERStat* sibling = c->next;
-            while (sibling != NULL) {
-                to_delete.push(sibling);
-                sibling = sibling->next;
-            }
-        }
-        delete n;
-    }
-}
-
 ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(init_pixel),
                level(init_level), area(0), perimeter(0), euler(0), probability(1.0),
                parent(0), child(0), next(0), prev(0), local_maxima(0),
@@ -101,6 +80,101 @@ ERStat::ERStat(int init_level, int init_pixel, int init_x, int init_y) : pixel(i
     crossings->push_back(0);
 }
 
+// Storage for the nodes of the component tree built by er_tree_extract. Nodes and their
+// crossings are recycled as soon as the extraction discards them, and the whole tree is
+// released at once when the extraction is done. The memory is kept for the next run.
+class ERStatPool
+{
+public:
+    ERStatPool() : used(0)
+    {
+        blank.crossings->clear();
+        delete blank.crossings;
+        blank.crossings = NULL;
+        blank.med_crossings = 0.f;
+        blank.hole_area_ratio = 0.f;
+        blank.convex_hull_ratio = 0.f;
+        blank.num_inflexion_points = 0.f;
+        blank.pixels = NULL;
+    }
+    // a copy starts empty, the nodes are never shared between filters
+    ERStatPool(const ERStatPool& other) : blank(other.blank), used(0) {}
+    ERStatPool& operator=(const ERStatPool&) { return *this; }
+    ~ERStatPool()
+    {
+        for (size_t b=0; b<blocks.size(); b++)
+            fastFree(blocks[b]);
+        for (size_t c=0; c<all_crossings.size(); c++)
+            delete all_crossings[c];
+    }
+
+    // returns a node initialized as ERStat(level, pixel, x, y)
+    ERStat* get(int level, int pixel, int x, int y)
+    {
+        ERStat *er;
+        if (!free_nodes.empty())
+        {
+            er = free_nodes.back();
+            free_nodes.pop_back();
+        }
+        else
+        {
+            if (used == blocks.size()*BLOCK_SIZE)
+                blocks.push_back((ERStat*)fastMalloc(BLOCK_SIZE*sizeof(ERStat)));
+            er = blocks[used/BLOCK_SIZE] + used%BLOCK_SIZE;
+            used++;
+        }
+        new (er) ERStat(blank);
+        er->level = level;
+        er->pixel = pixel;
+        er->rect = Rect(x,y,1,1);
+
+        if (free_crossings.empty())
+        {
+            all_crossings.push_back(new deque<int>());
+            free_crossings.push_back(all_crossings.back());
+        }
+        er->crossings = free_crossings.back();
+        free_crossings.pop_back();
+        er->crossings->clear();
+        er->crossings->push_back(0);
+        return er;
+    }
+
+    // gives back the crossings of a node, they are not needed once the node is merged
+    void releaseCrossings(ERStat *er)
+    {
+        if (er->crossings)
+            free_crossings.push_back(er->crossings);
+        er->crossings = NULL;
+    }
+
+    // gives back a node discarded by the extraction
+    void release(ERStat *er)
+    {
+        releaseCrossings(er);
+        free_nodes.push_back(er);
+    }
+
+    // gives back all the nodes and crossings at once
+    void releaseAll()
+    {
+        used = 0;
+        free_nodes.clear();
+        free_crossings = all_crossings;
+    }
+
+private:
+    enum { BLOCK_SIZE = 4096 };
+
+    ERStat blank;
+    vector<ERStat*> blocks;
+    size_t used;
+    vector<ERStat*> free_nodes;
+    vector< deque<int>* > all_crossings;
+    vector< deque<int>* > free_crossings;
+};
+
 
 // derivative classes
 
@@ -151,6 +225,13 @@ private:
     // image mask used for feature calculations
     Mat region_mask;
 
+    // buffers of er_tree_extract, kept from one call to the next
+    ERStatPool er_pool;
+    vector<ERStat*> er_stack;
+    vector<uchar> pixel_mask;
+    vector<int> boundary_pixes[256];
+    vector<int> boundary_edges[256];
+
     // extract the component tree and store all the ER regions
     void er_tree_extract( InputArray image );
     // accumulate a pixel into an ER
@@ -273,7 +354,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
     int width = src.cols, height = src.rows;
 
     // the component stack
-    vector<ERStat*> er_stack;
+    er_stack.clear();
 
     //the quads for euler number calculation
     unsigned char quads[3][4];
@@ -294,16 +375,20 @@ void ERFilterNM::er_tree_extract( InputArray image )
     // Q_1 and Q_2 have four patterns, while Q_3 has only two.
 
 
-    // masks to know if a pixel is accessible and if it has been already added to some region
-    vector<bool> accessible_pixel_mask(width * height);
-    vector<bool> accumulated_pixel_mask(width * height);
+    // mask to know if a pixel is accessible and if it has been already added to some region
+    const uchar ACCESSIBLE = 1, ACCUMULATED = 2;
+    pixel_mask.assign(width * height, (uchar)0);
+    uchar *mask = &pixel_mask[0];
 
     // heap of boundary pixels
-    vector<int> boundary_pixes[256];
-    vector<int> boundary_edges[256];
+    for (int l=0; l<256; l++)
+    {
+        boundary_pixes[l].clear();
+        boundary_edges[l].clear();
+    }
 
     // add a dummy-component before start
-    er_stack.push_back(new ERStat);
+    er_stack.push_back(er_pool.get(256, 0, 0, 0));
 
     // we'll look initially for all pixels with grey-level lower than a grey-level higher than any allowed in the image
     int threshold_level = (255/thresholdDelta)+1;
@@ -312,7 +397,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
     int current_pixel = 0;
     int current_edge = 0;
     int current_level = image_data[0];
-    accessible_pixel_mask[0] = true;
+    mask[0] |= ACCESSIBLE;
 
     bool push_new_component = true;
 
@@ -323,7 +408,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
         // push a component with current level in the component stack
         if (push_new_component)
-            er_stack.push_back(new ERStat(current_level, current_pixel, x, y));
+            er_stack.push_back(er_pool.get(current_level, current_pixel, x, y));
         push_new_component = false;
 
         // explore the (remaining) edges to the neighbors to the current pixel
@@ -341,11 +426,11 @@ void ERFilterNM::er_tree_extract( InputArray image )
             }
 
             // if neighbour is not accessible, mark it accessible and retreive its grey-level value
-            if ( !accessible_pixel_mask[neighbour_pixel] && (neighbour_pixel != current_pixel) )
+            if ( !(mask[neighbour_pixel] & ACCESSIBLE) && (neighbour_pixel != current_pixel) )
             {
 
                 int neighbour_level = image_data[neighbour_pixel];
-                accessible_pixel_mask[neighbour_pixel] = true;
+                mask[neighbour_pixel] |= ACCESSIBLE;
 
                 // if neighbour level is not lower than current level add neighbour to the boundary heap
                 if (neighbour_level >= current_level)
@@ -415,7 +500,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
                     case 6: if (y > 0) { neighbour4 = neighbour8 = current_pixel - width;} cell = 1; break;
                     default: if ((x < width - 1)&&(y > 0)) { neighbour8 = current_pixel + 1 - width;} cell = 2; break;
             }
-            if ((neighbour4 != -1)&&(accumulated_pixel_mask[neighbour4])&&(image_data[neighbour4]<=image_data[current_pixel]))
+            if ((neighbour4 != -1)&&(mask[neighbour4] & ACCUMULATED)&&(image_data[neighbour4]<=image_data[current_pixel]))
             {
                 non_boundary_neighbours++;
                 if ((edge == 0) || (edge == 4))
@@ -425,7 +510,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
             int pix_value = image_data[current_pixel] + 1;
             if (neighbour8 != -1)
             {
-                if (accumulated_pixel_mask[neighbour8])
+                if (mask[neighbour8] & ACCUMULATED)
                     pix_value = image_data[neighbour8];
             }
 
@@ -510,7 +595,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
         int d_C3 = C_after[2]-C_before[2];
 
         er_add_pixel(er_stack.back(), x, y, non_boundary_neighbours, non_boundary_neighbours_horiz, d_C1, d_C2, d_C3);
-        accumulated_pixel_mask[current_pixel] = true;
+        mask[current_pixel] |= ACCUMULATED;
 
         // if we have processed all the possible threshold levels (the hea is empty) we are done!
         if (threshold_level == (255/thresholdDelta)+1)
@@ -520,18 +605,8 @@ void ERFilterNM::er_tree_extract( InputArray image )
             regions->reserve(num_accepted_regions+1);
             er_save(er_stack.back(), NULL, NULL);
 
-            // clean memory
-            for (size_t r=0; r<er_stack.size(); r++)
-            {
-                ERStat *stat = er_stack.at(r);
-                if (stat->crossings)
-                {
-                    stat->crossings->clear();
-                    delete(stat->crossings);
-                    stat->crossings = NULL;
-                }
-                deleteERStatTree(stat);
-            }
+            // release the whole component tree
+            er_pool.releaseAll();
             er_stack.clear();
 
             return;
@@ -563,7 +638,7 @@ void ERFilterNM::er_tree_extract( InputArray image )
 
                 if (new_level < er_stack.back()->level)
                 {
-                    er_stack.push_back(new ERStat(new_level, current_pixel, current_pixel%width, current_pixel/width));
+                    er_stack.push_back(er_pool.get(new_level, current_pixel, current_pixel%width, current_pixel/width));
                     er_merge(er_stack.back(), er);
                     break;
                 }
@@ -665,9 +740,7 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
     child->med_crossings = (float)m_crossings.at(1);
 
     // free unnecessary mem
-    child->crossings->clear();
-    delete(child->crossings);
-    child->crossings = NULL;
+    er_pool.releaseCrossings(child);
 
     // recover the original grey-level
     child->level = child->level*thresholdDelta;
@@ -712,13 +785,7 @@ void ERFilterNM::er_merge(ERStat *parent, ERStat *child)
         }
 
         // free mem
-        if(child->crossings)
-        {
-            child->crossings->clear();
-            delete(child->crossings);
-            child->crossings = NULL;
-        }
-        delete(child);
+        er_pool.release(child);
     }
 
 }
@@ -729,6 +796,8 @@ ERStat* ERFilterNM::er_save( ERStat *er, ERStat *parent, ERStat *prev )
 
     regions->push_back(*er);
 
+    // the crossings belong to the node pool
+    regions->back().crossings = NULL;
     regions->back().parent = parent;
     if (prev != NULL)
     {
@@ -3472,9 +3541,9 @@ bool fitLineEstimates(vector< vector<ERStat> > &regions, region_triplet &triplet
 }
 
 
-// Evaluates if a pair of regions is valid or not
-// using thresholds learned on training (defined above)
-bool isValidPair(Mat &grey, Mat &lab, Mat &mask, vector<Mat> &channels, vector< vector<ERStat> >& regions, Vec2i idx1, Vec2i idx2)
+// Evaluates the geometric part of the pair test (size, position and root checks),
+// it does not touch the pixels of the regions
+static bool isValidPairGeometry(vector< vector<ERStat> >& regions, Vec2i idx1, Vec2i idx2)
 {
     Rect minarearect  = regions[idx1[0]][idx1[1]].rect | regions[idx2[0]][idx2[1]].rect;
 
@@ -3516,57 +3585,67 @@ bool isValidPair(Mat &grey, Mat &lab, Mat &mask, vector<Mat> &channels, vector<
     if ((i->parent == NULL)||(j->parent == NULL)) // deprecate the root region
       return false;
 
-    i = &regions[idx1[0]][idx1[1]];
-    j = &regions[idx2[0]][idx2[1]];
+    return true;
+}
 
-    Mat region = mask(Rect(Point(i->rect.x,i->rect.y),
-                           Point(i->rect.br().x+2,i->rect.br().y+2)));
+// Mean grey level and mean a,b chromaticity of the pixels of a region
+struct region_colour
+{
+    int grey_mean;
+    float a_mean;
+    float b_mean;
+};
+
+// Computes the colour of a region, mask is a scratch image of size (grey.rows+2)x(grey.cols+2)
+// only the part under the region bounding box is written
+static region_colour regionColour(Mat &grey, Mat &lab, Mat &mask, Mat &channel, ERStat &er)
+{
+    Mat region = mask(Rect(Point(er.rect.x,er.rect.y),
+                           Point(er.rect.br().x+2,er.rect.br().y+2)));
     region = Scalar(0);
 
     int newMaskVal = 255;
     int flags = 4 + (newMaskVal << 8) + FLOODFILL_FIXED_RANGE + FLOODFILL_MASK_ONLY;
     Rect rect;
 
-    floodFill( channels[idx1[0]](Rect(Point(i->rect.x,i->rect.y),Point(i->rect.br().x,i->rect.br().y))),
-               region, Point(i->pixel%grey.cols - i->rect.x, i->pixel/grey.cols - i->rect.y),
-               Scalar(255), &rect, Scalar(i->level), Scalar(0), flags);
-    rect.width += 2;
-    rect.height += 2;
-    Mat rect_mask = mask(Rect(i->rect.x+1,i->rect.y+1,i->rect.width,i->rect.height));
+    floodFill( channel(Rect(Point(er.rect.x,er.rect.y),Point(er.rect.br().x,er.rect.br().y))),
+               region, Point(er.pixel%grey.cols - er.rect.x, er.pixel/grey.cols - er.rect.y),
+               Scalar(255), &rect, Scalar(er.level), Scalar(0), flags);
+    Mat rect_mask = mask(Rect(er.rect.x+1,er.rect.y+1,er.rect.width,er.rect.height));
 
+    region_colour colour;
     Scalar mean,std;
-    meanStdDev(grey(i->rect),mean,std,rect_mask);
-    int grey_mean1 = (int)mean[0];
-    meanStdDev(lab(i->rect),mean,std,rect_mask);
-    float a_mean1 = (float)mean[1];
-    float b_mean1 = (float)mean[2];
-
-    region = mask(Rect(Point(j->rect.x,j->rect.y),
-                           Point(j->rect.br().x+2,j->rect.br().y+2)));
-    region = Scalar(0);
-
-    floodFill( channels[idx2[0]](Rect(Point(j->rect.x,j->rect.y),Point(j->rect.br().x,j->rect.br().y))),
-               region, Point(j->pixel%grey.cols - j->rect.x, j->pixel/grey.cols - j->rect.y),
-               Scalar(255), &rect, Scalar(j->level), Scalar(0), flags);
-    rect.width += 2;
-    rect.height += 2;
-    rect_mask = mask(Rect(j->rect.x+1,j->rect.y+1,j->rect.width,j->rect.height));
-
-    meanStdDev(grey(j->rect),mean,std,rect_mask);
-    int grey_mean2 = (int)mean[0];
-    meanStdDev(lab(j->rect),mean,std,rect_mask);
-    float a_mean2 = (float)mean[1];
-    float b_mean2 = (float)mean[2];
+    meanStdDev(grey(er.rect),mean,std,rect_mask);
+    colour.grey_mean = (int)mean[0];
+    meanStdDev(lab(er.rect),mean,std,rect_mask);
+    colour.a_mean = (float)mean[1];
+    colour.b_mean = (float)mean[2];
+    return colour;
+}
 
-    if (abs(grey_mean1-grey_mean2) > PAIR_MAX_INTENSITY_DIST)
+// Evaluates the colour part of the pair test
+static bool isValidPairColour(const region_colour &c1, const region_colour &c2)
+{
+    if (abs(c1.grey_mean-c2.grey_mean) > PAIR_MAX_INTENSITY_DIST)
       return false;
 
-    if (sqrt(pow(a_mean1-a_mean2,2)+pow(b_mean1-b_mean2,2)) > PAIR_MAX_AB_DIST)
+    if (sqrt(pow(c1.a_mean-c2.a_mean,2)+pow(c1.b_mean-c2.b_mean,2)) > PAIR_MAX_AB_DIST)
       return false;
 
+    return true;
+}
 
+// Evaluates if a pair of regions is valid or not
+// using thresholds learned on training (defined above)
+bool isValidPair(Mat &grey, Mat &lab, Mat &mask, vector<Mat> &channels, vector< vector<ERStat> >& regions, Vec2i idx1, Vec2i idx2)
+{
+    if (!isValidPairGeometry(regions, idx1, idx2))
+        return false;
 
-    return true;
+    region_colour colour1 = regionColour(grey, lab, mask, channels[idx1[0]], regions[idx1[0]][idx1[1]]);
+    region_colour colour2 = regionColour(grey, lab, mask, channels[idx2[0]], regions[idx2[0]][idx2[1]]);
+
+    return isValidPairColour(colour1, colour2);
 }
 
 // Evaluates if a set of 3 regions is valid or not
@@ -3733,347 +3812,486 @@ bool haveCommonRegion(region_sequence &sequence1, region_sequence &sequence2)
 bool sort_couples (Vec3i i,Vec3i j);
 bool sort_couples (Vec3i i,Vec3i j) { return (i[0]<j[0]); }
 
-/*!
-    Find groups of Extremal Regions that are organized as text lines. This function implements
-    the grouping algorithm described in:
-    Neumann L., Matas J.: Real-Time Scene Text Localization and Recognition, CVPR 2012
-    Neumann L., Matas J.: A method for text localization and detection, ACCV 2010
-
-    \param  _img           Original RGB image from wich the regions were extracted.
-    \param  _src           Vector of sinle channel images CV_8UC1 from wich the regions were extracted.
-    \param  regions        Vector of ER's retreived from the ERFilter algorithm from each channel
-    \param  out_groups     The output of the algorithm are stored in this parameter as list of indexes to provided regions.
-    \param  out_boxes      The output of the algorithm are stored in this parameter as list of rectangles.
-    \param  do_feedback    Whenever the grouping algorithm uses a feedback loop to recover missing regions in a line.
-*/
-
-void erGroupingNM(InputArray _img, InputArrayOfArrays _src, vector< vector<ERStat> >& regions,
-                  vector< vector<Vec2i> >& out_groups, vector<Rect>& out_boxes, bool do_feedback_loop)
+// For every region i of a channel, finds the regions j>i that pass the geometric pair test
+class PairCandidatesInvoker : public ParallelLoopBody
 {
+public:
+    PairCandidatesInvoker(vector< vector<ERStat> >& _regions, const vector<Vec2i>& _all_regions,
+                          vector< vector<int> >& _candidates)
+        : regions(_regions), all_regions(_all_regions), candidates(_candidates) {}
 
-    vector<Mat> src;
-    _src.getMatVector(src);
+    virtual void operator()(const Range& range) const
+    {
+        for (int i=range.start; i<range.end; i++)
+        {
+            for (size_t j=i+1; j<all_regions.size(); j++)
+            {
+                // check height ratio, centroid angle and region distance normalized by region width
+                // fall within a given interval
+                if (isValidPairGeometry(regions, all_regions[i], all_regions[j]))
+                    candidates[i].push_back((int)j);
+            }
+        }
+    }
 
-    CV_Assert ( !src.empty() );
-    //CV_Assert ( src.size() == regions.size() );
-    size_t num_channels = src.size();
+private:
+    vector< vector<ERStat> >& regions;
+    const vector<Vec2i>& all_regions;
+    vector< vector<int> >& candidates;
+};
 
-    Mat img = _img.getMat();
+// Computes the colour of a list of regions of a channel, each stripe uses its own scratch mask
+class RegionColourInvoker : public ParallelLoopBody
+{
+public:
+    RegionColourInvoker(Mat& _grey, Mat& _lab, Mat& _channel, vector<ERStat>& _channel_regions,
+                        const vector<int>& _indices, vector<region_colour>& _colours)
+        : grey(_grey), lab(_lab), channel(_channel), channel_regions(_channel_regions),
+          indices(_indices), colours(_colours) {}
 
-    //process each channel independently
-    for(size_t c=0; c<num_channels; c++)
+    virtual void operator()(const Range& range) const
     {
-        //store indices to regions in a single vector
-        vector< Vec2i > all_regions;
-        for(size_t r=0; r<regions[c].size(); r++)
-        {
-            all_regions.push_back(Vec2i((int)c,(int)r));
-        }
+        // regionColour clears the part of the mask it uses, no need to initialize it
+        Mat mask(grey.rows+2, grey.cols+2, CV_8UC1);
+        for (int k=range.start; k<range.end; k++)
+            colours[indices[k]] = regionColour(grey, lab, mask, channel, channel_regions[indices[k]]);
+    }
+
+private:
+    Mat& grey;
+    Mat& lab;
+    Mat& channel;
+    vector<ERStat>& channel_regions;
+    const vector<int>& indices;
+    vector<region_colour>& colours;
+};
 
-        vector< region_pair > valid_pairs;
-        Mat mask = Mat::zeros(img.rows+2, img.cols+2, CV_8UC1);
-        Mat grey,lab;
-        cvtColor(img, lab, COLOR_RGB2Lab);
-        cvtColor(img, grey, COLOR_RGB2GRAY);
+// Selects the valid pairs of every region i of a channel among its geometric candidates.
+// Each i only looks at its own candidates, so the pairs of different i's can be found
+// concurrently and concatenated in i order afterwards.
+class ValidPairsInvoker : public ParallelLoopBody
+{
+public:
+    ValidPairsInvoker(vector< vector<ERStat> >& _regions, const vector<Vec2i>& _all_regions,
+                      const vector< vector<int> >& _candidates, const vector<region_colour>& _colours,
+                      vector< vector<region_pair> >& _pairs)
+        : regions(_regions), all_regions(_all_regions), candidates(_candidates),
+          colours(_colours), pairs(_pairs) {}
 
-        //check every possible pair of regions
-        for (size_t i=0; i<all_regions.size(); i++)
+    virtual void operator()(const Range& range) const
+    {
+        for (int i=range.start; i<range.end; i++)
         {
+            vector<region_pair> &valid_pairs = pairs[i];
             vector<int> i_siblings;
-            int first_i_sibling_idx = (int)valid_pairs.size();
-            for (size_t j=i+1; j<all_regions.size(); j++)
+            for (size_t n=0; n<candidates[i].size(); n++)
             {
-                // check height ratio, centroid angle and region distance normalized by region width
-                // fall within a given interval
-                if (isValidPair(grey, lab, mask, src, regions, all_regions[i],all_regions[j]))
+                int j = candidates[i][n];
+                if (!isValidPairColour(colours[i], colours[j]))
+                    continue;
+
+                bool isCycle = false;
+                for (size_t k=0; k<i_siblings.size(); k++)
                 {
-                    bool isCycle = false;
-                    for (size_t k=0; k<i_siblings.size(); k++)
-                    {
-                      if (isValidPair(grey, lab, mask, src, regions, all_regions[j],all_regions[i_siblings[k]]))
-                      {
-                        // choose as sibling the closer and not the first that was "paired" with i
-                        Point i_center = Point( regions[all_regions[i][0]][all_regions[i][1]].rect.x +
-                                                regions[all_regions[i][0]][all_regions[i][1]].rect.width/2,
-                                                regions[all_regions[i][0]][all_regions[i][1]].rect.y +
-                                                regions[all_regions[i][0]][all_regions[i][1]].rect.height/2 );
-                        Point j_center = Point( regions[all_regions[j][0]][all_regions[j][1]].rect.x +
-                                                regions[all_regions[j][0]][all_regions[j][1]].rect.width/2,
-                                                regions[all_regions[j][0]][all_regions[j][1]].rect.y +
-                                                regions[all_regions[j][0]][all_regions[j][1]].rect.height/2 );
-                        Point k_center = Point( regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.x +
-                                                regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.width/2,
-                                                regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.y +
-                                                regions[all_regions[i_siblings[k]][0]][all_regions[i_siblings[k]][1]].rect.height/2 );
-
-                        if ( norm(i_center - j_center) < norm(i_center - k_center) )
-                        {
-                          valid_pairs[first_i_sibling_idx+k] = region_pair(all_regions[i],all_regions[j]);
-                          i_siblings[k] = (int)j;
-                        }
-                        isCycle = true;
-                        break;
-                      }
-                    }
-                    if (!isCycle)
+                  int s = i_siblings[k];
+                  if (isValidPairGeometry(regions, all_regions[j], all_regions[s]) &&
+                      isValidPairColour(colours[j], colours[s]))
+                  {
+                    // choose as sibling the closer and not the first that was "paired" with i
+                    const Rect &ri = regions[all_regions[i][0]][all_regions[i][1]].rect;
+                    const Rect &rj = regions[all_regions[j][0]][all_regions[j][1]].rect;
+                    const Rect &rk = regions[all_regions[s][0]][all_regions[s][1]].rect;
+                    Point i_center = Point( ri.x + ri.width/2, ri.y + ri.height/2 );
+                    Point j_center = Point( rj.x + rj.width/2, rj.y + rj.height/2 );
+                    Point k_center = Point( rk.x + rk.width/2, rk.y + rk.height/2 );
+
+                    if ( norm(i_center - j_center) < norm(i_center - k_center) )
                     {
-                      valid_pairs.push_back(region_pair(all_regions[i],all_regions[j]));
-                      i_siblings.push_back((int)j);
-                      //cout << "Valid pair (" << all_regions[i][0] << ","  << all_regions[i][1] << ") (" << all_regions[j][0] << ","  << all_regions[j][1] << ")" << endl;
+                      valid_pairs[k] = region_pair(all_regions[i],all_regions[j]);
+                      i_siblings[k] = j;
                     }
+                    isCycle = true;
+                    break;
+                  }
+                }
+                if (!isCycle)
+                {
+                  valid_pairs.push_back(region_pair(all_regions[i],all_regions[j]));
+                  i_siblings.push_back(j);
                 }
             }
         }
+    }
+
+private:
+    vector< vector<ERStat> >& regions;
+    const vector<Vec2i>& all_regions;
+    const vector< vector<int> >& candidates;
+    const vector<region_colour>& colours;
+    vector< vector<region_pair> >& pairs;
+};
+
+// Runs the grouping on the regions of channel c. The feedback loop only appends to regions[c],
+// so different channels can be processed concurrently.
+static void erGroupingNMChannel(Mat &grey, Mat &lab, vector<Mat> &src, vector< vector<ERStat> >& regions, size_t c,
+                                vector< vector<Vec2i> >& out_groups, vector<Rect>& out_boxes, bool do_feedback_loop)
+{
+    //store indices to regions in a single vector
+    vector< Vec2i > all_regions;
+    for(size_t r=0; r<regions[c].size(); r++)
+    {
+        all_regions.push_back(Vec2i((int)c,(int)r));
+    }
+
+    //check every possible pair of regions, the geometric test is cheap so it goes first and
+    //the colour of every region involved in a candidate pair is computed only once
+    vector< vector<int> > candidates(all_regions.size());
+    parallel_for_(Range(0,(int)all_regions.size()), PairCandidatesInvoker(regions, all_regions, candidates));
+
+    vector<int> coloured;
+    vector<bool> needs_colour(all_regions.size(), false);
+    for (size_t i=0; i<candidates.size(); i++)
+    {
+        if (!candidates[i].empty())
+            needs_colour[i] = true;
+        for (size_t n=0; n<candidates[i].size(); n++)
+            needs_colour[candidates[i][n]] = true;
+    }
+    for (size_t i=0; i<needs_colour.size(); i++)
+        if (needs_colour[i])
+            coloured.push_back((int)i);
+
+    vector<region_colour> colours(all_regions.size());
+    parallel_for_(Range(0,(int)coloured.size()),
+                  RegionColourInvoker(grey, lab, src[c], regions[c], coloured, colours),
+                  (double)getNumThreads());
+
+    vector< vector<region_pair> > i_pairs(all_regions.size());
+    parallel_for_(Range(0,(int)all_regions.size()),
+                  ValidPairsInvoker(regions, all_regions, candidates, colours, i_pairs));
+
+    vector< region_pair > valid_pairs;
+    for (size_t i=0; i<i_pairs.size(); i++)
+        valid_pairs.insert(valid_pairs.end(), i_pairs[i].begin(), i_pairs[i].end());
 
-        //cout << "GroupingNM : detected " << valid_pairs.size() << " valid pairs" << endl;
+    //cout << "GroupingNM : detected " << valid_pairs.size() << " valid pairs" << endl;
 
-        vector< region_triplet > valid_triplets;
+    vector< region_triplet > valid_triplets;
 
-        //check every possible triplet of regions
-        for (size_t i=0; i<valid_pairs.size(); i++)
+    //check every possible triplet of regions
+    for (size_t i=0; i<valid_pairs.size(); i++)
+    {
+        for (size_t j=i+1; j<valid_pairs.size(); j++)
         {
-            for (size_t j=i+1; j<valid_pairs.size(); j++)
+            // check colinearity rules
+            region_triplet valid_triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
+            if (isValidTriplet(regions, valid_pairs[i],valid_pairs[j], valid_triplet))
             {
-                // check colinearity rules
-                region_triplet valid_triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
-                if (isValidTriplet(regions, valid_pairs[i],valid_pairs[j], valid_triplet))
-                {
-                    valid_triplets.push_back(valid_triplet);
-                    //cout << "Valid triplet (" << valid_triplet.a[1] << "," <<  valid_triplet.b[1] << "," <<  valid_triplet.c[1] << ")" << endl;
-                }
+                valid_triplets.push_back(valid_triplet);
+                //cout << "Valid triplet (" << valid_triplet.a[1] << "," <<  valid_triplet.b[1] << "," <<  valid_triplet.c[1] << ")" << endl;
             }
         }
+    }
 
-        //cout << "GroupingNM : detected " << valid_triplets.size() << " valid triplets" << endl;
+    //cout << "GroupingNM : detected " << valid_triplets.size() << " valid triplets" << endl;
 
-        vector<region_sequence> valid_sequences;
-        vector<region_sequence> pending_sequences;
+    vector<region_sequence> valid_sequences;
+    vector<region_sequence> pending_sequences;
 
-        for (size_t i=0; i<valid_triplets.size(); i++)
-        {
-            pending_sequences.push_back(region_sequence(valid_triplets[i]));
-        }
+    for (size_t i=0; i<valid_triplets.size(); i++)
+    {
+        pending_sequences.push_back(region_sequence(valid_triplets[i]));
+    }
 
 
-        for (size_t i=0; i<pending_sequences.size(); i++)
+    for (size_t i=0; i<pending_sequences.size(); i++)
+    {
+        bool expanded = false;
+        for (size_t j=i+1; j<pending_sequences.size(); j++)
         {
-            bool expanded = false;
-            for (size_t j=i+1; j<pending_sequences.size(); j++)
+            if (isValidSequence(pending_sequences[i], pending_sequences[j]))
             {
-                if (isValidSequence(pending_sequences[i], pending_sequences[j]))
-                {
-                    expanded = true;
-                    pending_sequences[i].triplets.insert(pending_sequences[i].triplets.begin(), pending_sequences[j].triplets.begin(), pending_sequences[j].triplets.end());
-                    pending_sequences.erase(pending_sequences.begin()+j);
-                    j--;
-                }
-            }
-            if (expanded)
-            {
-                valid_sequences.push_back(pending_sequences[i]);
+                expanded = true;
+                pending_sequences[i].triplets.insert(pending_sequences[i].triplets.begin(), pending_sequences[j].triplets.begin(), pending_sequences[j].triplets.end());
+                pending_sequences.erase(pending_sequences.begin()+j);
+                j--;
             }
         }
+        if (expanded)
+        {
+            valid_sequences.push_back(pending_sequences[i]);
+        }
+    }
 
-        // remove a sequence if one its regions is already grouped within a longer seq
-        for (size_t i=0; i<valid_sequences.size(); i++)
+    // remove a sequence if one its regions is already grouped within a longer seq
+    for (size_t i=0; i<valid_sequences.size(); i++)
+    {
+        for (size_t j=i+1; j<valid_sequences.size(); j++)
         {
-            for (size_t j=i+1; j<valid_sequences.size(); j++)
+          if (haveCommonRegion(valid_sequences[i],valid_sequences[j]))
+          {
+            if (valid_sequences[i].triplets.size() < valid_sequences[j].triplets.size())
             {
-              if (haveCommonRegion(valid_sequences[i],valid_sequences[j]))
-              {
-                if (valid_sequences[i].triplets.size() < valid_sequences[j].triplets.size())
-                {
-                  valid_sequences.erase(valid_sequences.begin()+i);
-                  i--;
-                  break;
-                }
-                else
-                {
-                  valid_sequences.erase(valid_sequences.begin()+j);
-                  j--;
-                }
-              }
+              valid_sequences.erase(valid_sequences.begin()+i);
+              i--;
+              break;
+            }
+            else
+            {
+              valid_sequences.erase(valid_sequences.begin()+j);
+              j--;
             }
+          }
         }
+    }
+
 
+    //cout << "GroupingNM : detected " << valid_sequences.size() << " sequences." << endl;
 
-        //cout << "GroupingNM : detected " << valid_sequences.size() << " sequences." << endl;
+    if (do_feedback_loop)
+    {
+        Mat mask = Mat::zeros(grey.rows+2, grey.cols+2, CV_8UC1);
 
-        if (do_feedback_loop)
+        //Feedback loop of detected lines to region extraction ... tries to recover missmatches in the region decomposition step by extracting regions in the neighbourhood of a valid sequence and checking if they are consistent with its line estimates
+        Ptr<ERFilter> er_filter = createERFilterNM1(loadDummyClassifier(),1,0.005f,0.3f,0.f,false);
+        for (int i=0; i<(int)valid_sequences.size(); i++)
         {
+            vector<Point> bbox_points;
 
-            //Feedback loop of detected lines to region extraction ... tries to recover missmatches in the region decomposition step by extracting regions in the neighbourhood of a valid sequence and checking if they are consistent with its line estimates
-            Ptr<ERFilter> er_filter = createERFilterNM1(loadDummyClassifier(),1,0.005f,0.3f,0.f,false);
-            for (int i=0; i<(int)valid_sequences.size(); i++)
+            for (size_t j=0; j<valid_sequences[i].triplets.size(); j++)
             {
-                vector<Point> bbox_points;
+                bbox_points.push_back(regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.tl());
+                bbox_points.push_back(regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.br());
+                bbox_points.push_back(regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.tl());
+                bbox_points.push_back(regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.br());
+                bbox_points.push_back(regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.tl());
+                bbox_points.push_back(regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.br());
+            }
 
-                for (size_t j=0; j<valid_sequences[i].triplets.size(); j++)
-                {
-                    bbox_points.push_back(regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.tl());
-                    bbox_points.push_back(regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.br());
-                    bbox_points.push_back(regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.tl());
-                    bbox_points.push_back(regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.br());
-                    bbox_points.push_back(regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.tl());
-                    bbox_points.push_back(regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.br());
-                }
+            Rect rect = boundingRect(bbox_points);
+            rect.x = max(rect.x-10,0);
+            rect.y = max(rect.y-10,0);
+            rect.width = min(rect.width+20,src[c].cols-rect.x);
+            rect.height = min(rect.height+20,src[c].rows-rect.y);
 
-                Rect rect = boundingRect(bbox_points);
-                rect.x = max(rect.x-10,0);
-                rect.y = max(rect.y-10,0);
-                rect.width = min(rect.width+20,src[c].cols-rect.x);
-                rect.height = min(rect.height+20,src[c].rows-rect.y);
+            vector<ERStat> aux_regions;
+            Mat tmp;
+            src[c](rect).copyTo(tmp);
+            er_filter->run(tmp, aux_regions);
 
-                vector<ERStat> aux_regions;
-                Mat tmp;
-                src[c](rect).copyTo(tmp);
-                er_filter->run(tmp, aux_regions);
+            for(size_t r=0; r<aux_regions.size(); r++)
+            {
+                if ((aux_regions[r].rect.y == 0)||(aux_regions[r].rect.br().y >= tmp.rows))
+                  continue;
 
-                for(size_t r=0; r<aux_regions.size(); r++)
+                aux_regions[r].rect   = aux_regions[r].rect + Point(rect.x,rect.y);
+                aux_regions[r].pixel  = ((aux_regions[r].pixel/tmp.cols)+rect.y)*src[c].cols + (aux_regions[r].pixel%tmp.cols) + rect.x;
+                bool overlaps = false;
+                for (size_t j=0; j<valid_sequences[i].triplets.size(); j++)
                 {
-                    if ((aux_regions[r].rect.y == 0)||(aux_regions[r].rect.br().y >= tmp.rows))
-                      continue;
+                    Rect minarearect_a  = regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect | aux_regions[r].rect;
+                    Rect minarearect_b  = regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect | aux_regions[r].rect;
+                    Rect minarearect_c  = regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect | aux_regions[r].rect;
+
+                    // Overlapping regions are not valid pair in any case
+                    if ( (minarearect_a == aux_regions[r].rect) ||
+                         (minarearect_b == aux_regions[r].rect) ||
+                         (minarearect_c == aux_regions[r].rect) ||
+                         (minarearect_a == regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect) ||
+                         (minarearect_b == regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect) ||
+                         (minarearect_c == regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect) )
 
-                    aux_regions[r].rect   = aux_regions[r].rect + Point(rect.x,rect.y);
-                    aux_regions[r].pixel  = ((aux_regions[r].pixel/tmp.cols)+rect.y)*src[c].cols + (aux_regions[r].pixel%tmp.cols) + rect.x;
-                    bool overlaps = false;
+                    {
+                        overlaps = true;
+                        break;
+                    }
+                }
+                if (!overlaps)
+                {
+                    //now check if it has at least one valid pair
+                    vector<Vec3i> left_couples, right_couples;
+                    regions[c].push_back(aux_regions[r]);
                     for (size_t j=0; j<valid_sequences[i].triplets.size(); j++)
                     {
-                        Rect minarearect_a  = regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect | aux_regions[r].rect;
-                        Rect minarearect_b  = regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect | aux_regions[r].rect;
-                        Rect minarearect_c  = regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect | aux_regions[r].rect;
-
-                        // Overlapping regions are not valid pair in any case
-                        if ( (minarearect_a == aux_regions[r].rect) ||
-                             (minarearect_b == aux_regions[r].rect) ||
-                             (minarearect_c == aux_regions[r].rect) ||
-                             (minarearect_a == regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect) ||
-                             (minarearect_b == regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect) ||
-                             (minarearect_c == regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect) )
-
+                        if (isValidPair(grey, lab, mask, src, regions, valid_sequences[i].triplets[j].a, Vec2i((int)c,(int)(regions[c].size())-1)))
                         {
-                            overlaps = true;
-                            break;
+                            if (regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.x > aux_regions[r].rect.x)
+                                right_couples.push_back(Vec3i(regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.x - aux_regions[r].rect.x, valid_sequences[i].triplets[j].a[0],valid_sequences[i].triplets[j].a[1]));
+                            else
+                                left_couples.push_back(Vec3i(aux_regions[r].rect.x - regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.x, valid_sequences[i].triplets[j].a[0],valid_sequences[i].triplets[j].a[1]));
                         }
-                    }
-                    if (!overlaps)
-                    {
-                        //now check if it has at least one valid pair
-                        vector<Vec3i> left_couples, right_couples;
-                        regions[c].push_back(aux_regions[r]);
-                        for (size_t j=0; j<valid_sequences[i].triplets.size(); j++)
+                        if (isValidPair(grey, lab, mask, src, regions, valid_sequences[i].triplets[j].b, Vec2i((int)c,(int)(regions[c].size())-1)))
                         {
-                            if (isValidPair(grey, lab, mask, src, regions, valid_sequences[i].triplets[j].a, Vec2i((int)c,(int)(regions[c].size())-1)))
-                            {
-                                if (regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.x > aux_regions[r].rect.x)
-                                    right_couples.push_back(Vec3i(regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.x - aux_regions[r].rect.x, valid_sequences[i].triplets[j].a[0],valid_sequences[i].triplets[j].a[1]));
-                                else
-                                    left_couples.push_back(Vec3i(aux_regions[r].rect.x - regions[valid_sequences[i].triplets[j].a[0]][valid_sequences[i].triplets[j].a[1]].rect.x, valid_sequences[i].triplets[j].a[0],valid_sequences[i].triplets[j].a[1]));
-                            }
-                            if (isValidPair(grey, lab, mask, src, regions, valid_sequences[i].triplets[j].b, Vec2i((int)c,(int)(regions[c].size())-1)))
-                            {
-                                if (regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.x > aux_regions[r].rect.x)
-                                    right_couples.push_back(Vec3i(regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.x - aux_regions[r].rect.x, valid_sequences[i].triplets[j].b[0],valid_sequences[i].triplets[j].b[1]));
-                                else
-                                    left_couples.push_back(Vec3i(aux_regions[r].rect.x - regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.x, valid_sequences[i].triplets[j].b[0],valid_sequences[i].triplets[j].b[1]));
-                            }
-                            if (isValidPair(grey, lab, mask, src, regions, valid_sequences[i].triplets[j].c, Vec2i((int)c,(int)(regions[c].size())-1)))
-                            {
-                                if (regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.x > aux_regions[r].rect.x)
-                                    right_couples.push_back(Vec3i(regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.x - aux_regions[r].rect.x, valid_sequences[i].triplets[j].c[0],valid_sequences[i].triplets[j].c[1]));
-                                else
-                                    left_couples.push_back(Vec3i(aux_regions[r].rect.x - regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.x, valid_sequences[i].triplets[j].c[0],valid_sequences[i].triplets[j].c[1]));
-                            }
+                            if (regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.x > aux_regions[r].rect.x)
+                                right_couples.push_back(Vec3i(regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.x - aux_regions[r].rect.x, valid_sequences[i].triplets[j].b[0],valid_sequences[i].triplets[j].b[1]));
+                            else
+                                left_couples.push_back(Vec3i(aux_regions[r].rect.x - regions[valid_sequences[i].triplets[j].b[0]][valid_sequences[i].triplets[j].b[1]].rect.x, valid_sequences[i].triplets[j].b[0],valid_sequences[i].triplets[j].b[1]));
                         }
-
-                        //make it part of a triplet and check if line estimates is consistent with the sequence
-                        vector<region_triplet> new_valid_triplets;
-                        if(!left_couples.empty() && !right_couples.empty())
+                        if (isValidPair(grey, lab, mask, src, regions, valid_sequences[i].triplets[j].c, Vec2i((int)c,(int)(regions[c].size())-1)))
                         {
-                            sort(left_couples.begin(), left_couples.end(), sort_couples);
-                            sort(right_couples.begin(), right_couples.end(), sort_couples);
-                            region_pair pair1(Vec2i(left_couples[0][1],left_couples[0][2]),Vec2i((int)c,(int)(regions[c].size())-1));
-                            region_pair pair2(Vec2i((int)c,(int)(regions[c].size())-1), Vec2i(right_couples[0][1],right_couples[0][2]));
-                            region_triplet triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
-                            if (isValidTriplet(regions, pair1, pair2, triplet))
-                            {
-                                new_valid_triplets.push_back(triplet);
-                            }
+                            if (regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.x > aux_regions[r].rect.x)
+                                right_couples.push_back(Vec3i(regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.x - aux_regions[r].rect.x, valid_sequences[i].triplets[j].c[0],valid_sequences[i].triplets[j].c[1]));
+                            else
+                                left_couples.push_back(Vec3i(aux_regions[r].rect.x - regions[valid_sequences[i].triplets[j].c[0]][valid_sequences[i].triplets[j].c[1]].rect.x, valid_sequences[i].triplets[j].c[0],valid_sequences[i].triplets[j].c[1]));
                         }
-                        else if (right_couples.size() >= 2)
+                    }
+
+                    //make it part of a triplet and check if line estimates is consistent with the sequence
+                    vector<region_triplet> new_valid_triplets;
+                    if(!left_couples.empty() && !right_couples.empty())
+                    {
+                        sort(left_couples.begin(), left_couples.end(), sort_couples);
+                        sort(right_couples.begin(), right_couples.end(), sort_couples);
+                        region_pair pair1(Vec2i(left_couples[0][1],left_couples[0][2]),Vec2i((int)c,(int)(regions[c].size())-1));
+                        region_pair pair2(Vec2i((int)c,(int)(regions[c].size())-1), Vec2i(right_couples[0][1],right_couples[0][2]));
+                        region_triplet triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
+                        if (isValidTriplet(regions, pair1, pair2, triplet))
                         {
-                            sort(right_couples.begin(), right_couples.end(), sort_couples);
-                            region_pair pair1(Vec2i((int)c,(int)(regions[c].size())-1), Vec2i(right_couples[0][1],right_couples[0][2]));
-                            region_pair pair2(Vec2i(right_couples[0][1],right_couples[0][2]), Vec2i(right_couples[1][1],right_couples[1][2]));
-                            region_triplet triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
-                            if (isValidTriplet(regions, pair1, pair2, triplet))
-                            {
-                                new_valid_triplets.push_back(triplet);
-                            }
+                            new_valid_triplets.push_back(triplet);
                         }
-                        else if (left_couples.size() >=2)
+                    }
+                    else if (right_couples.size() >= 2)
+                    {
+                        sort(right_couples.begin(), right_couples.end(), sort_couples);
+                        region_pair pair1(Vec2i((int)c,(int)(regions[c].size())-1), Vec2i(right_couples[0][1],right_couples[0][2]));
+                        region_pair pair2(Vec2i(right_couples[0][1],right_couples[0][2]), Vec2i(right_couples[1][1],right_couples[1][2]));
+                        region_triplet triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
+                        if (isValidTriplet(regions, pair1, pair2, triplet))
                         {
-                            sort(left_couples.begin(), left_couples.end(), sort_couples);
-                            region_pair pair1(Vec2i(left_couples[1][1],left_couples[1][2]), Vec2i(left_couples[0][1],left_couples[0][2]));
-                            region_pair pair2(Vec2i(left_couples[0][1],left_couples[0][2]),Vec2i((int)c,(int)(regions[c].size())-1));
-                            region_triplet triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
-                            if (isValidTriplet(regions, pair1, pair2, triplet))
-                            {
-                                new_valid_triplets.push_back(triplet);
-                            }
+                            new_valid_triplets.push_back(triplet);
                         }
-                        else
+                    }
+                    else if (left_couples.size() >=2)
+                    {
+                        sort(left_couples.begin(), left_couples.end(), sort_couples);
+                        region_pair pair1(Vec2i(left_couples[1][1],left_couples[1][2]), Vec2i(left_couples[0][1],left_couples[0][2]));
+                        region_pair pair2(Vec2i(left_couples[0][1],left_couples[0][2]),Vec2i((int)c,(int)(regions[c].size())-1));
+                        region_triplet triplet(Vec2i(0,0),Vec2i(0,0),Vec2i(0,0));
+                        if (isValidTriplet(regions, pair1, pair2, triplet))
                         {
-                            // no possible triplet found
-                            continue;
+                            new_valid_triplets.push_back(triplet);
                         }
+                    }
+                    else
+                    {
+                        // no possible triplet found
+                        continue;
+                    }
 
-                        //check if line estimates is consistent with the sequence
-                        for (size_t t=0; t<new_valid_triplets.size(); t++)
+                    //check if line estimates is consistent with the sequence
+                    for (size_t t=0; t<new_valid_triplets.size(); t++)
+                    {
+                        region_sequence sequence(new_valid_triplets[t]);
+                        if (isValidSequence(valid_sequences[i],sequence))
                         {
-                            region_sequence sequence(new_valid_triplets[t]);
-                            if (isValidSequence(valid_sequences[i],sequence))
-                            {
-                                valid_sequences[i].triplets.push_back(new_valid_triplets[t]);
-                            }
-
+                            valid_sequences[i].triplets.push_back(new_valid_triplets[t]);
                         }
+
                     }
                 }
             }
-
         }
 
+    }
+
 
-        // Prepare the sequences for output
-        for (size_t i=0; i<valid_sequences.size(); i++)
-        {
-            vector<Point> bbox_points;
-            vector<Vec2i> group_regions;
+    // Prepare the sequences for output
+    for (size_t i=0; i<valid_sequences.size(); i++)
+    {
+        vector<Point> bbox_points;
+        vector<Vec2i> group_regions;
 
-            for (size_t j=0; j<valid_sequences[i].triplets.size(); j++)
+        for (size_t j=0; j<valid_sequences[i].triplets.size(); j++)
+        {
+            size_t prev_size = group_regions.size();
+            if(find(group_regions.begin(), group_regions.end(), valid_sequences[i].triplets[j].a) == group_regions.end())
+              group_regions.push_back(valid_sequences[i].triplets[j].a);
+            if(find(group_regions.begin(), group_regions.end(), valid_sequences[i].triplets[j].b) == group_regions.end())
+              group_regions.push_back(valid_sequences[i].triplets[j].b);
+            if(find(group_regions.begin(), group_regions.end(), valid_sequences[i].triplets[j].c) == group_regions.end())
+              group_regions.push_back(valid_sequences[i].triplets[j].c);
+
+            for (size_t k=prev_size; k<group_regions.size(); k++)
             {
-                size_t prev_size = group_regions.size();
-                if(find(group_regions.begin(), group_regions.end(), valid_sequences[i].triplets[j].a) == group_regions.end())
-                  group_regions.push_back(valid_sequences[i].triplets[j].a);
-                if(find(group_regions.begin(), group_regions.end(), valid_sequences[i].triplets[j].b) == group_regions.end())
-                  group_regions.push_back(valid_sequences[i].triplets[j].b);
-                if(find(group_regions.begin(), group_regions.end(), valid_sequences[i].triplets[j].c) == group_regions.end())
-                  group_regions.push_back(valid_sequences[i].triplets[j].c);
-
-                for (size_t k=prev_size; k<group_regions.size(); k++)
-                {
-                    bbox_points.push_back(regions[group_regions[k][0]][group_regions[k][1]].rect.tl());
-                    bbox_points.push_back(regions[group_regions[k][0]][group_regions[k][1]].rect.br());
-                }
+                bbox_points.push_back(regions[group_regions[k][0]][group_regions[k][1]].rect.tl());
+                bbox_points.push_back(regions[group_regions[k][0]][group_regions[k][1]].rect.br());
             }
+        }
 
-            out_groups.push_back(group_regions);
-            out_boxes.push_back(boundingRect(bbox_points));
+        out_groups.push_back(group_regions);
+        out_boxes.push_back(boundingRect(bbox_points));
 
-        }
     }
+}
+
+class ERGroupingNMInvoker : public ParallelLoopBody
+{
+public:
+    ERGroupingNMInvoker(Mat& _grey, Mat& _lab, vector<Mat>& _src, vector< vector<ERStat> >& _regions,
+                        vector< vector< vector<Vec2i> > >& _groups, vector< vector<Rect> >& _boxes,
+                        bool _do_feedback_loop)
+        : grey(_grey), lab(_lab), src(_src), regions(_regions), groups(_groups), boxes(_boxes),
+          do_feedback_loop(_do_feedback_loop) {}
+
+    virtual void operator()(const Range& range) const
+    {
+        for (int c=range.start; c<range.end; c++)
+            erGroupingNMChannel(grey, lab, src, regions, (size_t)c, groups[c], boxes[c], do_feedback_loop);
+    }
+
+private:
+    Mat& grey;
+    Mat& lab;
+    vector<Mat>& src;
+    vector< vector<ERStat> >& regions;
+    vector< vector< vector<Vec2i> > >& groups;
+    vector< vector<Rect> >& boxes;
+    bool do_feedback_loop;
+};
+
+/*!
+    Find groups of Extremal Regions that are organized as text lines. This function implements
+    the grouping algorithm described in:
+    Neumann L., Matas J.: Real-Time Scene Text Localization and Recognition, CVPR 2012
+    Neumann L., Matas J.: A method for text localization and detection, ACCV 2010
+
+    \param  _img           Original RGB image from wich the regions were extracted.
+    \param  _src           Vector of sinle channel images CV_8UC1 from wich the regions were extracted.
+    \param  regions        Vector of ER's retreived from the ERFilter algorithm from each channel
+    \param  out_groups     The output of the algorithm are stored in this parameter as list of indexes to provided regions.
+    \param  out_boxes      The output of the algorithm are stored in this parameter as list of rectangles.
+    \param  do_feedback    Whenever the grouping algorithm uses a feedback loop to recover missing regions in a line.
+*/
+
+void erGroupingNM(InputArray _img, InputArrayOfArrays _src, vector< vector<ERStat> >& regions,
+                  vector< vector<Vec2i> >& out_groups, vector<Rect>& out_boxes, bool do_feedback_loop)
+{
+
+    vector<Mat> src;
+    _src.getMatVector(src);
+
+    CV_Assert ( !src.empty() );
+    //CV_Assert ( src.size() == regions.size() );
+    size_t num_channels = src.size();
+
+    Mat img = _img.getMat();
+
+    // the colour conversions do not depend on the channel, do them only once
+    Mat grey,lab;
+    cvtColor(img, lab, COLOR_RGB2Lab);
+    cvtColor(img, grey, COLOR_RGB2GRAY);
+
+    //process each channel independently, the groups are output in channel order
+    vector< vector< vector<Vec2i> > > channel_groups(num_channels);
+    vector< vector<Rect> > channel_boxes(num_channels);
+    parallel_for_(Range(0,(int)num_channels),
+                  ERGroupingNMInvoker(grey, lab, src, regions, channel_groups, channel_boxes, do_feedback_loop));
 
+    for (size_t c=0; c<num_channels; c++)
+    {
+        out_groups.insert(out_groups.end(), channel_groups[c].begin(), channel_groups[c].end());
+        out_boxes.insert(out_boxes.end(), channel_boxes[c].begin(), channel_boxes[c].end());
+    }
 }
 
 void erGrouping(InputArray image, InputArrayOfArrays channels, vector<vector<ERStat> > &regions,  vector<vector<Vec2i> > &groups,  vector<Rect> &groups_rects, int method, const string& filename, float minProbability)
@@ -4233,5 +4451,80 @@ void detectRegions(InputArray image, const Ptr<ERFilter>& er_filter1, const Ptr<
 
 }
 
+// Gives every channel its own copy of the filter, the counters and the region buffers of an
+// ERFilterNM are not shared between concurrent runs. The classifier callback is shared.
+static Ptr<ERFilter> cloneERFilter(const Ptr<ERFilter>& er_filter)
+{
+    if (er_filter.empty())
+        return er_filter;
+    ERFilterNM *nm = dynamic_cast<ERFilterNM*>(er_filter.get());
+    if (nm == NULL)
+        return Ptr<ERFilter>();
+    return makePtr<ERFilterNM>(*nm);
+}
+
+class DetectRegionsInvoker : public ParallelLoopBody
+{
+public:
+    DetectRegionsInvoker(vector<Mat>& _channels, const vector< Ptr<ERFilter> >& _filters1,
+                         const vector< Ptr<ERFilter> >& _filters2, vector< vector<ERStat> >& _regions)
+        : channels(_channels), filters1(_filters1), filters2(_filters2), regions(_regions) {}
+
+    virtual void operator()(const Range& range) const
+    {
+        for (int c=range.start; c<range.end; c++)
+        {
+            filters1[c]->run(channels[c], regions[c]);
+            if (!filters2[c].empty())
+                filters2[c]->run(channels[c], regions[c]);
+        }
+    }
+
+private:
+    vector<Mat>& channels;
+    const vector< Ptr<ERFilter> >& filters1;
+    const vector< Ptr<ERFilter> >& filters2;
+    vector< vector<ERStat> >& regions;
+};
+
+// Extracts the ERs of every channel, the channels are processed concurrently
+void detectRegions(InputArrayOfArrays _channels, const Ptr<ERFilter>& er_filter1, const Ptr<ERFilter>& er_filter2,
+                   vector< vector<ERStat> >& regions)
+{
+    vector<Mat> channels;
+    _channels.getMatVector(channels);
+
+    // at least one ERFilter must be passed
+    CV_Assert( !er_filter1.empty() );
+    for (size_t c=0; c<channels.size(); c++)
+        CV_Assert( channels[c].type() == CV_8UC1 );
+
+    regions.clear();
+    regions.resize(channels.size());
+
+    vector< Ptr<ERFilter> > filters1(channels.size()), filters2(channels.size());
+    bool cloned = true;
+    for (size_t c=0; (c<channels.size()) && cloned; c++)
+    {
+        filters1[c] = cloneERFilter(er_filter1);
+        filters2[c] = cloneERFilter(er_filter2);
+        cloned = !filters1[c].empty() && (filters2[c].empty() == er_filter2.empty());
+    }
+
+    if (!cloned)
+    {
+        // user defined filters can not be copied, run them sequentially
+        for (size_t c=0; c<channels.size(); c++)
+        {
+            er_filter1->run(channels[c], regions[c]);
+            if (!er_filter2.empty())
+                er_filter2->run(channels[c], regions[c]);
+        }
+        return;
+    }
+
+    parallel_for_(Range(0,(int)channels.size()), DetectRegionsInvoker(channels, filters1, filters2, regions));
+}
+
 }
 }
@@ -47,6 +47,7 @@
 #include <iostream>
 #include <fstream>
 #include <set>
+#include <map>
 
 namespace cv
 {
@@ -144,12 +145,17 @@ struct beamSearch_node {
     double score;
     vector<int> segmentation;
     bool expanded;
-    // TODO calculating score of its childs would be much faster if we store the last column
-    //      of their "root" path.
 };
 
-bool beam_sort_function ( beamSearch_node a, beamSearch_node b );
-bool beam_sort_function ( beamSearch_node a, beamSearch_node b )
+// Last column of the Viterbi table of a segmentation: the best log probability of the paths
+// ending in each character, and the character preceding it in that path
+struct viterbi_state {
+    vector<double> V;
+    vector<int> back;
+};
+
+bool beam_sort_function ( const beamSearch_node &a, const beamSearch_node &b );
+bool beam_sort_function ( const beamSearch_node &a, const beamSearch_node &b )
 {
     return (a.score > b.score);
 }
@@ -229,6 +235,10 @@ public:
         }
 
 
+        // nothing is kept from a previous word
+        beam.clear();
+        viterbi_cache.clear();
+
         // TODO if input is a text line (not a word) we may need to split into words here!
 
         // do sliding window classification along a croped word image
@@ -278,6 +288,9 @@ public:
           i++;
         }
 
+        // NMS may leave a single window (e.g. one-letter words), there are no pairs to search
+        if (recognition_probabilities.size() < 2) return;
+
         /*Now we go with the beam search algorithm to optimize the recognition score*/
 
         //convert probabilities to log probabilities
@@ -302,19 +315,18 @@ public:
             beamSearch_node node;
             node.segmentation.push_back((int)i);
             node.segmentation.push_back((int)j);
-            node.score = score_segmentation(node.segmentation, out_sequence);
+            node.score = score_segmentation(node.segmentation);
             vector< vector<int> > childs = generate_childs( node.segmentation );
             node.expanded = true;
 
-            beam.push_back( node );
-
-            if (!childs.empty())
-              update_beam( childs );
+            insert_beam( node );
+            insert_childs( childs );
 
             generated_chids += (int)childs.size();
 
           }
         }
+        sort_heap(beam.begin(), beam.end(), beam_sort_function);
 
         while (generated_chids != 0)
         {
@@ -334,8 +346,10 @@ public:
             }
         }
 
+        if (beam.empty()) return;
+
         // Done! Get the best prediction found into out_sequence
-        double lp = score_segmentation( beam[0].segmentation, out_sequence );
+        double lp = score_segmentation( beam[0].segmentation, &out_sequence );
 
         // fill other (dummy) output parameters
         component_rects->push_back(Rect(0,0,src.cols,src.rows));
@@ -352,6 +366,8 @@ private:
     vector< beamSearch_node > beam;
     vector< vector<double> > recognition_probabilities;
     vector<int> oversegmentation;
+    // Viterbi states of the prefixes of the scored segmentations
+    map< vector<int>, viterbi_state > viterbi_cache;
 
     vector< vector<int> > generate_childs( vector<int> &segmentation )
     {
@@ -370,35 +386,90 @@ private:
         return childs;
     }
 
-    void update_beam ( vector< vector<int> > &childs )
+    // While nodes are inserted the beam is a min-heap bounded to beam_size nodes,
+    // its front is the lowest score needed to be part of the beam
+    void insert_beam ( const beamSearch_node &node )
     {
-        string out_sequence;
-        double min_score = -DBL_MAX; //min score value to be part of the beam
-        if ((int)beam.size() >= beam_size)
-            min_score = beam[beam_size-1].score; //last element has the lowest score
+        if (((int)beam.size() >= beam_size) && !beam.empty() && (node.score <= beam.front().score))
+            return;
+        beam.push_back(node);
+        push_heap(beam.begin(), beam.end(), beam_sort_function);
+        if ((int)beam.size() > beam_size)
+        {
+            pop_heap(beam.begin(), beam.end(), beam_sort_function);
+            beam.pop_back();
+        }
+    }
 
+    void insert_childs ( vector< vector<int> > &childs )
+    {
         for (size_t i=0; i<childs.size(); i++)
         {
-            double score = score_segmentation(childs[i], out_sequence);
-            if (score > min_score)
+            beamSearch_node node;
+            node.score = score_segmentation(childs[i]);
+            node.segmentation = childs[i];
+            node.expanded = false;
+            insert_beam(node);
+        }
+    }
+
+    // the beam is sorted by decreasing score between updates
+    void update_beam ( vector< vector<int> > &childs )
+    {
+        make_heap(beam.begin(), beam.end(), beam_sort_function);
+        insert_childs(childs);
+        sort_heap(beam.begin(), beam.end(), beam_sort_function);
+    }
+
+    // Viterbi step for a segmentation whose previous column is prev and last segment is seg_point
+    void viterbi_step( const viterbi_state &prev, int seg_point, viterbi_state &next )
+    {
+        next.V.resize(vocabulary.size());
+        next.back.resize(vocabulary.size());
+        for (int i=0; i<(int)vocabulary.size(); i++)
+        {
+            double max_prob = -DBL_MAX;
+            int best_idx = 0;
+            for (int j=0; j<(int)vocabulary.size(); j++)
             {
-                beamSearch_node node;
-                node.score = score;
-                node.segmentation = childs[i];
-                node.expanded = false;
-                beam.push_back(node);
-                sort(beam.begin(),beam.end(),beam_sort_function);
-                if ((int)beam.size() > beam_size)
+                double prob = prev.V[j] + transition_p.at<double>(j,i) + recognition_probabilities[seg_point][i];
+                if ( prob > max_prob)
                 {
-                    beam.erase(beam.begin()+beam_size,beam.end());
-                    min_score = beam[beam.size()-1].score;
+                    max_prob = prob;
+                    best_idx = j;
                 }
             }
+            next.V[i] = max_prob;
+            next.back[i] = best_idx;
         }
     }
 
+    // Viterbi state of the first length segments of a segmentation. It is memoised, so the
+    // childs of a node only need the step of their last segment.
+    const viterbi_state& viterbi_prefix( const vector<int> &segmentation, size_t length )
+    {
+        vector<int> key(segmentation.begin(), segmentation.begin()+length);
+        map< vector<int>, viterbi_state >::iterator it = viterbi_cache.find(key);
+        if (it != viterbi_cache.end())
+            return it->second;
 
-    double score_segmentation( vector<int> &segmentation, string& outstring )
+        viterbi_state state;
+        if (length == 1)
+        {
+            //TODO Extracting start probs from lexicon (if we have it) may boost accuracy!
+            state.V.resize(vocabulary.size());
+            state.back.assign(vocabulary.size(), 0);
+            for (int i=0; i<(int)vocabulary.size(); i++)
+                state.V[i] = log(1.0/vocabulary.size()) + recognition_probabilities[segmentation[0]][i];
+        }
+        else
+        {
+            viterbi_step(viterbi_prefix(segmentation, length-1), segmentation[length-1], state);
+        }
+        return viterbi_cache.insert(make_pair(key, state)).first->second;
+    }
+
+    double score_segmentation( vector<int> &segmentation, string* outstring = NULL )
     {
 
         // Score Heuristics:
@@ -421,61 +492,15 @@ private:
              return -DBL_MAX;
           }
         }
-        Scalar m, std;
-        meanStdDev(interdist, m, std);
-        //double interdist_std = std[0];
-
-        //TODO Extracting start probs from lexicon (if we have it) may boost accuracy!
-        vector<double> start_p(vocabulary.size());
-        for (int i=0; i<(int)vocabulary.size(); i++)
-            start_p[i] = log(1.0/vocabulary.size());
-
-
-        Mat V = Mat::ones((int)segmentation.size(),(int)vocabulary.size(),CV_64FC1);
-        V = V * -DBL_MAX;
-        vector<string> path(vocabulary.size());
-
-        // Initialize base cases (t == 0)
-        for (int i=0; i<(int)vocabulary.size(); i++)
-        {
-            V.at<double>(0,i) = start_p[i] + recognition_probabilities[segmentation[0]][i];
-            path[i] = vocabulary.at(i);
-        }
-
-
-        // Run Viterbi for t > 0
-        for (int t=1; t<(int)segmentation.size(); t++)
-        {
-
-            vector<string> newpath(vocabulary.size());
-
-            for (int i=0; i<(int)vocabulary.size(); i++)
-            {
-                double max_prob = -DBL_MAX;
-                int best_idx = 0;
-                for (int j=0; j<(int)vocabulary.size(); j++)
-                {
-                    double prob = V.at<double>(t-1,j) + transition_p.at<double>(j,i) + recognition_probabilities[segmentation[t]][i];
-                    if ( prob > max_prob)
-                    {
-                        max_prob = prob;
-                        best_idx = j;
-                    }
-                }
-
-                V.at<double>(t,i) = max_prob;
-                newpath[i] = path[best_idx] + vocabulary.at(i);
-            }
-
-            // Don't need to remember the old paths
-            path.swap(newpath);
-        }
+        // Run Viterbi only for the last segment, the previous ones come from the memoised prefix
+        viterbi_state last;
+        viterbi_step(viterbi_prefix(segmentation, segmentation.size()-1), segmentation.back(), last);
 
         double max_prob = -DBL_MAX;
         int best_idx = 0;
         for (int i=0; i<(int)vocabulary.size(); i++)
         {
-            double prob = V.at<double>((int)segmentation.size()-1,i);
+            double prob = last.V[i];
             if ( prob > max_prob)
             {
                 max_prob = prob;
@@ -483,7 +508,21 @@ private:
             }
         }
 
-        outstring = path[best_idx];
+        if (outstring != NULL)
+        {
+            // backtrack the best path
+            outstring->assign(segmentation.size(), ' ');
+            int t = (int)segmentation.size()-1;
+            (*outstring)[t] = vocabulary.at(best_idx);
+            int idx = last.back[best_idx];
+            for (t=t-1; t>=0; t--)
+            {
+                (*outstring)[t] = vocabulary.at(idx);
+                if (t > 0)
+                    idx = viterbi_prefix(segmentation, t+1).back[idx];
+            }
+        }
+
         return (max_prob / (segmentation.size()-1));
     }
 
@@ -526,7 +565,7 @@ public:
 
 protected:
     void normalizeAndZCA(Mat& patches);
-    double eval_feature(Mat& feature, double* prob_estimates);
+    double eval_scores(const double* scores, double* prob_estimates);
 
 private:
     int window_size; // window size
@@ -536,8 +575,10 @@ private:
     Mat feature_min; // scale range
     Mat feature_max;
     Mat weights;     // Logistic Regression weights
+    Mat weights_64f; // the same weights in double precision for the batched evaluation
     Mat kernels;     // CNN kernels
     Mat M, P;        // ZCA Whitening parameters
+    Mat zca_kernels; // P * kernels^T, whitening and kernels bank in a single projection
     int quad_size;
     int patch_size;
     int num_quads;   // extract 25 quads (12x12) from each image
@@ -566,6 +607,10 @@ OCRBeamSearchClassifierCNN::OCRBeamSearchClassifierCNN (const string& filename)
 
     nr_feature = weights.rows;
     nr_class   = weights.cols;
+    weights.convertTo(weights_64f, CV_64F);
+    // when the whitening params are not in the file eval() learns them from the first patch
+    if ((M.dims != 0) && (P.dims != 0))
+        zca_kernels = P * kernels.t();
     patch_size  = (int)sqrt((float)kernels.cols);
     window_size = 4*patch_size;
     step_size   = 4;
@@ -575,6 +620,27 @@ OCRBeamSearchClassifierCNN::OCRBeamSearchClassifierCNN (const string& filename)
     alpha       = 0.5; // used in non-linear activation function z = max(0, |D*a| - alpha)
 }
 
+// The 9 pools of a window, each one is the sum of the responses of a group of
+// overlapping quads. Quads are numbered from 1 to 25 in the order of the sliding window.
+static bool quadInPool(int quad_id, int pool)
+{
+    static const int pool_quads[9][10] = { { 1, 2, 6, 7, 0},
+                                           { 2, 7, 3, 8, 4, 9, 0},
+                                           { 4, 9, 5,10, 0},
+                                           { 6,11,16, 7,12,17, 0},
+                                           { 7,12,17, 8,13,18, 9,14,19, 0},
+                                           { 9,14,19,10,15,20, 0},
+                                           {16,21,17,22, 0},
+                                           {17,22,18,23,19,24, 0},
+                                           {19,24,20,25, 0} };
+    for (int i=0; pool_quads[pool][i] != 0; i++)
+    {
+        if (pool_quads[pool][i] == quad_id)
+            return true;
+    }
+    return false;
+}
+
 void OCRBeamSearchClassifierCNN::eval( InputArray _src, vector< vector<double> >& recognition_probabilities, vector<int>& oversegmentation)
 {
 
@@ -596,106 +662,136 @@ void OCRBeamSearchClassifierCNN::eval( InputArray _src, vector< vector<double> >
 
     resize(src,src,Size(window_size*src.cols/src.rows,window_size));
 
-    int seg_points = 0;
+    if (src.cols < window_size)
+        return;
 
-    Mat quad;
-    Mat tmp;
-    Mat img;
+    // Every window extracts 8x8 patches at the same offsets inside its 12x12 quads, so a patch
+    // only depends on its position in the word image. The responses of all the patches of the
+    // image are computed once and then pooled for each window.
+    int patch_len = patch_size*patch_size;
+    int num_rows  = window_size-patch_size+1; // patch rows reachable in a window
+    int num_cols  = src.cols-patch_size+1;    // patch columns in the whole image
 
-    // begin sliding window loop foreach detection window
-    for (int x_c=0; x_c<=src.cols-window_size; x_c=x_c+step_size)
+    // im2col: one normalized patch per row, stored in (y,x) order
+    Mat patches(num_rows*num_cols, patch_len, CV_64FC1);
+    for (int y=0; y<num_rows; y++)
     {
-
-        img = src(Rect(Point(x_c,0),Size(window_size,window_size)));
-
-        int patch_count = 0;
-        vector< vector<double> > data_pool(9);
-
-
-        int quad_id = 1;
-        for (int q_x=0; q_x<=window_size-quad_size; q_x=q_x+(quad_size/2-1))
+        for (int x=0; x<num_cols; x++)
         {
-            for (int q_y=0; q_y<=window_size-quad_size; q_y=q_y+(quad_size/2-1))
+            double *patch = patches.ptr<double>(y*num_cols+x);
+            double sum = 0, sqsum = 0;
+            for (int r=0; r<patch_size; r++)
             {
-                Rect quad_rect = Rect(q_x,q_y,quad_size,quad_size);
-                quad = img(quad_rect);
-
-                //start sliding window (8x8) in each tile and store the patch as row in data_pool
-                for (int w_x=0; w_x<=quad_size-patch_size; w_x++)
+                const uchar *pix = src.ptr<uchar>(y+r) + x;
+                for (int c=0; c<patch_size; c++)
                 {
-                    for (int w_y=0; w_y<=quad_size-patch_size; w_y++)
-                    {
-                        quad(Rect(w_x,w_y,patch_size,patch_size)).copyTo(tmp);
-                        tmp = tmp.reshape(0,1);
-                        tmp.convertTo(tmp, CV_64F);
-                        normalizeAndZCA(tmp);
-                        vector<double> patch;
-                        tmp.copyTo(patch);
-                        if ((quad_id == 1)||(quad_id == 2)||(quad_id == 6)||(quad_id == 7))
-                            data_pool[0].insert(data_pool[0].end(),patch.begin(),patch.end());
-                        if ((quad_id == 2)||(quad_id == 7)||(quad_id == 3)||(quad_id == 8)||(quad_id == 4)||(quad_id == 9))
-                            data_pool[1].insert(data_pool[1].end(),patch.begin(),patch.end());
-                        if ((quad_id == 4)||(quad_id == 9)||(quad_id == 5)||(quad_id == 10))
-                            data_pool[2].insert(data_pool[2].end(),patch.begin(),patch.end());
-                        if ((quad_id == 6)||(quad_id == 11)||(quad_id == 16)||(quad_id == 7)||(quad_id == 12)||(quad_id == 17))
-                            data_pool[3].insert(data_pool[3].end(),patch.begin(),patch.end());
-                        if ((quad_id == 7)||(quad_id == 12)||(quad_id == 17)||(quad_id == 8)||(quad_id == 13)||(quad_id == 18)||(quad_id == 9)||(quad_id == 14)||(quad_id == 19))
-                            data_pool[4].insert(data_pool[4].end(),patch.begin(),patch.end());
-                        if ((quad_id == 9)||(quad_id == 14)||(quad_id == 19)||(quad_id == 10)||(quad_id == 15)||(quad_id == 20))
-                            data_pool[5].insert(data_pool[5].end(),patch.begin(),patch.end());
-                        if ((quad_id == 16)||(quad_id == 21)||(quad_id == 17)||(quad_id == 22))
-                            data_pool[6].insert(data_pool[6].end(),patch.begin(),patch.end());
-                        if ((quad_id == 17)||(quad_id == 22)||(quad_id == 18)||(quad_id == 23)||(quad_id == 19)||(quad_id == 24))
-                            data_pool[7].insert(data_pool[7].end(),patch.begin(),patch.end());
-                        if ((quad_id == 19)||(quad_id == 24)||(quad_id == 20)||(quad_id == 25))
-                            data_pool[8].insert(data_pool[8].end(),patch.begin(),patch.end());
-                        patch_count++;
-                    }
+                    double v = pix[c];
+                    patch[r*patch_size+c] = v;
+                    sum += v;
+                    sqsum += v*v;
                 }
-
-                quad_id++;
             }
+            //Normalize for contrast
+            double mean = sum/patch_len;
+            double var  = max(sqsum/patch_len - mean*mean, 0.0);
+            double norm = 1./sqrt(var*patch_len/(patch_len-1)+10);
+            for (int k=0; k<patch_len; k++)
+                patch[k] = (patch[k] - mean)*norm;
         }
+    }
+
+    // ZCA whitening and the kernels bank are folded into a single projection (see the constructor)
+    if ((M.dims == 0) || (P.dims == 0))
+    {
+        // no whitening params in the classifier data, learn them from the first patch as before
+        Mat first;
+        src(Rect(0,0,patch_size,patch_size)).copyTo(first);
+        first = first.reshape(0,1);
+        first.convertTo(first, CV_64F);
+        normalizeAndZCA(first);
+        zca_kernels = P * kernels.t();
+    }
+    for (int i=0; i<patches.rows; i++)
+        patches.row(i) = patches.row(i) - M;
+
+    // responses of all the patches, non-linear activation z = max(0, |D*a| - alpha)
+    Mat responses;
+    gemm(patches, zca_kernels, 1, noArray(), 0, responses);
+    responses = abs(responses) - alpha;
+    responses = max(responses, 0.0);
+
+    // response of each quad row (sum over the patch rows of a quad) and then of each quad
+    // (sum over the patch columns of a quad), indexed by the column of the quad
+    int quad_step   = quad_size/2-1;
+    int quad_tiles  = quad_size-patch_size+1;
+    int quad_cols   = num_cols-quad_tiles+1;
+    vector<Mat> quad_responses;
+    for (int q_y=0; q_y<=window_size-quad_size; q_y=q_y+quad_step)
+    {
+        Mat row_sum = Mat::zeros(num_cols, kernels.rows, CV_64FC1);
+        for (int w_y=0; w_y<quad_tiles; w_y++)
+            row_sum += responses.rowRange((q_y+w_y)*num_cols, (q_y+w_y+1)*num_cols);
+        Mat quad_sum = Mat::zeros(quad_cols, kernels.rows, CV_64FC1);
+        for (int w_x=0; w_x<quad_tiles; w_x++)
+            quad_sum += row_sum.rowRange(w_x, w_x+quad_cols);
+        quad_responses.push_back(quad_sum);
+    }
 
-        //do dot product of each normalized and whitened patch
-        //each pool is averaged and this yields a representation of 9xD
-        Mat feature = Mat::zeros(9,kernels.rows,CV_64FC1);
-        for (int i=0; i<9; i++)
+    // each pool is the sum of the responses of its quads
+    // this yields a representation of 9xD for each window
+    int num_windows = (src.cols-window_size)/step_size+1;
+    Mat features = Mat::zeros(num_windows, 9*kernels.rows, CV_64FC1);
+    for (int w=0; w<num_windows; w++)
+    {
+        int x_c = w*step_size;
+        Mat feature = features.row(w).reshape(0,9);
+        int quad_id = 1;
+        for (int q_x=0; q_x<=window_size-quad_size; q_x=q_x+quad_step)
         {
-            Mat pool = Mat(data_pool[i]);
-            pool = pool.reshape(0,(int)data_pool[i].size()/kernels.cols);
-            for (int p=0; p<pool.rows; p++)
+            for (size_t q=0; q<quad_responses.size(); q++)
             {
-                for (int f=0; f<kernels.rows; f++)
+                Mat quad = quad_responses[q].row(x_c+q_x);
+                for (int i=0; i<9; i++)
                 {
-                    feature.row(i).at<double>(0,f) = feature.row(i).at<double>(0,f) + max(0.0,std::abs(pool.row(p).dot(kernels.row(f)))-alpha);
+                    if (quadInPool(quad_id, i))
+                    {
+                        Mat pool = feature.row(i);
+                        pool += quad;
+                    }
                 }
+                quad_id++;
             }
         }
-        feature = feature.reshape(0,1);
-
+    }
 
-        // data must be normalized within the range obtained during training
-        double lower = -1.0;
-        double upper =  1.0;
-        for (int k=0; k<feature.cols; k++)
+    // data must be normalized within the range obtained during training
+    double lower = -1.0;
+    double upper =  1.0;
+    for (int w=0; w<num_windows; w++)
+    {
+        double *feature = features.ptr<double>(w);
+        for (int k=0; k<features.cols; k++)
         {
-            feature.at<double>(0,k) = lower + (upper-lower) *
-                    (feature.at<double>(0,k)-feature_min.at<double>(0,k))/
+            feature[k] = lower + (upper-lower) *
+                    (feature[k]-feature_min.at<double>(0,k))/
                     (feature_max.at<double>(0,k)-feature_min.at<double>(0,k));
         }
+    }
 
-        double *p = new double[nr_class];
-        double predict_label = eval_feature(feature,p);
+    // Logistic Regression for all the windows at once
+    Mat scores;
+    gemm(features, weights_64f, 1, noArray(), 0, scores);
 
-        if ( (predict_label < 0) || (predict_label > nr_class) )
-            CV_Error(Error::StsOutOfRange, "OCRBeamSearchClassifierCNN::eval Error: unexpected prediction in eval_feature()");
+    for (int w=0; w<num_windows; w++)
+    {
+        vector<double> recognition_p(nr_class);
+        double predict_label = eval_scores(scores.ptr<double>(w), &recognition_p[0]);
 
+        if ( (predict_label < 0) || (predict_label > nr_class) )
+            CV_Error(Error::StsOutOfRange, "OCRBeamSearchClassifierCNN::eval Error: unexpected prediction in eval_scores()");
 
-        vector<double> recognition_p(p, p+nr_class);
         recognition_probabilities.push_back(recognition_p);
-        oversegmentation.push_back(seg_points);
-        seg_points++;
+        oversegmentation.push_back(w);
     }
 
 }
@@ -747,14 +843,11 @@ void OCRBeamSearchClassifierCNN::normalizeAndZCA(Mat& patches)
 
 }
 
-double OCRBeamSearchClassifierCNN::eval_feature(Mat& feature, double* prob_estimates)
+// converts the Logistic Regression scores of a window into class probabilities
+double OCRBeamSearchClassifierCNN::eval_scores(const double* scores, double* prob_estimates)
 {
     for(int i=0;i<nr_class;i++)
-        prob_estimates[i] = 0;
-
-    for(int idx=0; idx<nr_feature; idx++)
-        for(int i=0;i<nr_class;i++)
-            prob_estimates[i] += weights.at<float>(idx,i)*feature.at<double>(0,idx); //TODO use vectorized dot product
+        prob_estimates[i] = scores[i];
 
     int dec_max_idx = 0;
     for(int i=1;i<nr_class;i++)
@@ -43,6 +43,7 @@
 #define __OPENCV_TRACKING_KALMAN_HPP_
 
 #include "opencv2/core.hpp"
+#include "opencv2/core/utility.hpp"
 #include <limits>
 
 namespace cv
@@ -222,6 +223,385 @@ CV_EXPORTS Ptr<UnscentedKalmanFilter> createUnscentedKalmanFilter( const Unscent
 */
 CV_EXPORTS Ptr<UnscentedKalmanFilter> createAugmentedUnscentedKalmanFilter( const AugmentedUnscentedKalmanFilterParams &params );
 
+template<typename _Tp, int DP, int MP, int CP> class UnscentedKalmanFilterBatch;
+
+/** @brief Unscented Kalman filter with the dimensionalities fixed at compile time.
+
+* The algorithm is the one of createUnscentedKalmanFilter, with all vectors and matrices stored in Matx, so a step
+* performs no allocations and small loops are unrolled by the compiler. It is meant for small states (up to a dozen
+* dimensions) and for running many filters at once, see UnscentedKalmanFilterBatch.
+*
+* The dynamical system model is passed to predict() and correct() as a template argument. It has to provide
+* @code
+*     void stateConversionFunction( const StateVec& x_k, const ControlVec& u_k, StateVec& x_kplus1 ) const;
+*     void measurementFunction( const StateVec& x_k, MeasurementVec& z_k ) const;
+* @endcode
+* The noise vectors are omitted as the filter always evaluates the model at zero noise.
+* @tparam _Tp - type of elements, float or double,
+* @tparam DP - dimensionality of the state vector,
+* @tparam MP - dimensionality of the measurement vector,
+* @tparam CP - dimensionality of the control vector, 1 if the model has no control.
+*/
+template<typename _Tp, int DP, int MP, int CP = 1>
+class UnscentedKalmanFilterFixed
+{
+public:
+    typedef Matx<_Tp, DP, 1> StateVec;
+    typedef Matx<_Tp, DP, DP> StateCov;
+    typedef Matx<_Tp, MP, 1> MeasurementVec;
+    typedef Matx<_Tp, MP, MP> MeasurementCov;
+    typedef Matx<_Tp, DP, MP> GainMat;
+    typedef Matx<_Tp, CP, 1> ControlVec;
+    enum { SP = 2*DP+1 };                       //!< Number of sigma points.
+
+    /** The constructors.
+    * The default one creates a filter with zero state and identity covariance matrices.
+    */
+    UnscentedKalmanFilterFixed()
+    {
+        init( StateVec::zeros(), StateCov::eye(), StateCov::eye(), MeasurementCov::eye() );
+    }
+
+    /**
+    * @param stateInit - initial state,
+    * @param errorCovInit - initial state estimate cross-covariance matrix,
+    * @param processNoiseCov - process noise cross-covariance matrix,
+    * @param measurementNoiseCov - measurement noise cross-covariance matrix,
+    * @param alpha, k, beta - parameters of the algorithm, see UnscentedKalmanFilterParams.
+    */
+    UnscentedKalmanFilterFixed( const StateVec& stateInit, const StateCov& errorCovInit, const StateCov& processNoiseCov,
+                                const MeasurementCov& measurementNoiseCov, double alpha = 1e-3, double k = 0.0, double beta = 2.0 )
+    {
+        init( stateInit, errorCovInit, processNoiseCov, measurementNoiseCov, alpha, k, beta );
+    }
+
+    /** The function for initialization of the filter, the parameters are the ones of the constructor.
+    */
+    void init( const StateVec& stateInit, const StateCov& errorCovInit, const StateCov& processNoiseCov,
+               const MeasurementCov& measurementNoiseCov, double alpha = 1e-3, double k = 0.0, double beta = 2.0 )
+    {
+        state = stateInit;
+        errorCov = errorCovInit;
+        processNoiseCov_ = processNoiseCov;
+        measurementNoiseCov_ = measurementNoiseCov;
+
+        double lambda = alpha*alpha*( DP + k ) - DP;
+        double tmpLambda = lambda + DP;
+        coef = (_Tp)std::sqrt( tmpLambda );
+        wm0 = (_Tp)(lambda/tmpLambda);
+        wc0 = (_Tp)(lambda/tmpLambda + 1.0 - alpha*alpha + beta);
+        w = (_Tp)(0.5/tmpLambda);
+
+        for( int i = 0; i < SP; i++ )
+            transitionSPFuncValsCenter[i] = StateVec::zeros();
+    }
+
+    /** The function performs prediction step of the algorithm
+    * @param model - the dynamical system model,
+    * @param control - the current control vector,
+    * @return the predicted estimate of the state.
+    */
+    template<typename Model>
+    const StateVec& predict( const Model& model, const ControlVec& control = ControlVec::zeros() )
+    {
+        StateVec sigmaPoints[SP], fx[SP];
+        getSigmaPoints( sigmaPoints );
+
+        for( int i = 0; i < SP; i++ )
+            model.stateConversionFunction( sigmaPoints[i], control, fx[i] );
+
+        StateVec sum = StateVec::zeros();
+        for( int i = 1; i < SP; i++ )
+            sum += fx[i];
+        state = fx[0]*wm0 + sum*w;
+
+        StateCov cov = StateCov::zeros();
+        for( int i = 0; i < SP; i++ )
+        {
+            transitionSPFuncValsCenter[i] = fx[i] - state;
+            if( i > 0 )
+                cov += transitionSPFuncValsCenter[i] * transitionSPFuncValsCenter[i].t();
+        }
+        errorCov = transitionSPFuncValsCenter[0] * transitionSPFuncValsCenter[0].t() * wc0 + cov * w + processNoiseCov_;
+
+        return state;
+    }
+
+    /** The function performs correction step of the algorithm
+    * @param model - the dynamical system model,
+    * @param measurement - the current measurement vector,
+    * @return the corrected estimate of the state.
+    */
+    template<typename Model>
+    const StateVec& correct( const Model& model, const MeasurementVec& measurement )
+    {
+        StateVec sigmaPoints[SP];
+        MeasurementVec hx[SP];
+        getSigmaPoints( sigmaPoints );
+
+        for( int i = 0; i < SP; i++ )
+            model.measurementFunction( sigmaPoints[i], hx[i] );
+
+        MeasurementVec sum = MeasurementVec::zeros();
+        for( int i = 1; i < SP; i++ )
+            sum += hx[i];
+        MeasurementVec measurementEstimate = hx[0]*wm0 + sum*w;
+
+        MeasurementCov yyCov = MeasurementCov::zeros();
+        GainMat xyCov = GainMat::zeros();
+        for( int i = 1; i < SP; i++ )
+        {
+            MeasurementVec hc = hx[i] - measurementEstimate;
+            yyCov += hc * hc.t();
+            xyCov += transitionSPFuncValsCenter[i] * hc.t();
+        }
+        MeasurementVec hc0 = hx[0] - measurementEstimate;
+        yyCov = hc0 * hc0.t() * wc0 + yyCov * w + measurementNoiseCov_;
+        xyCov = transitionSPFuncValsCenter[0] * hc0.t() * wc0 + xyCov * w;
+
+        GainMat gain = getGain( xyCov, yyCov );
+        state += gain * ( measurement - measurementEstimate );
+        errorCov -= gain * xyCov.t();
+
+        return state;
+    }
+
+    StateVec state;                             //!< Current estimate of the state.
+    StateCov errorCov;                          //!< Current estimate of the state cross-covariance matrix.
+
+    const StateCov& getProcessNoiseCov() const { return processNoiseCov_; }
+    const MeasurementCov& getMeasurementNoiseCov() const { return measurementNoiseCov_; }
+
+private:
+    template<typename, int, int, int> friend class UnscentedKalmanFilterBatch;
+
+    // L = cholesky( A ), stops at the first non-positive pivot like the dynamically sized filter does
+    template<int n>
+    static bool choleskyDecomposition( const Matx<_Tp, n, n>& A, Matx<_Tp, n, n>& L )
+    {
+        L = Matx<_Tp, n, n>::zeros();
+        for( int i = 0; i < n; i++ )
+        {
+            for( int j = 0; j < i; j++ )
+            {
+                double s = A(i, j);
+                for( int k = 0; k < j; k++ )
+                    s -= L(i, k)*L(j, k);
+                L(i, j) = (_Tp)(s/L(j, j));
+            }
+            double s = A(i, i);
+            for( int k = 0; k < i; k++ )
+                s -= (double)L(i, k)*L(i, k);
+            if( s < std::numeric_limits<_Tp>::epsilon() )
+                return false;
+            L(i, i) = (_Tp)std::sqrt( s );
+        }
+        return true;
+    }
+
+    // x_0 = x*, x_i = x* + coef*L_i, x_(i+DP) = x* - coef*L_i, L = cholesky( P )
+    void getSigmaPoints( StateVec* sigmaPoints ) const
+    {
+        StateCov L;
+        choleskyDecomposition( errorCov, L );
+        sigmaPoints[0] = state;
+        for( int i = 0; i < DP; i++ )
+        {
+            StateVec d = L.col(i) * coef;
+            sigmaPoints[i+1] = state + d;
+            sigmaPoints[i+1+DP] = state - d;
+        }
+    }
+
+    // K = Sxy * Syy^(-1), solved with the Cholesky factor of Syy, SVD-based inverse if Syy is not positive definite
+    static GainMat getGain( const GainMat& xyCov, const MeasurementCov& yyCov )
+    {
+        MeasurementCov L;
+        if( !choleskyDecomposition( yyCov, L ) )
+            return xyCov * yyCov.inv( DECOMP_SVD );
+
+        GainMat gain;
+        for( int r = 0; r < DP; r++ )
+        {
+            double y[MP];
+            for( int i = 0; i < MP; i++ )
+            {
+                double s = xyCov(r, i);
+                for( int k = 0; k < i; k++ )
+                    s -= L(i, k)*y[k];
+                y[i] = s/L(i, i);
+            }
+            for( int i = MP-1; i >= 0; i-- )
+            {
+                double s = y[i];
+                for( int k = i+1; k < MP; k++ )
+                    s -= L(k, i)*gain(r, k);
+                gain(r, i) = (_Tp)(s/L(i, i));
+            }
+        }
+        return gain;
+    }
+
+    StateCov processNoiseCov_;
+    MeasurementCov measurementNoiseCov_;
+    StateVec transitionSPFuncValsCenter[SP];    // f-function values at sigma points minus the state, kept for correct()
+    _Tp coef, wm0, wc0, w;                      // sigma point spread and the weights of the mean and covariance
+};
+
+/** @brief A set of independent fixed-size Unscented Kalman filters stepped together.
+
+* The filters share the noise covariances and the parameters of the prototype filter, their states and covariances
+* are stored in structure of arrays layout: column i of getStates() is the state of filter i, row j holds component j
+* of all the states; getErrorCovs() stores the DP*DP covariance elements row-major in the same way. The filters are
+* processed in parallel.
+*/
+template<typename _Tp, int DP, int MP, int CP = 1>
+class UnscentedKalmanFilterBatch
+{
+public:
+    typedef UnscentedKalmanFilterFixed<_Tp, DP, MP, CP> Filter;
+    enum { SP = Filter::SP };
+
+    /**
+    * @param count - number of filters,
+    * @param prototype - the filter all the filters are initialized from.
+    */
+    UnscentedKalmanFilterBatch( int count, const Filter& prototype ) : prototype_(prototype)
+    {
+        CV_Assert( count >= 0 );
+        states.create( DP, count );
+        errorCovs.create( DP*DP, count );
+        centers.create( DP*SP, count );
+        for( int i = 0; i < count; i++ )
+            store( prototype_, i );
+    }
+
+    /** @return the number of filters.
+    */
+    int size() const { return states.cols; }
+
+    /** The function returns a copy of the filter i.
+    */
+    Filter get( int i ) const
+    {
+        CV_Assert( 0 <= i && i < size() );
+        Filter f = prototype_;
+        load( f, i );
+        return f;
+    }
+
+    /** The function replaces the filter i, e.g. when a new object starts being tracked.
+    */
+    void set( int i, const Filter& filter )
+    {
+        CV_Assert( 0 <= i && i < size() );
+        store( filter, i );
+    }
+
+    /** The function performs prediction step for all the filters
+    * @param model - the dynamical system model, see UnscentedKalmanFilterFixed,
+    * @param controls - CP x count matrix of control vectors, empty for zero controls.
+    */
+    template<typename Model>
+    void predict( const Model& model, const Mat& controls = Mat() )
+    {
+        CV_Assert( controls.empty() || (controls.type() == DataType<_Tp>::type && controls.rows == CP && controls.cols == size()) );
+        parallel_for_( Range(0, size()), StepInvoker<Model>(*this, model, controls, Mat(), true) );
+    }
+
+    /** The function performs correction step for the filters
+    * @param model - the dynamical system model, see UnscentedKalmanFilterFixed,
+    * @param measurements - MP x count matrix of measurement vectors,
+    * @param mask - optional 1 x count CV_8U matrix, filters with zero mask are not corrected.
+    */
+    template<typename Model>
+    void correct( const Model& model, const Mat& measurements, const Mat& mask = Mat() )
+    {
+        CV_Assert( measurements.type() == DataType<_Tp>::type && measurements.rows == MP && measurements.cols == size() );
+        CV_Assert( mask.empty() || (mask.type() == CV_8UC1 && mask.total() == (size_t)size()) );
+        parallel_for_( Range(0, size()), StepInvoker<Model>(*this, model, measurements, mask, false) );
+    }
+
+    /** @return DP x count matrix of the state estimates.
+    */
+    const Mat_<_Tp>& getStates() const { return states; }
+
+    /** @return DP*DP x count matrix of the state cross-covariance matrices.
+    */
+    const Mat_<_Tp>& getErrorCovs() const { return errorCovs; }
+
+private:
+    template<typename Model>
+    class StepInvoker : public ParallelLoopBody
+    {
+    public:
+        StepInvoker( UnscentedKalmanFilterBatch& batch, const Model& model, const Mat& vectors, const Mat& mask, bool isPredict )
+            : batch_(batch), model_(model), vectors_(vectors), mask_(mask), predict_(isPredict) {}
+
+        virtual void operator()( const Range& range ) const
+        {
+            Filter f = batch_.prototype_;
+            const uchar* mask = mask_.empty() ? 0 : mask_.ptr();
+            for( int i = range.start; i < range.end; i++ )
+            {
+                if( mask && !mask[i] )
+                    continue;
+                batch_.load( f, i );
+                if( predict_ )
+                {
+                    typename Filter::ControlVec control = Filter::ControlVec::zeros();
+                    if( !vectors_.empty() )
+                        for( int j = 0; j < CP; j++ )
+                            control(j) = vectors_.at<_Tp>(j, i);
+                    f.predict( model_, control );
+                }
+                else
+                {
+                    typename Filter::MeasurementVec measurement;
+                    for( int j = 0; j < MP; j++ )
+                        measurement(j) = vectors_.at<_Tp>(j, i);
+                    f.correct( model_, measurement );
+                }
+                batch_.store( f, i );
+            }
+        }
+
+    private:
+        UnscentedKalmanFilterBatch& batch_;
+        const Model& model_;
+        const Mat& vectors_;
+        const Mat& mask_;
+        bool predict_;
+    };
+
+    void load( Filter& f, int i ) const
+    {
+        for( int j = 0; j < DP; j++ )
+            f.state(j) = states(j, i);
+        for( int j = 0; j < DP*DP; j++ )
+            f.errorCov.val[j] = errorCovs(j, i);
+        for( int s = 0; s < SP; s++ )
+            for( int j = 0; j < DP; j++ )
+                f.transitionSPFuncValsCenter[s](j) = centers(s*DP + j, i);
+    }
+
+    void store( const Filter& f, int i )
+    {
+        for( int j = 0; j < DP; j++ )
+            states(j, i) = f.state(j);
+        for( int j = 0; j < DP*DP; j++ )
+            errorCovs(j, i) = f.errorCov.val[j];
+        for( int s = 0; s < SP; s++ )
+            for( int j = 0; j < DP; j++ )
+                centers(s*DP + j, i) = f.transitionSPFuncValsCenter[s](j);
+    }
+
+    Filter prototype_;
+    Mat_<_Tp> states;                           // DP x count
+    Mat_<_Tp> errorCovs;                        // DP*DP x count
+    Mat_<_Tp> centers;                          // DP*SP x count, f-function values at sigma points minus the state
+};
+
 } // tracking
 } // cv
 
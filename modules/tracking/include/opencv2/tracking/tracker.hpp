@@ -1045,13 +1045,29 @@ class CV_EXPORTS TrackerFeatureHAAR : public TrackerFeature
      */
   CvHaarEvaluator::FeatureHaar& getFeatureAt( int id );
 
+  /** @brief Enable or disable the cache of the responses of the current frame
+    @param enabled true to enable the cache (it is disabled by default)
+
+    Samples cut at the same position of the same integral image, e.g. positive samples that overlap the
+    search samples of the frame, are then evaluated only once. The cache is dropped when samples of another
+    image arrive or a feature is changed; call clearCache() if the sampled image is overwritten in place.
+     */
+  void setCacheEnabled( bool enabled );
+
+  /** @brief Drop the cached responses
+     */
+  void clearCache();
+
  protected:
   bool computeImpl( const std::vector<Mat>& images, Mat& response );
 
  private:
+  struct ResponseCache;
 
   Params params;
   Ptr<CvHaarEvaluator> featureEvaluator;
+  bool cacheEnabled;
+  Ptr<ResponseCache> cache;
 };
 
 /**
@@ -1159,6 +1175,8 @@ class CV_EXPORTS TrackerMedianFlow : public Tracker
     Params();
     int pointsInGrid; //!<square root of number of keypoints used; increase it to trade
                       //!<accurateness for speed; default value is sensible and recommended
+    bool cachePyramids; //!<keep the previous frame's image pyramid between updates, so that only the new frame's
+                        //!<pyramid is built per update; results are identical, at the cost of keeping the pyramid
     void read( const FileNode& /*fn*/ );
     void write( FileStorage& /*fs*/ ) const;
   };
@@ -1449,6 +1467,46 @@ public:
 	bool update_opt(const Mat& image);
 };
 
+/** @brief Multi Object Tracker for KCF.
+
+Every target is tracked as with TrackerKCF, with the same parameters for all of them. The work that does not
+depend on the target is shared: the frame is downscaled, converted to grayscale and mapped to color-names
+indices once per update, targets with the same window size share their Hann windows and Gaussian responses,
+and the targets are updated in parallel. Custom feature extractors are not supported.
+
+@sa TrackerKCF, MultiTracker
+*/
+class CV_EXPORTS MultiTrackerKCF
+{
+public:
+	virtual ~MultiTrackerKCF() {}
+
+	/** @brief Constructor
+	@param parameters KCF parameters used for every target, see TrackerKCF::Params
+	*/
+	static Ptr<MultiTrackerKCF> create(const TrackerKCF::Params &parameters = TrackerKCF::Params());
+
+	/** @brief Add a new target to the tracking-list and initialize its tracker
+	@param image The current frame
+	@param boundingBox The bounding box of the target
+
+	@return True if the target was added
+	*/
+	virtual bool add(const Mat& image, const Rect2d& boundingBox) = 0;
+
+	/** @brief Update all the targets
+	@param image The current frame
+	@param boundingBox The bounding boxes of the targets, in the order they were added
+
+	@return True if all the targets were updated, false if the tracker of one of them failed
+	*/
+	virtual bool update(const Mat& image, std::vector<Rect2d>& boundingBox) = 0;
+
+	/** @brief Current number of targets in the tracking-list
+	*/
+	virtual int getTargetNum() const = 0;
+};
+
 //! @}
 
 } /* namespace cv */
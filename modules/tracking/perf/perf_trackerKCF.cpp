@@ -0,0 +1,135 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+ //
+ //  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+ //
+ //  By downloading, copying, installing or using the software you agree to this license.
+ //  If you do not agree to this license, do not download, install,
+ //  copy or use the software.
+ //
+ //
+ //                           License Agreement
+ //                For Open Source Computer Vision Library
+ //
+ // Copyright (C) 2016, OpenCV Foundation, all rights reserved.
+ // Third party copyrights are property of their respective owners.
+ //
+ // Redistribution and use in source and binary forms, with or without modification,
+ // are permitted provided that the following conditions are met:
+ //
+ //   * Redistribution's of source code must retain the above copyright notice,
+ //     this list of conditions and the following disclaimer.
+ //
+ //   * Redistribution's in binary form must reproduce the above copyright notice,
+ //     this list of conditions and the following disclaimer in the documentation
+ //     and/or other materials provided with the distribution.
+ //
+ //   * The name of the copyright holders may not be used to endorse or promote products
+ //     derived from this software without specific prior written permission.
+ //
+ // This software is provided by the copyright holders and contributors "as is" and
+ // any express or implied warranties, including, but not limited to, the implied
+ // warranties of merchantability and fitness for a particular purpose are disclaimed.
+ // In no event shall the Intel Corporation or contributors be liable for any direct,
+ // indirect, incidental, special, exemplary, or consequential damages
+ // (including, but not limited to, procurement of substitute goods or services;
+ // loss of use, data, or profits; or business interruption) however caused
+ // and on any theory of liability, whether in contract, strict liability,
+ // or tort (including negligence or otherwise) arising in any way out of
+ // the use of this software, even if advised of the possibility of such damage.
+ //
+ //M*/
+
+
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace perf;
+
+typedef perf::TestBaseWithParam<int> kcf;
+
+#define KCF_TARGET_SIZES testing::Values(32, 64, 128)
+
+// Counts the Mat buffers allocated while it is the default allocator
+class CountingMatAllocator : public MatAllocator
+{
+public:
+    CountingMatAllocator() : count(0), stdAllocator(Mat::getStdAllocator()) {}
+
+    UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, int flags, UMatUsageFlags usageFlags) const
+    {
+        CV_XADD(&count, 1);
+        return stdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(UMatData* u, int accessFlags, UMatUsageFlags usageFlags) const
+    {
+        return stdAllocator->allocate(u, accessFlags, usageFlags);
+    }
+
+    void deallocate(UMatData* u) const
+    {
+        stdAllocator->deallocate(u);
+    }
+
+    mutable int count;
+
+private:
+    MatAllocator* stdAllocator;
+};
+
+// Textured target moving back and forth over a textured background, the sequence can be replayed in a loop
+static void createKCFSequence(int targetSize, vector<Mat>& frames, Rect& initBox)
+{
+    RNG rng(0);
+    Mat background(480, 640, CV_8UC3), target(targetSize, targetSize, CV_8UC3);
+    rng.fill(background, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+    GaussianBlur(background, background, Size(9, 9), 3.0);
+    rng.fill(target, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+    GaussianBlur(target, target, Size(5, 5), 1.5);
+
+    const int halfPeriod = 20, step = 3;
+    initBox = Rect(200, 150, targetSize, targetSize);
+    for( int t = 0; t < 2 * halfPeriod; t++ )
+    {
+        int shift = step * (t < halfPeriod ? t : 2 * halfPeriod - t);
+        Mat frame = background.clone();
+        target.copyTo(frame(initBox + Point(shift, shift / 2)));
+        frames.push_back(frame);
+    }
+}
+
+PERF_TEST_P(kcf, update, KCF_TARGET_SIZES)
+{
+    vector<Mat> frames;
+    Rect initBox;
+    createKCFSequence(GetParam(), frames, initBox);
+
+    Rect2d box = initBox;
+    Ptr<TrackerKCF> tracker = TrackerKCF::createTracker();
+    ASSERT_TRUE(tracker->init(frames[0], box));
+
+    // the working buffers get their size on the first updates
+    size_t frameId = 0;
+    for( ; frameId < 3; frameId++ )
+        tracker->update(frames[frameId], box);
+
+    CountingMatAllocator allocator;
+    MatAllocator* defaultAllocator = Mat::getDefaultAllocator();
+    Mat::setDefaultAllocator(&allocator);
+
+    int updates = 0;
+    TEST_CYCLE()
+    {
+        tracker->update(frames[frameId], box);
+        frameId = (frameId + 1) % frames.size();
+        updates++;
+    }
+
+    Mat::setDefaultAllocator(defaultAllocator);
+    RecordProperty("frames", updates);
+    RecordProperty("mat_allocations", allocator.count);
+    RecordProperty("mat_allocations_per_frame", format("%.2f", (double)allocator.count / std::max(updates, 1)));
+
+    SANITY_CHECK_NOTHING();
+}
@@ -0,0 +1,392 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2013, OpenCV Foundation, all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+
+/*
+ * Benchmark of the trackers of the module over the VOT sequences.
+ *
+ * Every tracker runs over every sequence with the VOT protocol: it is initialized from the ground truth of the
+ * first frame, a frame with zero overlap counts as a failure and the tracker is re-initialized a few frames later.
+ * For each tracker and sequence the harness reports the speed (FPS and update latency percentiles), the peak
+ * memory held in Mat buffers, the accuracy (mean overlap outside the burn-in frames after an initialization)
+ * and the number of failures. The results are written with FileStorage, so comparing two runs of the harness
+ * shows regressions of the module, e.g.
+ *
+ *     ./example_tracking_benchmark_vot /data/vot2015 --output=before.yml
+ */
+
+#include "opencv2/datasets/track_vot.hpp"
+#include <opencv2/core/utility.hpp>
+#include <opencv2/tracking.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define HAVE_GETRUSAGE
+#endif
+
+using namespace std;
+using namespace cv;
+using namespace cv::datasets;
+
+static const char* keys =
+{ "{@dataset_path |      | VOT dataset path                                     }"
+  "{output o      | tracking_benchmark.yml | output file (.yml or .xml)     }"
+  "{algorithms a  | MIL,BOOSTING,MEDIANFLOW,TLD,KCF | comma separated trackers }"
+  "{sequences s   | 0    | number of sequences to run, 0 for all                }"
+  "{frames f      | 0    | maximal number of frames per sequence, 0 for all     }"
+  "{skip          | 5    | frames skipped before re-initialization after failure }"
+  "{burnin        | 10   | frames after initialization excluded from accuracy   }"
+  "{help h        |      | print help                                           }"
+};
+
+// Tracks the bytes held in Mat buffers while it is the default allocator
+class PeakMatAllocator : public MatAllocator
+{
+public:
+    PeakMatAllocator() : live(0), peak(0), stdAllocator(Mat::getStdAllocator()) {}
+
+    UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, int flags, UMatUsageFlags usageFlags) const
+    {
+        UMatData* u = stdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (u)
+        {
+            u->currAllocator = this;
+            if (!data)
+            {
+                AutoLock lock(mutex);
+                live += u->size;
+                peak = std::max(peak, live);
+            }
+        }
+        return u;
+    }
+
+    bool allocate(UMatData* u, int accessFlags, UMatUsageFlags usageFlags) const
+    {
+        return stdAllocator->allocate(u, accessFlags, usageFlags);
+    }
+
+    void deallocate(UMatData* u) const
+    {
+        if (!u)
+            return;
+        if (!(u->flags & UMatData::USER_ALLOCATED))
+        {
+            AutoLock lock(mutex);
+            live -= u->size;
+        }
+        u->currAllocator = stdAllocator;
+        stdAllocator->deallocate(u);
+    }
+
+    // restarts the peak from the bytes currently held
+    void resetPeak() { AutoLock lock(mutex); peak = live; }
+    size_t getLive() const { AutoLock lock(mutex); return live; }
+    size_t getPeak() const { AutoLock lock(mutex); return peak; }
+
+private:
+    mutable Mutex mutex;
+    mutable size_t live, peak;
+    MatAllocator* stdAllocator;
+};
+
+struct RunResult
+{
+    string algorithm;
+    int sequence;
+    int frames;                 // frames passed to update()
+    vector<double> latencies;   // update() times, ms
+    double overlapSum;
+    int overlapFrames;
+    int failures;
+    size_t matPeakBytes;
+};
+
+static Rect2d gtToRect(const vector<Point2d>& gt)
+{
+    if (gt.empty())
+        return Rect2d();
+    double x0 = gt[0].x, y0 = gt[0].y, x1 = x0, y1 = y0;
+    for (size_t i = 1; i < gt.size(); i++)
+    {
+        x0 = std::min(x0, gt[i].x); y0 = std::min(y0, gt[i].y);
+        x1 = std::max(x1, gt[i].x); y1 = std::max(y1, gt[i].y);
+    }
+    return Rect2d(x0, y0, x1 - x0, y1 - y0);
+}
+
+static double overlap(const Rect2d& r1, const Rect2d& r2)
+{
+    double a0 = (r1 & r2).area();
+    double a = r1.area() + r2.area() - a0;
+    return a > 0 ? a0 / a : 0.0;
+}
+
+static double percentile(vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    size_t k = std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+static RunResult runSequence(const Ptr<TRACK_vot>& dataset, const string& algorithm, int sequence, int maxFrames,
+                             int skip, int burnin, PeakMatAllocator& allocator)
+{
+    RunResult res;
+    res.algorithm = algorithm;
+    res.sequence = sequence;
+    res.frames = 0;
+    res.overlapSum = 0;
+    res.overlapFrames = 0;
+    res.failures = 0;
+
+    dataset->initDataset(sequence);
+    int length = dataset->getDatasetLength(sequence);
+    if (maxFrames > 0)
+        length = std::min(length, maxFrames);
+
+    allocator.resetPeak();
+    size_t baseline = allocator.getLive();
+
+    Ptr<Tracker> tracker;
+    Mat frame;
+    int initFrame = -1, restartFrame = 0;
+    for (int i = 0; i < length && dataset->getNextFrame(frame); i++)
+    {
+        Rect2d gt = gtToRect(dataset->getGT());
+        if (i < restartFrame)
+            continue;
+
+        if (!tracker)
+        {
+            if (gt.area() <= 0)
+            {
+                restartFrame = i + 1;
+                continue;
+            }
+            tracker = Tracker::create(algorithm);
+            CV_Assert(tracker);
+            if (!tracker->init(frame, gt))
+            {
+                tracker.release();
+                restartFrame = i + 1;
+                continue;
+            }
+            initFrame = i;
+            continue;
+        }
+
+        Rect2d box;
+        int64 start = getTickCount();
+        bool ok = tracker->update(frame, box);
+        res.latencies.push_back((getTickCount() - start) * 1000.0 / getTickFrequency());
+        res.frames++;
+
+        double o = ok ? overlap(box, gt) : 0.0;
+        if (o <= 0 && gt.area() > 0)
+        {
+            res.failures++;
+            tracker.release();
+            restartFrame = i + skip;
+            continue;
+        }
+        if (gt.area() > 0 && i - initFrame > burnin)
+        {
+            res.overlapSum += o;
+            res.overlapFrames++;
+        }
+    }
+    tracker.release();
+    res.matPeakBytes = allocator.getPeak() - baseline;
+    return res;
+}
+
+static void writeStats(FileStorage& fs, const vector<double>& latencies, int frames, double overlapSum, int overlapFrames,
+                       int failures, size_t matPeakBytes)
+{
+    double total = 0;
+    for (size_t i = 0; i < latencies.size(); i++)
+        total += latencies[i];
+    fs << "frames" << frames;
+    fs << "fps" << (total > 0 ? 1000.0 * frames / total : 0.0);
+    fs << "latency_ms" << "{";
+    fs << "mean" << (frames > 0 ? total / frames : 0.0);
+    fs << "p50" << percentile(latencies, 0.5);
+    fs << "p90" << percentile(latencies, 0.9);
+    fs << "p99" << percentile(latencies, 0.99);
+    fs << "max" << (latencies.empty() ? 0.0 : *std::max_element(latencies.begin(), latencies.end()));
+    fs << "}";
+    fs << "accuracy" << (overlapFrames > 0 ? overlapSum / overlapFrames : 0.0);
+    fs << "failures" << failures;
+    fs << "mat_peak_bytes" << (double)matPeakBytes;
+}
+
+int main(int argc, char *argv[])
+{
+    CommandLineParser parser(argc, argv, keys);
+    parser.about("Benchmark of the tracking module over the VOT dataset");
+    string datasetPath = parser.get<string>(0);
+    if (parser.has("help") || datasetPath.empty())
+    {
+        parser.printMessage();
+        return datasetPath.empty() ? -1 : 0;
+    }
+    string output = parser.get<string>("output");
+    string algorithmsList = parser.get<string>("algorithms");
+    int maxSequences = parser.get<int>("sequences");
+    int maxFrames = parser.get<int>("frames");
+    int skip = std::max(parser.get<int>("skip"), 1);
+    int burnin = std::max(parser.get<int>("burnin"), 0);
+    if (!parser.check())
+    {
+        parser.printErrors();
+        return -1;
+    }
+
+    vector<string> algorithms;
+    for (size_t pos = 0; pos < algorithmsList.size(); )
+    {
+        size_t end = algorithmsList.find(',', pos);
+        if (end == string::npos)
+            end = algorithmsList.size();
+        if (end > pos)
+            algorithms.push_back(algorithmsList.substr(pos, end - pos));
+        pos = end + 1;
+    }
+
+    Ptr<TRACK_vot> dataset = TRACK_vot::create();
+    dataset->load(datasetPath);
+    int numSequences = dataset->getDatasetsNum();
+    if (maxSequences > 0)
+        numSequences = std::min(numSequences, maxSequences);
+    if (numSequences == 0)
+    {
+        cout << "No sequences found in " << datasetPath << endl;
+        return -1;
+    }
+
+    FileStorage fs(output, FileStorage::WRITE);
+    if (!fs.isOpened())
+    {
+        cout << "Can't open " << output << " for writing" << endl;
+        return -1;
+    }
+
+    // static, so that it outlives the buffers the library keeps until exit
+    static PeakMatAllocator allocator;
+    Mat::setDefaultAllocator(&allocator);
+
+    fs << "dataset" << datasetPath;
+    fs << "threads" << getNumThreads();
+    fs << "trackers" << "[";
+    cout << left << setw(12) << "tracker" << right << setw(10) << "fps" << setw(10) << "p50 ms" << setw(10) << "p99 ms"
+         << setw(10) << "accuracy" << setw(10) << "failures" << endl;
+    for (size_t a = 0; a < algorithms.size(); a++)
+    {
+        if (!Tracker::create(algorithms[a]))
+        {
+            cout << "Unknown tracker " << algorithms[a] << ", skipped" << endl;
+            continue;
+        }
+
+        vector<RunResult> runs;
+        vector<double> latencies;
+        int frames = 0, overlapFrames = 0, failures = 0;
+        double overlapSum = 0;
+        size_t matPeakBytes = 0;
+        for (int s = 1; s <= numSequences; s++)
+        {
+            runs.push_back(runSequence(dataset, algorithms[a], s, maxFrames, skip, burnin, allocator));
+            const RunResult& r = runs.back();
+            latencies.insert(latencies.end(), r.latencies.begin(), r.latencies.end());
+            frames += r.frames;
+            overlapSum += r.overlapSum;
+            overlapFrames += r.overlapFrames;
+            failures += r.failures;
+            matPeakBytes = std::max(matPeakBytes, r.matPeakBytes);
+        }
+
+        fs << "{" << "name" << algorithms[a];
+        writeStats(fs, latencies, frames, overlapSum, overlapFrames, failures, matPeakBytes);
+        fs << "sequences" << "[";
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            fs << "{" << "id" << runs[i].sequence;
+            writeStats(fs, runs[i].latencies, runs[i].frames, runs[i].overlapSum, runs[i].overlapFrames, runs[i].failures,
+                       runs[i].matPeakBytes);
+            fs << "}";
+        }
+        fs << "]" << "}";
+
+        double total = 0;
+        for (size_t i = 0; i < latencies.size(); i++)
+            total += latencies[i];
+        cout << left << setw(12) << algorithms[a] << right << fixed << setprecision(2)
+             << setw(10) << (total > 0 ? 1000.0 * frames / total : 0.0)
+             << setw(10) << percentile(latencies, 0.5) << setw(10) << percentile(latencies, 0.99)
+             << setw(10) << (overlapFrames > 0 ? overlapSum / overlapFrames : 0.0) << setw(10) << failures << endl;
+    }
+    fs << "]";
+
+#ifdef HAVE_GETRUSAGE
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+        double peakRssKb = usage.ru_maxrss / 1024.0;
+#else
+        double peakRssKb = (double)usage.ru_maxrss;
+#endif
+        fs << "process_peak_rss_kb" << peakRssKb;
+    }
+#endif
+    fs.release();
+    Mat::setDefaultAllocator(0);
+
+    cout << "Results written to " << output << endl;
+    return 0;
+}
@@ -62,6 +62,33 @@ namespace cv
 			return p;
 		}
 
+		// Calculate offsets of all the classifiers for an image with the given row step
+		void TLDDetector::computeOffsets(int rowstep, std::vector<Point2i>& ofs) const
+		{
+			int total = 0;
+			for (int k = 0; k < (int)classifiers.size(); k++)
+				total += (int)classifiers[k].measurements.size();
+			ofs.resize(total);
+			for (int k = 0, pos = 0; k < (int)classifiers.size(); k++)
+			{
+				classifiers[k].computeOffsets(rowstep, &ofs[pos]);
+				pos += (int)classifiers[k].measurements.size();
+			}
+		}
+
+		// Same as above, with the offsets given by computeOffsets()
+		double TLDDetector::ensembleClassifierNum(const uchar* data, const Point2i* ofs) const
+		{
+			double p = 0;
+			for (int k = 0; k < (int)classifiers.size(); k++)
+			{
+				p += classifiers[k].posteriorProbabilityFast(data, ofs);
+				ofs += classifiers[k].measurements.size();
+			}
+			p /= classifiers.size();
+			return p;
+		}
+
 		// Calculate Relative similarity of the patch (NN-Model)
 		double TLDDetector::Sr(const Mat_<uchar>& patch)
 		{
@@ -214,6 +241,30 @@ namespace cv
 			return splus / (sminus + splus);
 		}
 
+		// Calculate Relative and Conservative similarities in one pass over the model, med is the median
+		// of the positive time stamps
+		void TLDDetector::SrSc(const Mat_<uchar>& patch, int med, double& sr, double& sc) const
+		{
+			double splus = 0.0, splusConservative = 0.0, sminus = 0.0;
+			Mat_<uchar> modelSample(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE, posExp->data);
+			for (int i = 0; i < *posNum; i++)
+			{
+				modelSample.data = &(posExp->data[i * 225]);
+				double s = 0.5 * (NCC(modelSample, patch) + 1.0);
+				splus = std::max(splus, s);
+				if ((int)(*timeStampsPositive)[i] <= med)
+					splusConservative = std::max(splusConservative, s);
+			}
+			for (int i = 0; i < *negNum; i++)
+			{
+				modelSample.data = &(negExp->data[i * 225]);
+				sminus = std::max(sminus, 0.5 * (NCC(modelSample, patch) + 1.0));
+			}
+
+			sr = (splus + sminus == 0.0) ? 0.0 : splus / (sminus + splus);
+			sc = (splusConservative + sminus == 0.0) ? 0.0 : splusConservative / (sminus + splusConservative);
+		}
+
 #ifdef HAVE_OPENCL
 		double TLDDetector::ocl_Sc(const Mat_<uchar>& patch)
 		{
@@ -296,107 +347,253 @@ namespace cv
 			}
 		}
 
-		//Detection - returns most probable new target location (Max Sc)
+		// Number of scan-grid columns evaluated by one task of the detection cascade
+		static const int SCAN_BAND_COLUMNS = 8;
 
-		bool TLDDetector::detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches, Size initSize)
+		// Pyramid level of the scan grid
+		struct ScanLevel
 		{
-			patches.clear();
-			Mat_<uchar> standardPatch(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE);
-			Mat tmp;
-			int dx = initSize.width / 10, dy = initSize.height / 10;
-			Size2d size = img.size();
-			double scale = 1.0;
-			int npos = 0, nneg = 0;
-			double maxSc = -5.0;
-			Rect2d maxScRect;
-			int scaleID;
-			std::vector <Mat> resized_imgs, blurred_imgs;
-			std::vector <Point> varBuffer, ensBuffer;
-			std::vector <int> varScaleIDs, ensScaleIDs;
+			Mat resized, blurred;
+			Mat_<double> intImgP, intImgP2;
+			int gridCols, gridRows;
+		};
 
-			//Detection part
-			//Generate windows and filter by variance
-			scaleID = 0;
-			resized_imgs.push_back(img);
-			blurred_imgs.push_back(imgBlurred);
-			do
+		class BuildScanLevelsInvoker : public ParallelLoopBody
+		{
+		public:
+			BuildScanLevelsInvoker(const Mat& img, const std::vector<Size2d>& sizes, std::vector<ScanLevel>& levels) :
+				img_(img), sizes_(sizes), levels_(levels)
 			{
-				Mat_<double> intImgP, intImgP2;
-				computeIntegralImages(resized_imgs[scaleID], intImgP, intImgP2);
-				for (int i = 0, imax = cvFloor((0.0 + resized_imgs[scaleID].cols - initSize.width) / dx); i < imax; i++)
+			}
+
+			virtual void operator()(const Range& range) const
+			{
+				for (int s = range.start; s < range.end; s++)
 				{
-					for (int j = 0, jmax = cvFloor((0.0 + resized_imgs[scaleID].rows - initSize.height) / dy); j < jmax; j++)
+					ScanLevel& level = levels_[s];
+					if (s > 0)
 					{
-						if (!patchVariance(intImgP, intImgP2, originalVariancePtr, Point(dx * i, dy * j), initSize))
-							continue;
-						varBuffer.push_back(Point(dx * i, dy * j));
-						varScaleIDs.push_back(scaleID);
+						resize(img_, level.resized, sizes_[s], 0, 0, DOWNSCALE_MODE);
+						GaussianBlur(level.resized, level.blurred, GaussBlurKernelSize, 0.0f);
 					}
+					TLDDetector::computeIntegralImages(level.resized, level.intImgP, level.intImgP2);
 				}
-				scaleID++;
-				size.width /= SCALE_STEP;
-				size.height /= SCALE_STEP;
-				scale *= SCALE_STEP;
-				resize(img, tmp, size, 0, 0, DOWNSCALE_MODE);
-				resized_imgs.push_back(tmp);
-				GaussianBlur(resized_imgs[scaleID], tmp, GaussBlurKernelSize, 0.0f);
-				blurred_imgs.push_back(tmp);
-			} while (size.width >= initSize.width && size.height >= initSize.height);
+			}
 
-			//Encsemble classification
-			for (int i = 0; i < (int)varBuffer.size(); i++)
+		private:
+			const Mat& img_;
+			const std::vector<Size2d>& sizes_;
+			std::vector<ScanLevel>& levels_;
+		};
+
+		// Variance and ensemble filters over bands of scan-grid columns. Every task is a (level, first column,
+		// last column) triplet and writes the accepted windows of detector k to windows[task * detectors + k]
+		class ScanGridInvoker : public ParallelLoopBody
+		{
+		public:
+			ScanGridInvoker(const std::vector<ScanLevel>& levels, const std::vector<Vec3i>& tasks, const std::vector<TLDDetector*>& detectors,
+				const std::vector<std::vector<Point2i> >& offsets, Size initSize, std::vector<std::vector<Point> >& windows) :
+				levels_(levels), tasks_(tasks), detectors_(detectors), offsets_(offsets), initSize_(initSize), windows_(windows)
 			{
-				prepareClassifiers(static_cast<int> (blurred_imgs[varScaleIDs[i]].step[0]));
-				if (ensembleClassifierNum(&blurred_imgs[varScaleIDs[i]].at<uchar>(varBuffer[i].y, varBuffer[i].x)) <= ENSEMBLE_THRESHOLD)
-					continue;
-				ensBuffer.push_back(varBuffer[i]);
-				ensScaleIDs.push_back(varScaleIDs[i]);
+			}
+
+			virtual void operator()(const Range& range) const
+			{
+				int nd = (int)detectors_.size();
+				int dx = initSize_.width / 10, dy = initSize_.height / 10;
+				int width = initSize_.width, height = initSize_.height;
+				for (int t = range.start; t < range.end; t++)
+				{
+					const Vec3i& task = tasks_[t];
+					const ScanLevel& level = levels_[task[0]];
+					for (int i = task[1]; i < task[2]; i++)
+					{
+						for (int j = 0; j < level.gridRows; j++)
+						{
+							int x = dx * i, y = dy * j;
+							double A, B, C, D;
+
+							A = level.intImgP(y, x);
+							B = level.intImgP(y, x + width);
+							C = level.intImgP(y + height, x);
+							D = level.intImgP(y + height, x + width);
+							double p = (A + D - B - C) / (width * height);
+
+							A = level.intImgP2(y, x);
+							B = level.intImgP2(y, x + width);
+							C = level.intImgP2(y + height, x);
+							D = level.intImgP2(y + height, x + width);
+							double p2 = (A + D - B - C) / (width * height);
+							double windowVar = p2 - p * p;
+
+							const uchar* data = level.blurred.ptr<uchar>(y) + x;
+							for (int k = 0; k < nd; k++)
+							{
+								if (windowVar <= VARIANCE_THRESHOLD * *detectors_[k]->originalVariancePtr)
+									continue;
+								if (detectors_[k]->ensembleClassifierNum(data, &offsets_[task[0] * nd + k][0]) <= ENSEMBLE_THRESHOLD)
+									continue;
+								windows_[t * nd + k].push_back(Point(x, y));
+							}
+						}
+					}
+				}
+			}
+
+		private:
+			const std::vector<ScanLevel>& levels_;
+			const std::vector<Vec3i>& tasks_;
+			const std::vector<TLDDetector*>& detectors_;
+			const std::vector<std::vector<Point2i> >& offsets_;
+			Size initSize_;
+			std::vector<std::vector<Point> >& windows_;
+		};
+
+		// NN classification of the windows accepted by the ensemble, given as (detector, level, x, y).
+		// Every task resamples into its own standard patch
+		class NNClassifierInvoker : public ParallelLoopBody
+		{
+		public:
+			NNClassifierInvoker(const std::vector<ScanLevel>& levels, const std::vector<Vec4i>& candidates, const std::vector<TLDDetector*>& detectors,
+				const std::vector<int>& medians, Size initSize, std::vector<double>& srValues, std::vector<double>& scValues) :
+				levels_(levels), candidates_(candidates), detectors_(detectors), medians_(medians), initSize_(initSize),
+				srValues_(srValues), scValues_(scValues)
+			{
+			}
+
+			virtual void operator()(const Range& range) const
+			{
+				Mat_<uchar> standardPatch(STANDARD_PATCH_SIZE, STANDARD_PATCH_SIZE);
+				for (int i = range.start; i < range.end; i++)
+				{
+					const Vec4i& c = candidates_[i];
+					resample(levels_[c[1]].resized, Rect2d(Point(c[2], c[3]), initSize_), standardPatch);
+					detectors_[c[0]]->SrSc(standardPatch, medians_[c[0]], srValues_[i], scValues_[i]);
+				}
+			}
+
+		private:
+			const std::vector<ScanLevel>& levels_;
+			const std::vector<Vec4i>& candidates_;
+			const std::vector<TLDDetector*>& detectors_;
+			const std::vector<int>& medians_;
+			Size initSize_;
+			std::vector<double>& srValues_;
+			std::vector<double>& scValues_;
+		};
+
+		void TLDDetector::detectAll(const Mat& img, const Mat& imgBlurred, Size initSize, const std::vector<TLDDetector*>& detectors,
+			std::vector<Rect2d>& res, std::vector<std::vector<LabeledPatch> >& patches, std::vector<bool>& found)
+		{
+			int nd = (int)detectors.size();
+			int dx = initSize.width / 10, dy = initSize.height / 10;
+			for (int k = 0; k < nd; k++)
+				patches[k].clear();
+
+			//Detection part
+			//Build the pyramid, the original image is the first level
+			std::vector<Size2d> sizes(1, Size2d(img.size()));
+			for (;;)
+			{
+				Size2d next(sizes.back().width / SCALE_STEP, sizes.back().height / SCALE_STEP);
+				if (next.width < initSize.width || next.height < initSize.height)
+					break;
+				sizes.push_back(next);
+			}
+			std::vector<ScanLevel> levels(sizes.size());
+			levels[0].resized = img;
+			levels[0].blurred = imgBlurred;
+			parallel_for_(Range(0, (int)levels.size()), BuildScanLevelsInvoker(img, sizes, levels));
+
+			//Split every level into bands of columns
+			std::vector<std::vector<Point2i> > offsets(levels.size() * nd);
+			std::vector<Vec3i> tasks;
+			for (int s = 0; s < (int)levels.size(); s++)
+			{
+				ScanLevel& level = levels[s];
+				level.gridCols = cvFloor((0.0 + level.resized.cols - initSize.width) / dx);
+				level.gridRows = cvFloor((0.0 + level.resized.rows - initSize.height) / dy);
+				for (int k = 0; k < nd; k++)
+					detectors[k]->computeOffsets((int)level.blurred.step[0], offsets[s * nd + k]);
+				for (int i = 0; i < level.gridCols; i += SCAN_BAND_COLUMNS)
+					tasks.push_back(Vec3i(s, i, std::min(i + SCAN_BAND_COLUMNS, level.gridCols)));
+			}
+
+			//Filter by variance and ensemble
+			std::vector<std::vector<Point> > windows(tasks.size() * nd);
+			parallel_for_(Range(0, (int)tasks.size()), ScanGridInvoker(levels, tasks, detectors, offsets, initSize, windows));
+
+			//Gather the candidates detector by detector, in scan order
+			std::vector<Vec4i> candidates;
+			std::vector<int> medians(nd, 0);
+			for (int k = 0; k < nd; k++)
+			{
+				size_t first = candidates.size();
+				for (int t = 0; t < (int)tasks.size(); t++)
+				{
+					const std::vector<Point>& w = windows[t * nd + k];
+					for (int i = 0; i < (int)w.size(); i++)
+						candidates.push_back(Vec4i(k, tasks[t][0], w[i].x, w[i].y));
+				}
+				if (candidates.size() > first)
+					medians[k] = getMedian(*detectors[k]->timeStampsPositive);
 			}
 
 			//NN classification
-			for (int i = 0; i < (int)ensBuffer.size(); i++)
+			std::vector<double> srValues(candidates.size()), scValues(candidates.size());
+			parallel_for_(Range(0, (int)candidates.size()), NNClassifierInvoker(levels, candidates, detectors, medians, initSize, srValues, scValues));
+
+			std::vector<double> maxSc(nd, -5.0);
+			std::vector<Rect2d> maxScRect(nd);
+			for (int i = 0; i < (int)candidates.size(); i++)
 			{
+				int k = candidates[i][0];
 				LabeledPatch labPatch;
-				double curScale = pow(SCALE_STEP, ensScaleIDs[i]);
-				labPatch.rect = Rect2d(ensBuffer[i].x*curScale, ensBuffer[i].y*curScale, initSize.width * curScale, initSize.height * curScale);
-				resample(resized_imgs[ensScaleIDs[i]], Rect2d(ensBuffer[i], initSize), standardPatch);
-
-				double srValue, scValue;
-				srValue = Sr(standardPatch);
+				double curScale = pow(SCALE_STEP, candidates[i][1]);
+				labPatch.rect = Rect2d(candidates[i][2] * curScale, candidates[i][3] * curScale, initSize.width * curScale, initSize.height * curScale);
+				double srValue = srValues[i];
 
 				////To fix: Check the paper, probably this cause wrong learning
 				//
 				labPatch.isObject = srValue > THETA_NN;
 				labPatch.shouldBeIntegrated = abs(srValue - THETA_NN) < 0.1;
-				patches.push_back(labPatch);
+				patches[k].push_back(labPatch);
 				//
 
 				if (!labPatch.isObject)
-				{
-					nneg++;
 					continue;
-				}
-				else
+				if (scValues[i] > maxSc[k])
 				{
-					npos++;
-				}
-				scValue = Sc(standardPatch);
-				if (scValue > maxSc)
-				{
-					maxSc = scValue;
-					maxScRect = labPatch.rect;
+					maxSc[k] = scValues[i];
+					maxScRect[k] = labPatch.rect;
 				}
 			}
 
-			if (maxSc < 0)
-				return false;
-			else
+			for (int k = 0; k < nd; k++)
 			{
-				res = maxScRect;
-				return true;
+				found[k] = maxSc[k] >= 0;
+				if (found[k])
+					res[k] = maxScRect[k];
 			}
 		}
 
+		//Detection - returns most probable new target location (Max Sc)
+
+		bool TLDDetector::detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches, Size initSize)
+		{
+			std::vector<TLDDetector*> detectors(1, this);
+			std::vector<Rect2d> results(1, res);
+			std::vector<std::vector<LabeledPatch> > labeled(1);
+			std::vector<bool> found(1, false);
+
+			detectAll(img, imgBlurred, initSize, detectors, results, labeled, found);
+			patches.swap(labeled[0]);
+			if (!found[0])
+				return false;
+			res = results[0];
+			return true;
+		}
+
 #ifdef HAVE_OPENCL
 		bool TLDDetector::ocl_detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches, Size initSize)
 		{
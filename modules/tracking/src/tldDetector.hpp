@@ -74,9 +74,12 @@ namespace cv
 			TLDDetector(){}
 			~TLDDetector(){}
 			double ensembleClassifierNum(const uchar* data);
+			double ensembleClassifierNum(const uchar* data, const Point2i* ofs) const;
 			void prepareClassifiers(int rowstep);
+			void computeOffsets(int rowstep, std::vector<Point2i>& ofs) const;
 			double Sr(const Mat_<uchar>& patch);
 			double Sc(const Mat_<uchar>& patch);
+			void SrSc(const Mat_<uchar>& patch, int med, double& sr, double& sc) const;
 #ifdef HAVE_OPENCL
 			double ocl_Sr(const Mat_<uchar>& patch);
 			double ocl_Sc(const Mat_<uchar>& patch);
@@ -97,6 +100,10 @@ namespace cv
 				bool isObject, shouldBeIntegrated;
 			};
 			bool detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches, Size initSize);
+			// Runs several detectors over one scan grid: the pyramid and the window variances are computed once,
+			// res[k] is only updated for the detectors that found their target
+			static void detectAll(const Mat& img, const Mat& imgBlurred, Size initSize, const std::vector<TLDDetector*>& detectors,
+				std::vector<Rect2d>& res, std::vector<std::vector<LabeledPatch> >& patches, std::vector<bool>& found);
 			bool ocl_detect(const Mat& img, const Mat& imgBlurred, Rect2d& res, std::vector<LabeledPatch>& patches,  Size initSize);
 
 			friend class MyMouseCallbackDEBUG;
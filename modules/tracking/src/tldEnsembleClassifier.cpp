@@ -40,6 +40,7 @@
 //M*/
 
 #include "tldEnsembleClassifier.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -98,11 +99,18 @@ namespace cv
 			if (lastStep_ != rowstep)
 			{
 				lastStep_ = rowstep;
-				for (int i = 0; i < (int)offset.size(); i++)
-				{
-					offset[i].x = rowstep * measurements[i].val[2] + measurements[i].val[0];
-					offset[i].y = rowstep * measurements[i].val[3] + measurements[i].val[1];
-				}
+				computeOffsets(rowstep, &offset[0]);
+			}
+		}
+
+		// Calculate offsets for an image with the given row step without touching the cached ones,
+		// so that several pyramid levels can be classified concurrently
+		void TLDEnsembleClassifier::computeOffsets(int rowstep, Point2i* ofs) const
+		{
+			for (int i = 0; i < (int)measurements.size(); i++)
+			{
+				ofs[i].x = rowstep * measurements[i].val[2] + measurements[i].val[0];
+				ofs[i].y = rowstep * measurements[i].val[3] + measurements[i].val[1];
 			}
 		}
 
@@ -128,7 +136,11 @@ namespace cv
 		}
 		double TLDEnsembleClassifier::posteriorProbabilityFast(const uchar* data) const
 		{
-			int position = codeFast(data);
+			return posteriorProbabilityFast(data, &offset[0]);
+		}
+		double TLDEnsembleClassifier::posteriorProbabilityFast(const uchar* data, const Point2i* ofs) const
+		{
+			int position = codeFast(data, ofs);
 			double posNum = (double)posAndNeg[position].x, negNum = (double)posAndNeg[position].y;
 			if (posNum == 0.0 && negNum == 0.0)
 				return 0.0;
@@ -139,11 +151,31 @@ namespace cv
 		// Calculate the 13-bit fern index
 		int TLDEnsembleClassifier::codeFast(const uchar* data) const
 		{
+			return codeFast(data, &offset[0]);
+		}
+		int TLDEnsembleClassifier::codeFast(const uchar* data, const Point2i* ofs) const
+		{
+			int n = (int)measurements.size();
+#if CV_SIMD128
+			if (n <= v_uint8x16::nlanes)
+			{
+				// Gather the compared pixels in reverse order, so that the first measure ends up
+				// in the highest bit, and pack all the comparisons at once
+				uchar CV_DECL_ALIGNED(16) lhs[v_uint8x16::nlanes] = { 0 };
+				uchar CV_DECL_ALIGNED(16) rhs[v_uint8x16::nlanes] = { 0 };
+				for (int i = 0; i < n; i++)
+				{
+					lhs[n - 1 - i] = data[ofs[i].x];
+					rhs[n - 1 - i] = data[ofs[i].y];
+				}
+				return v_signmask(v_load_aligned(lhs) < v_load_aligned(rhs));
+			}
+#endif
 			int position = 0;
-			for (int i = 0; i < (int)measurements.size(); i++)
+			for (int i = 0; i < n; i++)
 			{
 				position = position << 1;
-				if (data[offset[i].x] < data[offset[i].y])
+				if (data[ofs[i].x] < data[ofs[i].y])
 					position++;
 			}
 			return position;
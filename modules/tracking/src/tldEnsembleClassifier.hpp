@@ -53,12 +53,15 @@ namespace cv
 			void integrate(const Mat_<uchar>& patch, bool isPositive);
 			double posteriorProbability(const uchar* data, int rowstep) const;
 			double posteriorProbabilityFast(const uchar* data) const;
+			double posteriorProbabilityFast(const uchar* data, const Point2i* ofs) const;
 			void prepareClassifier(int rowstep);
+			void computeOffsets(int rowstep, Point2i* ofs) const;
 
 			TLDEnsembleClassifier(const std::vector<Vec4b>& meas, int beg, int end);
 			static void stepPrefSuff(std::vector<Vec4b> & arr, int pos, int len, int gridSize);
 			int code(const uchar* data, int rowstep) const;
 			int codeFast(const uchar* data) const;
+			int codeFast(const uchar* data, const Point2i* ofs) const;
 			std::vector<Point2i> posAndNeg;
 			std::vector<Vec4b> measurements;
 			std::vector<Point2i> offset;
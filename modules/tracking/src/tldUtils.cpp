@@ -40,6 +40,7 @@
  //M*/
 
 #include "tldUtils.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 
 namespace cv
@@ -200,16 +201,54 @@ double NCC(const Mat_<uchar>& patch1, const Mat_<uchar>& patch2)
 
     int N = patch1.rows * patch1.cols;
     int s1 = 0, s2 = 0, n1 = 0, n2 = 0, prod = 0;
-    for( int i = 0; i < patch1.rows; i++ )
+    if( patch1.isContinuous() && patch2.isContinuous() )
     {
-        for( int j = 0; j < patch1.cols; j++ )
+        // Model samples and standard patches are stored densely, so both can be walked as one row
+        const uchar* data1 = patch1.ptr();
+        const uchar* data2 = patch2.ptr();
+        int i = 0;
+#if CV_SIMD128
+        v_int32x4 vs1 = v_setzero_s32(), vs2 = v_setzero_s32();
+        v_int32x4 vn1 = v_setzero_s32(), vn2 = v_setzero_s32(), vprod = v_setzero_s32();
+        v_int16x8 one = v_setall_s16(1);
+        for( ; i <= N - v_uint8x16::nlanes; i += v_uint8x16::nlanes )
         {
-            int p1 = patch1(i, j), p2 = patch2(i, j);
+            v_uint16x8 a0, a1, b0, b1;
+            v_expand(v_load(data1 + i), a0, a1);
+            v_expand(v_load(data2 + i), b0, b1);
+            v_int16x8 p10 = v_reinterpret_as_s16(a0), p11 = v_reinterpret_as_s16(a1);
+            v_int16x8 p20 = v_reinterpret_as_s16(b0), p21 = v_reinterpret_as_s16(b1);
+            vs1 += v_dotprod(p10, one) + v_dotprod(p11, one);
+            vs2 += v_dotprod(p20, one) + v_dotprod(p21, one);
+            vn1 += v_dotprod(p10, p10) + v_dotprod(p11, p11);
+            vn2 += v_dotprod(p20, p20) + v_dotprod(p21, p21);
+            vprod += v_dotprod(p10, p20) + v_dotprod(p11, p21);
+        }
+        s1 = v_reduce_sum(vs1); s2 = v_reduce_sum(vs2);
+        n1 = v_reduce_sum(vn1); n2 = v_reduce_sum(vn2);
+        prod = v_reduce_sum(vprod);
+#endif
+        for( ; i < N; i++ )
+        {
+            int p1 = data1[i], p2 = data2[i];
             s1 += p1; s2 += p2;
             n1 += (p1 * p1); n2 += (p2 * p2);
             prod += (p1 * p2);
         }
     }
+    else
+    {
+        for( int i = 0; i < patch1.rows; i++ )
+        {
+            for( int j = 0; j < patch1.cols; j++ )
+            {
+                int p1 = patch1(i, j), p2 = patch2(i, j);
+                s1 += p1; s2 += p2;
+                n1 += (p1 * p1); n2 += (p2 * p2);
+                prod += (p1 * p2);
+            }
+        }
+    }
     double sq1 = sqrt(std::max(0.0, n1 - 1.0 * s1 * s1 / N)), sq2 = sqrt(std::max(0.0, n2 - 1.0 * s2 * s2 / N));
     double ares = (sq2 == 0) ? sq1 / abs(sq1) : (prod - s1 * s2 / N) / sq1 / sq2;
     return ares;
@@ -40,6 +40,7 @@
  //M*/
 
 #include "precomp.hpp"
+#include <map>
 
 namespace cv
 {
@@ -159,6 +160,49 @@ TrackerFeatureHAAR::Params::Params()
   isIntegral = false;
 }
 
+/*
+ * Responses of the samples evaluated on one integral image, indexed by the position and size of the sample in it
+ */
+struct TrackerFeatureHAAR::ResponseCache
+{
+  typedef std::pair<size_t, std::pair<int, int> > Key;
+
+  Mat image;                      // holds the sampled buffer, so that it can't be reallocated under the cache
+  std::map<Key, int> index;       // sample -> position of its responses in values
+  std::vector<float> values;      // numFeatures responses per cached sample
+
+  void clear()
+  {
+    image.release();
+    index.clear();
+    values.clear();
+  }
+
+  static Key key( const Mat& sample )
+  {
+    return Key( (size_t)( sample.data - sample.datastart ), std::make_pair( sample.cols, sample.rows ) );
+  }
+
+  // the cache only holds samples of one refcounted buffer; it restarts when samples of another one arrive
+  bool accepts( const Mat& sample )
+  {
+    if( !sample.u )
+      return false;
+    if( image.datastart != sample.datastart )
+    {
+      clear();
+      image = sample;
+    }
+    return true;
+  }
+
+  const float* find( const Mat& sample ) const
+  {
+    std::map<Key, int>::const_iterator it = index.find( key( sample ) );
+    return it == index.end() ? 0 : &values[it->second];
+  }
+};
+
 TrackerFeatureHAAR::TrackerFeatureHAAR( const TrackerFeatureHAAR::Params &parameters ) :
     params( parameters )
 {
@@ -169,6 +213,9 @@ TrackerFeatureHAAR::TrackerFeatureHAAR( const TrackerFeatureHAAR::Params &parame
   haarParams.isIntegral = params.isIntegral;
   featureEvaluator = CvFeatureEvaluator::create( CvFeatureParams::HAAR ).staticCast<CvHaarEvaluator>();
   featureEvaluator->init( &haarParams, 1, params.rectSize );
+
+  cacheEnabled = false;
+  cache = Ptr<ResponseCache>( new ResponseCache() );
 }
 
 TrackerFeatureHAAR::~TrackerFeatureHAAR()
@@ -178,12 +225,15 @@ TrackerFeatureHAAR::~TrackerFeatureHAAR()
 
 CvHaarEvaluator::FeatureHaar& TrackerFeatureHAAR::getFeatureAt( int id )
 {
+  //the caller may modify the feature
+  cache->clear();
   return featureEvaluator->getFeatures( id );
 }
 
 bool TrackerFeatureHAAR::swapFeature( int id, CvHaarEvaluator::FeatureHaar& feature )
 {
   featureEvaluator->getFeatures( id ) = feature;
+  cache->clear();
   return true;
 }
 
@@ -192,78 +242,94 @@ bool TrackerFeatureHAAR::swapFeature( int source, int target )
   CvHaarEvaluator::FeatureHaar feature = featureEvaluator->getFeatures( source );
   featureEvaluator->getFeatures( source ) = featureEvaluator->getFeatures( target );
   featureEvaluator->getFeatures( target ) = feature;
+  cache->clear();
   return true;
 }
 
-bool TrackerFeatureHAAR::extractSelected( const std::vector<int> selFeatures, const std::vector<Mat>& images, Mat& response )
+void TrackerFeatureHAAR::setCacheEnabled( bool enabled )
 {
-  if( images.empty() )
-  {
-    return false;
-  }
-
-  int numFeatures = featureEvaluator->getNumFeatures();
-  int numSelFeatures = (int)selFeatures.size();
-
-  //response = Mat_<float>( Size( images.size(), numFeatures ) );
-  response.create( Size( (int)images.size(), numFeatures ), CV_32F );
-  response.setTo( 0 );
-
-  //double t = getTickCount();
-  //for each sample compute #n_feature -> put each feature (n Rect) in response
-  for ( size_t i = 0; i < images.size(); i++ )
-  {
-    int c = images[i].cols;
-    int r = images[i].rows;
-    for ( int j = 0; j < numSelFeatures; j++ )
-    {
-      float res = 0;
-      //const feat
-      CvHaarEvaluator::FeatureHaar& feature = featureEvaluator->getFeatures( selFeatures[j] );
-      feature.eval( images[i], Rect( 0, 0, c, r ), &res );
-      //( Mat_<float>( response ) )( j, i ) = res;
-      response.at<float>( selFeatures[j], (int)i ) = res;
-    }
-  }
-  //t = ( (double) getTickCount() - t ) / getTickFrequency();
-  //std::cout << "StrongClassifierDirectSelection time " << t << std::endl;
+  cacheEnabled = enabled;
+  if( !enabled )
+    cache->clear();
+}
 
-  return true;
+void TrackerFeatureHAAR::clearCache()
+{
+  cache->clear();
 }
 
+/*
+ * Evaluates the features (all of them, or the selected ones) on the listed samples, in parallel over the samples
+ */
 class Parallel_compute : public cv::ParallelLoopBody
 {
  private:
   Ptr<CvHaarEvaluator> featureEvaluator;
-  std::vector<Mat> images;
+  const std::vector<Mat>& images;
+  const std::vector<int>& samples;
+  const std::vector<int>* selFeatures;
   Mat response;
-  //std::vector<CvHaarEvaluator::FeatureHaar> features;
  public:
-  Parallel_compute( Ptr<CvHaarEvaluator>& fe, const std::vector<Mat>& img, Mat& resp ) :
+  Parallel_compute( Ptr<CvHaarEvaluator>& fe, const std::vector<Mat>& img, const std::vector<int>& sampleIdx, Mat& resp,
+                    const std::vector<int>* selected = 0 ) :
       featureEvaluator( fe ),
       images( img ),
+      samples( sampleIdx ),
+      selFeatures( selected ),
       response( resp )
   {
-
-    //features = featureEvaluator->getFeatures();
   }
 
   virtual void operator()( const cv::Range &r ) const
   {
-    for ( register int jf = r.start; jf != r.end; ++jf )
+    const std::vector<CvHaarEvaluator::FeatureHaar>& features = featureEvaluator->getFeatures();
+    int numFeatures = selFeatures ? (int)selFeatures->size() : (int)features.size();
+    for ( int k = r.start; k != r.end; ++k )
     {
-      int cols = images[jf].cols;
-      int rows = images[jf].rows;
-      for ( int j = 0; j < featureEvaluator->getNumFeatures(); j++ )
+      int jf = samples[k];
+      Rect roi( 0, 0, images[jf].cols, images[jf].rows );
+      for ( int j = 0; j < numFeatures; j++ )
       {
+        int id = selFeatures ? ( *selFeatures )[j] : j;
         float res = 0;
-        featureEvaluator->getFeatures()[j].eval( images[jf], Rect( 0, 0, cols, rows ), &res );
-        ( Mat_<float>( response ) )( j, jf ) = res;
+        features[id].eval( images[jf], roi, &res );
+        response.at<float>( id, jf ) = res;
       }
     }
   }
 };
 
+bool TrackerFeatureHAAR::extractSelected( const std::vector<int> selFeatures, const std::vector<Mat>& images, Mat& response )
+{
+  if( images.empty() )
+  {
+    return false;
+  }
+
+  int numFeatures = featureEvaluator->getNumFeatures();
+  int numSelFeatures = (int)selFeatures.size();
+
+  response.create( Size( (int)images.size(), numFeatures ), CV_32F );
+  response.setTo( 0 );
+
+  //for each sample compute #n_feature -> put each feature (n Rect) in response; cached samples are copied
+  std::vector<int> toCompute;
+  for ( int i = 0; i < (int)images.size(); i++ )
+  {
+    const float* cached = cacheEnabled && cache->accepts( images[i] ) ? cache->find( images[i] ) : 0;
+    if( !cached )
+    {
+      toCompute.push_back( i );
+      continue;
+    }
+    for ( int j = 0; j < numSelFeatures; j++ )
+      response.at<float>( selFeatures[j], i ) = cached[selFeatures[j]];
+  }
+  parallel_for_( Range( 0, (int)toCompute.size() ), Parallel_compute( featureEvaluator, images, toCompute, response, &selFeatures ) );
+
+  return true;
+}
+
 bool TrackerFeatureHAAR::computeImpl( const std::vector<Mat>& images, Mat& response )
 {
   if( images.empty() )
@@ -275,21 +341,35 @@ bool TrackerFeatureHAAR::computeImpl( const std::vector<Mat>& images, Mat& respo
 
   response = Mat_<float>( Size( (int)images.size(), numFeatures ) );
 
-  std::vector<CvHaarEvaluator::FeatureHaar> f = featureEvaluator->getFeatures();
+  //samples already evaluated on this frame are copied from the cache, the others are computed in parallel
+  std::vector<int> toCompute;
+  for ( int i = 0; i < (int)images.size(); i++ )
+  {
+    const float* cached = cacheEnabled && cache->accepts( images[i] ) ? cache->find( images[i] ) : 0;
+    if( !cached )
+    {
+      toCompute.push_back( i );
+      continue;
+    }
+    for ( int j = 0; j < numFeatures; j++ )
+      response.at<float>( j, i ) = cached[j];
+  }
+
   //for each sample compute #n_feature -> put each feature (n Rect) in response
-  parallel_for_( Range( 0, (int)images.size() ), Parallel_compute( featureEvaluator, images, response ) );
+  parallel_for_( Range( 0, (int)toCompute.size() ), Parallel_compute( featureEvaluator, images, toCompute, response ) );
 
-  /*for ( size_t i = 0; i < images.size(); i++ )
+  if( cacheEnabled )
   {
-    int c = images[i].cols;
-    int r = images[i].rows;
-    for ( int j = 0; j < numFeatures; j++ )
+    for ( size_t k = 0; k < toCompute.size(); k++ )
     {
-      float res = 0;
-      featureEvaluator->getFeatures( j ).eval( images[i], Rect( 0, 0, c, r ), &res );
-      ( Mat_<float>( response ) )( j, i ) = res;
+      const Mat& sample = images[toCompute[k]];
+      if( !cache->accepts( sample ) || cache->find( sample ) )
+        continue;
+      cache->index[ResponseCache::key( sample )] = (int)cache->values.size();
+      for ( int j = 0; j < numFeatures; j++ )
+        cache->values.push_back( response.at<float>( j, toCompute[k] ) );
     }
-  }*/
+  }
 
   return true;
 }
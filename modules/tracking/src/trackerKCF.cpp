@@ -40,6 +40,7 @@
  //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <complex>
 
 /*---------------------------
@@ -75,6 +76,13 @@ namespace cv{
     void write( FileStorage& /*fs*/ ) const;
     void setFeatureExtractor(void (*f)(const Mat, const Rect, Mat&), bool pca_func = false);
 
+    /*
+    * used by MultiTrackerKCF
+    */
+    bool track(const Mat& img, const Mat& gray, const Mat& cnIndex, Rect2d& boundingBox);
+    bool shareWindows(const TrackerKCFImpl& other);
+    bool isResized() const { return resizeImage; }
+
   protected:
      /*
     * basic functions and vars
@@ -88,21 +96,22 @@ namespace cv{
     * KCF functions and vars
     */
     void createHanningWindow(OutputArray dest, const cv::Size winSize, const int type) const;
-    void inline fft2(const Mat src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const;
-    void inline fft2(const Mat src, Mat & dest) const;
-    void inline ifft2(const Mat src, Mat & dest) const;
-    void inline pixelWiseMult(const std::vector<Mat> src1, const std::vector<Mat>  src2, std::vector<Mat>  & dest, const int flags, const bool conjB=false) const;
-    void inline sumChannels(std::vector<Mat> src, Mat & dest) const;
-    void inline updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix,double pca_rate, int compressed_sz,
-                                       std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat v) const;
-    void inline compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & data, Mat & compressed) const;
-    bool getSubWindow(const Mat img, const Rect roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc = GRAY) const;
-    bool getSubWindow(const Mat img, const Rect roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )) const;
-    void extractCN(Mat patch_data, Mat & cnFeatures) const;
-    void denseGaussKernel(const double sigma, const Mat , const Mat y_data, Mat & k_data,
-                          std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> xyf_v, Mat xy, Mat xyf ) const;
-    void calcResponse(const Mat alphaf_data, const Mat kf_data, Mat & response_data, Mat & spec_data) const;
-    void calcResponse(const Mat alphaf_data, const Mat alphaf_den_data, const Mat kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const;
+    void inline fft2(const Mat& src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const;
+    void inline fft2(const Mat& src, Mat & dest) const;
+    void inline ifft2(const Mat& src, Mat & dest) const;
+    void inline pixelWiseMult(const std::vector<Mat>& src1, const std::vector<Mat>& src2, std::vector<Mat>  & dest, const int flags, const bool conjB=false) const;
+    void inline sumChannels(const std::vector<Mat>& src, Mat & dest) const;
+    void inline updateProjectionMatrix(const Mat& src, Mat & old_cov,Mat &  proj_matrix,double pca_rate, int compressed_sz,
+                                       std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat& pca_data, Mat& new_cov, Mat& w, Mat& u, Mat& v);
+    void inline compress(const Mat& proj_matrix, const Mat& src, Mat & dest, Mat & compressed) const;
+    bool extractFeatures(const Mat& img, const Mat& gray, const Mat& cnIndex);
+    bool getSubWindow(const Mat& img, const Rect roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc = GRAY);
+    bool getSubWindow(const Mat& img, const Rect roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& ));
+    void extractCN(const Mat& cn_index, Mat & cnFeatures) const;
+    void denseGaussKernel(const double sigma, const Mat& x_data, const Mat& y_data, Mat & k_data,
+                          std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> & xyf_v, Mat & xy, Mat & xyf ) const;
+    void calcResponse(const Mat& alphaf_data, const Mat& kf_data, Mat & response_data, Mat & spec_data) const;
+    void calcResponse(const Mat& alphaf_data, const Mat& alphaf_den_data, const Mat& kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const;
 
     void shiftRows(Mat& mat) const;
     void shiftRows(Mat& mat, int n) const;
@@ -124,27 +133,31 @@ namespace cv{
     Mat response; // detection result
     Mat old_cov_mtx, proj_mtx; // for feature compression
 
-    // pre-defined Mat variables for optimization of private functions
+    // pre-defined Mat variables for optimization of private functions,
+    // they keep their size between frames so that the update does not allocate
     Mat spec, spec2;
     std::vector<Mat> layers;
     std::vector<Mat> vxf,vyf,vxyf;
     Mat xy_data,xyf_data;
-    Mat data_temp, compress_data;
+    Mat compress_data;
     std::vector<Mat> layers_pca_data;
     std::vector<Scalar> average_data;
-    Mat img_Patch;
+    Mat resized_img, gray_patch, cn_patch, hann_custom;
 
-    // storage for the extracted features, KRLS model, KRLS compressed model
-    Mat X[2],Z[2],Zc[2];
+    // storage for the extracted features, compressed features, KRLS model, KRLS compressed model
+    Mat X[2],Xc[2],Z[2],Zc[2];
 
-    // storage of the extracted features
+    // storage of the extracted features and of the patches they are extracted from
     std::vector<Mat> features_pca;
     std::vector<Mat> features_npca;
+    std::vector<Mat> patches_pca;
+    std::vector<Mat> patches_npca;
     std::vector<MODE> descriptors_pca;
     std::vector<MODE> descriptors_npca;
 
     // optimization variables for updateProjectionMatrix
     Mat data_pca, new_covar,w_data,u_data,vt_data;
+    Mat covar_mix, proj_vars, proj_tmp;
 
     // custom feature extractor
     bool use_custom_extractor_pca;
@@ -239,12 +252,14 @@ namespace cv{
     if((params.desc_npca & CN) == CN)descriptors_npca.push_back(CN);
     if(use_custom_extractor_npca)descriptors_npca.push_back(CUSTOM);
     features_npca.resize(descriptors_npca.size());
+    patches_npca.resize(descriptors_npca.size());
 
     // record the compressed descriptors
     if((params.desc_pca & GRAY) == GRAY)descriptors_pca.push_back(GRAY);
     if((params.desc_pca & CN) == CN)descriptors_pca.push_back(CN);
     if(use_custom_extractor_pca)descriptors_pca.push_back(CUSTOM);
     features_pca.resize(descriptors_pca.size());
+    patches_pca.resize(descriptors_pca.size());
 
     // accept only the available descriptor modes
     CV_Assert(
@@ -260,62 +275,125 @@ namespace cv{
     return true;
   }
 
+  /*
+   * Shares the hann windows and the gaussian response of a target with the same window size
+   */
+  bool TrackerKCFImpl::shareWindows(const TrackerKCFImpl& other){
+    if(roi.size() != other.roi.size())return false;
+    hann = other.hann;
+    hann_cn = other.hann_cn;
+    if(output_sigma == other.output_sigma){
+      y = other.y;
+      yf = other.yf;
+    }
+    return true;
+  }
+
+  /*
+   * Image a descriptor is extracted from: the precomputed grayscale or color-names index map when available
+   */
+  static inline const Mat& descriptorSource(TrackerKCF::MODE desc, const Mat& img, const Mat& gray, const Mat& cnIndex){
+    const Mat& precomputed = desc == TrackerKCF::CN ? cnIndex : gray;
+    return precomputed.empty() ? img : precomputed;
+  }
+
+  /*
+   * Index of every BGR pixel in the ColorNames table
+   */
+  static void computeCNIndex(const Mat& bgr, Mat& cnIndex, const Range& rows){
+    for(int i=rows.start;i<rows.end;i++){
+      const uchar* src = bgr.ptr<uchar>(i);
+      ushort* dst = cnIndex.ptr<ushort>(i);
+      int j=0;
+#if CV_SIMD128
+      for(;j<=bgr.cols-v_uint8x16::nlanes;j+=v_uint8x16::nlanes){
+        v_uint8x16 b, g, r;
+        v_load_deinterleave(src+3*j, b, g, r);
+        v_uint16x8 b0, b1, g0, g1, r0, r1;
+        v_expand(b, b0, b1);
+        v_expand(g, g0, g1);
+        v_expand(r, r0, r1);
+        v_store(dst+j, ((b0 >> 3) << 10) | ((g0 >> 3) << 5) | (r0 >> 3));
+        v_store(dst+j+v_uint16x8::nlanes, ((b1 >> 3) << 10) | ((g1 >> 3) << 5) | (r1 >> 3));
+      }
+#endif
+      for(;j<bgr.cols;j++)
+        dst[j]=(ushort)(((src[3*j] >> 3) << 10) | ((src[3*j+1] >> 3) << 5) | (src[3*j+2] >> 3));
+    }
+  }
+
+  class CNIndexInvoker : public ParallelLoopBody{
+  public:
+    CNIndexInvoker(const Mat& bgr, Mat& cnIndex) : bgr_(bgr), cnIndex_(cnIndex){}
+    virtual void operator()(const Range& range) const{
+      computeCNIndex(bgr_, cnIndex_, range);
+    }
+  private:
+    const Mat& bgr_;
+    Mat& cnIndex_;
+  };
+
+  static void computeCNIndex(const Mat& bgr, Mat& cnIndex, bool parallel=false){
+    CV_Assert(bgr.type() == CV_8UC3);
+    cnIndex.create(bgr.size(), CV_16UC1);
+    if(parallel)
+      parallel_for_(Range(0,bgr.rows), CNIndexInvoker(bgr, cnIndex));
+    else
+      computeCNIndex(bgr, cnIndex, Range(0,bgr.rows));
+  }
+
   /*
    * Main part of the KCF algorithm
    */
   bool TrackerKCFImpl::updateImpl( const Mat& image, Rect2d& boundingBox ){
-    double minVal, maxVal;	// min-max response
-    Point minLoc,maxLoc;	// min-max location
-
-    Mat img=image.clone();
     // check the channels of the input image, grayscale is preferred
-    CV_Assert(img.channels() == 1 || img.channels() == 3);
+    CV_Assert(image.channels() == 1 || image.channels() == 3);
 
     // resize the image whenever needed
-    if(resizeImage)resize(img,img,Size(img.cols/2,img.rows/2));
+    if(resizeImage){
+      resize(image,resized_img,Size(image.cols/2,image.rows/2));
+      return track(resized_img, Mat(), Mat(), boundingBox);
+    }
+
+    return track(image, Mat(), Mat(), boundingBox);
+  }
+
+  /*
+   * Tracking on an image that is already resized, gray and cnIndex are its grayscale version and its color-names
+   * indices when they have been computed once for several targets, empty otherwise
+   */
+  bool TrackerKCFImpl::track(const Mat& img, const Mat& gray, const Mat& cnIndex, Rect2d& boundingBox){
+    double minVal, maxVal;	// min-max response
+    Point minLoc,maxLoc;	// min-max location
 
     // detection part
     if(frame>0){
 
       // extract and pre-process the patch
-      // get non compressed descriptors
-      for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
-        if(!getSubWindow(img,roi, features_npca[i], img_Patch, descriptors_npca[i]))return false;
-      }
-      //get non-compressed custom descriptors
-      for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
-        if(!getSubWindow(img,roi, features_npca[j], extractor_npca[i]))return false;
-      }
-      if(features_npca.size()>0)merge(features_npca,X[1]);
-
-      // get compressed descriptors
-      for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
-        if(!getSubWindow(img,roi, features_pca[i], img_Patch, descriptors_pca[i]))return false;
-      }
-      //get compressed custom descriptors
-      for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
-        if(!getSubWindow(img,roi, features_pca[j], extractor_pca[i]))return false;
-      }
-      if(features_pca.size()>0)merge(features_pca,X[0]);
+      if(!extractFeatures(img,gray,cnIndex))return false;
 
       //compress the features and the KRSL model
       if(params.desc_pca !=0){
-        compress(proj_mtx,X[0],X[0],data_temp,compress_data);
-        compress(proj_mtx,Z[0],Zc[0],data_temp,compress_data);
+        compress(proj_mtx,X[0],Xc[0],compress_data);
+        compress(proj_mtx,Z[0],Zc[0],compress_data);
+      }else{
+        Xc[0] = X[0];
+        Zc[0] = Z[0];
       }
 
       // copy the compressed KRLS model
+      Xc[1] = X[1];
       Zc[1] = Z[1];
 
       // merge all features
       if(features_npca.size()==0){
-        x = X[0];
+        x = Xc[0];
         z = Zc[0];
       }else if(features_pca.size()==0){
-        x = X[1];
-        z = Z[1];
+        x = Xc[1];
+        z = Zc[1];
       }else{
-        merge(X,2,x);
+        merge(Xc,2,x);
         merge(Zc,2,z);
       }
 
@@ -324,7 +402,6 @@ namespace cv{
 
       // compute the fourier transform of the kernel
       fft2(k,kf);
-      if(frame==1)spec2=Mat_<Vec2d >(kf.rows, kf.cols);
 
       // calculate filter response
       if(params.split_coeff)
@@ -345,33 +422,15 @@ namespace cv{
     boundingBox.height = (resizeImage?roi.height*2:roi.height)/2;
 
     // extract the patch for learning purpose
-    // get non compressed descriptors
-    for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
-      if(!getSubWindow(img,roi, features_npca[i], img_Patch, descriptors_npca[i]))return false;
-    }
-    //get non-compressed custom descriptors
-    for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
-      if(!getSubWindow(img,roi, features_npca[j], extractor_npca[i]))return false;
-    }
-    if(features_npca.size()>0)merge(features_npca,X[1]);
-
-    // get compressed descriptors
-    for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
-      if(!getSubWindow(img,roi, features_pca[i], img_Patch, descriptors_pca[i]))return false;
-    }
-    //get compressed custom descriptors
-    for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
-      if(!getSubWindow(img,roi, features_pca[j], extractor_pca[i]))return false;
-    }
-    if(features_pca.size()>0)merge(features_pca,X[0]);
+    if(!extractFeatures(img,gray,cnIndex))return false;
 
     //update the training data
     if(frame==0){
       Z[0] = X[0].clone();
       Z[1] = X[1].clone();
     }else{
-      Z[0]=(1.0-params.interp_factor)*Z[0]+params.interp_factor*X[0];
-      Z[1]=(1.0-params.interp_factor)*Z[1]+params.interp_factor*X[1];
+      if(!X[0].empty())addWeighted(Z[0],1.0-params.interp_factor,X[0],params.interp_factor,0.0,Z[0]);
+      if(!X[1].empty())addWeighted(Z[1],1.0-params.interp_factor,X[1],params.interp_factor,0.0,Z[1]);
     }
 
     if(params.desc_pca !=0 || use_custom_extractor_pca){
@@ -383,16 +442,19 @@ namespace cv{
 
       // feature compression
       updateProjectionMatrix(Z[0],old_cov_mtx,proj_mtx,params.pca_learning_rate,params.compressed_size,layers_pca_data,average_data,data_pca, new_covar,w_data,u_data,vt_data);
-      compress(proj_mtx,X[0],X[0],data_temp,compress_data);
+      compress(proj_mtx,X[0],Xc[0],compress_data);
+    }else{
+      Xc[0] = X[0];
     }
+    Xc[1] = X[1];
 
     // merge all features
     if(features_npca.size()==0)
-      x = X[0];
+      x = Xc[0];
     else if(features_pca.size()==0)
-      x = X[1];
+      x = Xc[1];
     else
-      merge(X,2,x);
+      merge(Xc,2,x);
 
     // initialize some required Mat variables
     if(frame==0){
@@ -408,7 +470,7 @@ namespace cv{
 
     // compute the fourier transform of the kernel and add a small value
     fft2(k,kf);
-    kf_lambda=kf+params.lambda;
+    add(kf,Scalar(params.lambda),kf_lambda);
 
     double den;
     if(params.split_coeff){
@@ -416,13 +478,14 @@ namespace cv{
       mulSpectrums(kf,kf_lambda,new_alphaf_den,0);
     }else{
       for(int i=0;i<yf.rows;i++){
+        const Vec2d* yf_row = yf.ptr<Vec2d>(i);
+        const Vec2d* kfl_row = kf_lambda.ptr<Vec2d>(i);
+        Vec2d* alphaf_row = new_alphaf.ptr<Vec2d>(i);
         for(int j=0;j<yf.cols;j++){
-          den = 1.0/(kf_lambda.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[0]+kf_lambda.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[1]);
+          den = 1.0/(kfl_row[j][0]*kfl_row[j][0]+kfl_row[j][1]*kfl_row[j][1]);
 
-          new_alphaf.at<Vec2d>(i,j)[0]=
-          (yf.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[0]+yf.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[1])*den;
-          new_alphaf.at<Vec2d>(i,j)[1]=
-          (yf.at<Vec2d>(i,j)[1]*kf_lambda.at<Vec2d>(i,j)[0]-yf.at<Vec2d>(i,j)[0]*kf_lambda.at<Vec2d>(i,j)[1])*den;
+          alphaf_row[j][0]=(yf_row[j][0]*kfl_row[j][0]+yf_row[j][1]*kfl_row[j][1])*den;
+          alphaf_row[j][1]=(yf_row[j][1]*kfl_row[j][0]-yf_row[j][0]*kfl_row[j][1])*den;
         }
       }
     }
@@ -432,14 +495,41 @@ namespace cv{
       alphaf=new_alphaf.clone();
       if(params.split_coeff)alphaf_den=new_alphaf_den.clone();
     }else{
-      alphaf=(1.0-params.interp_factor)*alphaf+params.interp_factor*new_alphaf;
-      if(params.split_coeff)alphaf_den=(1.0-params.interp_factor)*alphaf_den+params.interp_factor*new_alphaf_den;
+      addWeighted(alphaf,1.0-params.interp_factor,new_alphaf,params.interp_factor,0.0,alphaf);
+      if(params.split_coeff)addWeighted(alphaf_den,1.0-params.interp_factor,new_alphaf_den,params.interp_factor,0.0,alphaf_den);
     }
 
     frame++;
     return true;
   }
 
+  /*
+   * Extract the descriptors around the current roi, the compressed ones into X[0] and the others into X[1]
+   */
+  bool TrackerKCFImpl::extractFeatures(const Mat& img, const Mat& gray, const Mat& cnIndex){
+    // get non compressed descriptors
+    for(unsigned i=0;i<descriptors_npca.size()-extractor_npca.size();i++){
+      if(!getSubWindow(descriptorSource(descriptors_npca[i],img,gray,cnIndex),roi, features_npca[i], patches_npca[i], descriptors_npca[i]))return false;
+    }
+    //get non-compressed custom descriptors
+    for(unsigned i=0,j=(unsigned)(descriptors_npca.size()-extractor_npca.size());i<extractor_npca.size();i++,j++){
+      if(!getSubWindow(img,roi, features_npca[j], extractor_npca[i]))return false;
+    }
+    if(features_npca.size()>0)merge(features_npca,X[1]);
+
+    // get compressed descriptors
+    for(unsigned i=0;i<descriptors_pca.size()-extractor_pca.size();i++){
+      if(!getSubWindow(descriptorSource(descriptors_pca[i],img,gray,cnIndex),roi, features_pca[i], patches_pca[i], descriptors_pca[i]))return false;
+    }
+    //get compressed custom descriptors
+    for(unsigned i=0,j=(unsigned)(descriptors_pca.size()-extractor_pca.size());i<extractor_pca.size();i++,j++){
+      if(!getSubWindow(img,roi, features_pca[j], extractor_pca[i]))return false;
+    }
+    if(features_pca.size()>0)merge(features_pca,X[0]);
+
+    return true;
+  }
+
 
   /*-------------------------------------
   |  implementation of the KCF functions
@@ -486,11 +576,11 @@ namespace cv{
   /*
    * simplification of fourier transform function in opencv
    */
-  void inline TrackerKCFImpl::fft2(const Mat src, Mat & dest) const {
+  void inline TrackerKCFImpl::fft2(const Mat& src, Mat & dest) const {
     dft(src,dest,DFT_COMPLEX_OUTPUT);
   }
 
-  void inline TrackerKCFImpl::fft2(const Mat src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const {
+  void inline TrackerKCFImpl::fft2(const Mat& src, std::vector<Mat> & dest, std::vector<Mat> & layers_data) const {
     split(src, layers_data);
 
     for(int i=0;i<src.channels();i++){
@@ -501,14 +591,14 @@ namespace cv{
   /*
    * simplification of inverse fourier transform function in opencv
    */
-  void inline TrackerKCFImpl::ifft2(const Mat src, Mat & dest) const {
+  void inline TrackerKCFImpl::ifft2(const Mat& src, Mat & dest) const {
     idft(src,dest,DFT_SCALE+DFT_REAL_OUTPUT);
   }
 
   /*
    * Point-wise multiplication of two Multichannel Mat data
    */
-  void inline TrackerKCFImpl::pixelWiseMult(const std::vector<Mat> src1, const std::vector<Mat>  src2, std::vector<Mat>  & dest, const int flags, const bool conjB) const {
+  void inline TrackerKCFImpl::pixelWiseMult(const std::vector<Mat>& src1, const std::vector<Mat>& src2, std::vector<Mat>  & dest, const int flags, const bool conjB) const {
     for(unsigned i=0;i<src1.size();i++){
       mulSpectrums(src1[i], src2[i], dest[i],flags,conjB);
     }
@@ -517,61 +607,64 @@ namespace cv{
   /*
    * Combines all channels in a multi-channels Mat data into a single channel
    */
-  void inline TrackerKCFImpl::sumChannels(std::vector<Mat> src, Mat & dest) const {
-    dest=src[0].clone();
+  void inline TrackerKCFImpl::sumChannels(const std::vector<Mat>& src, Mat & dest) const {
+    src[0].copyTo(dest);
     for(unsigned i=1;i<src.size();i++){
-      dest+=src[i];
+      add(dest,src[i],dest);
     }
   }
 
   /*
    * obtains the projection matrix using PCA
    */
-  void inline TrackerKCFImpl::updateProjectionMatrix(const Mat src, Mat & old_cov,Mat &  proj_matrix, double pca_rate, int compressed_sz,
-                                                     std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat pca_data, Mat new_cov, Mat w, Mat u, Mat vt) const {
+  void inline TrackerKCFImpl::updateProjectionMatrix(const Mat& src, Mat & old_cov,Mat &  proj_matrix, double pca_rate, int compressed_sz,
+                                                     std::vector<Mat> & layers_pca,std::vector<Scalar> & average, Mat& pca_data, Mat& new_cov, Mat& w, Mat& u, Mat& vt) {
     CV_Assert(compressed_sz<=src.channels());
 
     split(src,layers_pca);
 
     for (int i=0;i<src.channels();i++){
       average[i]=mean(layers_pca[i]);
-      layers_pca[i]-=average[i];
+      subtract(layers_pca[i],average[i],layers_pca[i]);
     }
 
     // calc covariance matrix
     merge(layers_pca,pca_data);
-    pca_data=pca_data.reshape(1,src.rows*src.cols);
+    Mat pca_rows=pca_data.reshape(1,src.rows*src.cols);
 
-    new_cov=1.0/(double)(src.rows*src.cols-1)*(pca_data.t()*pca_data);
+    gemm(pca_rows,pca_rows,1.0/(double)(src.rows*src.cols-1),noArray(),0.0,new_cov,GEMM_1_T);
     if(old_cov.rows==0)old_cov=new_cov.clone();
 
     // calc PCA
-    SVD::compute((1.0-pca_rate)*old_cov+pca_rate*new_cov, w, u, vt);
+    addWeighted(old_cov,1.0-pca_rate,new_cov,pca_rate,0.0,covar_mix);
+    SVD::compute(covar_mix, w, u, vt);
 
     // extract the projection matrix
-    proj_matrix=u(Rect(0,0,compressed_sz,src.channels())).clone();
-    Mat proj_vars=Mat::eye(compressed_sz,compressed_sz,proj_matrix.type());
+    u(Rect(0,0,compressed_sz,src.channels())).copyTo(proj_matrix);
+    proj_vars.create(compressed_sz,compressed_sz,proj_matrix.type());
+    proj_vars.setTo(Scalar::all(0));
     for(int i=0;i<compressed_sz;i++){
       proj_vars.at<double>(i,i)=w.at<double>(i);
     }
 
     // update the covariance matrix
-    old_cov=(1.0-pca_rate)*old_cov+pca_rate*proj_matrix*proj_vars*proj_matrix.t();
+    gemm(proj_matrix,proj_vars,pca_rate,noArray(),0.0,proj_tmp);
+    gemm(proj_tmp,proj_matrix,1.0,old_cov,1.0-pca_rate,old_cov,GEMM_2_T);
   }
 
   /*
    * compress the features
    */
-  void inline TrackerKCFImpl::compress(const Mat proj_matrix, const Mat src, Mat & dest, Mat & data, Mat & compressed) const {
-    data=src.reshape(1,src.rows*src.cols);
-    compressed=data*proj_matrix;
-    dest=compressed.reshape(proj_matrix.cols,src.rows).clone();
+  void inline TrackerKCFImpl::compress(const Mat& proj_matrix, const Mat& src, Mat & dest, Mat & compressed) const {
+    Mat data=src.reshape(1,src.rows*src.cols);
+    gemm(data,proj_matrix,1.0,noArray(),0.0,compressed);
+    compressed.reshape(proj_matrix.cols,src.rows).copyTo(dest);
   }
 
   /*
    * obtain the patch and apply hann window filter to it
    */
-  bool TrackerKCFImpl::getSubWindow(const Mat img, const Rect _roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc) const {
+  bool TrackerKCFImpl::getSubWindow(const Mat& img, const Rect _roi, Mat& feat, Mat& patch, TrackerKCF::MODE desc) {
 
     Rect region=_roi;
 
@@ -590,8 +683,6 @@ namespace cv{
     if(region.width>img.cols)region.width=img.cols;
     if(region.height>img.rows)region.height=img.rows;
 
-    patch=img(region).clone();
-
     // add some padding to compensate when the patch is outside image border
     int addTop,addBottom, addLeft, addRight;
     addTop=region.y-_roi.y;
@@ -599,24 +690,30 @@ namespace cv{
     addLeft=region.x-_roi.x;
     addRight=(_roi.width+_roi.x>img.cols?_roi.width+_roi.x-img.cols:0);
 
-    copyMakeBorder(patch,patch,addTop,addBottom,addLeft,addRight,BORDER_REPLICATE);
+    // the patch buffer keeps its size from one frame to the next
+    copyMakeBorder(img(region),patch,addTop,addBottom,addLeft,addRight,BORDER_REPLICATE|BORDER_ISOLATED);
     if(patch.rows==0 || patch.cols==0)return false;
 
     // extract the desired descriptors
     switch(desc){
       case CN:
-        CV_Assert(img.channels() == 3);
-        extractCN(patch,feat);
-        feat=feat.mul(hann_cn); // hann window filter
+        if(patch.type() == CV_16UC1){
+          extractCN(patch,feat);
+        }else{
+          CV_Assert(img.channels() == 3);
+          computeCNIndex(patch,cn_patch);
+          extractCN(cn_patch,feat);
+        }
+        multiply(feat,hann_cn,feat); // hann window filter
         break;
       default: // GRAY
-        if(img.channels()>1)
-          cvtColor(patch,feat, CV_BGR2GRAY);
-        else
-          feat=patch;
-        feat.convertTo(feat,CV_64F);
-        feat=feat/255.0-0.5; // normalize to range -0.5 .. 0.5
-        feat=feat.mul(hann); // hann window filter
+        if(img.channels()>1){
+          cvtColor(patch,gray_patch, CV_BGR2GRAY);
+          gray_patch.convertTo(feat,CV_64F,1.0/255.0,-0.5); // normalize to range -0.5 .. 0.5
+        }else{
+          patch.convertTo(feat,CV_64F,1.0/255.0,-0.5);
+        }
+        multiply(feat,hann,feat); // hann window filter
         break;
     }
 
@@ -627,7 +724,7 @@ namespace cv{
   /*
    * get feature using external function
    */
-  bool TrackerKCFImpl::getSubWindow(const Mat img, const Rect _roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )) const{
+  bool TrackerKCFImpl::getSubWindow(const Mat& img, const Rect _roi, Mat& feat, void (*f)(const Mat, const Rect, Mat& )) {
 
     // return false if roi is outside the image
     if((_roi.x+_roi.width<0)
@@ -643,37 +740,30 @@ namespace cv{
       printf("Rules: roi.width==feat.cols && roi.height = feat.rows \n");
     }
 
-    Mat hann_win;
-    std::vector<Mat> _layers;
-
-    for(int i=0;i<feat.channels();i++)
-      _layers.push_back(hann);
-
-    merge(_layers, hann_win);
+    // the multi-channel window is kept for the next frames
+    if(hann_custom.channels() != feat.channels()){
+      std::vector<Mat> _layers(feat.channels(), hann);
+      merge(_layers, hann_custom);
+    }
 
-    feat=feat.mul(hann_win); // hann window filter
+    multiply(feat,hann_custom,feat); // hann window filter
 
     return true;
   }
 
-  /* Convert BGR to ColorNames
+  /* Convert ColorNames indices to ColorNames
    */
-  void TrackerKCFImpl::extractCN(Mat patch_data, Mat & cnFeatures) const {
-    Vec3b & pixel = patch_data.at<Vec3b>(0,0);
-    unsigned index;
-
-    if(cnFeatures.type() != CV_64FC(10))
-      cnFeatures = Mat::zeros(patch_data.rows,patch_data.cols,CV_64FC(10));
-
-    for(int i=0;i<patch_data.rows;i++){
-      for(int j=0;j<patch_data.cols;j++){
-        pixel=patch_data.at<Vec3b>(i,j);
-        index=(unsigned)(floor((float)pixel[2]/8)+32*floor((float)pixel[1]/8)+32*32*floor((float)pixel[0]/8));
+  void TrackerKCFImpl::extractCN(const Mat& cn_index, Mat & cnFeatures) const {
+    cnFeatures.create(cn_index.rows,cn_index.cols,CV_64FC(10));
 
+    for(int i=0;i<cn_index.rows;i++){
+      const ushort* index = cn_index.ptr<ushort>(i);
+      double* dst = cnFeatures.ptr<double>(i);
+      for(int j=0;j<cn_index.cols;j++,dst+=10){
         //copy the values
-        for(int _k=0;_k<10;_k++){
-          cnFeatures.at<Vec<double,10> >(i,j)[_k]=ColorNames[index][_k];
-        }
+        const double* cn = ColorNames[index[j]];
+        for(int _k=0;_k<10;_k++)
+          dst[_k]=cn[_k];
       }
     }
 
@@ -682,40 +772,48 @@ namespace cv{
   /*
    *  dense gauss kernel function
    */
-  void TrackerKCFImpl::denseGaussKernel(const double sigma, const Mat x_data, const Mat y_data, Mat & k_data,
-                                        std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> xyf_v, Mat xy, Mat xyf ) const {
+  void TrackerKCFImpl::denseGaussKernel(const double sigma, const Mat& x_data, const Mat& y_data, Mat & k_data,
+                                        std::vector<Mat> & layers_data,std::vector<Mat> & xf_data,std::vector<Mat> & yf_data, std::vector<Mat> & xyf_v, Mat & xy, Mat & xyf ) const {
     double normX, normY;
 
     fft2(x_data,xf_data,layers_data);
-    fft2(y_data,yf_data,layers_data);
-
     normX=norm(x_data);
     normX*=normX;
-    normY=norm(y_data);
-    normY*=normY;
 
-    pixelWiseMult(xf_data,yf_data,xyf_v,0,true);
+    // the auto-correlation used for training transforms the features only once
+    bool autoCorrelation = x_data.data == y_data.data;
+    if(autoCorrelation){
+      normY=normX;
+    }else{
+      fft2(y_data,yf_data,layers_data);
+      normY=norm(y_data);
+      normY*=normY;
+    }
+
+    pixelWiseMult(xf_data,autoCorrelation?xf_data:yf_data,xyf_v,0,true);
     sumChannels(xyf_v,xyf);
-    ifft2(xyf,xyf);
+    ifft2(xyf,xy);
 
     if(params.wrap_kernel){
-      shiftRows(xyf, x_data.rows/2);
-      shiftCols(xyf, x_data.cols/2);
+      shiftRows(xy, x_data.rows/2);
+      shiftCols(xy, x_data.cols/2);
     }
 
     //(xx + yy - 2 * xy) / numel(x)
-    xy=(normX+normY-2*xyf)/(x_data.rows*x_data.cols*x_data.channels());
+    double scale=1.0/(x_data.rows*x_data.cols*x_data.channels());
+    xy.convertTo(xy,-1,-2.0*scale,(normX+normY)*scale);
 
     // TODO: check wether we really need thresholding or not
     //threshold(xy,xy,0.0,0.0,THRESH_TOZERO);//max(0, (xx + yy - 2 * xy) / numel(x))
     for(int i=0;i<xy.rows;i++){
+      double* xy_row=xy.ptr<double>(i);
       for(int j=0;j<xy.cols;j++){
-        if(xy.at<double>(i,j)<0.0)xy.at<double>(i,j)=0.0;
+        if(xy_row[j]<0.0)xy_row[j]=0.0;
       }
     }
 
     double sig=-1.0/(sigma*sigma);
-    xy=sig*xy;
+    xy.convertTo(xy,-1,sig);
     exp(xy,k_data);
 
   }
@@ -774,7 +872,7 @@ namespace cv{
   /*
    * calculate the detection response
    */
-  void TrackerKCFImpl::calcResponse(const Mat alphaf_data, const Mat kf_data, Mat & response_data, Mat & spec_data) const {
+  void TrackerKCFImpl::calcResponse(const Mat& alphaf_data, const Mat& kf_data, Mat & response_data, Mat & spec_data) const {
     //alpha f--> 2channels ; k --> 1 channel;
     mulSpectrums(alphaf_data,kf_data,spec_data,0,false);
     ifft2(spec_data,response_data);
@@ -783,19 +881,21 @@ namespace cv{
   /*
    * calculate the detection response for splitted form
    */
-  void TrackerKCFImpl::calcResponse(const Mat alphaf_data, const Mat _alphaf_den, const Mat kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const {
+  void TrackerKCFImpl::calcResponse(const Mat& alphaf_data, const Mat& _alphaf_den, const Mat& kf_data, Mat & response_data, Mat & spec_data, Mat & spec2_data) const {
 
     mulSpectrums(alphaf_data,kf_data,spec_data,0,false);
+    spec2_data.create(kf_data.rows,kf_data.cols,CV_64FC2);
 
     //z=(a+bi)/(c+di)=[(ac+bd)+i(bc-ad)]/(c^2+d^2)
     double den;
     for(int i=0;i<kf_data.rows;i++){
+      const Vec2d* den_row=_alphaf_den.ptr<Vec2d>(i);
+      const Vec2d* spec_row=spec_data.ptr<Vec2d>(i);
+      Vec2d* spec2_row=spec2_data.ptr<Vec2d>(i);
       for(int j=0;j<kf_data.cols;j++){
-        den=1.0/(_alphaf_den.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[0]+_alphaf_den.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[1]);
-        spec2_data.at<Vec2d>(i,j)[0]=
-          (spec_data.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[0]+spec_data.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[1])*den;
-        spec2_data.at<Vec2d>(i,j)[1]=
-          (spec_data.at<Vec2d>(i,j)[1]*_alphaf_den.at<Vec2d>(i,j)[0]-spec_data.at<Vec2d>(i,j)[0]*_alphaf_den.at<Vec2d>(i,j)[1])*den;
+        den=1.0/(den_row[j][0]*den_row[j][0]+den_row[j][1]*den_row[j][1]);
+        spec2_row[j][0]=(spec_row[j][0]*den_row[j][0]+spec_row[j][1]*den_row[j][1])*den;
+        spec2_row[j][1]=(spec_row[j][1]*den_row[j][0]-spec_row[j][0]*den_row[j][1])*den;
       }
     }
 
@@ -813,6 +913,106 @@ namespace cv{
   }
   /*----------------------------------------------------------------------*/
 
+  /*---------------------------
+  |  MultiTrackerKCF
+  |---------------------------*/
+  class MultiTrackerKCFImpl : public MultiTrackerKCF {
+  public:
+    MultiTrackerKCFImpl( const TrackerKCF::Params &parameters ) : params( parameters ){}
+    bool add( const Mat& image, const Rect2d& boundingBox );
+    bool update( const Mat& image, std::vector<Rect2d>& boundingBox );
+    int getTargetNum() const { return (int)targets.size(); }
+
+  private:
+    TrackerKCF::Params params;
+    std::vector<Ptr<TrackerKCFImpl> > targets;
+    std::vector<Rect2d> objects;
+
+    // frame data shared by all the targets, the second element is the half-size frame, kept between updates
+    Mat frames[2], grays[2], cnIndices[2];
+    std::vector<uchar> status;
+  };
+
+  class MultiTrackerKCFInvoker : public ParallelLoopBody{
+  public:
+    MultiTrackerKCFInvoker(std::vector<Ptr<TrackerKCFImpl> >& targets, std::vector<Rect2d>& objects, std::vector<uchar>& status,
+                           const Mat* frames, const Mat* grays, const Mat* cnIndices) :
+      targets_(targets), objects_(objects), status_(status), frames_(frames), grays_(grays), cnIndices_(cnIndices){}
+
+    virtual void operator()(const Range& range) const{
+      for(int i=range.start;i<range.end;i++){
+        int s = targets_[i]->isResized() ? 1 : 0;
+        status_[i] = targets_[i]->track(frames_[s], grays_[s], cnIndices_[s], objects_[i]);
+      }
+    }
+
+  private:
+    std::vector<Ptr<TrackerKCFImpl> >& targets_;
+    std::vector<Rect2d>& objects_;
+    std::vector<uchar>& status_;
+    const Mat* frames_;
+    const Mat* grays_;
+    const Mat* cnIndices_;
+  };
+
+  Ptr<MultiTrackerKCF> MultiTrackerKCF::create(const TrackerKCF::Params &parameters){
+    return Ptr<MultiTrackerKCFImpl>(new MultiTrackerKCFImpl(parameters));
+  }
+
+  bool MultiTrackerKCFImpl::add( const Mat& image, const Rect2d& boundingBox ){
+    Ptr<TrackerKCFImpl> target(new TrackerKCFImpl(params));
+    if(!target->init(image, boundingBox))return false;
+
+    // targets with the same window size use the same filters
+    for(size_t i=0;i<targets.size();i++){
+      if(target->shareWindows(*targets[i]))break;
+    }
+
+    targets.push_back(target);
+    objects.push_back(boundingBox);
+    return true;
+  }
+
+  bool MultiTrackerKCFImpl::update( const Mat& image, std::vector<Rect2d>& boundingBox ){
+    if(image.empty())return false;
+    CV_Assert(image.channels() == 1 || image.channels() == 3);
+
+    unsigned desc = params.desc_npca | params.desc_pca;
+    bool needGray = image.channels() == 3 && (desc & TrackerKCF::GRAY) == TrackerKCF::GRAY;
+    bool needCN = image.channels() == 3 && (desc & TrackerKCF::CN) == TrackerKCF::CN;
+    bool needFrame[2] = { false, false };
+    for(size_t i=0;i<targets.size();i++)
+      needFrame[targets[i]->isResized() ? 1 : 0] = true;
+
+    // convert the frame once for all the targets
+    for(int s=0;s<2;s++){
+      if(!needFrame[s])continue;
+      if(s == 0)
+        frames[s] = image;
+      else
+        resize(image,frames[s],Size(image.cols/2,image.rows/2));
+
+      if(needGray)
+        cvtColor(frames[s],grays[s],COLOR_BGR2GRAY);
+      else
+        grays[s].release();
+
+      if(needCN)
+        computeCNIndex(frames[s],cnIndices[s],true);
+      else
+        cnIndices[s].release();
+    }
+
+    status.assign(targets.size(), 0);
+    parallel_for_(Range(0,(int)targets.size()), MultiTrackerKCFInvoker(targets, objects, status, frames, grays, cnIndices));
+
+    // do not keep a reference to the caller's image
+    frames[0].release();
+
+    boundingBox = objects;
+    return std::find(status.begin(), status.end(), 0) == status.end();
+  }
+
   /*
  * Parameters
  */
@@ -126,11 +126,15 @@ void TrackerMILImpl::write( cv::FileStorage& fs ) const
 
 void TrackerMILImpl::compute_integral( const Mat & img, Mat & ii_img )
 {
-  Mat ii;
-  std::vector<Mat> ii_imgs;
-  integral( img, ii, CV_32F );
-  split( ii, ii_imgs );
-  ii_img = ii_imgs[0];
+  //only the first channel is sampled, so the integral of the other ones is not computed
+  if( img.channels() == 1 )
+  {
+    integral( img, ii_img, CV_32F );
+    return;
+  }
+  Mat channel;
+  extractChannel( img, channel, 0 );
+  integral( channel, ii_img, CV_32F );
 }
 
 bool TrackerMILImpl::initImpl( const Mat& image, const Rect2d& boundingBox )
@@ -171,7 +175,10 @@ bool TrackerMILImpl::initImpl( const Mat& image, const Rect2d& boundingBox )
   HAARparameters.numFeatures = params.featureSetNumFeatures;
   HAARparameters.rectSize = Size( (int)boundingBox.width, (int)boundingBox.height );
   HAARparameters.isIntegral = true;
-  Ptr<TrackerFeature> trackerFeature = Ptr<TrackerFeatureHAAR>( new TrackerFeatureHAAR( HAARparameters ) );
+  Ptr<TrackerFeatureHAAR> trackerFeatureHAAR = Ptr<TrackerFeatureHAAR>( new TrackerFeatureHAAR( HAARparameters ) );
+  //the positive samples of an update overlap its detection samples, their responses are reused
+  trackerFeatureHAAR->setCacheEnabled( true );
+  Ptr<TrackerFeature> trackerFeature = trackerFeatureHAAR;
   featureSet->addTrackerFeature( trackerFeature );
 
   featureSet->extraction( posSamples );
@@ -199,6 +206,7 @@ bool TrackerMILImpl::updateImpl( const Mat& image, Rect2d& boundingBox )
 {
   Mat intImage;
   compute_integral( image, intImage );
+  featureSet->getTrackerFeature()[0].second.staticCast<TrackerFeatureHAAR>()->clearCache();
 
   //get the last location [AAM] X(k-1)
   Ptr<TrackerTargetState> lastLocation = model->getLastTargetState();
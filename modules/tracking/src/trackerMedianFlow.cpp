@@ -42,6 +42,7 @@
 #include "precomp.hpp"
 #include "opencv2/video/tracking.hpp"
 #include "opencv2/imgproc.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 #include <algorithm>
 #include <limits.h>
 
@@ -76,13 +77,13 @@ namespace cv
 
 class TrackerMedianFlowImpl : public TrackerMedianFlow{
  public:
-     TrackerMedianFlowImpl(TrackerMedianFlow::Params paramsIn):termcrit(TermCriteria::COUNT|TermCriteria::EPS,20,0.3){params=paramsIn;isInit=false;}
+     TrackerMedianFlowImpl(TrackerMedianFlow::Params paramsIn):termcrit(TermCriteria::COUNT|TermCriteria::EPS,20,0.3){params=paramsIn;isInit=false;prevPyramidValid=false;}
      void read( const FileNode& fn );
      void write( FileStorage& fs ) const;
  private:
      bool initImpl( const Mat& image, const Rect2d& boundingBox );
      bool updateImpl( const Mat& image, Rect2d& boundingBox );
-     bool medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& oldBox);
+     bool medianFlowImpl(const Mat& oldImage,const Mat& newImage,Rect2d& oldBox);
      Rect2d vote(const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,const Rect2d& oldRect,Point2f& mD);
      //FIXME: this can be optimized: current method uses sort->select approach, there are O(n) selection algo for median; besides
           //it makes copy all the time
@@ -91,14 +92,24 @@ class TrackerMedianFlowImpl : public TrackerMedianFlow{
      float dist(Point2f p1,Point2f p2);
      std::string type2str(int type);
      void computeStatistics(std::vector<float>& data,int size=-1);
-     void check_FB(const Mat& oldImage,const Mat& newImage,
-             const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,std::vector<bool>& status);
-     void check_NCC(const Mat& oldImage,const Mat& newImage,
-             const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,std::vector<bool>& status);
-     inline double l2distance(Point2f p1,Point2f p2);
+     void check_FB(std::vector<double>& errors,std::vector<bool>& status);
+     void check_NCC(std::vector<float>& ncc,std::vector<bool>& status);
+     static inline double l2distance(Point2f p1,Point2f p2);
 
      TrackerMedianFlow::Params params;
      TermCriteria termcrit;
+
+     // grayscale frames and their pyramids; prev* hold the last accepted frame when params.cachePyramids is set
+     Mat prevGray,nextGray;
+     std::vector<Mat> prevPyramid,nextPyramid;
+     bool prevPyramidValid;
+     // per grid point results of the forward-backward pass, reused between updates
+     std::vector<Point2f> pointsToTrackOld,pointsToTrackNew;
+     std::vector<uchar> LKstatus;
+     std::vector<double> FBerror;
+     std::vector<float> NCC;
+
+     friend class MedianFlowPointsInvoker;
 };
 
 class TrackerMedianFlowModel : public TrackerModel{
@@ -120,14 +131,18 @@ class TrackerMedianFlowModel : public TrackerModel{
  */
 TrackerMedianFlow::Params::Params(){
     pointsInGrid=10;
+    cachePyramids=true;
 }
 
 void TrackerMedianFlow::Params::read( const cv::FileNode& fn ){
   pointsInGrid=fn["pointsInGrid"];
+  if (!fn["cachePyramids"].empty())
+    cachePyramids=(int)fn["cachePyramids"] != 0;
 }
 
 void TrackerMedianFlow::Params::write( cv::FileStorage& fs ) const{
   fs << "pointsInGrid" << pointsInGrid;
+  fs << "cachePyramids" << (int)cachePyramids;
 }
 
 void TrackerMedianFlowImpl::read( const cv::FileNode& fn )
@@ -148,6 +163,7 @@ bool TrackerMedianFlowImpl::initImpl( const Mat& image, const Rect2d& boundingBo
     model=Ptr<TrackerMedianFlowModel>(new TrackerMedianFlowModel(params));
     ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setImage(image);
     ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setBoudingBox(boundingBox);
+    prevPyramidValid=false;
     return true;
 }
 
@@ -159,6 +175,8 @@ bool TrackerMedianFlowImpl::updateImpl( const Mat& image, Rect2d& boundingBox ){
         return false;
     }
     boundingBox=oldBox;
+    std::swap(prevGray,nextGray);
+    std::swap(prevPyramid,nextPyramid);
     ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setImage(image);
     ((TrackerMedianFlowModel*)static_cast<TrackerModel*>(model))->setBoudingBox(oldBox);
     return true;
@@ -186,20 +204,107 @@ std::string TrackerMedianFlowImpl::type2str(int type) {
 
   return r;
 }
-bool TrackerMedianFlowImpl::medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& oldBox){
-    std::vector<Point2f> pointsToTrackOld,pointsToTrackNew;
-
-    Mat oldImage_gray,newImage_gray;
-    if (oldImage.channels() != 1)
-        cvtColor( oldImage, oldImage_gray, COLOR_BGR2GRAY );
+static void toGray(const Mat& image,Mat& gray){
+    if (image.channels() != 1)
+        cvtColor( image, gray, COLOR_BGR2GRAY );
     else
-        oldImage.copyTo(oldImage_gray);
+        image.copyTo(gray);
+}
 
-    if (newImage.channels() != 1)
-        cvtColor( newImage, newImage_gray, COLOR_BGR2GRAY );
-    else
-        newImage.copyTo(newImage_gray);
+static const Size LKwinSize(3,3);
+static const int LKmaxLevel=5;
+static const Size NCCpatchSize(30,30);
+
+// NCC of two continuous 8-bit patches; the sums are exact integers, so the result matches sum()/norm()/dot()
+static float patchNCC(const uchar* data1,const uchar* data2,int N){
+    int s1=0,s2=0,n1=0,n2=0,prod=0,i=0;
+#if CV_SIMD128
+    v_int32x4 vs1 = v_setzero_s32(), vs2 = v_setzero_s32();
+    v_int32x4 vn1 = v_setzero_s32(), vn2 = v_setzero_s32(), vprod = v_setzero_s32();
+    v_int16x8 one = v_setall_s16(1);
+    for( ; i <= N - v_uint8x16::nlanes; i += v_uint8x16::nlanes )
+    {
+        v_uint16x8 a0, a1, b0, b1;
+        v_expand(v_load(data1 + i), a0, a1);
+        v_expand(v_load(data2 + i), b0, b1);
+        v_int16x8 p10 = v_reinterpret_as_s16(a0), p11 = v_reinterpret_as_s16(a1);
+        v_int16x8 p20 = v_reinterpret_as_s16(b0), p21 = v_reinterpret_as_s16(b1);
+        vs1 += v_dotprod(p10, one) + v_dotprod(p11, one);
+        vs2 += v_dotprod(p20, one) + v_dotprod(p21, one);
+        vn1 += v_dotprod(p10, p10) + v_dotprod(p11, p11);
+        vn2 += v_dotprod(p20, p20) + v_dotprod(p21, p21);
+        vprod += v_dotprod(p10, p20) + v_dotprod(p11, p21);
+    }
+    s1 = v_reduce_sum(vs1); s2 = v_reduce_sum(vs2);
+    n1 = v_reduce_sum(vn1); n2 = v_reduce_sum(vn2);
+    prod = v_reduce_sum(vprod);
+#endif
+    for( ; i < N; i++ )
+    {
+        int p1 = data1[i], p2 = data2[i];
+        s1 += p1; s2 += p2;
+        n1 += (p1 * p1); n2 += (p2 * p2);
+        prod += (p1 * p2);
+    }
 
+    double ds1=s1,ds2=s2;
+    double nrm1=std::sqrt((double)n1),nrm2=std::sqrt((double)n2);
+    double sq1=sqrt(nrm1*nrm1-ds1*ds1/N),sq2=sqrt(nrm2*nrm2-ds2*ds2/N);
+    double ares=(sq2==0)?sq1/abs(sq1):(prod-ds1*ds2/N)/sq1/sq2;
+    return (float)ares;
+}
+
+/*
+ * Forward LK, backward LK and NCC for a chunk of the grid points. The backward pass of a point only needs its own
+ * forward result, so chunks run the two passes back to back concurrently with the other chunks
+ */
+class MedianFlowPointsInvoker : public ParallelLoopBody{
+ public:
+    MedianFlowPointsInvoker(TrackerMedianFlowImpl& tracker,int chunk):tracker_(tracker),chunk_(chunk){}
+    virtual void operator()(const Range& range) const{
+        TrackerMedianFlowImpl& t=tracker_;
+        int npoints=(int)t.pointsToTrackOld.size();
+        int begin=range.start*chunk_,end=std::min(range.end*chunk_,npoints);
+        if(begin>=end){
+            return;
+        }
+        std::vector<Point2f> oldPoints(t.pointsToTrackOld.begin()+begin,t.pointsToTrackOld.begin()+end);
+        std::vector<Point2f> newPoints,reprojection;
+        std::vector<uchar> status,backStatus;
+        std::vector<float> errors;
+
+        calcOpticalFlowPyrLK(t.prevPyramid,t.nextPyramid,oldPoints,newPoints,status,errors,LKwinSize,LKmaxLevel,t.termcrit,0);
+        calcOpticalFlowPyrLK(t.nextPyramid,t.prevPyramid,newPoints,reprojection,backStatus,errors,LKwinSize,LKmaxLevel,t.termcrit,0);
+
+        Mat p1(NCCpatchSize,CV_8U),p2(NCCpatchSize,CV_8U);
+        for(int i=begin;i<end;i++){
+            t.pointsToTrackNew[i]=newPoints[i-begin];
+            t.LKstatus[i]=status[i-begin];
+            t.FBerror[i]=TrackerMedianFlowImpl::l2distance(oldPoints[i-begin],reprojection[i-begin]);
+
+            getRectSubPix( t.prevGray, NCCpatchSize, oldPoints[i-begin],p1);
+            getRectSubPix( t.nextGray, NCCpatchSize, newPoints[i-begin],p2);
+            t.NCC[i]=patchNCC(p1.ptr(),p2.ptr(),NCCpatchSize.area());
+        }
+    }
+ private:
+    TrackerMedianFlowImpl& tracker_;
+    int chunk_;
+};
+
+bool TrackerMedianFlowImpl::medianFlowImpl(const Mat& oldImage,const Mat& newImage,Rect2d& oldBox){
+    // the pyramid of oldImage is left over from the previous update unless the cache is off; both pyramids carry
+    // their derivatives, so the forward and backward LK share them instead of rebuilding them per call
+    if(!params.cachePyramids || !prevPyramidValid){
+        toGray(oldImage,prevGray);
+        buildOpticalFlowPyramid(prevGray,prevPyramid,LKwinSize,LKmaxLevel,true);
+        prevPyramidValid=true;
+    }
+    toGray(newImage,nextGray);
+    CV_Assert(nextGray.depth() == CV_8U);
+    buildOpticalFlowPyramid(nextGray,nextPyramid,LKwinSize,LKmaxLevel,true);
+
+    pointsToTrackOld.clear();
     //"open ended" grid
     for(int i=0;i<params.pointsInGrid;i++){
         for(int j=0;j<params.pointsInGrid;j++){
@@ -209,21 +314,25 @@ bool TrackerMedianFlowImpl::medianFlowImpl(Mat oldImage,Mat newImage,Rect2d& old
         }
     }
 
-    std::vector<uchar> status(pointsToTrackOld.size());
-    std::vector<float> errors(pointsToTrackOld.size());
-    calcOpticalFlowPyrLK(oldImage_gray, newImage_gray,pointsToTrackOld,pointsToTrackNew,status,errors,Size(3,3),5,termcrit,0);
-    dprintf(("\t%d after LK forward\n",(int)pointsToTrackOld.size()));
+    int npoints=(int)pointsToTrackOld.size();
+    pointsToTrackNew.resize(npoints);
+    LKstatus.resize(npoints);
+    FBerror.resize(npoints);
+    NCC.resize(npoints);
+    const int chunk=16;
+    parallel_for_(Range(0,(npoints+chunk-1)/chunk),MedianFlowPointsInvoker(*this,chunk));
+    dprintf(("\t%d after LK forward\n",npoints));
 
     std::vector<Point2f> di;
-    for(int i=0;i<(int)pointsToTrackOld.size();i++){
-        if(status[i]==1){
+    for(int i=0;i<npoints;i++){
+        if(LKstatus[i]==1){
             di.push_back(pointsToTrackNew[i]-pointsToTrackOld[i]);
         }
     }
 
     std::vector<bool> filter_status;
-    check_FB(oldImage_gray,newImage_gray,pointsToTrackOld,pointsToTrackNew,filter_status);
-    check_NCC(oldImage_gray,newImage_gray,pointsToTrackOld,pointsToTrackNew,filter_status);
+    check_FB(FBerror,filter_status);
+    check_NCC(NCC,filter_status);
 
     // filter
     for(int i=0;i<(int)pointsToTrackOld.size();i++){
@@ -344,52 +453,24 @@ double TrackerMedianFlowImpl::l2distance(Point2f p1,Point2f p2){
     double dx=p1.x-p2.x, dy=p1.y-p2.y;
     return sqrt(dx*dx+dy*dy);
 }
-void TrackerMedianFlowImpl::check_FB(const Mat& oldImage,const Mat& newImage,
-        const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,std::vector<bool>& status){
+void TrackerMedianFlowImpl::check_FB(std::vector<double>& errors,std::vector<bool>& status){
 
     if(status.size()==0){
-        status=std::vector<bool>(oldPoints.size(),true);
+        status=std::vector<bool>(errors.size(),true);
     }
 
-    std::vector<uchar> LKstatus(oldPoints.size());
-    std::vector<float> errors(oldPoints.size());
-    std::vector<double> FBerror(oldPoints.size());
-    std::vector<Point2f> pointsToTrackReprojection;
-    calcOpticalFlowPyrLK(newImage, oldImage,newPoints,pointsToTrackReprojection,LKstatus,errors,Size(3,3),5,termcrit,0);
-
-    for(int i=0;i<(int)oldPoints.size();i++){
-        FBerror[i]=l2distance(oldPoints[i],pointsToTrackReprojection[i]);
-    }
-    double FBerrorMedian=getMedian(FBerror);
+    double FBerrorMedian=getMedian(errors);
     dprintf(("point median=%f\n",FBerrorMedian));
     dprintf(("FBerrorMedian=%f\n",FBerrorMedian));
-    for(int i=0;i<(int)oldPoints.size();i++){
-        status[i]=(FBerror[i]<FBerrorMedian);
+    for(int i=0;i<(int)errors.size();i++){
+        status[i]=(errors[i]<FBerrorMedian);
     }
 }
-void TrackerMedianFlowImpl::check_NCC(const Mat& oldImage,const Mat& newImage,
-        const std::vector<Point2f>& oldPoints,const std::vector<Point2f>& newPoints,std::vector<bool>& status){
-
-    std::vector<float> NCC(oldPoints.size(),0.0);
-    Size patch(30,30);
-    Mat p1,p2;
+void TrackerMedianFlowImpl::check_NCC(std::vector<float>& ncc,std::vector<bool>& status){
 
-	for (int i = 0; i < (int)oldPoints.size(); i++) {
-		getRectSubPix( oldImage, patch, oldPoints[i],p1);
-		getRectSubPix( newImage, patch, newPoints[i],p2);
-
-        const int N=900;
-        double s1=sum(p1)(0),s2=sum(p2)(0);
-        double n1=norm(p1),n2=norm(p2);
-        double prod=p1.dot(p2);
-        double sq1=sqrt(n1*n1-s1*s1/N),sq2=sqrt(n2*n2-s2*s2/N);
-        double ares=(sq2==0)?sq1/abs(sq1):(prod-s1*s2/N)/sq1/sq2;
-
-		NCC[i] = (float)ares;
-	}
-	float median = getMedian(NCC);
-	for(int i = 0; i < (int)oldPoints.size(); i++) {
-        status[i] = status[i] && (NCC[i]>median);
+	float median = getMedian(ncc);
+	for(int i = 0; i < (int)ncc.size(); i++) {
+        status[i] = status[i] && (ncc[i]>median);
 	}
 }
 } /* namespace cv */
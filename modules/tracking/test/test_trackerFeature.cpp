@@ -0,0 +1,86 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+ //
+ //  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+ //
+ //  By downloading, copying, installing or using the software you agree to this license.
+ //  If you do not agree to this license, do not download, install,
+ //  copy or use the software.
+ //
+ //
+ //                           License Agreement
+ //                For Open Source Computer Vision Library
+ //
+ // Copyright (C) 2016, OpenCV Foundation, all rights reserved.
+ // Third party copyrights are property of their respective owners.
+ //
+ // Redistribution and use in source and binary forms, with or without modification,
+ // are permitted provided that the following conditions are met:
+ //
+ //   * Redistribution's of source code must retain the above copyright notice,
+ //     this list of conditions and the following disclaimer.
+ //
+ //   * Redistribution's in binary form must reproduce the above copyright notice,
+ //     this list of conditions and the following disclaimer in the documentation
+ //     and/or other materials provided with the distribution.
+ //
+ //   * The name of the copyright holders may not be used to endorse or promote products
+ //     derived from this software without specific prior written permission.
+ //
+ // This software is provided by the copyright holders and contributors "as is" and
+ // any express or implied warranties, including, but not limited to, the implied
+ // warranties of merchantability and fitness for a particular purpose are disclaimed.
+ // In no event shall the Intel Corporation or contributors be liable for any direct,
+ // indirect, incidental, special, exemplary, or consequential damages
+ // (including, but not limited to, procurement of substitute goods or services;
+ // loss of use, data, or profits; or business interruption) however caused
+ // and on any theory of liability, whether in contract, strict liability,
+ // or tort (including negligence or otherwise) arising in any way out of
+ // the use of this software, even if advised of the possibility of such damage.
+ //
+ //M*/
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+
+TEST(TrackerFeatureHAAR, cachedResponsesMatchComputed)
+{
+    RNG rng(7);
+    Mat image(120, 160, CV_8UC1), intImage;
+    rng.fill(image, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+    integral(image, intImage, CV_32F);
+
+    TrackerFeatureHAAR::Params params;
+    params.numFeatures = 50;
+    params.rectSize = Size(30, 20);
+    params.isIntegral = true;
+    Ptr<TrackerFeatureHAAR> cached(new TrackerFeatureHAAR(params));
+    cached->setCacheEnabled(true);
+
+    // the second set overlaps the first one, as the positive samples overlap the detection ones in MIL
+    std::vector<Mat> first, second;
+    for (int y = 10; y < 40; y += 3)
+        for (int x = 20; x < 60; x += 4)
+            first.push_back(intImage(Rect(x, y, params.rectSize.width, params.rectSize.height)));
+    for (int y = 25; y < 55; y += 3)
+        for (int x = 40; x < 80; x += 4)
+            second.push_back(intImage(Rect(x, y, params.rectSize.width, params.rectSize.height)));
+
+    Mat response, cachedResponse;
+    cached->compute(first, cachedResponse);
+    cached->compute(second, cachedResponse);
+
+    cached->setCacheEnabled(false);
+    cached->compute(second, response);
+    EXPECT_EQ(0.0, cvtest::norm(response, cachedResponse, NORM_INF));
+
+    std::vector<int> selected;
+    selected.push_back(3);
+    selected.push_back(17);
+    selected.push_back(42);
+    cached->extractSelected(selected, second, response);
+    cached->setCacheEnabled(true);
+    cached->compute(first, cachedResponse);
+    cached->extractSelected(selected, second, cachedResponse);
+    EXPECT_EQ(0.0, cvtest::norm(response, cachedResponse, NORM_INF));
+}
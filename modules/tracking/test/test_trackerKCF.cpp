@@ -0,0 +1,93 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+ //
+ //  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+ //
+ //  By downloading, copying, installing or using the software you agree to this license.
+ //  If you do not agree to this license, do not download, install,
+ //  copy or use the software.
+ //
+ //
+ //                           License Agreement
+ //                For Open Source Computer Vision Library
+ //
+ // Copyright (C) 2016, OpenCV Foundation, all rights reserved.
+ // Third party copyrights are property of their respective owners.
+ //
+ // Redistribution and use in source and binary forms, with or without modification,
+ // are permitted provided that the following conditions are met:
+ //
+ //   * Redistribution's of source code must retain the above copyright notice,
+ //     this list of conditions and the following disclaimer.
+ //
+ //   * Redistribution's in binary form must reproduce the above copyright notice,
+ //     this list of conditions and the following disclaimer in the documentation
+ //     and/or other materials provided with the distribution.
+ //
+ //   * The name of the copyright holders may not be used to endorse or promote products
+ //     derived from this software without specific prior written permission.
+ //
+ // This software is provided by the copyright holders and contributors "as is" and
+ // any express or implied warranties, including, but not limited to, the implied
+ // warranties of merchantability and fitness for a particular purpose are disclaimed.
+ // In no event shall the Intel Corporation or contributors be liable for any direct,
+ // indirect, incidental, special, exemplary, or consequential damages
+ // (including, but not limited to, procurement of substitute goods or services;
+ // loss of use, data, or profits; or business interruption) however caused
+ // and on any theory of liability, whether in contract, strict liability,
+ // or tort (including negligence or otherwise) arising in any way out of
+ // the use of this software, even if advised of the possibility of such damage.
+ //
+ //M*/
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+
+// Textured background with two colored blocks moving in opposite directions
+static void drawKCFFrame(const Mat& background, int t, Mat& frame, Rect& small, Rect& large)
+{
+    background.copyTo(frame);
+    small = Rect(60 + 2 * t, 50 + t, 40, 40);
+    large = Rect(200 - 2 * t, 100, 100, 100);
+    frame(small).setTo(Scalar(40, 200, 230));
+    frame(large).setTo(Scalar(220, 60, 30));
+    rectangle(frame, Rect(large.x + 20, large.y + 20, 60, 60), Scalar(20, 20, 20), 3);
+}
+
+TEST(MultiTrackerKCF, sameResultsAsTrackerKCF)
+{
+    RNG rng(12345);
+    Mat background(240, 360, CV_8UC3);
+    rng.fill(background, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+    GaussianBlur(background, background, Size(5, 5), 1.5);
+
+    Mat frame;
+    Rect small, large;
+    drawKCFFrame(background, 0, frame, small, large);
+
+    Ptr<MultiTrackerKCF> multiTracker = MultiTrackerKCF::create();
+    std::vector<Ptr<TrackerKCF> > trackers;
+    std::vector<Rect2d> boxes, multiBoxes;
+    boxes.push_back(small);
+    boxes.push_back(large);
+    boxes.push_back(small);
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        trackers.push_back(TrackerKCF::createTracker());
+        ASSERT_TRUE(trackers[i]->init(frame, boxes[i]));
+        ASSERT_TRUE(multiTracker->add(frame, boxes[i]));
+    }
+    ASSERT_EQ((int)boxes.size(), multiTracker->getTargetNum());
+
+    for (int t = 0; t < 10; t++)
+    {
+        drawKCFFrame(background, t, frame, small, large);
+        bool ok = true;
+        for (size_t i = 0; i < trackers.size(); i++)
+            ok = trackers[i]->update(frame, boxes[i]) && ok;
+        ASSERT_EQ(ok, multiTracker->update(frame, multiBoxes));
+        ASSERT_EQ(boxes.size(), multiBoxes.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+            EXPECT_EQ(boxes[i], multiBoxes[i]) << "target " << i << " frame " << t;
+    }
+}
@@ -0,0 +1,89 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+ //
+ //  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+ //
+ //  By downloading, copying, installing or using the software you agree to this license.
+ //  If you do not agree to this license, do not download, install,
+ //  copy or use the software.
+ //
+ //
+ //                           License Agreement
+ //                For Open Source Computer Vision Library
+ //
+ // Copyright (C) 2016, OpenCV Foundation, all rights reserved.
+ // Third party copyrights are property of their respective owners.
+ //
+ // Redistribution and use in source and binary forms, with or without modification,
+ // are permitted provided that the following conditions are met:
+ //
+ //   * Redistribution's of source code must retain the above copyright notice,
+ //     this list of conditions and the following disclaimer.
+ //
+ //   * Redistribution's in binary form must reproduce the above copyright notice,
+ //     this list of conditions and the following disclaimer in the documentation
+ //     and/or other materials provided with the distribution.
+ //
+ //   * The name of the copyright holders may not be used to endorse or promote products
+ //     derived from this software without specific prior written permission.
+ //
+ // This software is provided by the copyright holders and contributors "as is" and
+ // any express or implied warranties, including, but not limited to, the implied
+ // warranties of merchantability and fitness for a particular purpose are disclaimed.
+ // In no event shall the Intel Corporation or contributors be liable for any direct,
+ // indirect, incidental, special, exemplary, or consequential damages
+ // (including, but not limited to, procurement of substitute goods or services;
+ // loss of use, data, or profits; or business interruption) however caused
+ // and on any theory of liability, whether in contract, strict liability,
+ // or tort (including negligence or otherwise) arising in any way out of
+ // the use of this software, even if advised of the possibility of such damage.
+ //
+ //M*/
+
+#include "test_precomp.hpp"
+
+using namespace cv;
+
+// Textured block drifting over a textured background
+static void drawMedianFlowFrame(const Mat& background, const Mat& texture, int t, Mat& frame, Rect& target)
+{
+    background.copyTo(frame);
+    target = Rect(80 + 3 * t, 60 + 2 * t, texture.cols, texture.rows);
+    texture.copyTo(frame(target));
+}
+
+TEST(TrackerMedianFlow, cachedPyramidsGiveSameResults)
+{
+    RNG rng(12345);
+    Mat background(240, 360, CV_8UC3), texture(60, 60, CV_8UC3);
+    rng.fill(background, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+    rng.fill(texture, RNG::UNIFORM, Scalar::all(0), Scalar::all(256));
+    GaussianBlur(background, background, Size(5, 5), 1.5);
+    GaussianBlur(texture, texture, Size(3, 3), 1.0);
+
+    Mat frame;
+    Rect target;
+    drawMedianFlowFrame(background, texture, 0, frame, target);
+
+    TrackerMedianFlow::Params params;
+    params.cachePyramids = true;
+    Ptr<TrackerMedianFlow> cached = TrackerMedianFlow::createTracker(params);
+    params.cachePyramids = false;
+    Ptr<TrackerMedianFlow> uncached = TrackerMedianFlow::createTracker(params);
+
+    Rect2d cachedBox = target, uncachedBox = target;
+    ASSERT_TRUE(cached->init(frame, cachedBox));
+    ASSERT_TRUE(uncached->init(frame, uncachedBox));
+
+    for (int t = 1; t < 10; t++)
+    {
+        drawMedianFlowFrame(background, texture, t, frame, target);
+        bool ok = cached->update(frame, cachedBox);
+        ASSERT_EQ(ok, uncached->update(frame, uncachedBox)) << "frame " << t;
+        EXPECT_EQ(cachedBox, uncachedBox) << "frame " << t;
+        if (ok)
+        {
+            Rect2d overlap = cachedBox & Rect2d(target);
+            EXPECT_GT(overlap.area(), 0.5 * target.area()) << "frame " << t;
+        }
+    }
+}
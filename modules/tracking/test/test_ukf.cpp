@@ -432,3 +432,107 @@ TEST(UKF, ungm_mean_squared_error)
 
     ASSERT_GE( mse_treshold, average_error );
 }
+
+// Constant velocity motion in the plane observed by range and bearing, in both the Mat and the Matx model forms
+class RangeBearingModel: public UkfSystemModel
+{
+public:
+    static const double step;
+
+    void stateConversionFunction(const Mat& x_k, const Mat& /*u_k*/, const Mat& v_k, Mat& x_kplus1)
+    {
+        Mat x = x_k.clone();
+        x.at<double>(0, 0) += step * x_k.at<double>(2, 0);
+        x.at<double>(1, 0) += step * x_k.at<double>(3, 0);
+        x_kplus1 = x + v_k;
+    }
+
+    void measurementFunction(const Mat& x_k, const Mat& n_k, Mat& z_k)
+    {
+        double x = x_k.at<double>(0, 0), y = x_k.at<double>(1, 0);
+        z_k.at<double>(0, 0) = sqrt( x*x + y*y ) + n_k.at<double>(0, 0);
+        z_k.at<double>(1, 0) = atan2( y, x ) + n_k.at<double>(1, 0);
+    }
+};
+
+const double RangeBearingModel::step = 0.1;
+
+struct RangeBearingModelFixed
+{
+    typedef UnscentedKalmanFilterFixed<double, 4, 2> Filter;
+
+    void stateConversionFunction(const Filter::StateVec& x_k, const Filter::ControlVec& /*u_k*/, Filter::StateVec& x_kplus1) const
+    {
+        x_kplus1 = x_k;
+        x_kplus1(0) += RangeBearingModel::step * x_k(2);
+        x_kplus1(1) += RangeBearingModel::step * x_k(3);
+    }
+
+    void measurementFunction(const Filter::StateVec& x_k, Filter::MeasurementVec& z_k) const
+    {
+        z_k(0) = sqrt( x_k(0)*x_k(0) + x_k(1)*x_k(1) );
+        z_k(1) = atan2( x_k(1), x_k(0) );
+    }
+};
+
+TEST(UKF, fixed_size_and_batch_match_dynamic)
+{
+    const int DP = 4, MP = 2, nFilters = 37, nIterations = 50;
+    typedef RangeBearingModelFixed::Filter Filter;
+
+    Filter::StateVec stateInit( 10.0, 5.0, 1.0, -0.5 );
+    Filter::StateCov P = Filter::StateCov::eye();
+    Filter::StateCov Q = 1e-3 * Filter::StateCov::eye();
+    Filter::MeasurementCov R( 1e-2, 0.0, 0.0, 1e-4 );
+
+    UnscentedKalmanFilterParams params( DP, MP, 0, 0, 0, Ptr<RangeBearingModel>( new RangeBearingModel() ) );
+    params.stateInit = Mat( stateInit ).clone();
+    params.errorCovInit = Mat( P ).clone();
+    params.processNoiseCov = Mat( Q ).clone();
+    params.measurementNoiseCov = Mat( R ).clone();
+    params.alpha = 1.0;
+    params.k = 0.0;
+    params.beta = 2.0;
+    Ptr<UnscentedKalmanFilter> dynamicFilter = createUnscentedKalmanFilter( params );
+
+    RangeBearingModelFixed model;
+    Filter fixedFilter( stateInit, P, Q, R, params.alpha, params.k, params.beta );
+    UnscentedKalmanFilterBatch<double, DP, MP> batch( nFilters, fixedFilter );
+
+    RNG rng( 42 );
+    Mat_<double> measurements( MP, nFilters );
+    Mat_<uchar> mask( 1, nFilters );
+    for (int i = 0; i < nIterations; i++)
+    {
+        rng.fill( measurements, RNG::NORMAL, Scalar::all(0), Scalar::all(0.05) );
+        rng.fill( mask, RNG::UNIFORM, 0, 2 );
+        mask(0, 0) = 1;
+        for (int j = 0; j < nFilters; j++)
+        {
+            measurements(0, j) += sqrt( 125.0 ) + 0.1 * i;
+            measurements(1, j) += atan2( 5.0, 10.0 );
+        }
+
+        dynamicFilter->predict();
+        fixedFilter.predict( model );
+        batch.predict( model );
+
+        Filter::MeasurementVec z( measurements(0, 0), measurements(1, 0) );
+        Mat dynamicState = dynamicFilter->correct( Mat( z ) );
+        fixedFilter.correct( model, z );
+        batch.correct( model, measurements, mask );
+
+        for (int j = 0; j < DP; j++)
+            ASSERT_NEAR( dynamicState.at<double>(j, 0), fixedFilter.state(j), 1e-6 ) << "iteration " << i;
+        Mat dynamicCov = dynamicFilter->getErrorCov();
+        for (int j = 0; j < DP*DP; j++)
+            ASSERT_NEAR( dynamicCov.at<double>(j / DP, j % DP), fixedFilter.errorCov.val[j], 1e-6 ) << "iteration " << i;
+
+        Filter first = batch.get( 0 );
+        for (int j = 0; j < DP; j++)
+        {
+            ASSERT_NEAR( fixedFilter.state(j), first.state(j), 1e-12 ) << "iteration " << i;
+            ASSERT_NEAR( fixedFilter.state(j), batch.getStates()(j, 0), 1e-12 ) << "iteration " << i;
+        }
+    }
+}
@@ -222,6 +222,31 @@ public:
      */
     virtual void compute( InputArray image, OutputArray descriptors ) = 0;
 
+    /** @brief Receives the dense descriptors computed for a band of image rows.
+     */
+    class CV_EXPORTS BandCallback
+    {
+    public:
+        virtual ~BandCallback() {}
+
+        /**
+         * @param rows image rows covered by the band
+         * @param descriptors descriptors of the band pixels, stored row by row (the matrix is
+         * reused for the next band, copy it to keep it)
+         */
+        virtual void operator()( const Range& rows, const Mat& descriptors ) = 0;
+    };
+
+    /**@overload
+     * Computes the descriptors of all image pixels band by band, so that the memory used is
+     * proportional to the image width times the band height instead of the image area. The
+     * descriptors are identical to the ones of compute( image, descriptors ).
+     * @param image image to extract descriptors
+     * @param callback receives the descriptors of each band, from top to bottom
+     * @param band_height number of image rows per band
+     */
+    virtual void compute( InputArray image, BandCallback& callback, int band_height = 64 ) = 0;
+
     /**
      * @param y position y on image
      * @param x position x on image
@@ -359,6 +384,72 @@ public:
                     bool use_scale_orientation = true, float scale_factor = 6.25f );
 };
 
+/** @brief Image-wide preprocessing shared by several descriptor extractors computed on the same image.
+
+The context holds the grayscale version of an image and computes on first request the smoothed images,
+integral images and keypoint patches that the extractors need. When several descriptors are computed for
+one image (e.g. for an ensemble matcher), VGG, BoostDesc, LATCH and BriefDescriptorExtractor pull this data
+from the context instead of preprocessing the image again. Other extractors are run on the grayscale image.
+
+@code
+    Ptr<ImageFeatureContext> context = ImageFeatureContext::create( image );
+    context->compute( BoostDesc::create(), keypoints, binboost );
+    context->compute( VGG::create(), keypoints, vgg );
+@endcode
+
+@note The cached data is not released before the context is destroyed or cleared. A context is not thread safe.
+*/
+class CV_EXPORTS ImageFeatureContext
+{
+public:
+    virtual ~ImageFeatureContext() {}
+
+    /**
+     * @param image image to compute descriptors on, converted to grayscale if it has several channels
+     */
+    static Ptr<ImageFeatureContext> create( InputArray image );
+
+    /** @brief Computes the descriptors of a set of keypoints with the given extractor.
+     * @param extractor descriptor extractor
+     * @param keypoints keypoints to describe, the extractor may remove some of them as with Feature2D::compute
+     * @param descriptors computed descriptors
+     */
+    virtual void compute( const Ptr<Feature2D>& extractor, std::vector<KeyPoint>& keypoints,
+                          OutputArray descriptors ) = 0;
+
+    /** @brief Returns the image the context was created with */
+    virtual Mat getImage() const = 0;
+
+    /** @brief Returns the grayscale image */
+    virtual const Mat& getGray() const = 0;
+
+    /** @brief Returns the grayscale image converted to ddepth and smoothed by GaussianBlur
+     * @param ddepth depth of the smoothed image
+     * @param ksize Gaussian kernel size
+     * @param sigma Gaussian kernel standard deviation, in both directions
+     * @param borderType pixel extrapolation method
+     */
+    virtual Mat getSmoothed( int ddepth, Size ksize, double sigma, int borderType = BORDER_DEFAULT ) = 0;
+
+    /** @brief Returns the integral image of the grayscale image
+     * @param sdepth depth of the integral image, CV_32S, CV_32F or CV_64F
+     */
+    virtual Mat getIntegral( int sdepth ) = 0;
+
+    /** @brief Returns square patches of the grayscale image rectified around the keypoints
+     * @param keypoints keypoints the patches are centered on
+     * @param patchSize patch side in pixels
+     * @param useScaleOrientation scale and rotate the patches by keypoints size and angle
+     * @param scaleFactor ratio between the sampled window and the keypoint size
+     * @return one row of patchSize*patchSize pixels per keypoint
+     */
+    virtual Mat getRectifiedPatches( const std::vector<KeyPoint>& keypoints, int patchSize,
+                                     bool useScaleOrientation, float scaleFactor ) = 0;
+
+    /** @brief Releases all the cached data */
+    virtual void clear() = 0;
+};
+
 //! @}
 
 }
@@ -79,6 +79,21 @@ public:
     CV_WRAP static Ptr<SIFT> create( int nfeatures = 0, int nOctaveLayers = 3,
                                     double contrastThreshold = 0.04, double edgeThreshold = 10,
                                     double sigma = 1.6);
+
+    /** @brief Builds the Gaussian and difference-of-Gaussian pyramids of an image once.
+
+    Subsequent calls of detect, compute and detectAndCompute on the same image (for instance with
+    different masks) reuse the stored scale space instead of rebuilding it. The image is recognized by
+    its data pointer, size and step, so buildPyramid must be called again if its content is modified
+    in place.
+
+    @param image Input 8-bit image.
+     */
+    CV_WRAP virtual void buildPyramid( InputArray image ) = 0;
+
+    /** @brief Releases the scale space stored by buildPyramid.
+     */
+    CV_WRAP virtual void releasePyramid() = 0;
 };
 
 typedef SIFT SiftFeatureDetector;
@@ -31,3 +31,26 @@ PERF_TEST_P(daisy, extract, testing::Values(DAISY_IMAGES))
 
     SANITY_CHECK_NOTHING();
 }
+
+class DAISYBandSink : public DAISY::BandCallback
+{
+public:
+    void operator()( const Range&, const Mat& ) {}
+};
+
+PERF_TEST_P(daisy, extract_bands, testing::Values(DAISY_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame).time(90);
+
+    Ptr<DAISY> descriptor = DAISY::create();
+
+    DAISYBandSink sink;
+    // compute all daisies in image, 64 rows at a time
+    TEST_CYCLE() descriptor->compute(frame, sink, 64);
+
+    SANITY_CHECK_NOTHING();
+}
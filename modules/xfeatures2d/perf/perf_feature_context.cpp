@@ -0,0 +1,76 @@
+#include "perf_precomp.hpp"
+
+using namespace std;
+using namespace cv;
+using namespace cv::xfeatures2d;
+using namespace perf;
+using std::tr1::make_tuple;
+using std::tr1::get;
+
+typedef perf::TestBaseWithParam<std::string> feature_context;
+
+#define FEATURE_CONTEXT_IMAGES \
+    "cv/detectors_descriptors_evaluation/images_datasets/leuven/img1.png",\
+    "stitching/a3.png"
+
+static void createEnsemble(vector<Ptr<Feature2D> >& extractors)
+{
+    extractors.push_back(BoostDesc::create(BoostDesc::BINBOOST_256));
+    extractors.push_back(BoostDesc::create(BoostDesc::BINBOOST_64));
+    extractors.push_back(LATCH::create());
+}
+
+PERF_TEST_P(feature_context, separate, testing::Values(FEATURE_CONTEXT_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame).time(90);
+
+    vector<KeyPoint> points;
+    SURF::create()->detect(frame, points);
+
+    vector<Ptr<Feature2D> > extractors;
+    createEnsemble(extractors);
+    vector<Mat> descriptors(extractors.size());
+
+    TEST_CYCLE()
+    {
+        for( size_t i = 0; i < extractors.size(); i++ )
+        {
+            vector<KeyPoint> kpts = points;
+            extractors[i]->compute(frame, kpts, descriptors[i]);
+        }
+    }
+
+    SANITY_CHECK_NOTHING();
+}
+
+PERF_TEST_P(feature_context, shared, testing::Values(FEATURE_CONTEXT_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    declare.in(frame).time(90);
+
+    vector<KeyPoint> points;
+    SURF::create()->detect(frame, points);
+
+    vector<Ptr<Feature2D> > extractors;
+    createEnsemble(extractors);
+    vector<Mat> descriptors(extractors.size());
+
+    TEST_CYCLE()
+    {
+        Ptr<ImageFeatureContext> context = ImageFeatureContext::create(frame);
+        for( size_t i = 0; i < extractors.size(); i++ )
+        {
+            vector<KeyPoint> kpts = points;
+            context->compute(extractors[i], kpts, descriptors[i]);
+        }
+    }
+
+    SANITY_CHECK_NOTHING();
+}
@@ -64,3 +64,20 @@ PERF_TEST_P(surf, full, testing::Values(SURF_IMAGES))
 
     SANITY_CHECK_NOTHING();
 }
+
+PERF_TEST_P(surf, full_upright, testing::Values(SURF_IMAGES))
+{
+    string filename = getDataPath(GetParam());
+    Mat frame = imread(filename, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(frame.empty()) << "Unable to load source image " << filename;
+
+    Mat mask;
+    declare.in(frame).time(90);
+    Ptr<SURF> detector = SURF::create(100, 4, 3, false, true);
+    vector<KeyPoint> points;
+    vector<float> descriptors;
+
+    TEST_CYCLE() detector->detectAndCompute(frame, mask, points, descriptors, false);
+
+    SANITY_CHECK_NOTHING();
+}
@@ -53,6 +53,7 @@
 
 #include <bitset>
 #include "precomp.hpp"
+#include "feature_context.hpp"
 
 
 
@@ -68,7 +69,7 @@ namespace xfeatures2d
 /*
  !BoostDesc implementation
  */
-class BoostDesc_Impl : public BoostDesc
+class BoostDesc_Impl : public BoostDesc, public ContextDescriptorExtractor
 {
 
 public:
@@ -93,6 +94,9 @@ public:
     // compute descriptors given keypoints
     virtual void compute( InputArray image, vector<KeyPoint>& keypoints, OutputArray descriptors );
 
+    // compute descriptors given keypoints, using the rectified patches of the context
+    virtual void computeFromContext( ImageFeatureContext& context, vector<KeyPoint>& keypoints, OutputArray descriptors );
+
 protected:
 
     /*
@@ -336,61 +340,25 @@ static float computeWLResponse( const int x_min,  const int x_max,
     return total ? ( (current / total) - thresh ) : 0.f;
 }
 
-static void rectifyPatch( const Mat& image, const KeyPoint& kp,
-                          const int& patchSize, Mat& patch,
-                          const bool use_scale_orientation,
-                          const float scale_factor )
-{
-    Mat M;
-    if ( use_scale_orientation )
-    {
-      const float s = scale_factor * (float) kp.size / (float) patchSize;
-
-      const float cosine = (kp.angle>=0) ? cos(kp.angle*(float)CV_PI/180.0f) : 1.f;
-      const float sine   = (kp.angle>=0) ? sin(kp.angle*(float)CV_PI/180.0f) : 0.f;
-
-      float M_[] = {
-          s*cosine, -s*sine,   (-s*cosine + s*sine  ) * patchSize/2.0f + kp.pt.x,
-          s*sine,    s*cosine, (-s*sine   - s*cosine) * patchSize/2.0f + kp.pt.y
-      };
-      M = Mat( 2, 3, CV_32FC1, M_ ).clone();
-    }
-    else
-    {
-      float M_[] = {
-          1.f,  0.f, -1.f * patchSize/2.0f + kp.pt.x,
-          0.f,  1.f, -1.f * patchSize/2.0f + kp.pt.y
-      };
-      M = Mat( 2, 3, CV_32FC1, M_ ).clone();
-    }
-
-    warpAffine( image, patch, M, Size( patchSize, patchSize ),
-                WARP_INVERSE_MAP + INTER_CUBIC + WARP_FILL_OUTLIERS );
-}
-
 // -------------------------------------------------
 /* BoostDesc interface implementation */
 
 struct ComputeBoostDescInvoker : ParallelLoopBody
 {
-    ComputeBoostDescInvoker( const Mat& _image, Mat* _descriptors,
-                        const vector<KeyPoint>& _keypoints,
+    ComputeBoostDescInvoker( const Mat& _patches, Mat* _descriptors,
                         const int _desc_type, const int _grad_atype,
                         const int _orient_q, const int _patch_size,
                         const int _nWLs, const int _Dims,
                         const Mat& _wl_x_min, const Mat& _wl_x_max,
                         const Mat& _wl_y_min, const Mat& _wl_y_max,
                         const Mat& _wl_thresh, const Mat& _wl_orient,
-                        const Mat& _wl_alpha, const Mat& _wl_beta,
-                        const bool _use_scale_orientation,
-                        const float _scale_factor )
+                        const Mat& _wl_alpha, const Mat& _wl_beta )
     {
       nWLs = _nWLs;
       Dims = _Dims;
-      image = _image;
+      patches = _patches;
       orient_q = _orient_q;
       desc_type = _desc_type;
-      keypoints = _keypoints;
       grad_atype = _grad_atype;
       patch_size = _patch_size;
       descriptors = _descriptors;
@@ -403,9 +371,6 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
       wl_y_max = _wl_y_max;
       wl_thresh = _wl_thresh;
       wl_orient = _wl_orient;
-
-      scale_factor = _scale_factor;
-      use_scale_orientation  = _use_scale_orientation;
     }
 
     void operator ()( const cv::Range& range ) const
@@ -421,10 +386,8 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
       for ( int i = range.start; i < range.end; i++ )
       {
 
-        Mat patch;
-        // rectify the patch around a given keypoint
-        rectifyPatch( image, keypoints[i], patch_size,
-                      patch, use_scale_orientation, scale_factor );
+        // patch rectified around the keypoint
+        Mat patch = patches.row( i ).reshape( 1, patch_size );
 
         // compute gradient maps (and integral gradient maps)
         computeGradientMaps( patch, grad_atype, orient_q, gradMap );
@@ -518,16 +481,12 @@ struct ComputeBoostDescInvoker : ParallelLoopBody
     int grad_atype;
     int patch_szie;
 
-    Mat image;
+    Mat patches;
     Mat *descriptors;
-    vector<KeyPoint> keypoints;
 
     Mat wl_x_min, wl_x_max, wl_y_min, wl_y_max;
     Mat wl_thresh, wl_orient, wl_alpha, wl_beta;
 
-    float scale_factor;
-    bool use_scale_orientation;
-
     enum
     {
       BGM = 100, BGM_HARD = 101, BGM_BILINEAR = 102, LBGM = 200,
@@ -545,14 +504,26 @@ void BoostDesc_Impl::compute( InputArray _image, vector<KeyPoint>& keypoints, Ou
     if( keypoints.empty() )
       return;
 
-    m_image = _image.getMat().clone();
+    // Only 8bit images
+    CV_Assert( _image.depth() == CV_8U );
+
+    Ptr<ImageFeatureContext> context = ImageFeatureContext::create( _image );
+    computeFromContext( *context, keypoints, _descriptors );
+}
+
+void BoostDesc_Impl::computeFromContext( ImageFeatureContext& context, vector<KeyPoint>& keypoints, OutputArray _descriptors )
+{
+    if( keypoints.empty() )
+      return;
+
+    m_image = context.getGray();
 
     // Only 8bit images
     CV_Assert( m_image.depth() == CV_8U );
 
-    // convert to gray inplace
-    if( m_image.channels() > 1 )
-      cvtColor( m_image, m_image, COLOR_BGR2GRAY );
+    // patches rectified around the keypoints
+    Mat patches = context.getRectifiedPatches( keypoints, m_patch_size,
+                                               m_use_scale_orientation, m_scale_factor );
 
     // initialize the variables
     _descriptors.create( (int)keypoints.size(), descriptorSize(), descriptorType() );
@@ -562,12 +533,11 @@ void BoostDesc_Impl::compute( InputArray _image, vector<KeyPoint>& keypoints, Ou
     Mat descriptors = _descriptors.getMat();
 
     parallel_for_( Range( 0, (int) keypoints.size() ),
-        ComputeBoostDescInvoker( m_image, &descriptors, keypoints,
+        ComputeBoostDescInvoker( patches, &descriptors,
                             m_desc_type, m_grad_atype, m_orient_q,
                             m_patch_size, m_nWLs, m_Dims,
                             m_wl_x_min, m_wl_x_max, m_wl_y_min, m_wl_y_max,
-                            m_wl_thresh, m_wl_orient, m_wl_alpha, m_wl_beta,
-                            m_use_scale_orientation, m_scale_factor )
+                            m_wl_thresh, m_wl_orient, m_wl_alpha, m_wl_beta )
     );
 }
 
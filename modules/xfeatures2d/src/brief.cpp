@@ -41,6 +41,7 @@
 //M*/
 
 #include "precomp.hpp"
+#include "feature_context.hpp"
 #include <algorithm>
 #include <vector>
 
@@ -55,7 +56,7 @@ namespace xfeatures2d
 /*
  * BRIEF Descriptor
  */
-class BriefDescriptorExtractorImpl : public BriefDescriptorExtractor
+class BriefDescriptorExtractorImpl : public BriefDescriptorExtractor, public ContextDescriptorExtractor
 {
 public:
     enum { PATCH_SIZE = 48, KERNEL_SIZE = 9 };
@@ -72,8 +73,13 @@ public:
 
     virtual void compute(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
 
+    // same as compute(), using the integral image of the context
+    virtual void computeFromContext(ImageFeatureContext& context, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
+
 protected:
-    typedef void(*PixelTestFn)(InputArray, const std::vector<KeyPoint>&, OutputArray, bool use_orientation );
+    typedef void(*PixelTestFn)(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range );
+
+    struct ComputeBriefInvoker;
 
     int bytes_;
     bool use_orientation_;
@@ -105,13 +111,12 @@ inline int smoothedSum(const Mat& sum, const KeyPoint& pt, int y, int x, bool us
            + sum.at<int>(img_y - HALF_KERNEL, img_x - HALF_KERNEL);
 }
 
-static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation )
+static void pixelTests16(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range )
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -125,13 +130,12 @@ static void pixelTests16(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation)
+static void pixelTests32(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -145,13 +149,12 @@ static void pixelTests32(InputArray _sum, const std::vector<KeyPoint>& keypoints
     }
 }
 
-static void pixelTests64(InputArray _sum, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, bool use_orientation)
+static void pixelTests64(const Mat& sum, const std::vector<KeyPoint>& keypoints, Mat& descriptors, bool use_orientation, const Range& range)
 {
     Matx21f R;
-    Mat sum = _sum.getMat(), descriptors = _descriptors.getMat();
-    for (size_t i = 0; i < keypoints.size(); ++i)
+    for (int i = range.start; i < range.end; ++i)
     {
-        uchar* desc = descriptors.ptr(static_cast<int>(i));
+        uchar* desc = descriptors.ptr(i);
         const KeyPoint& pt = keypoints[i];
         if ( use_orientation )
         {
@@ -186,6 +189,31 @@ BriefDescriptorExtractorImpl::BriefDescriptorExtractorImpl(int bytes, bool use_o
     }
 }
 
+// Multi-threaded pixel tests, each keypoint only writes its own descriptor row
+struct BriefDescriptorExtractorImpl::ComputeBriefInvoker : ParallelLoopBody
+{
+    ComputeBriefInvoker( PixelTestFn _test_fn, const Mat& _sum, const std::vector<KeyPoint>& _keypoints,
+                         Mat& _descriptors, bool _use_orientation )
+    {
+        test_fn = _test_fn;
+        sum = &_sum;
+        keypoints = &_keypoints;
+        descriptors = &_descriptors;
+        use_orientation = _use_orientation;
+    }
+
+    void operator ()(const cv::Range& range) const
+    {
+        test_fn(*sum, *keypoints, *descriptors, use_orientation, range);
+    }
+
+    PixelTestFn test_fn;
+    const Mat* sum;
+    const std::vector<KeyPoint>* keypoints;
+    Mat* descriptors;
+    bool use_orientation;
+};
+
 int BriefDescriptorExtractorImpl::descriptorSize() const
 {
     return bytes_;
@@ -230,25 +258,26 @@ void BriefDescriptorExtractorImpl::compute(InputArray image,
                                            std::vector<KeyPoint>& keypoints,
                                            OutputArray descriptors)
 {
-    // Construct integral image for fast smoothing (box filter)
-    Mat sum;
-
-    Mat grayImage = image.getMat();
-    if( image.type() != CV_8U ) cvtColor( image, grayImage, COLOR_BGR2GRAY );
-
-    ///TODO allow the user to pass in a precomputed integral image
-    //if(image.type() == CV_32S)
-    //  sum = image;
-    //else
+    Ptr<ImageFeatureContext> context = ImageFeatureContext::create(image);
+    computeFromContext(*context, keypoints, descriptors);
+}
 
-    integral( grayImage, sum, CV_32S);
+void BriefDescriptorExtractorImpl::computeFromContext(ImageFeatureContext& context,
+                                                      std::vector<KeyPoint>& keypoints,
+                                                      OutputArray descriptors)
+{
+    // Integral image for fast smoothing (box filter)
+    Mat sum = context.getIntegral(CV_32S);
 
     //Remove keypoints very close to the border
-    KeyPointsFilter::runByImageBorder(keypoints, image.size(), PATCH_SIZE/2 + KERNEL_SIZE/2);
+    KeyPointsFilter::runByImageBorder(keypoints, context.getGray().size(), PATCH_SIZE/2 + KERNEL_SIZE/2);
 
     descriptors.create((int)keypoints.size(), bytes_, CV_8U);
     descriptors.setTo(Scalar::all(0));
-    test_fn_(sum, keypoints, descriptors, use_orientation_);
+
+    Mat desc = descriptors.getMat();
+    parallel_for_(Range(0, (int)keypoints.size()),
+                  ComputeBriefInvoker(test_fn_, sum, keypoints, desc, use_orientation_));
 }
 
 }
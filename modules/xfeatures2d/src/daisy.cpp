@@ -135,6 +135,13 @@ public:
      */
     virtual void compute( InputArray image, OutputArray descriptors );
 
+    /** @overload
+     * @param image image to extract descriptors
+     * @param callback receives the descriptors of each band
+     * @param band_height number of image rows per band
+     */
+    virtual void compute( InputArray image, BandCallback& callback, int band_height );
+
     /**
      * @param y position y on image
      * @param x position x on image
@@ -236,6 +243,13 @@ protected:
     // n>= 1; layer[0] is the layered_gradient
     std::vector<Mat> m_smoothed_gradient_layers;
 
+    // storage of the layers above, reused from one band to the next
+    std::vector<Mat> m_layer_buffers;
+
+    // image row corresponding to the first row of the layers
+    // (non zero when the image is processed by bands)
+    int m_layers_y_off;
+
     // hold the scales of the pixels
     Mat m_scale_map;
 
@@ -322,6 +336,12 @@ private:
 
     inline void update_selected_cubes();
 
+    // returns a cube over the reusable storage of cube c
+    inline Mat layer_cube( int c, const int* dims );
+
+    // rows of context needed around a band to get exact descriptors
+    inline int band_margin() const;
+
 }; // END DAISY_Impl CLASS
 
 
@@ -331,6 +351,7 @@ private:
 inline void DAISY_Impl::reset()
 {
     m_image.release();
+    m_layers_y_off = 0;
 
     m_scale_map.release();
     m_orientation_map.release();
@@ -338,6 +359,7 @@ inline void DAISY_Impl::reset()
     for (size_t i=0; i<m_smoothed_gradient_layers.size(); i++)
       m_smoothed_gradient_layers[i].release();
     m_smoothed_gradient_layers.clear();
+    m_layer_buffers.clear();
 }
 
 inline void DAISY_Impl::release_auxiliary()
@@ -572,15 +594,18 @@ static void normalize_descriptor( float* desc, const int nrm_type, const int _gr
         CV_Error( Error::StsInternal, "No such normalization" );
 }
 
-static void ni_get_histogram( float* histogram, const int y, const int x, const int shift, const Mat* hcube )
+// y_off is the image row stored in the first row of hcube (non zero when
+// processing the image by bands); y is always given in image coordinates
+static void ni_get_histogram( float* histogram, const int y, const int x, const int shift, const Mat* hcube,
+                              const int y_off = 0 )
 {
 
     if ( ! Point( x, y ).inside(
-           Rect( 0, 0, hcube->size[1]-1, hcube->size[0]-1 ) )
+           Rect( 0, 0, hcube->size[1]-1, hcube->size[0]+y_off-1 ) )
        ) return;
 
     int _hist_th_q_no = hcube->size[2];
-    const float* hptr = hcube->ptr<float>(y,x,0);
+    const float* hptr = hcube->ptr<float>(y-y_off,x,0);
     for( int h=0; h<_hist_th_q_no; h++ )
     {
       int hi = h+shift;
@@ -589,12 +614,13 @@ static void ni_get_histogram( float* histogram, const int y, const int x, const
     }
 }
 
-static void bi_get_histogram( float* histogram, const double y, const double x, const int shift, const Mat* hcube )
+static void bi_get_histogram( float* histogram, const double y, const double x, const int shift, const Mat* hcube,
+                              const int y_off = 0 )
 {
     int mnx = int( x );
     int mny = int( y );
     int _hist_th_q_no = hcube->size[2];
-    if( mnx >= hcube->size[1]-2  || mny >= hcube->size[0]-2 )
+    if( mnx >= hcube->size[1]-2  || mny >= hcube->size[0]+y_off-2 )
     {
       memset(histogram, 0, sizeof(float)*_hist_th_q_no);
       return;
@@ -602,10 +628,10 @@ static void bi_get_histogram( float* histogram, const double y, const double x,
 
     // A C --> pixel positions
     // B D
-    const float* A = hcube->ptr<float>( mny   ,  mnx   , 0);
-    const float* B = hcube->ptr<float>((mny+1),  mnx   , 0);
-    const float* C = hcube->ptr<float>( mny   , (mnx+1), 0);
-    const float* D = hcube->ptr<float>((mny+1), (mnx+1), 0);
+    const float* A = hcube->ptr<float>( mny-y_off   ,  mnx   , 0);
+    const float* B = hcube->ptr<float>((mny-y_off+1),  mnx   , 0);
+    const float* C = hcube->ptr<float>( mny-y_off   , (mnx+1), 0);
+    const float* D = hcube->ptr<float>((mny-y_off+1), (mnx+1), 0);
 
     double alpha = mnx+1-x;
     double beta  = mny+1-y;
@@ -635,13 +661,14 @@ static void bi_get_histogram( float* histogram, const double y, const double x,
     }
 }
 
-static void ti_get_histogram( float* histogram, const double y, const double x, const double shift, const Mat* hcube )
+static void ti_get_histogram( float* histogram, const double y, const double x, const double shift, const Mat* hcube,
+                              const int y_off = 0 )
 {
     int ishift = int( shift );
     double layer_alpha  = shift - ishift;
 
     float thist[MAX_CUBE_NO];
-    bi_get_histogram( thist, y, x, ishift, hcube );
+    bi_get_histogram( thist, y, x, ishift, hcube, y_off );
 
     int _hist_th_q_no = hcube->size[2];
     for( int h=0; h<_hist_th_q_no-1; h++ )
@@ -649,19 +676,21 @@ static void ti_get_histogram( float* histogram, const double y, const double x,
     histogram[_hist_th_q_no-1] = (float) ((1-layer_alpha)*thist[_hist_th_q_no-1]+layer_alpha*thist[0]);
 }
 
-static void i_get_histogram( float* histogram, const double y, const double x, const double shift, const Mat* hcube )
+static void i_get_histogram( float* histogram, const double y, const double x, const double shift, const Mat* hcube,
+                             const int y_off = 0 )
 {
     int ishift = (int)shift;
     double fshift = shift-ishift;
-    if     ( fshift < 0.01 ) bi_get_histogram( histogram, y, x, ishift  , hcube );
-    else if( fshift > 0.99 ) bi_get_histogram( histogram, y, x, ishift+1, hcube );
-    else                     ti_get_histogram( histogram, y, x,  shift  , hcube );
+    if     ( fshift < 0.01 ) bi_get_histogram( histogram, y, x, ishift  , hcube, y_off );
+    else if( fshift > 0.99 ) bi_get_histogram( histogram, y, x, ishift+1, hcube, y_off );
+    else                     ti_get_histogram( histogram, y, x,  shift  , hcube, y_off );
 }
 
 static void ni_get_descriptor( const double y, const double x, const int orientation, float* descriptor, const std::vector<Mat>* layers,
-                               const Mat* _oriented_grid_points, const double* _orientation_shift_table, const int _th_q_no )
+                               const Mat* _oriented_grid_points, const double* _orientation_shift_table, const int _th_q_no,
+                               const int y_off = 0 )
 {
-    CV_Assert( y >= 0 && y < layers->at(0).size[0] );
+    CV_Assert( y >= y_off && y < layers->at(0).size[0] + y_off );
     CV_Assert( x >= 0 && x < layers->at(0).size[1] );
     CV_Assert( orientation >= 0 && orientation < 360 );
     CV_Assert( !layers->empty() );
@@ -678,7 +707,7 @@ static void ni_get_descriptor( const double y, const double x, const int orienta
     int ix = (int)x; if( x - ix > 0.5 ) ix++;
 
     // center
-    ni_get_histogram( descriptor, iy, ix, ishift, &layers->at(g_selected_cubes[0]) );
+    ni_get_histogram( descriptor, iy, ix, ishift, &layers->at(g_selected_cubes[0]), y_off );
 
     double yy, xx;
     float* histogram=0;
@@ -696,19 +725,20 @@ static void ni_get_descriptor( const double y, const double x, const int orienta
          ix = (int)xx; if( xx - ix > 0.5 ) ix++;
 
          if ( ! Point2f( (float)xx, (float)yy ).inside(
-                Rect( 0, 0, layers->at(0).size[1]-1, layers->at(0).size[0]-1 ) )
+                Rect( 0, 0, layers->at(0).size[1]-1, layers->at(0).size[0]+y_off-1 ) )
             ) continue;
 
          histogram = descriptor + region*_hist_th_q_no;
-         ni_get_histogram( histogram, iy, ix, ishift, &layers->at(g_selected_cubes[r]) );
+         ni_get_histogram( histogram, iy, ix, ishift, &layers->at(g_selected_cubes[r]), y_off );
       }
     }
 }
 
 static void i_get_descriptor( const double y, const double x, const int orientation, float* descriptor, const std::vector<Mat>* layers,
-                              const Mat* _oriented_grid_points, const double *_orientation_shift_table, const int _th_q_no )
+                              const Mat* _oriented_grid_points, const double *_orientation_shift_table, const int _th_q_no,
+                              const int y_off = 0 )
 {
-    CV_Assert( y >= 0 && y < layers->at(0).size[0] );
+    CV_Assert( y >= y_off && y < layers->at(0).size[0] + y_off );
     CV_Assert( x >= 0 && x < layers->at(0).size[1] );
     CV_Assert( orientation >= 0 && orientation < 360 );
     CV_Assert( !layers->empty() );
@@ -719,7 +749,7 @@ static void i_get_descriptor( const double y, const double x, const int orientat
     int _hist_th_q_no = layers->at(0).size[2];
     double shift = _orientation_shift_table[orientation];
 
-    i_get_histogram( descriptor, y, x, shift, &layers->at(g_selected_cubes[0]) );
+    i_get_histogram( descriptor, y, x, shift, &layers->at(g_selected_cubes[0]), y_off );
 
     int r, rdt, region;
     double yy, xx;
@@ -737,11 +767,11 @@ static void i_get_descriptor( const double y, const double x, const int orientat
          xx = x + grid.at<double>(2*region + 1);
 
          if ( ! Point2f( (float)xx, (float)yy ).inside(
-                Rect( 0, 0, layers->at(0).size[1]-1, layers->at(0).size[0]-1 ) )
+                Rect( 0, 0, layers->at(0).size[1]-1, layers->at(0).size[0]+y_off-1 ) )
             ) continue;
 
          histogram = descriptor + region*_hist_th_q_no;
-         i_get_histogram( histogram, yy, xx, shift, &layers->at(r) );
+         i_get_histogram( histogram, yy, xx, shift, &layers->at(r), y_off );
       }
     }
 }
@@ -874,14 +904,15 @@ static bool i_get_descriptor_h( const double y, const double x, const int orient
 
 static void get_unnormalized_descriptor( const double y, const double x, const int orientation, float* descriptor,
             const std::vector<Mat>* m_smoothed_gradient_layers, const Mat* m_oriented_grid_points,
-            const double* m_orientation_shift_table, const int m_th_q_no, const bool m_enable_interpolation )
+            const double* m_orientation_shift_table, const int m_th_q_no, const bool m_enable_interpolation,
+            const int y_off = 0 )
 {
     if( m_enable_interpolation )
       i_get_descriptor( y, x, orientation, descriptor, m_smoothed_gradient_layers,
-                        m_oriented_grid_points, m_orientation_shift_table, m_th_q_no );
+                        m_oriented_grid_points, m_orientation_shift_table, m_th_q_no, y_off );
     else
      ni_get_descriptor( y, x, orientation, descriptor, m_smoothed_gradient_layers,
-                        m_oriented_grid_points, m_orientation_shift_table, m_th_q_no);
+                        m_oriented_grid_points, m_orientation_shift_table, m_th_q_no, y_off );
 }
 
 static void get_descriptor( const double y, const double x, const int orientation, float* descriptor,
@@ -986,14 +1017,15 @@ inline void DAISY_Impl::compute_grid_points()
 
 struct ComputeDescriptorsInvoker : ParallelLoopBody
 {
-    ComputeDescriptorsInvoker( Mat* _descriptors, Mat* _image, Rect* _roi,
+    ComputeDescriptorsInvoker( Mat* _descriptors, Rect* _roi, int _layers_y_off,
                                std::vector<Mat>* _layers, Mat* _orientation_map,
                                Mat* _oriented_grid_points, double* _orientation_shift_table,
                                int _th_q_no, bool _enable_interpolation )
     {
       x_off = _roi->x;
       x_end = _roi->x + _roi->width;
-      image = _image;
+      y_off = _roi->y;
+      layers_y_off = _layers_y_off;
       layers = _layers;
       th_q_no = _th_q_no;
       descriptors = _descriptors;
@@ -1010,7 +1042,8 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
       {
         for( int x = x_off; x < x_end; x++ )
         {
-          index = y*image->cols + x;
+          // descriptors are stored row by row for the roi pixels only
+          index = (y - y_off)*(x_end - x_off) + (x - x_off);
           orientation = 0;
           if( !orientation_map->empty() )
               orientation = (int) orientation_map->at<ushort>( y, x );
@@ -1018,19 +1051,20 @@ struct ComputeDescriptorsInvoker : ParallelLoopBody
               orientation = 0;
           get_unnormalized_descriptor( y, x, orientation, descriptors->ptr<float>( index ),
                                        layers, oriented_grid_points, orientation_shift_table,
-                                       th_q_no, enable_interpolation );
+                                       th_q_no, enable_interpolation, layers_y_off );
         }
       }
     }
 
     int th_q_no;
-    int x_off, x_end;
+    int x_off, x_end, y_off;
+    int layers_y_off;
     std::vector<Mat>* layers;
     Mat *descriptors;
     Mat *orientation_map;
     bool enable_interpolation;
     double* orientation_shift_table;
-    Mat *image, *oriented_grid_points;
+    Mat *oriented_grid_points;
 };
 
 // Computes the descriptor by sampling convoluted orientation maps.
@@ -1045,7 +1079,7 @@ inline void DAISY_Impl::compute_descriptors( Mat* m_dense_descriptors )
     m_dense_descriptors->setTo( Scalar(0) );
 
     parallel_for_( Range(y_off, y_end),
-        ComputeDescriptorsInvoker( m_dense_descriptors, &m_image, &m_roi, &m_smoothed_gradient_layers,
+        ComputeDescriptorsInvoker( m_dense_descriptors, &m_roi, m_layers_y_off, &m_smoothed_gradient_layers,
                                    &m_orientation_map, &m_oriented_grid_points, m_orientation_shift_table,
                                    m_th_q_no, m_enable_interpolation )
     );
@@ -1101,8 +1135,9 @@ inline void DAISY_Impl::initialize()
     m_smoothed_gradient_layers.resize( m_rad_q_no + 1 );
 
     int dims[3] = { m_hist_th_q_no, m_image.rows, m_image.cols };
+    m_layer_buffers.resize( m_rad_q_no + 1 );
     for ( int c=0; c<=m_rad_q_no; c++)
-      m_smoothed_gradient_layers[c] = Mat( 3, dims, CV_32F );
+      m_smoothed_gradient_layers[c] = layer_cube( c, dims );
 
     layered_gradient( m_image, &m_smoothed_gradient_layers[0] );
 
@@ -1175,21 +1210,54 @@ inline void DAISY_Impl::compute_histograms()
       int m_y = m_smoothed_gradient_layers.at(r).size[1];
       int m_x = m_smoothed_gradient_layers.at(r).size[2];
 
-      // empty targeted cube
-      m_smoothed_gradient_layers.at(r).release();
-
-      // recreate cube space
+      // recreate cube space over the storage of the targeted cube,
+      // its content is not needed anymore
       int dims[3] = { m_y, m_x, m_h };
-      m_smoothed_gradient_layers.at(r) = Mat( 3, dims, CV_32F );
+      m_smoothed_gradient_layers.at(r) = layer_cube( r, dims );
 
       // copy backward all cubes and realign structure
       parallel_for_( Range(0, m_image.rows), ComputeHistogramsInvoker( &m_smoothed_gradient_layers, r ) );
     }
     // trim unused region from collection of cubes
+    // (its storage is kept for the next band, if any)
     m_smoothed_gradient_layers[m_rad_q_no].release();
     m_smoothed_gradient_layers.pop_back();
 }
 
+// returns a cube header of the given dims over the storage of cube c,
+// growing the storage only when it is too small
+inline Mat DAISY_Impl::layer_cube( int c, const int* dims )
+{
+    int total = dims[0] * dims[1] * dims[2];
+    if( (int) m_layer_buffers[c].total() < total )
+      m_layer_buffers[c].create( 1, total, CV_32F );
+
+    return Mat( 3, dims, CV_32F, m_layer_buffers[c].ptr<float>() );
+}
+
+// number of rows above and below a band that influence the descriptors of the band:
+// the support of the successive smoothings plus the radius of the sampling grid
+inline int DAISY_Impl::band_margin() const
+{
+    // 5x5 blur and 3 taps derivatives of the layered gradient
+    int margin = 2 + 1;
+    // initial smoothing of the layers
+    margin += filter_size( sqrt(g_sigma_init*g_sigma_init-0.25f), 5.0f ) / 2;
+    // incremental smoothings of the cubes
+    for( int r=0; r<m_rad_q_no; r++ )
+    {
+      double sigma;
+      if( r == 0 )
+        sigma = m_cube_sigmas.at<double>(0);
+      else
+        sigma = sqrt( m_cube_sigmas.at<double>(r  ) * m_cube_sigmas.at<double>(r  )
+                    - m_cube_sigmas.at<double>(r-1) * m_cube_sigmas.at<double>(r-1) );
+      margin += filter_size( sigma, 5.0f ) / 2;
+    }
+    // grid radius, rounding and bilinear interpolation
+    return margin + cvCeil( m_rad ) + 3;
+}
+
 inline void DAISY_Impl::compute_smoothed_gradient_layers()
 {
     double sigma;
@@ -1588,6 +1656,58 @@ void DAISY_Impl::compute( InputArray _image, OutputArray _descriptors )
     normalize_descriptors( &descriptors );
 }
 
+// full scope, by bands of rows
+void DAISY_Impl::compute( InputArray _image, BandCallback& callback, int band_height )
+{
+    // do nothing if no image
+    if( _image.getMat().empty() )
+      return;
+
+    CV_Assert( m_h_matrix.empty() );
+    CV_Assert( ! m_use_orientation );
+    CV_Assert( band_height > 0 );
+
+    set_image( _image );
+    set_parameters();
+
+    Mat image = m_image;
+    Mat band_image, descriptors;
+    int margin = band_margin();
+
+    for( int y0 = 0; y0 < image.rows; y0 += band_height )
+    {
+      int y1 = std::min( y0 + band_height, image.rows );
+
+      // the band is extended by enough rows for its descriptors to be
+      // identical to the ones computed over the whole image
+      int ey0 = std::max( y0 - margin, 0 );
+      int ey1 = std::min( y1 + margin, image.rows );
+      image.rowRange( ey0, ey1 ).copyTo( band_image );
+
+      m_image = band_image;
+      m_layers_y_off = ey0;
+      m_roi = Rect( 0, y0, image.cols, y1 - y0 );
+
+      initialize_single_descriptor_mode();
+
+      descriptors.create( m_roi.width*m_roi.height, m_descriptor_size, CV_32F );
+
+      compute_descriptors( &descriptors );
+      normalize_descriptors( &descriptors );
+
+      callback( Range( y0, y1 ), descriptors );
+    }
+
+    // the layers only cover the last band, they are not usable afterwards
+    for (size_t i=0; i<m_smoothed_gradient_layers.size(); i++)
+      m_smoothed_gradient_layers[i].release();
+    m_smoothed_gradient_layers.clear();
+    m_layer_buffers.clear();
+
+    m_image = image;
+    m_layers_y_off = 0;
+}
+
 // constructor
 DAISY_Impl::DAISY_Impl( float _radius, int _q_radius, int _q_theta, int _q_hist,
              int _norm, InputArray _H, bool _interpolation, bool _use_orientation )
@@ -1597,6 +1717,7 @@ DAISY_Impl::DAISY_Impl( float _radius, int _q_radius, int _q_theta, int _q_hist,
 
     m_descriptor_size = 0;
     m_grid_point_number = 0;
+    m_layers_y_off = 0;
 
     m_scale_invariant = false;
     m_rotation_invariant = false;
@@ -0,0 +1,284 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//
+//                           License Agreement
+//                For Open Source Computer Vision Library
+//
+// Copyright (C) 2000-2008, Intel Corporation, all rights reserved.
+// Copyright (C) 2009, Willow Garage Inc., all rights reserved.
+// Third party copyrights are property of their respective owners.
+//
+// Redistribution and use in source and binary forms, with or without modification,
+// are permitted provided that the following conditions are met:
+//
+//   * Redistribution's of source code must retain the above copyright notice,
+//     this list of conditions and the following disclaimer.
+//
+//   * Redistribution's in binary form must reproduce the above copyright notice,
+//     this list of conditions and the following disclaimer in the documentation
+//     and/or other materials provided with the distribution.
+//
+//   * The name of the copyright holders may not be used to endorse or promote products
+//     derived from this software without specific prior written permission.
+//
+// This software is provided by the copyright holders and contributors "as is" and
+// any express or implied warranties, including, but not limited to, the implied
+// warranties of merchantability and fitness for a particular purpose are disclaimed.
+// In no event shall the Intel Corporation or contributors be liable for any direct,
+// indirect, incidental, special, exemplary, or consequential damages
+// (including, but not limited to, procurement of substitute goods or services;
+// loss of use, data, or profits; or business interruption) however caused
+// and on any theory of liability, whether in contract, strict liability,
+// or tort (including negligence or otherwise) arising in any way out of
+// the use of this software, even if advised of the possibility of such damage.
+//
+//M*/
+
+#include "precomp.hpp"
+#include "feature_context.hpp"
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+void rectifyPatch( const Mat& image, const KeyPoint& kp,
+                   const int& patchSize, Mat& patch,
+                   const bool use_scale_orientation,
+                   const float scale_factor )
+{
+    Mat M;
+    if ( use_scale_orientation )
+    {
+      const float s = scale_factor * (float) kp.size / (float) patchSize;
+
+      const float cosine = (kp.angle>=0) ? cos(kp.angle*(float)CV_PI/180.0f) : 1.f;
+      const float sine   = (kp.angle>=0) ? sin(kp.angle*(float)CV_PI/180.0f) : 0.f;
+
+      float M_[] = {
+          s*cosine, -s*sine,   (-s*cosine + s*sine  ) * patchSize/2.0f + kp.pt.x,
+          s*sine,    s*cosine, (-s*sine   - s*cosine) * patchSize/2.0f + kp.pt.y
+      };
+      M = Mat( 2, 3, CV_32FC1, M_ ).clone();
+    }
+    else
+    {
+      float M_[] = {
+          1.f,  0.f, -1.f * patchSize/2.0f + kp.pt.x,
+          0.f,  1.f, -1.f * patchSize/2.0f + kp.pt.y
+      };
+      M = Mat( 2, 3, CV_32FC1, M_ ).clone();
+    }
+
+    warpAffine( image, patch, M, Size( patchSize, patchSize ),
+                WARP_INVERSE_MAP + INTER_CUBIC + WARP_FILL_OUTLIERS );
+}
+
+struct RectifyPatchesInvoker : ParallelLoopBody
+{
+    RectifyPatchesInvoker( const Mat& _image, const std::vector<KeyPoint>& _keypoints, Mat* _patches,
+                           int _patch_size, bool _use_scale_orientation, float _scale_factor )
+    {
+      image = _image;
+      keypoints = &_keypoints;
+      patches = _patches;
+      patch_size = _patch_size;
+      use_scale_orientation = _use_scale_orientation;
+      scale_factor = _scale_factor;
+    }
+
+    void operator ()( const cv::Range& range ) const
+    {
+      for ( int i = range.start; i < range.end; i++ )
+      {
+        // the patch is written in place in its row
+        Mat patch = patches->row( i ).reshape( 1, patch_size );
+        rectifyPatch( image, (*keypoints)[i], patch_size, patch,
+                      use_scale_orientation, scale_factor );
+      }
+    }
+
+    Mat image;
+    const std::vector<KeyPoint>* keypoints;
+    Mat* patches;
+    int patch_size;
+    bool use_scale_orientation;
+    float scale_factor;
+};
+
+/*
+ !ImageFeatureContext implementation
+ */
+class ImageFeatureContext_Impl : public ImageFeatureContext
+{
+public:
+
+    explicit ImageFeatureContext_Impl( InputArray image );
+
+    virtual void compute( const Ptr<Feature2D>& extractor, std::vector<KeyPoint>& keypoints,
+                          OutputArray descriptors );
+
+    virtual Mat getImage() const { return m_image; }
+    virtual const Mat& getGray() const { return m_gray; }
+
+    virtual Mat getSmoothed( int ddepth, Size ksize, double sigma, int borderType );
+    virtual Mat getIntegral( int sdepth );
+    virtual Mat getRectifiedPatches( const std::vector<KeyPoint>& keypoints, int patchSize,
+                                     bool useScaleOrientation, float scaleFactor );
+
+    virtual void clear();
+
+protected:
+
+    struct Smoothed
+    {
+      int ddepth, borderType;
+      Size ksize;
+      double sigma;
+      Mat image;
+    };
+
+    struct Patches
+    {
+      int patchSize;
+      bool useScaleOrientation;
+      float scaleFactor;
+      std::vector<KeyPoint> keypoints;
+      Mat patches;
+    };
+
+    // source and grayscale images
+    Mat m_image, m_gray;
+
+    // cached data, looked up by parameters
+    std::vector<Smoothed> m_smoothed;
+    std::vector<Mat> m_integrals;
+    std::vector<Patches> m_patches;
+};
+
+ImageFeatureContext_Impl::ImageFeatureContext_Impl( InputArray _image )
+{
+    m_image = _image.getMat();
+    CV_Assert( !m_image.empty() );
+
+    if( m_image.channels() > 1 )
+      cvtColor( m_image, m_gray, COLOR_BGR2GRAY );
+    else
+      m_gray = m_image;
+}
+
+void ImageFeatureContext_Impl::compute( const Ptr<Feature2D>& extractor, std::vector<KeyPoint>& keypoints,
+                                        OutputArray descriptors )
+{
+    CV_Assert( !extractor.empty() );
+
+    ContextDescriptorExtractor* ctx_extractor = dynamic_cast<ContextDescriptorExtractor*>( extractor.get() );
+    if( ctx_extractor )
+      ctx_extractor->computeFromContext( *this, keypoints, descriptors );
+    else
+      extractor->compute( m_gray, keypoints, descriptors );
+}
+
+Mat ImageFeatureContext_Impl::getSmoothed( int ddepth, Size ksize, double sigma, int borderType )
+{
+    for ( size_t i = 0; i < m_smoothed.size(); i++ )
+    {
+      const Smoothed& s = m_smoothed[i];
+      if ( s.ddepth == ddepth && s.ksize == ksize && s.sigma == sigma && s.borderType == borderType )
+        return s.image;
+    }
+
+    Smoothed s;
+    s.ddepth = ddepth;
+    s.ksize = ksize;
+    s.sigma = sigma;
+    s.borderType = borderType;
+    if ( m_gray.depth() == ddepth )
+      GaussianBlur( m_gray, s.image, ksize, sigma, sigma, borderType );
+    else
+    {
+      m_gray.convertTo( s.image, ddepth );
+      GaussianBlur( s.image, s.image, ksize, sigma, sigma, borderType );
+    }
+    m_smoothed.push_back( s );
+
+    return m_smoothed.back().image;
+}
+
+Mat ImageFeatureContext_Impl::getIntegral( int sdepth )
+{
+    for ( size_t i = 0; i < m_integrals.size(); i++ )
+    {
+      if ( m_integrals[i].depth() == sdepth )
+        return m_integrals[i];
+    }
+
+    Mat sum;
+    integral( m_gray, sum, sdepth );
+    m_integrals.push_back( sum );
+
+    return m_integrals.back();
+}
+
+static bool sameKeypoints( const std::vector<KeyPoint>& a, const std::vector<KeyPoint>& b )
+{
+    if ( a.size() != b.size() )
+      return false;
+
+    for ( size_t i = 0; i < a.size(); i++ )
+    {
+      if ( a[i].pt != b[i].pt || a[i].size != b[i].size || a[i].angle != b[i].angle )
+        return false;
+    }
+    return true;
+}
+
+Mat ImageFeatureContext_Impl::getRectifiedPatches( const std::vector<KeyPoint>& keypoints, int patchSize,
+                                                   bool useScaleOrientation, float scaleFactor )
+{
+    CV_Assert( patchSize > 0 );
+
+    for ( size_t i = 0; i < m_patches.size(); i++ )
+    {
+      const Patches& p = m_patches[i];
+      if ( p.patchSize == patchSize && p.useScaleOrientation == useScaleOrientation &&
+           p.scaleFactor == scaleFactor && sameKeypoints( p.keypoints, keypoints ) )
+        return p.patches;
+    }
+
+    Patches p;
+    p.patchSize = patchSize;
+    p.useScaleOrientation = useScaleOrientation;
+    p.scaleFactor = scaleFactor;
+    p.keypoints = keypoints;
+    p.patches.create( (int) keypoints.size(), patchSize * patchSize, m_gray.type() );
+
+    parallel_for_( Range( 0, (int) keypoints.size() ),
+        RectifyPatchesInvoker( m_gray, keypoints, &p.patches,
+                               patchSize, useScaleOrientation, scaleFactor )
+    );
+    m_patches.push_back( p );
+
+    return m_patches.back().patches;
+}
+
+void ImageFeatureContext_Impl::clear()
+{
+    m_smoothed.clear();
+    m_integrals.clear();
+    m_patches.clear();
+}
+
+Ptr<ImageFeatureContext> ImageFeatureContext::create( InputArray image )
+{
+    return makePtr<ImageFeatureContext_Impl>( image );
+}
+
+} // END NAMESPACE XFEATURES2D
+} // END NAMESPACE CV
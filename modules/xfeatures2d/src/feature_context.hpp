@@ -0,0 +1,32 @@
+///////////// see LICENSE.txt in the OpenCV root directory //////////////
+
+#ifndef __OPENCV_XFEATURES2D_FEATURE_CONTEXT_HPP__
+#define __OPENCV_XFEATURES2D_FEATURE_CONTEXT_HPP__
+
+namespace cv
+{
+namespace xfeatures2d
+{
+
+/*!
+ Implemented by the descriptor extractors that can pull their image-wide
+ preprocessing from an ImageFeatureContext.
+ */
+class ContextDescriptorExtractor
+{
+public:
+    virtual ~ContextDescriptorExtractor() {}
+
+    //! same as Feature2D::compute() on the image of the context
+    virtual void computeFromContext( ImageFeatureContext& context, std::vector<KeyPoint>& keypoints,
+                                     OutputArray descriptors ) = 0;
+};
+
+//! samples a square patch around a keypoint (bicubic, outliers filled with 0)
+void rectifyPatch( const Mat& image, const KeyPoint& kp, const int& patchSize, Mat& patch,
+                   const bool use_scale_orientation, const float scale_factor );
+
+}
+}
+
+#endif
@@ -44,6 +44,8 @@
 //M*/
 
 #include "precomp.hpp"
+#include "opencv2/core/hal/intrin.hpp"
+#include "feature_context.hpp"
 #include <algorithm>
 #include <vector>
 
@@ -58,7 +60,7 @@ namespace cv
         /*
         * LATCH Descriptor
         */
-        class LATCHDescriptorExtractorImpl : public LATCH
+        class LATCHDescriptorExtractorImpl : public LATCH, public ContextDescriptorExtractor
         {
         public:
             enum { PATCH_SIZE = 48 };
@@ -74,8 +76,12 @@ namespace cv
 
             virtual void compute(InputArray image, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
 
+            // same as compute(), using the smoothed image of the context
+            virtual void computeFromContext(ImageFeatureContext& context, std::vector<KeyPoint>& keypoints, OutputArray descriptors);
+
+            typedef void(*PixelTestFn)(const Mat& input_image, const std::vector<KeyPoint>& keypoints, Mat& descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size, const Range& range);
+
         protected:
-            typedef void(*PixelTestFn)(const Mat& input_image, const std::vector<KeyPoint>& keypoints, OutputArray, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size);
             void setSamplingPoints();
             int bytes_;
             PixelTestFn test_fn_;
@@ -92,42 +98,32 @@ namespace cv
         }
         void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size);
 
-
-        static void pixelTests1(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        // compares the 8 triplets starting at points[count], the first triplet gives the most significant bit
+        static inline uchar tripletsByte(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, float cos_theta, float sin_theta, int half_ssd_size)
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 1; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
+            // triplet j is stored in lane 7-j so that its comparison lands on bit 7-j
+            int suma[8], sumc[8];
+            for (int j = 0; j < 8; j++){
+                suma[7 - j] = 0;
+                sumc[7 - j] = 0;
+                CalcuateSums(count + 6*j, points, rotationInvariance, grayImage, pt, suma[7 - j], sumc[7 - j], cos_theta, sin_theta, half_ssd_size);
             }
+#if CV_SIMD128
+            int bits = v_signmask(v_load(suma) < v_load(sumc)) |
+                      (v_signmask(v_load(suma + 4) < v_load(sumc + 4)) << 4);
+            return (uchar)bits;
+#else
+            uchar byte = 0;
+            for (int j = 0; j < 8; j++)
+                byte |= (uchar)((suma[j] < sumc[j]) << j);
+            return byte;
+#endif
         }
 
-
-        static void pixelTests2(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        template<int BYTES>
+        static void pixelTests(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, Mat& descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size, const Range& range)
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            for (int i = range.start; i < range.end; ++i)
             {
                 uchar* desc = descriptors.ptr(i);
                 const KeyPoint& pt = keypoints[i];
@@ -138,176 +134,41 @@ namespace cv
                 angle *= (float)(CV_PI / 180.f);
                 float cos_theta = cos(angle);
                 float sin_theta = sin(angle);
-                for (int ix = 0; ix < 2; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
+                for (int ix = 0; ix < BYTES; ix++){
+                    desc[ix] = tripletsByte(count, points, rotationInvariance, grayImage, pt, cos_theta, sin_theta, half_ssd_size);
+                    count += 6*8;
                 }
             }
         }
 
-
-        static void pixelTests4(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 4; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-
-        static void pixelTests8(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 8; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
-
-
-        static void pixelTests16(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
+        struct ComputeLATCHInvoker : ParallelLoopBody
         {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            ComputeLATCHInvoker( LATCHDescriptorExtractorImpl::PixelTestFn _test_fn, const Mat& _grayImage,
+                                 const std::vector<KeyPoint>& _keypoints, Mat& _descriptors,
+                                 const std::vector<int>& _points, bool _rotationInvariance, int _half_ssd_size )
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 16; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
+                test_fn = _test_fn;
+                grayImage = &_grayImage;
+                keypoints = &_keypoints;
+                descriptors = &_descriptors;
+                points = &_points;
+                rotationInvariance = _rotationInvariance;
+                half_ssd_size = _half_ssd_size;
             }
-        }
 
-
-        static void pixelTests32(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
+            void operator ()(const cv::Range& range) const
             {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 32; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
+                test_fn(*grayImage, *keypoints, *descriptors, *points, rotationInvariance, half_ssd_size, range);
             }
-        }
-
 
-        static void pixelTests64(const Mat& grayImage, const std::vector<KeyPoint>& keypoints, OutputArray _descriptors, const std::vector<int> &points, bool rotationInvariance, int half_ssd_size)
-        {
-            Mat descriptors = _descriptors.getMat();
-            for (int i = 0; i < (int)keypoints.size(); ++i)
-            {
-                uchar* desc = descriptors.ptr(i);
-                const KeyPoint& pt = keypoints[i];
-                int count = 0;
-
-                //handling keypoint orientation
-                float angle = pt.angle;
-                angle *= (float)(CV_PI / 180.f);
-                float cos_theta = cos(angle);
-                float sin_theta = sin(angle);
-                for (int ix = 0; ix < 64; ix++){
-                    desc[ix] = 0;
-                    for (int j = 7; j >= 0; j--){
-
-                        int suma = 0;
-                        int sumc = 0;
-
-                        CalcuateSums(count, points, rotationInvariance, grayImage, pt, suma, sumc, cos_theta, sin_theta, half_ssd_size);
-                        desc[ix] += (uchar)((suma < sumc) << j);
-
-                        count += 6;
-                    }
-                }
-            }
-        }
+            LATCHDescriptorExtractorImpl::PixelTestFn test_fn;
+            const Mat* grayImage;
+            const std::vector<KeyPoint>* keypoints;
+            Mat* descriptors;
+            const std::vector<int>* points;
+            bool rotationInvariance;
+            int half_ssd_size;
+        };
 
         void CalcuateSums(int count, const std::vector<int> &points, bool rotationInvariance, const Mat &grayImage, const KeyPoint &pt, int &suma, int &sumc, float cos_theta, float sin_theta, int half_ssd_size)
 
@@ -383,6 +244,28 @@ namespace cv
 
 
             int K = half_ssd_size;
+#if CV_SIMD128
+            // a patch row fits in 8 lanes, the lanes beyond the patch width are masked out
+            if (2*K + 1 <= 8 && std::max(ax2, std::max(bx2, cx2)) - K + 8 <= grayImage.cols)
+            {
+                static const short lane_mask[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+                v_int16x8 vmask = v_load(lane_mask + 8 - (2*K + 1));
+                v_int32x4 vsuma = v_setzero_s32(), vsumc = v_setzero_s32();
+                for (int iy = -K; iy <= K; iy++)
+                {
+                    v_int16x8 va = v_reinterpret_as_s16(v_load_expand(grayImage.ptr<uchar>(ay2 + iy) + ax2 - K));
+                    v_int16x8 vb = v_reinterpret_as_s16(v_load_expand(grayImage.ptr<uchar>(by2 + iy) + bx2 - K));
+                    v_int16x8 vc = v_reinterpret_as_s16(v_load_expand(grayImage.ptr<uchar>(cy2 + iy) + cx2 - K));
+                    v_int16x8 difa = (va - vb) & vmask;
+                    v_int16x8 difc = (vc - vb) & vmask;
+                    vsuma += v_dotprod(difa, difa);
+                    vsumc += v_dotprod(difc, difc);
+                }
+                suma += v_reduce_sum(vsuma);
+                sumc += v_reduce_sum(vsumc);
+                return;
+            }
+#endif
             for (int iy = -K; iy <= K; iy++)
             {
                 const uchar * Mi_a = grayImage.ptr<uchar>(ay2 + iy);
@@ -409,25 +292,25 @@ namespace cv
             switch (bytes)
             {
             case 1:
-                test_fn_ = pixelTests1;
+                test_fn_ = pixelTests<1>;
                 break;
             case 2:
-                test_fn_ = pixelTests2;
+                test_fn_ = pixelTests<2>;
                 break;
             case 4:
-                test_fn_ = pixelTests4;
+                test_fn_ = pixelTests<4>;
                 break;
             case 8:
-                test_fn_ = pixelTests8;
+                test_fn_ = pixelTests<8>;
                 break;
             case 16:
-                test_fn_ = pixelTests16;
+                test_fn_ = pixelTests<16>;
                 break;
             case 32:
-                test_fn_ = pixelTests32;
+                test_fn_ = pixelTests<32>;
                 break;
             case 64:
-                test_fn_ = pixelTests64;
+                test_fn_ = pixelTests<64>;
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
@@ -457,25 +340,25 @@ namespace cv
             switch (dSize)
             {
             case 1:
-                test_fn_ = pixelTests1;
+                test_fn_ = pixelTests<1>;
                 break;
             case 2:
-                test_fn_ = pixelTests2;
+                test_fn_ = pixelTests<2>;
                 break;
             case 4:
-                test_fn_ = pixelTests4;
+                test_fn_ = pixelTests<4>;
                 break;
             case 8:
-                test_fn_ = pixelTests8;
+                test_fn_ = pixelTests<8>;
                 break;
             case 16:
-                test_fn_ = pixelTests16;
+                test_fn_ = pixelTests<16>;
                 break;
             case 32:
-                test_fn_ = pixelTests32;
+                test_fn_ = pixelTests<32>;
                 break;
             case 64:
-                test_fn_ = pixelTests64;
+                test_fn_ = pixelTests<64>;
                 break;
             default:
                 CV_Error(Error::StsBadArg, "descriptorSize must be 1,2, 4, 8, 16, 32, or 64");
@@ -500,16 +383,21 @@ namespace cv
             if ( keypoints.empty() )
                 return;
 
+            Ptr<ImageFeatureContext> context = ImageFeatureContext::create(image);
+            computeFromContext(*context, keypoints, _descriptors);
+        }
 
-            Mat grayImage;
-            GaussianBlur(image, grayImage, cv::Size(3, 3), 2, 2);
-
-            if (image.type() != CV_8U) cvtColor(image, grayImage, COLOR_BGR2GRAY);
-
+        void LATCHDescriptorExtractorImpl::computeFromContext(ImageFeatureContext& context,
+            std::vector<KeyPoint>& keypoints,
+            OutputArray _descriptors)
+        {
+            if ( keypoints.empty() )
+                return;
 
+            Mat grayImage = context.getSmoothed(CV_8U, cv::Size(3, 3), 2);
 
             //Remove keypoints very close to the border
-            KeyPointsFilter::runByImageBorder(keypoints, image.size(), PATCH_SIZE / 2 + half_ssd_size_);
+            KeyPointsFilter::runByImageBorder(keypoints, grayImage.size(), PATCH_SIZE / 2 + half_ssd_size_);
             
             bool _1d = false;
             Mat descriptors;
@@ -531,7 +419,8 @@ namespace cv
             //Mat descriptors = _descriptors.getMat();
 
 
-            test_fn_(grayImage, keypoints, descriptors, sampling_points_, rotationInvariance_, half_ssd_size_);
+            parallel_for_(Range(0, (int)keypoints.size()),
+                ComputeLATCHInvoker(test_fn_, grayImage, keypoints, descriptors, sampling_points_, rotationInvariance_, half_ssd_size_));
         }
 
 
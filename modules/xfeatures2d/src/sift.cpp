@@ -106,6 +106,7 @@
 #include <iostream>
 #include <stdarg.h>
 #include <opencv2/core/hal/hal.hpp>
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -140,17 +141,31 @@ public:
                     OutputArray descriptors,
                     bool useProvidedKeypoints = false);
 
+    //! builds the scale space of the image once for the following calls on the same image
+    void buildPyramid( InputArray image );
+
+    //! releases the scale space stored by buildPyramid()
+    void releasePyramid();
+
     void buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, int nOctaves ) const;
     void buildDoGPyramid( const std::vector<Mat>& pyr, std::vector<Mat>& dogpyr ) const;
     void findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
                                std::vector<KeyPoint>& keypoints ) const;
 
 protected:
+    //! checks whether the stored scale space was built for this image and covers the requested octaves
+    bool hasPyramid( const Mat& image, int firstOctave, int nOctaves ) const;
+
     CV_PROP_RW int nfeatures;
     CV_PROP_RW int nOctaveLayers;
     CV_PROP_RW double contrastThreshold;
     CV_PROP_RW double edgeThreshold;
     CV_PROP_RW double sigma;
+
+    //! scale space stored by buildPyramid()
+    Mat pyramidImage;
+    int pyramidFirstOctave;
+    std::vector<Mat> pyramidGauss, pyramidDoG;
 };
 
 Ptr<SIFT> SIFT::create( int _nfeatures, int _nOctaveLayers,
@@ -284,21 +299,40 @@ void SIFT_Impl::buildGaussianPyramid( const Mat& base, std::vector<Mat>& pyr, in
 }
 
 
-void SIFT_Impl::buildDoGPyramid( const std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr ) const
+class SIFTBuildDoGInvoker : public ParallelLoopBody
 {
-    int nOctaves = (int)gpyr.size()/(nOctaveLayers + 3);
-    dogpyr.resize( nOctaves*(nOctaveLayers + 2) );
+public:
+    SIFTBuildDoGInvoker( int _nOctaveLayers, const std::vector<Mat>& _gpyr, std::vector<Mat>& _dogpyr )
+        : nOctaveLayers(_nOctaveLayers), gpyr(_gpyr), dogpyr(_dogpyr) {}
 
-    for( int o = 0; o < nOctaves; o++ )
+    void operator()( const Range& range ) const
     {
-        for( int i = 0; i < nOctaveLayers + 2; i++ )
+        for( int a = range.start; a < range.end; a++ )
         {
+            const int o = a / (nOctaveLayers + 2);
+            const int i = a % (nOctaveLayers + 2);
+
             const Mat& src1 = gpyr[o*(nOctaveLayers + 3) + i];
             const Mat& src2 = gpyr[o*(nOctaveLayers + 3) + i + 1];
             Mat& dst = dogpyr[o*(nOctaveLayers + 2) + i];
             subtract(src2, src1, dst, noArray(), DataType<sift_wt>::type);
         }
     }
+
+private:
+    SIFTBuildDoGInvoker& operator=( const SIFTBuildDoGInvoker& );
+
+    int nOctaveLayers;
+    const std::vector<Mat>& gpyr;
+    std::vector<Mat>& dogpyr;
+};
+
+void SIFT_Impl::buildDoGPyramid( const std::vector<Mat>& gpyr, std::vector<Mat>& dogpyr ) const
+{
+    int nOctaves = (int)gpyr.size()/(nOctaveLayers + 3);
+    dogpyr.resize( nOctaves*(nOctaveLayers + 2) );
+
+    parallel_for_(Range(0, nOctaves*(nOctaveLayers + 2)), SIFTBuildDoGInvoker(nOctaveLayers, gpyr, dogpyr));
 }
 
 
@@ -479,92 +513,208 @@ static bool adjustLocalExtrema( const std::vector<Mat>& dog_pyr, KeyPoint& kpt,
 }
 
 
+// number of DoG rows searched for extrema by a single task
+static const int SIFT_EXTREMA_ROWS_PER_TASK = 16;
+
+struct SIFTExtremaTask
+{
+    int octave, layer;
+    int rowStart, rowEnd;
+};
+
+class SIFTFindExtremaInvoker : public ParallelLoopBody
+{
+public:
+    SIFTFindExtremaInvoker( const std::vector<Mat>& _gauss_pyr, const std::vector<Mat>& _dog_pyr,
+                            const std::vector<SIFTExtremaTask>& _tasks,
+                            std::vector<std::vector<KeyPoint> >& _taskKeypoints,
+                            int _nOctaveLayers, float _contrastThreshold, float _edgeThreshold,
+                            float _sigma, int _threshold )
+        : gauss_pyr(_gauss_pyr), dog_pyr(_dog_pyr), tasks(_tasks), taskKeypoints(_taskKeypoints),
+          nOctaveLayers(_nOctaveLayers), contrastThreshold(_contrastThreshold),
+          edgeThreshold(_edgeThreshold), sigma(_sigma), threshold(_threshold) {}
+
+    void operator()( const Range& range ) const
+    {
+        for( int t = range.start; t < range.end; t++ )
+            findExtrema(tasks[t], taskKeypoints[t]);
+    }
+
+private:
+    SIFTFindExtremaInvoker& operator=( const SIFTFindExtremaInvoker& );
+
+    void findExtrema( const SIFTExtremaTask& task, std::vector<KeyPoint>& keypoints ) const
+    {
+        const int o = task.octave, i = task.layer;
+        const int idx = o*(nOctaveLayers+2)+i;
+        const Mat& img = dog_pyr[idx];
+        const Mat& prev = dog_pyr[idx-1];
+        const Mat& next = dog_pyr[idx+1];
+        int step = (int)img.step1();
+        int cols = img.cols;
+
+        for( int r = task.rowStart; r < task.rowEnd; r++)
+        {
+            const sift_wt* currptr = img.ptr<sift_wt>(r);
+            const sift_wt* prevptr = prev.ptr<sift_wt>(r);
+            const sift_wt* nextptr = next.ptr<sift_wt>(r);
+            int c = SIFT_IMG_BORDER;
+
+#if CV_SIMD128
+            // a pixel is an extremum candidate when it exceeds the threshold and
+            // dominates the maximum (or minimum) of its 26 neighbours
+            const v_float32x4 vthr = v_setall_f32((float)threshold), vnthr = v_setall_f32(-(float)threshold);
+            for( ; c <= cols - SIFT_IMG_BORDER - 4; c += 4 )
+            {
+                v_float32x4 val = v_load(currptr + c);
+                v_float32x4 vmax = v_max(v_load(currptr + c - 1), v_load(currptr + c + 1));
+                v_float32x4 vmin = v_min(v_load(currptr + c - 1), v_load(currptr + c + 1));
+                for( int dr = -1; dr <= 1; dr += 2 )
+                {
+                    for( int dc = -1; dc <= 1; dc++ )
+                    {
+                        v_float32x4 v = v_load(currptr + c + dr*step + dc);
+                        vmax = v_max(vmax, v);
+                        vmin = v_min(vmin, v);
+                    }
+                }
+                for( int dr = -1; dr <= 1; dr++ )
+                {
+                    for( int dc = -1; dc <= 1; dc++ )
+                    {
+                        v_float32x4 vp = v_load(prevptr + c + dr*step + dc);
+                        v_float32x4 vn = v_load(nextptr + c + dr*step + dc);
+                        vmax = v_max(vmax, v_max(vp, vn));
+                        vmin = v_min(vmin, v_min(vp, vn));
+                    }
+                }
+
+                int mask = v_signmask(((val > vthr) & (val >= vmax)) | ((val < vnthr) & (val <= vmin)));
+                for( int k = 0; mask != 0; k++, mask >>= 1 )
+                {
+                    if( mask & 1 )
+                        addExtremum(o, i, r, c + k, keypoints);
+                }
+            }
+#endif
+
+            for( ; c < cols-SIFT_IMG_BORDER; c++)
+            {
+                sift_wt val = currptr[c];
+
+                // find local extrema with pixel accuracy
+                if( std::abs(val) > threshold &&
+                   ((val > 0 && val >= currptr[c-1] && val >= currptr[c+1] &&
+                     val >= currptr[c-step-1] && val >= currptr[c-step] && val >= currptr[c-step+1] &&
+                     val >= currptr[c+step-1] && val >= currptr[c+step] && val >= currptr[c+step+1] &&
+                     val >= nextptr[c] && val >= nextptr[c-1] && val >= nextptr[c+1] &&
+                     val >= nextptr[c-step-1] && val >= nextptr[c-step] && val >= nextptr[c-step+1] &&
+                     val >= nextptr[c+step-1] && val >= nextptr[c+step] && val >= nextptr[c+step+1] &&
+                     val >= prevptr[c] && val >= prevptr[c-1] && val >= prevptr[c+1] &&
+                     val >= prevptr[c-step-1] && val >= prevptr[c-step] && val >= prevptr[c-step+1] &&
+                     val >= prevptr[c+step-1] && val >= prevptr[c+step] && val >= prevptr[c+step+1]) ||
+                    (val < 0 && val <= currptr[c-1] && val <= currptr[c+1] &&
+                     val <= currptr[c-step-1] && val <= currptr[c-step] && val <= currptr[c-step+1] &&
+                     val <= currptr[c+step-1] && val <= currptr[c+step] && val <= currptr[c+step+1] &&
+                     val <= nextptr[c] && val <= nextptr[c-1] && val <= nextptr[c+1] &&
+                     val <= nextptr[c-step-1] && val <= nextptr[c-step] && val <= nextptr[c-step+1] &&
+                     val <= nextptr[c+step-1] && val <= nextptr[c+step] && val <= nextptr[c+step+1] &&
+                     val <= prevptr[c] && val <= prevptr[c-1] && val <= prevptr[c+1] &&
+                     val <= prevptr[c-step-1] && val <= prevptr[c-step] && val <= prevptr[c-step+1] &&
+                     val <= prevptr[c+step-1] && val <= prevptr[c+step] && val <= prevptr[c+step+1])))
+                {
+                    addExtremum(o, i, r, c, keypoints);
+                }
+            }
+        }
+    }
+
+    // refines an extremum found with pixel accuracy and stores a keypoint per dominant orientation
+    void addExtremum( int o, int i, int r, int c, std::vector<KeyPoint>& keypoints ) const
+    {
+        const int n = SIFT_ORI_HIST_BINS;
+        float hist[n];
+        KeyPoint kpt;
+
+        int r1 = r, c1 = c, layer = i;
+        if( !adjustLocalExtrema(dog_pyr, kpt, o, layer, r1, c1,
+                                nOctaveLayers, contrastThreshold,
+                                edgeThreshold, sigma) )
+            return;
+        float scl_octv = kpt.size*0.5f/(1 << o);
+        float omax = calcOrientationHist(gauss_pyr[o*(nOctaveLayers+3) + layer],
+                                         Point(c1, r1),
+                                         cvRound(SIFT_ORI_RADIUS * scl_octv),
+                                         SIFT_ORI_SIG_FCTR * scl_octv,
+                                         hist, n);
+        float mag_thr = (float)(omax * SIFT_ORI_PEAK_RATIO);
+        for( int j = 0; j < n; j++ )
+        {
+            int l = j > 0 ? j - 1 : n - 1;
+            int r2 = j < n-1 ? j + 1 : 0;
+
+            if( hist[j] > hist[l]  &&  hist[j] > hist[r2]  &&  hist[j] >= mag_thr )
+            {
+                float bin = j + 0.5f * (hist[l]-hist[r2]) / (hist[l] - 2*hist[j] + hist[r2]);
+                bin = bin < 0 ? n + bin : bin >= n ? bin - n : bin;
+                kpt.angle = 360.f - (float)((360.f/n) * bin);
+                if(std::abs(kpt.angle - 360.f) < FLT_EPSILON)
+                    kpt.angle = 0.f;
+                keypoints.push_back(kpt);
+            }
+        }
+    }
+
+    const std::vector<Mat>& gauss_pyr;
+    const std::vector<Mat>& dog_pyr;
+    const std::vector<SIFTExtremaTask>& tasks;
+    std::vector<std::vector<KeyPoint> >& taskKeypoints;
+    int nOctaveLayers;
+    float contrastThreshold, edgeThreshold, sigma;
+    int threshold;
+};
+
 //
 // Detects features at extrema in DoG scale space.  Bad features are discarded
 // based on contrast and ratio of principal curvatures.
+// The layers are split in row stripes searched concurrently; keypoints are
+// gathered in stripe order so that the output does not depend on scheduling.
 void SIFT_Impl::findScaleSpaceExtrema( const std::vector<Mat>& gauss_pyr, const std::vector<Mat>& dog_pyr,
                                   std::vector<KeyPoint>& keypoints ) const
 {
     int nOctaves = (int)gauss_pyr.size()/(nOctaveLayers + 3);
     int threshold = cvFloor(0.5 * contrastThreshold / nOctaveLayers * 255 * SIFT_FIXPT_SCALE);
-    const int n = SIFT_ORI_HIST_BINS;
-    float hist[n];
-    KeyPoint kpt;
 
     keypoints.clear();
 
+    std::vector<SIFTExtremaTask> tasks;
     for( int o = 0; o < nOctaves; o++ )
         for( int i = 1; i <= nOctaveLayers; i++ )
         {
-            int idx = o*(nOctaveLayers+2)+i;
-            const Mat& img = dog_pyr[idx];
-            const Mat& prev = dog_pyr[idx-1];
-            const Mat& next = dog_pyr[idx+1];
-            int step = (int)img.step1();
-            int rows = img.rows, cols = img.cols;
-
-            for( int r = SIFT_IMG_BORDER; r < rows-SIFT_IMG_BORDER; r++)
+            int rows = dog_pyr[o*(nOctaveLayers+2)+i].rows;
+            for( int r = SIFT_IMG_BORDER; r < rows-SIFT_IMG_BORDER; r += SIFT_EXTREMA_ROWS_PER_TASK )
             {
-                const sift_wt* currptr = img.ptr<sift_wt>(r);
-                const sift_wt* prevptr = prev.ptr<sift_wt>(r);
-                const sift_wt* nextptr = next.ptr<sift_wt>(r);
-
-                for( int c = SIFT_IMG_BORDER; c < cols-SIFT_IMG_BORDER; c++)
-                {
-                    sift_wt val = currptr[c];
-
-                    // find local extrema with pixel accuracy
-                    if( std::abs(val) > threshold &&
-                       ((val > 0 && val >= currptr[c-1] && val >= currptr[c+1] &&
-                         val >= currptr[c-step-1] && val >= currptr[c-step] && val >= currptr[c-step+1] &&
-                         val >= currptr[c+step-1] && val >= currptr[c+step] && val >= currptr[c+step+1] &&
-                         val >= nextptr[c] && val >= nextptr[c-1] && val >= nextptr[c+1] &&
-                         val >= nextptr[c-step-1] && val >= nextptr[c-step] && val >= nextptr[c-step+1] &&
-                         val >= nextptr[c+step-1] && val >= nextptr[c+step] && val >= nextptr[c+step+1] &&
-                         val >= prevptr[c] && val >= prevptr[c-1] && val >= prevptr[c+1] &&
-                         val >= prevptr[c-step-1] && val >= prevptr[c-step] && val >= prevptr[c-step+1] &&
-                         val >= prevptr[c+step-1] && val >= prevptr[c+step] && val >= prevptr[c+step+1]) ||
-                        (val < 0 && val <= currptr[c-1] && val <= currptr[c+1] &&
-                         val <= currptr[c-step-1] && val <= currptr[c-step] && val <= currptr[c-step+1] &&
-                         val <= currptr[c+step-1] && val <= currptr[c+step] && val <= currptr[c+step+1] &&
-                         val <= nextptr[c] && val <= nextptr[c-1] && val <= nextptr[c+1] &&
-                         val <= nextptr[c-step-1] && val <= nextptr[c-step] && val <= nextptr[c-step+1] &&
-                         val <= nextptr[c+step-1] && val <= nextptr[c+step] && val <= nextptr[c+step+1] &&
-                         val <= prevptr[c] && val <= prevptr[c-1] && val <= prevptr[c+1] &&
-                         val <= prevptr[c-step-1] && val <= prevptr[c-step] && val <= prevptr[c-step+1] &&
-                         val <= prevptr[c+step-1] && val <= prevptr[c+step] && val <= prevptr[c+step+1])))
-                    {
-                        int r1 = r, c1 = c, layer = i;
-                        if( !adjustLocalExtrema(dog_pyr, kpt, o, layer, r1, c1,
-                                                nOctaveLayers, (float)contrastThreshold,
-                                                (float)edgeThreshold, (float)sigma) )
-                            continue;
-                        float scl_octv = kpt.size*0.5f/(1 << o);
-                        float omax = calcOrientationHist(gauss_pyr[o*(nOctaveLayers+3) + layer],
-                                                         Point(c1, r1),
-                                                         cvRound(SIFT_ORI_RADIUS * scl_octv),
-                                                         SIFT_ORI_SIG_FCTR * scl_octv,
-                                                         hist, n);
-                        float mag_thr = (float)(omax * SIFT_ORI_PEAK_RATIO);
-                        for( int j = 0; j < n; j++ )
-                        {
-                            int l = j > 0 ? j - 1 : n - 1;
-                            int r2 = j < n-1 ? j + 1 : 0;
-
-                            if( hist[j] > hist[l]  &&  hist[j] > hist[r2]  &&  hist[j] >= mag_thr )
-                            {
-                                float bin = j + 0.5f * (hist[l]-hist[r2]) / (hist[l] - 2*hist[j] + hist[r2]);
-                                bin = bin < 0 ? n + bin : bin >= n ? bin - n : bin;
-                                kpt.angle = 360.f - (float)((360.f/n) * bin);
-                                if(std::abs(kpt.angle - 360.f) < FLT_EPSILON)
-                                    kpt.angle = 0.f;
-                                keypoints.push_back(kpt);
-                            }
-                        }
-                    }
-                }
+                SIFTExtremaTask task;
+                task.octave = o;
+                task.layer = i;
+                task.rowStart = r;
+                task.rowEnd = std::min(r + SIFT_EXTREMA_ROWS_PER_TASK, rows-SIFT_IMG_BORDER);
+                tasks.push_back(task);
             }
         }
+
+    std::vector<std::vector<KeyPoint> > taskKeypoints(tasks.size());
+    parallel_for_(Range(0, (int)tasks.size()),
+                  SIFTFindExtremaInvoker(gauss_pyr, dog_pyr, tasks, taskKeypoints, nOctaveLayers,
+                                         (float)contrastThreshold, (float)edgeThreshold,
+                                         (float)sigma, threshold));
+
+    size_t total = 0;
+    for( size_t t = 0; t < taskKeypoints.size(); t++ )
+        total += taskKeypoints[t].size();
+    keypoints.reserve(total);
+    for( size_t t = 0; t < taskKeypoints.size(); t++ )
+        keypoints.insert(keypoints.end(), taskKeypoints[t].begin(), taskKeypoints[t].end());
 }
 
 
@@ -625,7 +775,72 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
     cv::hal::magnitude32f(X, Y, Mag, len);
     cv::hal::exp32f(W, W, len);
 
-    for( k = 0; k < len; k++ )
+    k = 0;
+#if CV_SIMD128
+    {
+        // the interpolation weights of 4 samples are computed at once,
+        // only the scattered histogram updates remain scalar
+        int CV_DECL_ALIGNED(16) idx_buf[4];
+        float CV_DECL_ALIGNED(16) rco_buf[8*4];
+        const v_float32x4 v_ori = v_setall_f32(ori), v_bins_per_rad = v_setall_f32(bins_per_rad);
+        const v_int32x4 v_n = v_setall_s32(n), v_zero = v_setzero_s32();
+
+        for( ; k <= len - 4; k += 4 )
+        {
+            v_float32x4 rbin = v_load(RBin + k);
+            v_float32x4 cbin = v_load(CBin + k);
+            v_float32x4 obin = (v_load(Ori + k) - v_ori) * v_bins_per_rad;
+            v_float32x4 mag = v_load(Mag + k) * v_load(W + k);
+
+            v_int32x4 r0 = v_floor(rbin);
+            v_int32x4 c0 = v_floor(cbin);
+            v_int32x4 o0 = v_floor(obin);
+            rbin -= v_cvt_f32(r0);
+            cbin -= v_cvt_f32(c0);
+            obin -= v_cvt_f32(o0);
+
+            o0 += v_n & (o0 < v_zero);
+            o0 -= v_n & (o0 >= v_n);
+
+            // histogram update using tri-linear interpolation
+            v_float32x4 v_r1 = mag*rbin, v_r0 = mag - v_r1;
+            v_float32x4 v_rc11 = v_r1*cbin, v_rc10 = v_r1 - v_rc11;
+            v_float32x4 v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01;
+            v_float32x4 v_rco111 = v_rc11*obin, v_rco110 = v_rc11 - v_rco111;
+            v_float32x4 v_rco101 = v_rc10*obin, v_rco100 = v_rc10 - v_rco101;
+            v_float32x4 v_rco011 = v_rc01*obin, v_rco010 = v_rc01 - v_rco011;
+            v_float32x4 v_rco001 = v_rc00*obin, v_rco000 = v_rc00 - v_rco001;
+
+            v_store_aligned(rco_buf, v_rco000);
+            v_store_aligned(rco_buf + 4, v_rco001);
+            v_store_aligned(rco_buf + 8, v_rco010);
+            v_store_aligned(rco_buf + 12, v_rco011);
+            v_store_aligned(rco_buf + 16, v_rco100);
+            v_store_aligned(rco_buf + 20, v_rco101);
+            v_store_aligned(rco_buf + 24, v_rco110);
+            v_store_aligned(rco_buf + 28, v_rco111);
+
+            int CV_DECL_ALIGNED(16) r0_buf[4], c0_buf[4];
+            v_store_aligned(r0_buf, r0);
+            v_store_aligned(c0_buf, c0);
+            v_store_aligned(idx_buf, o0);
+
+            for( int id = 0; id < 4; id++ )
+            {
+                int idx = ((r0_buf[id]+1)*(d+2) + c0_buf[id]+1)*(n+2) + idx_buf[id];
+                hist[idx] += rco_buf[id];
+                hist[idx+1] += rco_buf[id + 4];
+                hist[idx+(n+2)] += rco_buf[id + 8];
+                hist[idx+(n+3)] += rco_buf[id + 12];
+                hist[idx+(d+2)*(n+2)] += rco_buf[id + 16];
+                hist[idx+(d+2)*(n+2)+1] += rco_buf[id + 20];
+                hist[idx+(d+3)*(n+2)] += rco_buf[id + 24];
+                hist[idx+(d+3)*(n+2)+1] += rco_buf[id + 28];
+            }
+        }
+    }
+#endif
+    for( ; k < len; k++ )
     {
         float rbin = RBin[k], cbin = CBin[k];
         float obin = (Ori[k] - ori)*bins_per_rad;
@@ -679,10 +894,35 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
     // to byte array
     float nrm2 = 0;
     len = d*d*n;
-    for( k = 0; k < len; k++ )
+    k = 0;
+#if CV_SIMD128
+    {
+        v_float32x4 v_nrm2 = v_setzero_f32();
+        for( ; k <= len - 4; k += 4 )
+        {
+            v_float32x4 v = v_load(dst + k);
+            v_nrm2 += v * v;
+        }
+        nrm2 = v_reduce_sum(v_nrm2);
+    }
+#endif
+    for( ; k < len; k++ )
         nrm2 += dst[k]*dst[k];
     float thr = std::sqrt(nrm2)*SIFT_DESCR_MAG_THR;
-    for( i = 0, nrm2 = 0; i < k; i++ )
+    i = 0, nrm2 = 0;
+#if CV_SIMD128
+    {
+        v_float32x4 v_nrm2 = v_setzero_f32(), v_thr = v_setall_f32(thr);
+        for( ; i <= len - 4; i += 4 )
+        {
+            v_float32x4 v = v_min(v_load(dst + i), v_thr);
+            v_store(dst + i, v);
+            v_nrm2 += v * v;
+        }
+        nrm2 = v_reduce_sum(v_nrm2);
+    }
+#endif
+    for( ; i < len; i++ )
     {
         float val = std::min(dst[i], thr);
         dst[i] = val;
@@ -710,27 +950,60 @@ static void calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, float sc
 #endif
 }
 
-static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints,
-                            Mat& descriptors, int nOctaveLayers, int firstOctave )
+class SIFTDescriptorInvoker : public ParallelLoopBody
 {
-    int d = SIFT_DESCR_WIDTH, n = SIFT_DESCR_HIST_BINS;
+public:
+    SIFTDescriptorInvoker( const std::vector<Mat>& _gpyr, const std::vector<KeyPoint>& _keypoints,
+                           Mat& _descriptors, int _nOctaveLayers, int _firstOctave )
+        : gpyr(_gpyr), keypoints(_keypoints), descriptors(_descriptors),
+          nOctaveLayers(_nOctaveLayers), firstOctave(_firstOctave) {}
 
-    for( size_t i = 0; i < keypoints.size(); i++ )
+    void operator()( const Range& range ) const
     {
-        KeyPoint kpt = keypoints[i];
-        int octave, layer;
-        float scale;
-        unpackOctave(kpt, octave, layer, scale);
-        CV_Assert(octave >= firstOctave && layer <= nOctaveLayers+2);
-        float size=kpt.size*scale;
-        Point2f ptf(kpt.pt.x*scale, kpt.pt.y*scale);
-        const Mat& img = gpyr[(octave - firstOctave)*(nOctaveLayers + 3) + layer];
-
-        float angle = 360.f - kpt.angle;
-        if(std::abs(angle - 360.f) < FLT_EPSILON)
-            angle = 0.f;
-        calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descriptors.ptr<float>((int)i));
+        int d = SIFT_DESCR_WIDTH, n = SIFT_DESCR_HIST_BINS;
+
+        for( int i = range.start; i < range.end; i++ )
+        {
+            KeyPoint kpt = keypoints[i];
+            int octave, layer;
+            float scale;
+            unpackOctave(kpt, octave, layer, scale);
+            CV_Assert(octave >= firstOctave && layer <= nOctaveLayers+2);
+            float size=kpt.size*scale;
+            Point2f ptf(kpt.pt.x*scale, kpt.pt.y*scale);
+            const Mat& img = gpyr[(octave - firstOctave)*(nOctaveLayers + 3) + layer];
+
+            float angle = 360.f - kpt.angle;
+            if(std::abs(angle - 360.f) < FLT_EPSILON)
+                angle = 0.f;
+            calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descriptors.ptr<float>(i));
+        }
     }
+
+private:
+    SIFTDescriptorInvoker& operator=( const SIFTDescriptorInvoker& );
+
+    const std::vector<Mat>& gpyr;
+    const std::vector<KeyPoint>& keypoints;
+    Mat& descriptors;
+    int nOctaveLayers;
+    int firstOctave;
+};
+
+static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints,
+                            Mat& descriptors, int nOctaveLayers, int firstOctave )
+{
+    parallel_for_(Range(0, (int)keypoints.size()),
+                  SIFTDescriptorInvoker(gpyr, keypoints, descriptors, nOctaveLayers, firstOctave));
+}
+
+// number of octaves of the scale space built from an image of the given size
+static int defaultNOctaves( Size imageSize, int firstOctave )
+{
+    int minSize = std::min(imageSize.width, imageSize.height);
+    if( firstOctave < 0 )
+        minSize *= 2;
+    return cvRound(std::log( (double)minSize ) / std::log(2.) - 2) - firstOctave;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -738,7 +1011,8 @@ static void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyP
 SIFT_Impl::SIFT_Impl( int _nfeatures, int _nOctaveLayers,
            double _contrastThreshold, double _edgeThreshold, double _sigma )
     : nfeatures(_nfeatures), nOctaveLayers(_nOctaveLayers),
-    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma)
+    contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma),
+    pyramidFirstOctave(0)
 {
 }
 
@@ -758,6 +1032,43 @@ int SIFT_Impl::defaultNorm() const
 }
 
 
+void SIFT_Impl::buildPyramid( InputArray _image )
+{
+    Mat image = _image.getMat();
+
+    if( image.empty() || image.depth() != CV_8U )
+        CV_Error( Error::StsBadArg, "image is empty or has incorrect depth (!=CV_8U)" );
+
+    // same scale space as the one built for detection
+    int firstOctave = -1;
+    Mat base = createInitialImage(image, true, (float)sigma);
+    buildGaussianPyramid(base, pyramidGauss, defaultNOctaves(image.size(), firstOctave));
+    buildDoGPyramid(pyramidGauss, pyramidDoG);
+
+    pyramidImage = image;
+    pyramidFirstOctave = firstOctave;
+}
+
+void SIFT_Impl::releasePyramid()
+{
+    pyramidImage.release();
+    pyramidGauss.clear();
+    pyramidDoG.clear();
+    pyramidFirstOctave = 0;
+}
+
+bool SIFT_Impl::hasPyramid( const Mat& image, int firstOctave, int nOctaves ) const
+{
+    // the stored header keeps the image data alive, so comparing data pointers is safe
+    if( pyramidImage.empty() || pyramidImage.data != image.data || pyramidImage.size() != image.size() ||
+        pyramidImage.step != image.step || pyramidImage.type() != image.type() )
+        return false;
+
+    int storedNOctaves = (int)pyramidGauss.size()/(nOctaveLayers + 3);
+    return pyramidFirstOctave <= firstOctave &&
+           pyramidFirstOctave + storedNOctaves >= firstOctave + nOctaves;
+}
+
 void SIFT_Impl::detectAndCompute(InputArray _image, InputArray _mask,
                       std::vector<KeyPoint>& keypoints,
                       OutputArray _descriptors,
@@ -791,14 +1102,24 @@ void SIFT_Impl::detectAndCompute(InputArray _image, InputArray _mask,
         actualNOctaves = maxOctave - firstOctave + 1;
     }
 
-    Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
     std::vector<Mat> gpyr, dogpyr;
-    int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(std::log( (double)std::min( base.cols, base.rows ) ) / std::log(2.) - 2) - firstOctave;
+    int nOctaves = actualNOctaves > 0 ? actualNOctaves : defaultNOctaves(image.size(), firstOctave);
 
     //double t, tf = getTickFrequency();
     //t = (double)getTickCount();
-    buildGaussianPyramid(base, gpyr, nOctaves);
-    buildDoGPyramid(gpyr, dogpyr);
+    if( hasPyramid(image, firstOctave, nOctaves) )
+    {
+        // the stored scale space may start one octave earlier than needed
+        gpyr = pyramidGauss;
+        dogpyr = pyramidDoG;
+        firstOctave = pyramidFirstOctave;
+    }
+    else
+    {
+        Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
+        buildGaussianPyramid(base, gpyr, nOctaves);
+        buildDoGPyramid(gpyr, dogpyr);
+    }
 
     //t = (double)getTickCount() - t;
     //printf("pyramid construction time: %g\n", t*1000./tf);
@@ -109,6 +109,7 @@ Modifications by Ian Mahon
 */
 #include "precomp.hpp"
 #include "surf.hpp"
+#include "opencv2/core/hal/intrin.hpp"
 
 namespace cv
 {
@@ -122,6 +123,12 @@ static const float SURF_DESC_SIGMA     = 3.3f;
 // Wavelet size at first layer of first octave.
 static const int SURF_HAAR_SIZE0 = 9;
 
+// Number of sample rows of a layer handled by one Hessian task
+static const int SURF_STRIPE_ROWS = 32;
+
+// Keypoints are described tile by tile, this is the tile size in pixels
+static const int SURF_KEYPOINT_TILE = 64;
+
 // Wavelet size increment between layers. This should be an even number,
 // such that the wavelet sizes in an octave are either all even or all odd.
 // This ensures that when looking for the neighbours of a sample, the layers
@@ -145,6 +152,36 @@ inline float calcHaarPattern( const int* origin, const SurfHF* f, int n )
     return (float)d;
 }
 
+#if CV_SIMD128
+// Haar pattern responses at 4 consecutive origins
+inline v_float32x4 calcHaarPattern4( const int* origin, const SurfHF* f, int n )
+{
+    v_float32x4 d = v_setzero_f32();
+    for( int k = 0; k < n; k++ )
+    {
+        v_int32x4 v = v_load(origin + f[k].p0) + v_load(origin + f[k].p3) -
+                      v_load(origin + f[k].p1) - v_load(origin + f[k].p2);
+        d += v_cvt_f32(v)*v_setall_f32(f[k].w);
+    }
+    return d;
+}
+
+// Haar pattern responses at 4 arbitrary origins
+inline v_float32x4 gatherHaarPattern4( const int* o0, const int* o1, const int* o2, const int* o3,
+                                       const SurfHF* f, int n )
+{
+    v_float32x4 d = v_setzero_f32();
+    for( int k = 0; k < n; k++ )
+    {
+        int p0 = f[k].p0, p1 = f[k].p1, p2 = f[k].p2, p3 = f[k].p3;
+        v_int32x4 v = v_int32x4(o0[p0], o1[p0], o2[p0], o3[p0]) + v_int32x4(o0[p3], o1[p3], o2[p3], o3[p3]) -
+                      v_int32x4(o0[p1], o1[p1], o2[p1], o3[p1]) - v_int32x4(o0[p2], o1[p2], o2[p2], o3[p2]);
+        d += v_cvt_f32(v)*v_setall_f32(f[k].w);
+    }
+    return d;
+}
+#endif
+
 static void
 resizeHaarPattern( const int src[][5], SurfHF* dst, int n, int oldSize, int newSize, int widthStep )
 {
@@ -164,11 +201,11 @@ resizeHaarPattern( const int src[][5], SurfHF* dst, int n, int oldSize, int newS
 }
 
 /*
- * Calculate the determinant and trace of the Hessian for a layer of the
- * scale-space pyramid
+ * Calculate the determinant and trace of the Hessian for the given sample
+ * rows of a layer of the scale-space pyramid
  */
 static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
-                                  Mat& det, Mat& trace )
+                                  Mat& det, Mat& trace, const Range& rows )
 {
     const int NX=3, NY=3, NXY=4;
     const int dx_s[NX][5] = { {0, 2, 3, 7, 1}, {3, 2, 6, 7, -2}, {6, 2, 9, 7, 1} };
@@ -191,12 +228,29 @@ static void calcLayerDetAndTrace( const Mat& sum, int size, int sampleStep,
     /* Ignore pixels where some of the kernel is outside the image */
     int margin = (size/2)/sampleStep;
 
-    for( int i = 0; i < samples_i; i++ )
+    int i_end = std::min( rows.end, samples_i );
+    for( int i = rows.start; i < i_end; i++ )
     {
         const int* sum_ptr = sum.ptr<int>(i*sampleStep);
         float* det_ptr = &det.at<float>(i+margin, margin);
         float* trace_ptr = &trace.at<float>(i+margin, margin);
-        for( int j = 0; j < samples_j; j++ )
+        int j = 0;
+#if CV_SIMD128
+        if( sampleStep == 1 )
+        {
+            const v_float32x4 v081 = v_setall_f32(0.81f);
+            for( ; j <= samples_j - 4; j += 4 )
+            {
+                v_float32x4 dx  = calcHaarPattern4( sum_ptr + j, Dx , 3 );
+                v_float32x4 dy  = calcHaarPattern4( sum_ptr + j, Dy , 3 );
+                v_float32x4 dxy = calcHaarPattern4( sum_ptr + j, Dxy, 4 );
+                v_store( det_ptr + j, dx*dy - v081*dxy*dxy );
+                v_store( trace_ptr + j, dx + dy );
+            }
+            sum_ptr += j;
+        }
+#endif
+        for( ; j < samples_j; j++ )
         {
             float dx  = calcHaarPattern( sum_ptr, Dx , 3 );
             float dy  = calcHaarPattern( sum_ptr, Dy , 3 );
@@ -265,19 +319,27 @@ struct SURFBuildInvoker : ParallelLoopBody
 {
     SURFBuildInvoker( const Mat& _sum, const std::vector<int>& _sizes,
                       const std::vector<int>& _sampleSteps,
-                      std::vector<Mat>& _dets, std::vector<Mat>& _traces )
+                      std::vector<Mat>& _dets, std::vector<Mat>& _traces,
+                      const std::vector<Vec3i>& _stripes )
     {
         sum = &_sum;
         sizes = &_sizes;
         sampleSteps = &_sampleSteps;
         dets = &_dets;
         traces = &_traces;
+        stripes = &_stripes;
     }
 
     void operator()(const Range& range) const
     {
         for( int i=range.start; i<range.end; i++ )
-            calcLayerDetAndTrace( *sum, (*sizes)[i], (*sampleSteps)[i], (*dets)[i], (*traces)[i] );
+        {
+            // layer index, first and last sample rows
+            const Vec3i& stripe = (*stripes)[i];
+            int layer = stripe[0];
+            calcLayerDetAndTrace( *sum, (*sizes)[layer], (*sampleSteps)[layer], (*dets)[layer],
+                                  (*traces)[layer], Range(stripe[1], stripe[2]) );
+        }
     }
 
     const Mat *sum;
@@ -285,6 +347,7 @@ struct SURFBuildInvoker : ParallelLoopBody
     const std::vector<int> *sampleSteps;
     std::vector<Mat>* dets;
     std::vector<Mat>* traces;
+    const std::vector<Vec3i>* stripes;
 };
 
 // Multi-threaded search of the scale-space pyramid for keypoints
@@ -369,6 +432,9 @@ void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
        resizeHaarPattern( dm, &Dm, NM, 9, size, mask_sum.cols );
 
     int step = (int)(dets[layer].step/dets[layer].elemSize());
+#if CV_SIMD128
+    const v_float32x4 vthreshold = v_setall_f32(hessianThreshold);
+#endif
 
     for( int i = margin; i < layer_rows - margin; i++ )
     {
@@ -376,6 +442,14 @@ void SURFFindInvoker::findMaximaInLayer( const Mat& sum, const Mat& mask_sum,
         const float* trace_ptr = traces[layer].ptr<float>(i);
         for( int j = margin; j < layer_cols-margin; j++ )
         {
+#if CV_SIMD128
+            // skip runs of 4 samples below the threshold
+            if( j + 4 <= layer_cols-margin && v_signmask(v_load(det_ptr + j) > vthreshold) == 0 )
+            {
+                j += 3;
+                continue;
+            }
+#endif
             float val0 = det_ptr[j];
             if( val0 > hessianThreshold )
             {
@@ -501,9 +575,16 @@ static void fastHessianDetector( const Mat& sum, const Mat& mask_sum, std::vecto
         step *= 2;
     }
 
+    // Split the layers into stripes of sample rows, the layers of the first
+    // octave being much larger than the others
+    std::vector<Vec3i> stripes;
+    for( int i = 0; i < nTotalLayers; i++ )
+        for( int r = 0; r < dets[i].rows; r += SURF_STRIPE_ROWS )
+            stripes.push_back( Vec3i(i, r, std::min(r + SURF_STRIPE_ROWS, dets[i].rows)) );
+
     // Calculate hessian determinant and trace samples in each layer
-    parallel_for_( Range(0, nTotalLayers),
-                   SURFBuildInvoker(sum, sizes, sampleSteps, dets, traces) );
+    parallel_for_( Range(0, (int)stripes.size()),
+                   SURFBuildInvoker(sum, sizes, sampleSteps, dets, traces, stripes) );
 
     // Find maxima in the determinant of the hessian
     parallel_for_( Range(0, nMiddleLayers),
@@ -520,39 +601,43 @@ struct SURFInvoker : ParallelLoopBody
     enum { ORI_RADIUS = 6, ORI_WIN = 60, PATCH_SZ = 20 };
 
     SURFInvoker( const Mat& _img, const Mat& _sum,
-                 std::vector<KeyPoint>& _keypoints, Mat& _descriptors,
-                 bool _extended, bool _upright )
+                 std::vector<KeyPoint>& _keypoints, const std::vector<int>& _order,
+                 Mat& _descriptors, bool _extended, bool _upright )
     {
         keypoints = &_keypoints;
+        order = &_order;
         descriptors = &_descriptors;
         img = &_img;
         sum = &_sum;
         extended = _extended;
         upright = _upright;
 
-        // Simple bound for number of grid points in circle of radius ORI_RADIUS
-        const int nOriSampleBound = (2*ORI_RADIUS+1)*(2*ORI_RADIUS+1);
-
-        // Allocate arrays
-        apt.resize(nOriSampleBound);
-        aptw.resize(nOriSampleBound);
         DW.resize(PATCH_SZ*PATCH_SZ);
 
-        /* Coordinates and weights of samples used to calculate orientation */
-        Mat G_ori = getGaussianKernel( 2*ORI_RADIUS+1, SURF_ORI_SIGMA, CV_32F );
+        /* Coordinates and weights of samples used to calculate orientation,
+           upright features do not need them */
         nOriSamples = 0;
-        for( int i = -ORI_RADIUS; i <= ORI_RADIUS; i++ )
+        if( !upright )
         {
-            for( int j = -ORI_RADIUS; j <= ORI_RADIUS; j++ )
+            // Simple bound for number of grid points in circle of radius ORI_RADIUS
+            const int nOriSampleBound = (2*ORI_RADIUS+1)*(2*ORI_RADIUS+1);
+            apt.resize(nOriSampleBound);
+            aptw.resize(nOriSampleBound);
+
+            Mat G_ori = getGaussianKernel( 2*ORI_RADIUS+1, SURF_ORI_SIGMA, CV_32F );
+            for( int i = -ORI_RADIUS; i <= ORI_RADIUS; i++ )
             {
-                if( i*i + j*j <= ORI_RADIUS*ORI_RADIUS )
+                for( int j = -ORI_RADIUS; j <= ORI_RADIUS; j++ )
                 {
-                    apt[nOriSamples] = Point(i,j);
-                    aptw[nOriSamples++] = G_ori.at<float>(i+ORI_RADIUS,0) * G_ori.at<float>(j+ORI_RADIUS,0);
+                    if( i*i + j*j <= ORI_RADIUS*ORI_RADIUS )
+                    {
+                        apt[nOriSamples] = Point(i,j);
+                        aptw[nOriSamples++] = G_ori.at<float>(i+ORI_RADIUS,0) * G_ori.at<float>(j+ORI_RADIUS,0);
+                    }
                 }
             }
+            CV_Assert( nOriSamples <= nOriSampleBound );
         }
-        CV_Assert( nOriSamples <= nOriSampleBound );
 
         /* Gaussian used to weight descriptor samples */
         Mat G_desc = getGaussianKernel( PATCH_SZ, SURF_DESC_SIGMA, CV_32F );
@@ -574,27 +659,29 @@ struct SURFInvoker : ParallelLoopBody
         // array lengths.  Maybe because it is a constant known at compile time
         const int nOriSampleBound =(2*ORI_RADIUS+1)*(2*ORI_RADIUS+1);
 
-        float X[nOriSampleBound], Y[nOriSampleBound], angle[nOriSampleBound];
+        float X[nOriSampleBound], Y[nOriSampleBound], angle[nOriSampleBound], W[nOriSampleBound];
+        int ofs[nOriSampleBound], iangle[nOriSampleBound];
         uchar PATCH[PATCH_SZ+1][PATCH_SZ+1];
         float DX[PATCH_SZ][PATCH_SZ], DY[PATCH_SZ][PATCH_SZ];
         Mat _patch(PATCH_SZ+1, PATCH_SZ+1, CV_8U, PATCH);
 
         int dsize = extended ? 128 : 64;
 
-        int k, k1 = range.start, k2 = range.end;
+        int idx, idx1 = range.start, idx2 = range.end;
         float maxSize = 0;
-        for( k = k1; k < k2; k++ )
+        for( idx = idx1; idx < idx2; idx++ )
         {
-            maxSize = std::max(maxSize, (*keypoints)[k].size);
+            maxSize = std::max(maxSize, (*keypoints)[(*order)[idx]].size);
         }
         int imaxSize = std::max(cvCeil((PATCH_SZ+1)*maxSize*1.2f/9.0f), 1);
         cv::AutoBuffer<uchar> winbuf(imaxSize*imaxSize);
 
-        for( k = k1; k < k2; k++ )
+        for( idx = idx1; idx < idx2; idx++ )
         {
             int i, j, kk, nangle;
             float* vec;
             SurfHF dx_t[NX], dy_t[NY];
+            int k = (*order)[idx];
             KeyPoint& kp = (*keypoints)[k];
             float size = kp.size;
             Point2f center = kp.pt;
@@ -627,13 +714,30 @@ struct SURFInvoker : ParallelLoopBody
                     if( y < 0 || y >= sum->rows - grad_wav_size ||
                         x < 0 || x >= sum->cols - grad_wav_size )
                         continue;
-                    const int* ptr = &sum->at<int>(y, x);
-                    float vx = calcHaarPattern( ptr, dx_t, 2 );
-                    float vy = calcHaarPattern( ptr, dy_t, 2 );
-                    X[nangle] = vx*aptw[kk];
-                    Y[nangle] = vy*aptw[kk];
+                    ofs[nangle] = y*sum->cols + x;
+                    W[nangle] = aptw[kk];
                     nangle++;
                 }
+
+                // Haar responses of the samples inside the image
+                const int* sum0 = sum->ptr<int>();
+                kk = 0;
+#if CV_SIMD128
+                for( ; kk <= nangle - 4; kk += 4 )
+                {
+                    const int *o0 = sum0 + ofs[kk], *o1 = sum0 + ofs[kk+1],
+                              *o2 = sum0 + ofs[kk+2], *o3 = sum0 + ofs[kk+3];
+                    v_float32x4 w = v_load(W + kk);
+                    v_store(X + kk, gatherHaarPattern4( o0, o1, o2, o3, dx_t, NX )*w);
+                    v_store(Y + kk, gatherHaarPattern4( o0, o1, o2, o3, dy_t, NY )*w);
+                }
+#endif
+                for( ; kk < nangle; kk++ )
+                {
+                    const int* ptr = sum0 + ofs[kk];
+                    X[kk] = calcHaarPattern( ptr, dx_t, NX )*W[kk];
+                    Y[kk] = calcHaarPattern( ptr, dy_t, NY )*W[kk];
+                }
                 if( nangle == 0 )
                 {
                     // No gradient could be sampled because the keypoint is too
@@ -646,13 +750,36 @@ struct SURFInvoker : ParallelLoopBody
 
                 phase( Mat(1, nangle, CV_32F, X), Mat(1, nangle, CV_32F, Y), Mat(1, nangle, CV_32F, angle), true );
 
+                for( j = 0; j < nangle; j++ )
+                    iangle[j] = cvRound(angle[j]);
+
                 float bestx = 0, besty = 0, descriptor_mod = 0;
+#if CV_SIMD128
+                const v_int32x4 vzero = v_setzero_s32();
+                const v_int32x4 vwin_lo = v_setall_s32(ORI_WIN/2), vwin_hi = v_setall_s32(360-ORI_WIN/2);
+#endif
                 for( i = 0; i < 360; i += SURF_ORI_SEARCH_INC )
                 {
                     float sumx = 0, sumy = 0, temp_mod;
-                    for( j = 0; j < nangle; j++ )
+                    j = 0;
+#if CV_SIMD128
+                    // sum the responses whose angle lies in the sliding window
+                    v_float32x4 vsumx = v_setzero_f32(), vsumy = v_setzero_f32();
+                    v_int32x4 vi = v_setall_s32(i);
+                    for( ; j <= nangle - 4; j += 4 )
+                    {
+                        v_int32x4 d = v_load(iangle + j) - vi;
+                        d = v_max(d, vzero - d);
+                        v_float32x4 inwin = v_reinterpret_as_f32((d < vwin_lo) | (d > vwin_hi));
+                        vsumx += v_load(X + j) & inwin;
+                        vsumy += v_load(Y + j) & inwin;
+                    }
+                    sumx = v_reduce_sum(vsumx);
+                    sumy = v_reduce_sum(vsumy);
+#endif
+                    for( ; j < nangle; j++ )
                     {
-                        int d = std::abs(cvRound(angle[j]) - i);
+                        int d = std::abs(iangle[j] - i);
                         if( d < ORI_WIN/2 || d > 360-ORI_WIN/2 )
                         {
                             sumx += X[j];
@@ -754,17 +881,32 @@ struct SURFInvoker : ParallelLoopBody
                 int start_x = cvRound(center.x + win_offset);
                 int start_y = cvRound(center.y - win_offset);
                 uchar* WIN = win.data;
-                for( i = 0; i < win_size; i++, start_x++ )
+                if( start_x >= 0 && start_x + win_size <= img->cols &&
+                    start_y - win_size + 1 >= 0 && start_y < img->rows )
                 {
-                    int pixel_x = start_x;
-                    int pixel_y = start_y;
-                    for( j = 0; j < win_size; j++, pixel_y-- )
+                    // the window is inside the image, no clamping needed;
+                    // WIN is the rect transposed, read it one image row at a time
+                    for( j = 0; j < win_size; j++ )
                     {
-                        int x = MAX( pixel_x, 0 );
-                        int y = MAX( pixel_y, 0 );
-                        x = MIN( x, img->cols-1 );
-                        y = MIN( y, img->rows-1 );
-                        WIN[i*win_size + j] = img->at<uchar>(y, x);
+                        const uchar* imgptr = img->ptr<uchar>(start_y - j) + start_x;
+                        for( i = 0; i < win_size; i++ )
+                            WIN[i*win_size + j] = imgptr[i];
+                    }
+                }
+                else
+                {
+                    for( i = 0; i < win_size; i++, start_x++ )
+                    {
+                        int pixel_x = start_x;
+                        int pixel_y = start_y;
+                        for( j = 0; j < win_size; j++, pixel_y-- )
+                        {
+                            int x = MAX( pixel_x, 0 );
+                            int y = MAX( pixel_y, 0 );
+                            x = MIN( x, img->cols-1 );
+                            y = MIN( y, img->rows-1 );
+                            WIN[i*win_size + j] = img->at<uchar>(y, x);
+                        }
                     }
                 }
             }
@@ -774,7 +916,26 @@ struct SURFInvoker : ParallelLoopBody
 
             // Calculate gradients in x and y with wavelets of size 2s
             for( i = 0; i < PATCH_SZ; i++ )
-                for( j = 0; j < PATCH_SZ; j++ )
+            {
+                j = 0;
+#if CV_SIMD128
+                for( ; j <= PATCH_SZ - 8; j += 8 )
+                {
+                    v_int16x8 p00 = v_reinterpret_as_s16(v_load_expand(&PATCH[i][j]));
+                    v_int16x8 p01 = v_reinterpret_as_s16(v_load_expand(&PATCH[i][j+1]));
+                    v_int16x8 p10 = v_reinterpret_as_s16(v_load_expand(&PATCH[i+1][j]));
+                    v_int16x8 p11 = v_reinterpret_as_s16(v_load_expand(&PATCH[i+1][j+1]));
+                    v_int32x4 vx0, vx1, vy0, vy1;
+                    v_expand(p01 - p00 + p11 - p10, vx0, vx1);
+                    v_expand(p10 - p00 + p11 - p01, vy0, vy1);
+                    v_float32x4 dw0 = v_load(&DW[i*PATCH_SZ + j]), dw1 = v_load(&DW[i*PATCH_SZ + j + 4]);
+                    v_store(&DX[i][j], v_cvt_f32(vx0)*dw0);
+                    v_store(&DX[i][j+4], v_cvt_f32(vx1)*dw1);
+                    v_store(&DY[i][j], v_cvt_f32(vy0)*dw0);
+                    v_store(&DY[i][j+4], v_cvt_f32(vy1)*dw1);
+                }
+#endif
+                for( ; j < PATCH_SZ; j++ )
                 {
                     float dw = DW[i*PATCH_SZ + j];
                     float vx = (PATCH[i][j+1] - PATCH[i][j] + PATCH[i+1][j+1] - PATCH[i+1][j])*dw;
@@ -782,6 +943,7 @@ struct SURFInvoker : ParallelLoopBody
                     DX[i][j] = vx;
                     DY[i][j] = vy;
                 }
+            }
 
             // Construct the descriptor
             vec = descriptors->ptr<float>(k);
@@ -846,7 +1008,13 @@ struct SURFInvoker : ParallelLoopBody
             // unit vector is essential for contrast invariance
             vec = descriptors->ptr<float>(k);
             float scale = (float)(1./(std::sqrt(square_mag) + DBL_EPSILON));
-            for( kk = 0; kk < dsize; kk++ )
+            kk = 0;
+#if CV_SIMD128
+            v_float32x4 vscale = v_setall_f32(scale);
+            for( ; kk <= dsize - 4; kk += 4 )
+                v_store(vec + kk, v_load(vec + kk)*vscale);
+#endif
+            for( ; kk < dsize; kk++ )
                 vec[kk] *= scale;
         }
     }
@@ -855,6 +1023,7 @@ struct SURFInvoker : ParallelLoopBody
     const Mat* img;
     const Mat* sum;
     std::vector<KeyPoint>* keypoints;
+    const std::vector<int>* order;
     Mat* descriptors;
     bool extended;
     bool upright;
@@ -867,6 +1036,29 @@ struct SURFInvoker : ParallelLoopBody
 };
 
 
+/*
+ * Order the keypoints tile by tile so that neighbouring keypoints, which read
+ * the same parts of the image and of its integral, are described one after
+ * the other by the same thread
+ */
+static void orderKeypointsByTile( const std::vector<KeyPoint>& keypoints, std::vector<int>& order )
+{
+    int N = (int)keypoints.size();
+    std::vector<std::pair<int64, int> > tiles(N);
+    for( int k = 0; k < N; k++ )
+    {
+        int64 tx = std::max(cvFloor(keypoints[k].pt.x), 0) / SURF_KEYPOINT_TILE;
+        int64 ty = std::max(cvFloor(keypoints[k].pt.y), 0) / SURF_KEYPOINT_TILE;
+        tiles[k] = std::make_pair( (ty << 32) | tx, k );
+    }
+    std::sort( tiles.begin(), tiles.end() );
+
+    order.resize(N);
+    for( int k = 0; k < N; k++ )
+        order[k] = tiles[k].second;
+}
+
+
 SURF_Impl::SURF_Impl(double _threshold, int _nOctaves, int _nOctaveLayers, bool _extended, bool _upright)
 {
     hessianThreshold = _threshold;
@@ -967,9 +1159,12 @@ void SURF_Impl::detectAndCompute(InputArray _img, InputArray _mask,
             }
         }
 
+        std::vector<int> order;
+        orderKeypointsByTile( keypoints, order );
+
         // we call SURFInvoker in any case, even if we do not need descriptors,
         // since it computes orientation of each feature.
-        parallel_for_(Range(0, N), SURFInvoker(img, sum, keypoints, descriptors, extended, upright) );
+        parallel_for_(Range(0, N), SURFInvoker(img, sum, keypoints, order, descriptors, extended, upright) );
 
         // remove keypoints that were marked for deletion
         for( i = j = 0; i < N; i++ )
@@ -54,6 +54,7 @@
  */
 
 #include "precomp.hpp"
+#include "feature_context.hpp"
 
 
 
@@ -69,7 +70,7 @@ namespace xfeatures2d
 /*
  !VGG implementation
  */
-class VGG_Impl : public VGG
+class VGG_Impl : public VGG, public ContextDescriptorExtractor
 {
 
 public:
@@ -94,6 +95,9 @@ public:
     // compute descriptors given keypoints
     virtual void compute( InputArray image, vector<KeyPoint>& keypoints, OutputArray descriptors );
 
+    // compute descriptors given keypoints, using the smoothed image of the context
+    virtual void computeFromContext( ImageFeatureContext& context, vector<KeyPoint>& keypoints, OutputArray descriptors );
+
 protected:
 
     /*
@@ -377,23 +381,20 @@ void VGG_Impl::compute( InputArray _image, vector<KeyPoint>& keypoints, OutputAr
     if( _image.getMat().empty() )
       return;
 
-    m_image = _image.getMat().clone();
-
     // Only 8bit images
-    CV_Assert( m_image.depth() == CV_8U );
+    CV_Assert( _image.depth() == CV_8U );
 
-    // convert to gray inplace
-    if( m_image.channels() > 1 )
-      cvtColor( m_image, m_image, COLOR_BGR2GRAY );
+    Ptr<ImageFeatureContext> context = ImageFeatureContext::create( _image );
+    computeFromContext( *context, keypoints, _descriptors );
+}
 
-    //convert
-    Mat image;
-    m_image.convertTo( image, CV_32F );
-    m_image = image;
-    image.release();
+void VGG_Impl::computeFromContext( ImageFeatureContext& context, vector<KeyPoint>& keypoints, OutputArray _descriptors )
+{
+    // Only 8bit images
+    CV_Assert( context.getGray().depth() == CV_8U );
 
-    // smooth whole image
-    GaussianBlur( m_image, m_image, Size( 0, 0 ), m_isigma, m_isigma, BORDER_REPLICATE );
+    // gray image converted to float and smoothed
+    m_image = context.getSmoothed( CV_32F, Size( 0, 0 ), m_isigma, BORDER_REPLICATE );
 
     // allocate array
     _descriptors.create( (int) keypoints.size(), m_descriptor_size, CV_32F );
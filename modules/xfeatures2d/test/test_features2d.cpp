@@ -41,6 +41,7 @@
 
 #include "test_precomp.hpp"
 #include "opencv2/calib3d.hpp"
+#include "../src/feature_context.hpp"
 
 using namespace std;
 using namespace cv;
@@ -1348,3 +1349,207 @@ TEST( XFeatures2d_DescriptorExtractor, batch )
         EXPECT_GT(descriptors[i].rows, 100);
     }
 }
+
+TEST( Features2d_SIFT, reusedPyramid )
+{
+    string path = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(path, 0);
+    ASSERT_FALSE(img.empty());
+
+    Mat mask(img.size(), CV_8UC1, Scalar(0));
+    mask(Rect(0, 0, img.cols/2, img.rows)).setTo(255);
+
+    Ptr<SIFT> sift = SIFT::create();
+    vector<KeyPoint> keypoints, keypointsReused;
+    Mat descriptors, descriptorsReused;
+    sift->detectAndCompute(img, mask, keypoints, descriptors);
+
+    sift->buildPyramid(img);
+    sift->detectAndCompute(img, mask, keypointsReused, descriptorsReused);
+    sift->releasePyramid();
+
+    ASSERT_EQ(keypoints.size(), keypointsReused.size());
+    for( size_t i = 0; i < keypoints.size(); i++ )
+    {
+        EXPECT_EQ(keypoints[i].pt, keypointsReused[i].pt);
+        EXPECT_EQ(keypoints[i].octave, keypointsReused[i].octave);
+    }
+    EXPECT_EQ(0, cvtest::norm(descriptors, descriptorsReused, NORM_INF));
+}
+
+class DAISYBandCollector : public DAISY::BandCallback
+{
+public:
+    DAISYBandCollector() : nextRow(0) {}
+
+    void operator()( const Range& rows, const Mat& descriptors )
+    {
+        EXPECT_EQ(nextRow, rows.start);
+        nextRow = rows.end;
+        all.push_back(descriptors);
+    }
+
+    int nextRow;
+    Mat all;
+};
+
+TEST( Features2d_DAISY, computeByBands )
+{
+    string path = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(path, 0);
+    ASSERT_FALSE(img.empty());
+    resize(img, img, Size(), 0.5, 0.5);
+
+    Ptr<DAISY> daisy = DAISY::create();
+    Mat descriptors;
+    daisy->compute(img, descriptors);
+
+    DAISYBandCollector collector;
+    daisy->compute(img, collector, 37);
+
+    EXPECT_EQ(img.rows, collector.nextRow);
+    ASSERT_EQ(descriptors.size(), collector.all.size());
+    EXPECT_LE(cvtest::norm(descriptors, collector.all, NORM_INF), 1e-5);
+}
+
+// The preprocessing the extractors did on their own before ImageFeatureContext existed,
+// recomputed on every request and with the patches rectified one after another
+class ReferenceFeatureContext : public ImageFeatureContext
+{
+public:
+    explicit ReferenceFeatureContext( const Mat& image )
+    {
+        m_image = image;
+        if( m_image.channels() > 1 )
+            cvtColor( m_image, m_gray, COLOR_BGR2GRAY );
+        else
+            m_gray = m_image;
+    }
+
+    virtual void compute( const Ptr<Feature2D>& extractor, vector<KeyPoint>& keypoints, OutputArray descriptors )
+    {
+        ContextDescriptorExtractor* ctx_extractor = dynamic_cast<ContextDescriptorExtractor*>( extractor.get() );
+        if( ctx_extractor )
+            ctx_extractor->computeFromContext( *this, keypoints, descriptors );
+        else
+            extractor->compute( m_gray, keypoints, descriptors );
+    }
+
+    virtual Mat getImage() const { return m_image; }
+    virtual const Mat& getGray() const { return m_gray; }
+
+    virtual Mat getSmoothed( int ddepth, Size ksize, double sigma, int borderType )
+    {
+        Mat smoothed;
+        m_gray.convertTo( smoothed, ddepth );
+        GaussianBlur( smoothed, smoothed, ksize, sigma, sigma, borderType );
+        return smoothed;
+    }
+
+    virtual Mat getIntegral( int sdepth )
+    {
+        Mat sum;
+        integral( m_gray, sum, sdepth );
+        return sum;
+    }
+
+    virtual Mat getRectifiedPatches( const vector<KeyPoint>& keypoints, int patchSize,
+                                     bool useScaleOrientation, float scaleFactor )
+    {
+        Mat patches( (int)keypoints.size(), patchSize * patchSize, m_gray.type() );
+        for( size_t i = 0; i < keypoints.size(); i++ )
+        {
+            const KeyPoint& kp = keypoints[i];
+            Mat M;
+            if( useScaleOrientation )
+            {
+                const float s = scaleFactor * (float) kp.size / (float) patchSize;
+                const float cosine = (kp.angle>=0) ? cos(kp.angle*(float)CV_PI/180.0f) : 1.f;
+                const float sine   = (kp.angle>=0) ? sin(kp.angle*(float)CV_PI/180.0f) : 0.f;
+                float M_[] = {
+                    s*cosine, -s*sine,   (-s*cosine + s*sine  ) * patchSize/2.0f + kp.pt.x,
+                    s*sine,    s*cosine, (-s*sine   - s*cosine) * patchSize/2.0f + kp.pt.y
+                };
+                M = Mat( 2, 3, CV_32FC1, M_ ).clone();
+            }
+            else
+            {
+                float M_[] = {
+                    1.f,  0.f, -1.f * patchSize/2.0f + kp.pt.x,
+                    0.f,  1.f, -1.f * patchSize/2.0f + kp.pt.y
+                };
+                M = Mat( 2, 3, CV_32FC1, M_ ).clone();
+            }
+            Mat patch;
+            warpAffine( m_gray, patch, M, Size( patchSize, patchSize ),
+                        WARP_INVERSE_MAP + INTER_CUBIC + WARP_FILL_OUTLIERS );
+            patch.reshape( 1, 1 ).copyTo( patches.row( (int)i ) );
+        }
+        return patches;
+    }
+
+    virtual void clear() {}
+
+private:
+    Mat m_image, m_gray;
+};
+
+TEST( Features2d_ImageFeatureContext, sameDescriptors )
+{
+    string path = string(cvtest::TS::ptr()->get_data_path() + "detectors_descriptors_evaluation/images_datasets/graf/img1.png");
+    Mat img = imread(path, IMREAD_GRAYSCALE);
+    ASSERT_FALSE(img.empty());
+
+    vector<KeyPoint> keypoints;
+    SURF::create()->detect(img, keypoints);
+    ASSERT_FALSE(keypoints.empty());
+
+    vector<Ptr<Feature2D> > extractors;
+    extractors.push_back(BoostDesc::create(BoostDesc::BINBOOST_256));
+    extractors.push_back(BoostDesc::create(BoostDesc::BGM));
+    extractors.push_back(VGG::create());
+    extractors.push_back(LATCH::create());
+    extractors.push_back(BriefDescriptorExtractor::create());
+    extractors.push_back(FREAK::create());
+    const size_t n = extractors.size();
+
+    // reference descriptors, with the preprocessing of the extractors before the context
+    vector<vector<KeyPoint> > refKeypoints(n, keypoints);
+    vector<Mat> refDescriptors(n);
+    for( size_t i = 0; i < n; i++ )
+    {
+        ReferenceFeatureContext reference(img);
+        reference.compute(extractors[i], refKeypoints[i], refDescriptors[i]);
+        ASSERT_FALSE(refDescriptors[i].empty()) << "extractor " << i;
+    }
+
+    // each extractor alone, through Feature2D::compute
+    for( size_t i = 0; i < n; i++ )
+    {
+        vector<KeyPoint> kpts = keypoints;
+        Mat descriptors;
+        extractors[i]->compute(img, kpts, descriptors);
+
+        ASSERT_EQ(refKeypoints[i].size(), kpts.size()) << "extractor " << i;
+        ASSERT_EQ(refDescriptors[i].size(), descriptors.size()) << "extractor " << i;
+        EXPECT_EQ(0, cvtest::norm(refDescriptors[i], descriptors, NORM_INF)) << "extractor " << i;
+    }
+
+    // all the extractors sharing one context, in both orders so that each one
+    // also runs on data cached by the others
+    Ptr<ImageFeatureContext> context = ImageFeatureContext::create(img);
+    for( int pass = 0; pass < 2; pass++ )
+    {
+        for( size_t k = 0; k < n; k++ )
+        {
+            size_t i = pass == 0 ? k : n - 1 - k;
+            vector<KeyPoint> kpts = keypoints;
+            Mat descriptors;
+            context->compute(extractors[i], kpts, descriptors);
+
+            ASSERT_EQ(refKeypoints[i].size(), kpts.size()) << "extractor " << i << ", pass " << pass;
+            ASSERT_EQ(refDescriptors[i].size(), descriptors.size()) << "extractor " << i << ", pass " << pass;
+            EXPECT_EQ(0, cvtest::norm(refDescriptors[i], descriptors, NORM_INF)) << "extractor " << i << ", pass " << pass;
+        }
+    }
+}